@@ -0,0 +1,49 @@
+#pragma once
+// Platform independent part of common.h
+// Everything in here must compile without d3d12/windows headers so the cpu/ pipeline can be built on any platform.
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+
+// std :(
+#include <vector>
+
+#define CONSUME_VAR(v_)       ((void)(v_))
+#define ASSERT(x_)                                  \
+    if (false == (x_)) {                             \
+        ::printf("[ERROR] " #x_ "() failed. \n");   \
+        ::abort();                                  \
+    }                                               \
+    /**/
+
+// Vertex/Index Buffer:
+struct Vertex {
+    float       pos[4];
+    float       normal[4];
+    float       col[4];
+    float       uv[2];
+};
+
+using IndexType = uint32_t;
+
+struct Mesh {
+    std::vector<Vertex> vertices;
+    std::vector<IndexType> indices;
+};
+
+// Read only Mesh that doesn't own its vertices and indices, e.g. pointing into a mapped mesh file (cpu/mesh_file.hpp).
+struct MeshView {
+    Vertex const *      vertices = nullptr;
+    IndexType const *   indices = nullptr;
+    uint32_t            vertex_count = 0;
+    uint32_t            index_count = 0;
+};
+
+inline MeshView GetMeshView(Mesh const & mesh) {
+    MeshView view = {};
+    view.vertices = mesh.vertices.data();
+    view.indices = mesh.indices.data();
+    view.vertex_count = static_cast<uint32_t>(mesh.vertices.size());
+    view.index_count = static_cast<uint32_t>(mesh.indices.size());
+    return view;
+}
@@ -5,6 +5,9 @@
 #include <filesystem>
 #include <chrono>
 
+// Platform independent types (Vertex, Mesh) and macros.
+#include "base.h"
+
 // DirectX 12 specific headers.
 #include <d3d12.h>
 #include <dxgi1_6.h>
@@ -89,13 +92,6 @@ odbccp32.lib
 runtimeobject.lib
 */
 
-#define CONSUME_VAR(v_)       ((void)(v_))
-#define ASSERT(x_)                                  \
-    if (false == (x_)) {                             \
-        ::printf("[ERROR] " #x_ "() failed. \n");   \
-        ::abort();                                  \
-    }                                               \
-    /**/
 #define SUCCEEDED(hr)   (((HRESULT)(hr)) >= 0)
 #define FAILED(hr)      (((HRESULT)(hr)) < 0)
 #define CHECK_AND_FAIL(hr)                          \
@@ -111,23 +107,8 @@ runtimeobject.lib
 #define ENABLE_DEBUG_LAYER 0
 #endif
 
-// Vertex/Index Buffer:
-struct Vertex {
-    float       pos[4];
-    float       normal[4];
-    float       col[4];
-    float       uv[2];
-};
-
-
-using IndexType = uint32_t;
 static DXGI_FORMAT IndexBufferFormat = DXGI_FORMAT_R32_UINT;
 
-struct Mesh {
-    std::vector<Vertex> vertices;
-    std::vector<IndexType> indices;
-};
-
 inline D3D12_HEAP_PROPERTIES GetDefaultHeapProps(D3D12_HEAP_TYPE type) {
     D3D12_HEAP_PROPERTIES ret = {};
     ret.Type = type;
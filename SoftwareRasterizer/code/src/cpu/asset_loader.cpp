@@ -0,0 +1,244 @@
+#include "asset_loader.hpp"
+
+#include "mesh_file.hpp"
+#include "obj_importer.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+static bool HasExtension(std::string const & path, char const * extension) {
+    size_t const length = strlen(extension);
+    if(path.size() < length) {
+        return false;
+    }
+    for(size_t i = 0; i < length; ++i) {
+        char c = path[path.size() - length + i];
+        if('A' <= c && 'Z' >= c) {
+            c = static_cast<char>(c - 'A' + 'a');
+        }
+        if(c != extension[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool LoadMeshFile(char const * path, Mesh & out) {
+    MappedMeshFile file;
+    if(false == file.Open(path)) {
+        return false;
+    }
+    MeshView const & mesh = file.GetView().mesh;
+    out.vertices.assign(mesh.vertices, mesh.vertices + mesh.vertex_count);
+    out.indices.assign(mesh.indices, mesh.indices + mesh.index_count);
+    return true;
+}
+
+AssetLoader::~AssetLoader() {
+    Exit();
+}
+
+void AssetLoader::Init(uint32_t thread_count) {
+    ASSERT(workers.empty());
+    if(0 == thread_count) {
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+    quit = false;
+    assets.clear();
+    completions.clear();
+    stats = {};
+    workers.reserve(thread_count);
+    for(uint32_t i = 0; i < thread_count; ++i) {
+        workers.emplace_back(&AssetLoader::WorkerMain, this);
+    }
+}
+
+void AssetLoader::Exit() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+        // Dropped requests complete as failed, so WaitIdle and PollCompletions see every request through
+        for(AssetHandle handle : queue) {
+            Asset & asset = assets[handle];
+            asset.state = AssetState::Failed;
+
+            AssetCompletion completion = {};
+            completion.handle = handle;
+            completion.type = asset.type;
+            completion.loaded = false;
+            completion.load_ms = 0.0f;
+            completions.push_back(completion);
+
+            ++stats.failed;
+            --stats.pending;
+        }
+        queue.clear();
+    }
+    wake_cv.notify_all();
+    idle_cv.notify_all();
+    for(std::thread & worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+    texture_cache = nullptr;
+}
+
+void AssetLoader::SetTextureCache(TextureCache * cache) {
+    std::lock_guard<std::mutex> lock(mutex);
+    texture_cache = cache;
+}
+
+AssetHandle AssetLoader::RequestTexture(char const * path, TextureBuildOptions const & options) {
+    return Request(AssetType::Texture, path, options);
+}
+
+AssetHandle AssetLoader::RequestMesh(char const * path) {
+    return Request(AssetType::Mesh, path, TextureBuildOptions());
+}
+
+AssetHandle AssetLoader::Request(AssetType type, char const * path, TextureBuildOptions const & options) {
+    ASSERT(false == workers.empty());
+    AssetHandle handle = InvalidAssetHandle;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if(0 == stats.pending) {
+            batch_start = Clock::now();
+        }
+        handle = static_cast<AssetHandle>(assets.size());
+        Asset & asset = assets.emplace_back();
+        asset.type = type;
+        asset.state = AssetState::Queued;
+        asset.path = path;
+        asset.texture_options = options;
+        asset.texture_cache = texture_cache;
+        queue.push_back(handle);
+        ++stats.requested;
+        ++stats.pending;
+    }
+    wake_cv.notify_one();
+    return handle;
+}
+
+uint32_t AssetLoader::PollCompletions(std::vector<AssetCompletion> & out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    uint32_t const count = static_cast<uint32_t>(completions.size());
+    out.insert(out.end(), completions.begin(), completions.end());
+    completions.clear();
+    return count;
+}
+
+void AssetLoader::WaitIdle() {
+    std::unique_lock<std::mutex> lock(mutex);
+    idle_cv.wait(lock, [this] { return 0 == stats.pending; });
+}
+
+AssetState AssetLoader::GetState(AssetHandle handle) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    ASSERT(handle < assets.size());
+    return assets[handle].state;
+}
+
+bool AssetLoader::TakeTexture(AssetHandle handle, Texture & out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if(handle >= assets.size()) {
+        return false;
+    }
+    Asset & asset = assets[handle];
+    if(AssetType::Texture != asset.type || AssetState::Loaded != asset.state) {
+        return false;
+    }
+    out = std::move(asset.texture);
+    asset.texture = Texture();
+    asset.state = AssetState::Taken;
+    return true;
+}
+
+bool AssetLoader::TakeMesh(AssetHandle handle, Mesh & out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if(handle >= assets.size()) {
+        return false;
+    }
+    Asset & asset = assets[handle];
+    if(AssetType::Mesh != asset.type || AssetState::Loaded != asset.state) {
+        return false;
+    }
+    out = std::move(asset.mesh);
+    asset.mesh = Mesh();
+    asset.state = AssetState::Taken;
+    return true;
+}
+
+AssetLoaderStats AssetLoader::GetStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    AssetLoaderStats result = stats;
+    if(0 != result.pending) {
+        result.wall_ms = std::chrono::duration<float, std::milli>(Clock::now() - batch_start).count();
+    }
+    return result;
+}
+
+bool AssetLoader::LoadAsset(Asset & asset) {
+    // One file per worker: the pipelines run single threaded (pool = nullptr) and the parallelism comes from
+    // the workers loading different files
+    if(AssetType::Texture == asset.type) {
+        if(nullptr != asset.texture_cache) {
+            return asset.texture_cache->Load(asset.path.c_str(), asset.texture_options, asset.texture, nullptr);
+        }
+        return LoadTexture(asset.path.c_str(), asset.texture_options, asset.texture, nullptr);
+    }
+    if(HasExtension(asset.path, ".obj")) {
+        return ImportObj(asset.path.c_str(), asset.mesh, nullptr, nullptr);
+    }
+    return LoadMeshFile(asset.path.c_str(), asset.mesh);
+}
+
+void AssetLoader::WorkerMain() {
+    while(true) {
+        Asset * asset = nullptr;
+        AssetHandle handle = InvalidAssetHandle;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake_cv.wait(lock, [this] { return quit || false == queue.empty(); });
+            if(quit) {
+                return;
+            }
+            handle = queue.front();
+            queue.pop_front();
+            asset = &assets[handle];
+            asset->state = AssetState::Loading;
+        }
+
+        // The asset is only touched by this worker until its state leaves Loading
+        auto const start = Clock::now();
+        bool const loaded = LoadAsset(*asset);
+        float const load_ms = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+        if(false == loaded) {
+            ::printf("AssetLoader: failed to load %s\n", asset->path.c_str());
+            asset->texture = Texture();
+            asset->mesh = Mesh();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            asset->state = loaded ? AssetState::Loaded : AssetState::Failed;
+
+            AssetCompletion completion = {};
+            completion.handle = handle;
+            completion.type = asset->type;
+            completion.loaded = loaded;
+            completion.load_ms = load_ms;
+            completions.push_back(completion);
+
+            if(loaded) {
+                ++stats.loaded;
+            } else {
+                ++stats.failed;
+            }
+            --stats.pending;
+            stats.sum_load_ms += load_ms;
+            stats.max_load_ms = std::max(stats.max_load_ms, load_ms);
+            stats.wall_ms = std::chrono::duration<float, std::milli>(Clock::now() - batch_start).count();
+        }
+        idle_cv.notify_all();
+    }
+}
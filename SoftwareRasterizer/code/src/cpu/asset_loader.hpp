@@ -0,0 +1,119 @@
+#pragma once
+
+#include "texture.hpp"
+#include "texture_cache.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Loads textures and meshes in the background so the renderer never waits on a file.
+//
+// Requests are queued and picked up by the loader's own worker threads (ThreadPool is a blocking fork/join, a
+// request must return right away). Every worker takes one whole file at a time and decodes it on its own thread:
+// n files run on n workers side by side, so a batch takes about as long as its slowest file instead of the sum of
+// all of them. Finished assets are pushed to a completion queue that the render thread drains once a frame with
+// PollCompletions, then it takes the results (TakeTexture / TakeMesh) and uploads them. Until an asset completes
+// the renderer draws with a placeholder of its own.
+//
+// Textures go through LoadTexture (stb_image + mip chain), or the TextureCache when one is set, meshes through
+// ImportObj for .obj files and MappedMeshFile for everything else (copied out of the mapping into a Mesh).
+enum class AssetType : uint8_t {
+    Texture,
+    Mesh,
+};
+
+enum class AssetState : uint8_t {
+    Queued,
+    Loading,
+    Loaded,
+    Failed,
+    Taken,              // moved out with TakeTexture / TakeMesh
+};
+
+using AssetHandle = uint32_t;
+constexpr AssetHandle InvalidAssetHandle = ~0u;
+
+struct AssetCompletion {
+    AssetHandle handle;
+    AssetType   type;
+    bool        loaded;             // false: failed, nothing to take
+    float       load_ms;            // on the worker, queue time excluded
+};
+
+struct AssetLoaderStats {
+    uint32_t    requested;
+    uint32_t    loaded;
+    uint32_t    failed;
+    uint32_t    pending;            // queued or loading
+    float       sum_load_ms;        // since Init, what loading everything one after the other would take
+    float       max_load_ms;        // since Init, slowest file
+    float       wall_ms;            // first request to last completion of the current (or last) batch
+};
+
+class AssetLoader {
+public:
+    AssetLoader() = default;
+    ~AssetLoader();
+    AssetLoader(AssetLoader const &) = delete;
+    AssetLoader & operator=(AssetLoader const &) = delete;
+
+    // thread_count == 0 -> std::thread::hardware_concurrency()
+    void Init(uint32_t thread_count);
+    // Fails the queued requests and waits for the ones being loaded. The states, completions and stats stay
+    // readable until the next Init.
+    void Exit();
+
+    // Textures requested after this are loaded through `cache` (nullptr: straight from the source files)
+    void SetTextureCache(TextureCache * cache);
+
+    AssetHandle RequestTexture(char const * path, TextureBuildOptions const & options);
+    AssetHandle RequestMesh(char const * path);
+
+    // Appends the assets completed since the last call to `out`, returns how many were appended
+    uint32_t PollCompletions(std::vector<AssetCompletion> & out);
+    // Blocks until nothing is queued or loading
+    void WaitIdle();
+
+    AssetState GetState(AssetHandle handle) const;
+    // Moves a Loaded asset out of the loader. Returns false when it isn't Loaded (or isn't of that type).
+    bool TakeTexture(AssetHandle handle, Texture & out);
+    bool TakeMesh(AssetHandle handle, Mesh & out);
+
+    AssetLoaderStats GetStats() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Asset {
+        AssetType           type;
+        AssetState          state;
+        std::string         path;
+        TextureBuildOptions texture_options;
+        TextureCache *      texture_cache;
+        Texture             texture;
+        Mesh                mesh;
+    };
+
+    AssetHandle Request(AssetType type, char const * path, TextureBuildOptions const & options);
+    void WorkerMain();
+    static bool LoadAsset(Asset & asset);
+
+    std::vector<std::thread>        workers;
+
+    mutable std::mutex              mutex;
+    std::condition_variable         wake_cv;
+    std::condition_variable         idle_cv;
+    bool                            quit = false;
+
+    std::deque<Asset>               assets;         // indexed by AssetHandle, a deque keeps them in place while it grows
+    std::deque<AssetHandle>         queue;
+    std::vector<AssetCompletion>    completions;
+    TextureCache *                  texture_cache = nullptr;
+
+    AssetLoaderStats                stats = {};
+    Clock::time_point               batch_start = {};
+};
@@ -0,0 +1,43 @@
+#include "attribute_encoding.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+float HalfToFloat(uint16_t value) {
+    uint32_t const sign = static_cast<uint32_t>(value & 0x8000u) << 16;
+    uint32_t const exponent = (value >> 10) & 0x1Fu;
+    uint32_t const mantissa = value & 0x3FFu;
+    if(0 == exponent) {
+        float const magnitude = static_cast<float>(mantissa) * (1.0f / 16777216.0f);
+        return BitsToFloat(FloatBits(magnitude) | sign);
+    }
+    if(0x1F == exponent) {
+        return BitsToFloat(sign | 0x7F800000u | (mantissa << 13));
+    }
+    return BitsToFloat(sign | ((exponent + 127u - 15u) << 23) | (mantissa << 13));
+}
+
+static float UnpackSnorm16(uint32_t bits) {
+    float const value = static_cast<float>(static_cast<int16_t>(static_cast<uint16_t>(bits & 0xFFFFu))) * (1.0f / Snorm16Steps);
+    return std::max(value, -1.0f);
+}
+
+void DecodeOctahedral(uint32_t bits, float out[3]) {
+    float x = UnpackSnorm16(bits);
+    float y = UnpackSnorm16(bits >> 16);
+    float const z = 1.0f - std::fabs(x) - std::fabs(y);
+    // Unfolds the lower half: t is how far the point is past the diagonals.
+    float const t = std::max(-z, 0.0f);
+    x += x >= 0.0f ? -t : t;
+    y += y >= 0.0f ? -t : t;
+    float const inv_length = 1.0f / std::sqrt(x * x + y * y + z * z);
+    out[0] = x * inv_length;
+    out[1] = y * inv_length;
+    out[2] = z * inv_length;
+}
+
+void UnpackRGBA8(uint32_t bits, float out[4]) {
+    for(uint32_t i = 0; i < 4; ++i) {
+        out[i] = static_cast<float>((bits >> (8 * i)) & 0xFFu) * (1.0f / 255.0f);
+    }
+}
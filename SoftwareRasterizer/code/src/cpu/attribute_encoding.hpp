@@ -0,0 +1,99 @@
+#pragma once
+
+#include "simd.hpp"
+
+#include <cstring>
+
+// Compact encodings of vertex and fragment attributes, shared by PackedFragment (fragment_packing.hpp) and
+// QuantizedVertexStreams (vertex_quantization.hpp) so both round and decode the same way:
+//  - IEEE half floats, round to nearest even
+//  - unit vectors as the octahedral mapping of the direction to [-1, 1]^2, 2 x snorm16 in one uint32 (x in the
+//    low bits)
+//  - RGBA8 unorm colors, r in the low byte
+// The encoders are used by the raster kernels, see simd.hpp on why they are force inlined and stay away from std::.
+// The SIMD decoders live next to the kernels that need them.
+
+constexpr float Snorm16Steps = 32767.0f;
+
+static SIMD_FORCEINLINE uint32_t FloatBits(float f) {
+    uint32_t bits = 0;
+    memcpy(&bits, &f, sizeof(bits));
+    return bits;
+}
+
+static SIMD_FORCEINLINE float BitsToFloat(uint32_t bits) {
+    float f = 0.0f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+// Round to nearest even, overflow goes to infinity, NaNs stay NaNs.
+static SIMD_FORCEINLINE uint16_t FloatToHalf(float value) {
+    uint32_t bits = FloatBits(value);
+    uint32_t const sign = bits & 0x80000000u;
+    bits ^= sign;
+
+    uint32_t ret = 0;
+    if(bits >= (127u + 16u) << 23) {
+        ret = bits > 0x7F800000u ? 0x7E00u : 0x7C00u;
+    } else if(bits < (127u - 14u) << 23) {
+        // Subnormal result: adding 0.5 lets the FPU do the rounding of the shifted out mantissa bits.
+        uint32_t const magic = (127u - 15u + 23u - 10u + 1u) << 23;
+        ret = FloatBits(BitsToFloat(bits) + BitsToFloat(magic)) - magic;
+    } else {
+        uint32_t const mantissa_odd = (bits >> 13) & 1u;
+        bits += (static_cast<uint32_t>(15 - 127) << 23) + 0xFFFu + mantissa_odd;
+        ret = bits >> 13;
+    }
+    return static_cast<uint16_t>(ret | (sign >> 16));
+}
+
+static SIMD_FORCEINLINE int32_t RoundToInt(float value) {
+    return value >= 0.0f ? static_cast<int32_t>(value + 0.5f) : -static_cast<int32_t>(0.5f - value);
+}
+
+static SIMD_FORCEINLINE uint32_t PackSnorm16x2(float x, float y) {
+    x = x < -1.0f ? -1.0f : (x > 1.0f ? 1.0f : x);
+    y = y < -1.0f ? -1.0f : (y > 1.0f ? 1.0f : y);
+    uint32_t const sx = static_cast<uint32_t>(RoundToInt(x * Snorm16Steps)) & 0xFFFFu;
+    uint32_t const sy = static_cast<uint32_t>(RoundToInt(y * Snorm16Steps)) & 0xFFFFu;
+    return sx | (sy << 16);
+}
+
+// Projects the direction onto the octahedron |x| + |y| + |z| = 1 and folds the lower half over the diagonals.
+static SIMD_FORCEINLINE uint32_t EncodeOctahedral(float x, float y, float z) {
+    float const ax = x < 0.0f ? -x : x;
+    float const ay = y < 0.0f ? -y : y;
+    float const az = z < 0.0f ? -z : z;
+    float const l1 = ax + ay + az;
+    if(!(l1 > 0.0f)) {
+        return PackSnorm16x2(0.0f, 0.0f);
+    }
+    float px = x / l1;
+    float py = y / l1;
+    if(z < 0.0f) {
+        float const fx = (1.0f - (py < 0.0f ? -py : py)) * (px >= 0.0f ? 1.0f : -1.0f);
+        float const fy = (1.0f - (px < 0.0f ? -px : px)) * (py >= 0.0f ? 1.0f : -1.0f);
+        px = fx;
+        py = fy;
+    }
+    return PackSnorm16x2(px, py);
+}
+
+static SIMD_FORCEINLINE uint32_t PackUnorm8(float value) {
+    value = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+    return static_cast<uint32_t>(value * 255.0f + 0.5f);
+}
+
+static SIMD_FORCEINLINE uint32_t PackRGBA8(float const color[4]) {
+    return PackUnorm8(color[0]) | (PackUnorm8(color[1]) << 8) | (PackUnorm8(color[2]) << 16) | (PackUnorm8(color[3]) << 24);
+}
+
+static SIMD_FORCEINLINE uint32_t PackHalf2(float const uv[2]) {
+    return static_cast<uint32_t>(FloatToHalf(uv[0])) | (static_cast<uint32_t>(FloatToHalf(uv[1])) << 16);
+}
+
+// Scalar decoders of the encodings above
+float HalfToFloat(uint16_t value);
+void DecodeOctahedral(uint32_t bits, float out[3]);
+void UnpackRGBA8(uint32_t bits, float out[4]);
@@ -0,0 +1,203 @@
+#include "color_output.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// sRGB transfer functions in double, the reference the tables are built from
+static double EncodeSrgb(double linear) {
+    return (linear <= 0.0031308) ? linear * 12.92 : 1.055 * std::pow(linear, 1.0 / 2.4) - 0.055;
+}
+
+static double DecodeSrgb(double encoded) {
+    return (encoded <= 0.04045) ? encoded / 12.92 : std::pow((encoded + 0.055) / 1.055, 2.4);
+}
+
+SrgbEncodeTable const & GetSrgbEncodeTable() {
+    static SrgbEncodeTable const table = []() {
+        SrgbEncodeTable t = {};
+        // Smallest float whose encoding rounds to k + 1: start from the decoded midpoint and step to the exact float
+        for(uint32_t k = 0; k < 255; ++k) {
+            double const midpoint = (static_cast<double>(k) + 0.5) / 255.0;
+            float threshold = static_cast<float>(DecodeSrgb(midpoint));
+            while(EncodeSrgb(static_cast<double>(threshold)) < midpoint) {
+                threshold = std::nextafter(threshold, 2.0f);
+            }
+            while(EncodeSrgb(static_cast<double>(std::nextafter(threshold, 0.0f))) >= midpoint) {
+                threshold = std::nextafter(threshold, 0.0f);
+            }
+            t.thresholds[k] = threshold;
+        }
+        t.thresholds[255] = 2.0f;
+
+        for(uint32_t b = 0; b < SrgbEncodeBucketCount; ++b) {
+            int32_t const bits = SrgbEncodeBucketBase + static_cast<int32_t>(b << SrgbEncodeBucketShift);
+            float first = 0.0f;
+            memcpy(&first, &bits, sizeof(first));
+            t.buckets[b] = static_cast<uint8_t>(std::upper_bound(t.thresholds, t.thresholds + 255, first) - t.thresholds);
+        }
+        // A bucket may hold at most one code boundary, the encoders fix up one step only
+        for(uint32_t b = 0; b + 1 < SrgbEncodeBucketCount; ++b) {
+            ASSERT(t.buckets[b + 1] <= t.buckets[b] + 1);
+        }
+        return t;
+    }();
+    return table;
+}
+
+static uint32_t EncodeUnorm8(float value, SrgbEncodeTable const * table) {
+    // NaN fails the first compare and goes to 0
+    value = (value > 0.0f) ? ((value < 1.0f) ? value : 1.0f) : 0.0f;
+    if(nullptr == table) {
+        return static_cast<uint32_t>(std::nearbyint(value * 255.0f));
+    }
+    int32_t bits = 0;
+    memcpy(&bits, &value, sizeof(bits));
+    int32_t const bucket = std::max((bits - SrgbEncodeBucketBase) >> SrgbEncodeBucketShift, 0);
+    uint32_t const code = table->buckets[bucket];
+    return code + ((value >= table->thresholds[code]) ? 1u : 0u);
+}
+
+void PackColors_Scalar(float const * colors, size_t stride, uint32_t count, ColorOutputFormat format, uint32_t * out) {
+    SrgbEncodeTable const * table = (ColorEncoding::sRGB == format.encoding) ? &GetSrgbEncodeTable() : nullptr;
+    for(uint32_t i = 0; i < count; ++i) {
+        float const * color = &colors[i * stride];
+        uint32_t const alpha = format.opaque ? 0xFFu : EncodeUnorm8(color[3], nullptr);
+        out[i] = EncodeUnorm8(color[0], table) | (EncodeUnorm8(color[1], table) << 8) | (EncodeUnorm8(color[2], table) << 16) | (alpha << 24);
+    }
+}
+
+#if SIMD_X86
+
+// One RGBA color to 4 codes in [0, 255], one per 32 bit lane. Alpha is never sRGB encoded.
+static SIMD_FORCEINLINE __m128i EncodeColor_SSE(__m128 value, SrgbEncodeTable const * table) {
+    // max returns its second operand for NaN
+    value = _mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+    __m128i const linear = _mm_cvtps_epi32(_mm_mul_ps(value, _mm_set1_ps(255.0f)));
+    if(nullptr == table) {
+        return linear;
+    }
+    __m128i bucket = _mm_srai_epi32(_mm_sub_epi32(_mm_castps_si128(value), _mm_set1_epi32(SrgbEncodeBucketBase)), SrgbEncodeBucketShift);
+    bucket = _mm_andnot_si128(_mm_srai_epi32(bucket, 31), bucket);
+
+    // No gathers before AVX2, the three color lanes are looked up one by one
+    alignas(16) int32_t buckets[4];
+    alignas(16) int32_t codes[4] = {};
+    alignas(16) float thresholds[4] = {};
+    _mm_store_si128(reinterpret_cast<__m128i *>(buckets), bucket);
+    for(uint32_t c = 0; c < 3; ++c) {
+        codes[c] = table->buckets[buckets[c]];
+        thresholds[c] = table->thresholds[codes[c]];
+    }
+    __m128i const past = _mm_castps_si128(_mm_cmpge_ps(value, _mm_load_ps(thresholds)));
+    __m128i const srgb = _mm_sub_epi32(_mm_load_si128(reinterpret_cast<__m128i const *>(codes)), past);
+    __m128i const alpha_mask = _mm_setr_epi32(0, 0, 0, -1);
+    return _mm_or_si128(_mm_andnot_si128(alpha_mask, srgb), _mm_and_si128(alpha_mask, linear));
+}
+
+void PackColors_SSE(float const * colors, size_t stride, uint32_t count, ColorOutputFormat format, uint32_t * out) {
+    constexpr uint32_t Lanes = 8;
+    SrgbEncodeTable const * table = (ColorEncoding::sRGB == format.encoding) ? &GetSrgbEncodeTable() : nullptr;
+    __m128i const opaque_bits = _mm_set1_epi32(format.opaque ? static_cast<int32_t>(0xFF000000u) : 0);
+    uint32_t i = 0;
+    for(; i + Lanes <= count; i += Lanes) {
+        __m128i codes[Lanes];
+        for(uint32_t l = 0; l < Lanes; ++l) {
+            codes[l] = EncodeColor_SSE(_mm_loadu_ps(&colors[(i + l) * stride]), table);
+        }
+        // Codes fit in 8 bits, the signed 32 -> 16 pack doesn't saturate them
+        for(uint32_t h = 0; h < 2; ++h) {
+            __m128i const low = _mm_packs_epi32(codes[4 * h + 0], codes[4 * h + 1]);
+            __m128i const high = _mm_packs_epi32(codes[4 * h + 2], codes[4 * h + 3]);
+            __m128i const pixels = _mm_or_si128(_mm_packus_epi16(low, high), opaque_bits);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(&out[i + 4 * h]), pixels);
+        }
+    }
+    PackColors_Scalar(&colors[i * stride], stride, count - i, format, &out[i]);
+}
+
+#endif // SIMD_X86
+
+PackColorsFn GetPackColorsFn(SimdLevel level) {
+#if SIMD_X86
+    switch(level) {
+        case SimdLevel::AVX512: // no AVX-512 kernel, the AVX2 one is bandwidth bound already
+        case SimdLevel::AVX2:   return &PackColors_AVX2;
+        case SimdLevel::SSE:    return &PackColors_SSE;
+        case SimdLevel::Scalar: break;
+    }
+#else
+    CONSUME_VAR(level);
+#endif
+    return &PackColors_Scalar;
+}
+
+void PackColors(
+    float const * colors,
+    uint32_t count,
+    ColorOutputFormat format,
+    uint32_t * out,
+    ThreadPool * pool,
+    SimdLevel simd_level)
+{
+    PackColorsFn const pack = GetPackColorsFn(std::min(simd_level, GetSimdLevel()));
+
+    // Multiple of every kernel's lane count, so only the last batch has a scalar remainder.
+    constexpr uint32_t BatchSize = 16384;
+    uint32_t const batch_count = (count + BatchSize - 1) / BatchSize;
+
+    auto pack_batch = [&](uint32_t batch, uint32_t) {
+        uint32_t const begin = batch * BatchSize;
+        uint32_t const end = std::min(count, begin + BatchSize);
+        pack(&colors[4 * static_cast<size_t>(begin)], 4, end - begin, format, &out[begin]);
+    };
+
+    if(nullptr != pool && batch_count > 1) {
+        pool->ParallelFor(batch_count, pack_batch);
+    } else {
+        for(uint32_t b = 0; b < batch_count; ++b) {
+            pack_batch(b, 0);
+        }
+    }
+}
+
+void ShadeFragments(
+    Fragment const * fragments,
+    uint32_t width,
+    uint32_t height,
+    ColorEncoding encoding,
+    void * out,
+    size_t row_pitch,
+    ThreadPool * pool,
+    SimdLevel simd_level)
+{
+    ASSERT(row_pitch >= width * sizeof(uint32_t));
+    PackColorsFn const pack = GetPackColorsFn(std::min(simd_level, GetSimdLevel()));
+
+    ColorOutputFormat format = {};
+    format.encoding = encoding;
+    format.opaque = true;
+
+    // Whole rows per batch, about as many pixels as PackColors takes
+    uint32_t const rows_per_batch = std::max(1u, 16384 / std::max(width, 1u));
+    uint32_t const batch_count = (height + rows_per_batch - 1) / rows_per_batch;
+    constexpr size_t FragmentStride = sizeof(Fragment) / sizeof(float);
+
+    auto shade_batch = [&](uint32_t batch, uint32_t) {
+        uint32_t const begin = batch * rows_per_batch;
+        uint32_t const end = std::min(height, begin + rows_per_batch);
+        for(uint32_t y = begin; y < end; ++y) {
+            uint32_t * row = reinterpret_cast<uint32_t *>(static_cast<uint8_t *>(out) + y * row_pitch);
+            pack(fragments[static_cast<size_t>(y) * width].col, FragmentStride, width, format, row);
+        }
+    };
+
+    if(nullptr != pool && batch_count > 1) {
+        pool->ParallelFor(batch_count, shade_batch);
+    } else {
+        for(uint32_t b = 0; b < batch_count; ++b) {
+            shade_batch(b, 0);
+        }
+    }
+}
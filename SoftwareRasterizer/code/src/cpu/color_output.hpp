@@ -0,0 +1,78 @@
+#pragma once
+
+#include "pipeline_types.hpp"
+#include "simd.hpp"
+
+class ThreadPool;
+
+// Output stage of the CPU pipeline: float RGBA colors to RGBA8 unorm pixels (r in the low bits), the format of
+// the framebuffer and swap chain.
+//
+// Rounding is to nearest even of the float product clamp(value, 0, 1) * 255 (the D3D float -> unorm rule), the
+// same bytes on every level. NaN goes to 0. With ColorEncoding::sRGB color channels are encoded with the exact sRGB
+// curve and rounded correctly (alpha stays linear), through SrgbEncodeTable instead of a pow per channel:
+//  - the float bits of a value in [2^-13, 1] pick one of SrgbEncodeBucketCount buckets (exponent and the top
+//    SrgbEncodeBucketBits mantissa bits), which holds the code of its smallest value. Buckets are narrow enough
+//    that no more than one code boundary falls inside one.
+//  - one compare against the linear threshold of the next code fixes up the values past that boundary.
+// Two table reads per channel (gathers with AVX2), 2.7 KB of tables that stay in L1.
+//
+// The SIMD kernels take 8 (SSE) or 16 (AVX2) pixels per iteration and write whole 32 / 64 byte runs, so a linear
+// output pass is bound by memory bandwidth, not by the conversion.
+enum class ColorEncoding : uint8_t {
+    Linear,
+    sRGB,
+};
+
+struct ColorOutputFormat {
+    ColorEncoding   encoding = ColorEncoding::Linear;
+    bool            opaque = false;     // alpha written as 255, like PackColor in fragment_shading.comp.hlsl
+};
+
+constexpr uint32_t SrgbEncodeMinExponent = 13;     // 2^-13 is below the first threshold, smaller values encode to 0
+constexpr uint32_t SrgbEncodeBucketBits = 7;
+constexpr uint32_t SrgbEncodeBucketCount = (SrgbEncodeMinExponent << SrgbEncodeBucketBits) + 1;   // the last one is 1.0
+constexpr int32_t  SrgbEncodeBucketBase = (127 - static_cast<int32_t>(SrgbEncodeMinExponent)) << 23;   // float bits of 2^-13
+constexpr int32_t  SrgbEncodeBucketShift = 23 - static_cast<int32_t>(SrgbEncodeBucketBits);
+
+struct SrgbEncodeTable {
+    float       thresholds[256];                        // [k]: smallest float encoding to k + 1, above 1 for 255
+    uint8_t     buckets[SrgbEncodeBucketCount + 3];     // padded for 32 bit gathers
+};
+
+// Built on first use
+SrgbEncodeTable const & GetSrgbEncodeTable();
+
+// Kernels: pack `count` colors, colors[i * stride + 0..3] to out[i]. The SIMD ones leave the remainder to the
+// scalar kernel.
+using PackColorsFn = void (*)(float const * colors, size_t stride, uint32_t count, ColorOutputFormat format, uint32_t * out);
+
+void PackColors_Scalar(float const * colors, size_t stride, uint32_t count, ColorOutputFormat format, uint32_t * out);
+#if SIMD_X86
+void PackColors_SSE(float const * colors, size_t stride, uint32_t count, ColorOutputFormat format, uint32_t * out);
+void PackColors_AVX2(float const * colors, size_t stride, uint32_t count, ColorOutputFormat format, uint32_t * out);
+#endif
+
+PackColorsFn GetPackColorsFn(SimdLevel level);
+
+// `count` RGBA colors (4 floats each) to `out`. `pool` can be nullptr.
+void PackColors(
+    float const * colors,
+    uint32_t count,
+    ColorOutputFormat format,
+    uint32_t * out,
+    ThreadPool * pool,
+    SimdLevel simd_level);
+
+// CPU port of shaders/demo003/rasterization/fragment_shading.comp.hlsl: pixel (x, y) of the width * height image
+// is PackColor(float4(col.xyz, 1)) of fragments[y * width + x], with the image rows `row_pitch` bytes apart so
+// they can be written straight into a texture upload footprint. `pool` can be nullptr.
+void ShadeFragments(
+    Fragment const * fragments,
+    uint32_t width,
+    uint32_t height,
+    ColorEncoding encoding,
+    void * out,
+    size_t row_pitch,
+    ThreadPool * pool,
+    SimdLevel simd_level);
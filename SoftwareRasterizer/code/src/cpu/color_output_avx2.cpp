@@ -0,0 +1,56 @@
+#include "color_output.hpp"
+
+#if SIMD_X86
+
+// Two RGBA colors, one per 128 bit half. Contiguous float4 colors are one load.
+SIMD_TARGET_AVX2
+static SIMD_FORCEINLINE __m256 LoadColors_AVX2(float const * colors, size_t stride) {
+    if(4 == stride) {
+        return _mm256_loadu_ps(colors);
+    }
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(colors)), _mm_loadu_ps(&colors[stride]), 1);
+}
+
+// Two RGBA colors to 8 codes in [0, 255], one per 32 bit lane, see EncodeColor_SSE.
+SIMD_TARGET_AVX2
+static SIMD_FORCEINLINE __m256i EncodeColors_AVX2(__m256 value, SrgbEncodeTable const * table) {
+    value = _mm256_min_ps(_mm256_max_ps(value, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+    __m256i const linear = _mm256_cvtps_epi32(_mm256_mul_ps(value, _mm256_set1_ps(255.0f)));
+    if(nullptr == table) {
+        return linear;
+    }
+    __m256i bucket = _mm256_srai_epi32(_mm256_sub_epi32(_mm256_castps_si256(value), _mm256_set1_epi32(SrgbEncodeBucketBase)), SrgbEncodeBucketShift);
+    bucket = _mm256_max_epi32(bucket, _mm256_setzero_si256());
+    // Byte table read 32 bits at a time (it's padded for that), the code is the low byte
+    __m256i const code = _mm256_and_si256(_mm256_i32gather_epi32(reinterpret_cast<int const *>(table->buckets), bucket, 1), _mm256_set1_epi32(0xFF));
+    __m256 const threshold = _mm256_i32gather_ps(table->thresholds, code, 4);
+    __m256i const srgb = _mm256_sub_epi32(code, _mm256_castps_si256(_mm256_cmp_ps(value, threshold, _CMP_GE_OQ)));
+    // Alpha lanes (3 and 7) stay linear
+    return _mm256_blend_epi32(srgb, linear, 0x88);
+}
+
+SIMD_TARGET_AVX2
+void PackColors_AVX2(float const * colors, size_t stride, uint32_t count, ColorOutputFormat format, uint32_t * out) {
+    constexpr uint32_t Lanes = 16;
+    SrgbEncodeTable const * table = (ColorEncoding::sRGB == format.encoding) ? &GetSrgbEncodeTable() : nullptr;
+    __m256i const opaque_bits = _mm256_set1_epi32(format.opaque ? static_cast<int32_t>(0xFF000000u) : 0);
+    // The packs below work within 128 bit halves, this puts the 8 colors of a 256 bit store back in order
+    __m256i const pixel_order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    uint32_t i = 0;
+    for(; i + Lanes <= count; i += Lanes) {
+        __m256i codes[Lanes / 2];
+        for(uint32_t p = 0; p < Lanes / 2; ++p) {
+            codes[p] = EncodeColors_AVX2(LoadColors_AVX2(&colors[(i + 2 * p) * stride], stride), table);
+        }
+        // Two 32 byte stores, one cache line when `out` is aligned
+        for(uint32_t h = 0; h < 2; ++h) {
+            __m256i const low = _mm256_packus_epi32(codes[4 * h + 0], codes[4 * h + 1]);
+            __m256i const high = _mm256_packus_epi32(codes[4 * h + 2], codes[4 * h + 3]);
+            __m256i const pixels = _mm256_permutevar8x32_epi32(_mm256_packus_epi16(low, high), pixel_order);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(&out[i + 8 * h]), _mm256_or_si256(pixels, opaque_bits));
+        }
+    }
+    PackColors_Scalar(&colors[i * stride], stride, count - i, format, &out[i]);
+}
+
+#endif // SIMD_X86
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "attribute_encoding.hpp"
+#include "pipeline_types.hpp"
+
+// Encoding of PackedFragment, 16 bytes instead of the 72 of a Fragment:
+//  - depth:  pos_ndc.z as is, pos_ndc.xy are the pixel center and pos_world is unprojected from them
+//  - normal: octahedral mapping of the direction to [-1, 1]^2, 2 x snorm16 (length is lost, normals are unit anyway)
+//  - color:  RGBA8 unorm, clamped to [0, 1]
+//  - uv:     2 x IEEE half, round to nearest even
+// The kernels pack 4 or 8 lanes at once with the _SSE helpers. The packed buffer is only read on the GPU, by
+// shaders/demo003/rasterization/fragment_shading_packed.comp.hlsl.
+//
+// The scalar encoders are in attribute_encoding.hpp, shared with the vertex quantization. Encoders are used by the
+// raster kernels, see simd.hpp on why they are force inlined and stay away from std::.
+
+static SIMD_FORCEINLINE PackedFragment PackFragment(Fragment const & frag) {
+    PackedFragment ret = {};
+    ret.depth = frag.pos_ndc[2];
+    ret.normal = EncodeOctahedral(frag.normal_world[0], frag.normal_world[1], frag.normal_world[2]);
+    ret.color = PackRGBA8(frag.col);
+    ret.uv = PackHalf2(frag.uv);
+    return ret;
+}
+
+#if SIMD_X86
+
+// FloatToHalf on 4 lanes, halves are in the low 16 bits of each lane.
+static SIMD_FORCEINLINE __m128i FloatToHalf_SSE(__m128 value) {
+    __m128i const sign = _mm_and_si128(_mm_castps_si128(value), _mm_set1_epi32(static_cast<int32_t>(0x80000000u)));
+    __m128i const bits = _mm_xor_si128(_mm_castps_si128(value), sign);
+    __m128 const magnitude = _mm_castsi128_ps(bits);
+
+    __m128i const regular = _mm_cmpgt_epi32(_mm_set1_epi32((127 + 16) << 23), bits);
+    __m128i const nan_bit = _mm_and_si128(_mm_castps_si128(_mm_cmpunord_ps(magnitude, magnitude)), _mm_set1_epi32(0x200));
+    __m128i const special = _mm_or_si128(nan_bit, _mm_set1_epi32(0x7C00));
+
+    __m128i const subnormal = _mm_cmpgt_epi32(_mm_set1_epi32((127 - 14) << 23), bits);
+    __m128i const magic = _mm_set1_epi32((127 - 15 + 23 - 10 + 1) << 23);
+    __m128i const subnormal_result = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(magnitude, _mm_castsi128_ps(magic))), magic);
+
+    __m128i const mantissa_odd = _mm_and_si128(_mm_srli_epi32(bits, 13), _mm_set1_epi32(1));
+    __m128i const normal_bias = _mm_set1_epi32(static_cast<int32_t>((static_cast<uint32_t>(15 - 127) << 23) + 0xFFFu));
+    __m128i const normal_result = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(bits, normal_bias), mantissa_odd), 13);
+
+    __m128i const finite = _mm_or_si128(_mm_and_si128(subnormal, subnormal_result), _mm_andnot_si128(subnormal, normal_result));
+    __m128i const ret = _mm_or_si128(_mm_and_si128(regular, finite), _mm_andnot_si128(regular, special));
+    return _mm_or_si128(ret, _mm_srli_epi32(sign, 16));
+}
+
+static SIMD_FORCEINLINE __m128 Clamp_SSE(__m128 value, float min_value, float max_value) {
+    return _mm_min_ps(_mm_max_ps(value, _mm_set1_ps(min_value)), _mm_set1_ps(max_value));
+}
+
+static SIMD_FORCEINLINE __m128i PackSnorm16x2_SSE(__m128 x, __m128 y) {
+    __m128i const sx = _mm_cvtps_epi32(_mm_mul_ps(Clamp_SSE(x, -1.0f, 1.0f), _mm_set1_ps(Snorm16Steps)));
+    __m128i const sy = _mm_cvtps_epi32(_mm_mul_ps(Clamp_SSE(y, -1.0f, 1.0f), _mm_set1_ps(Snorm16Steps)));
+    return _mm_or_si128(_mm_and_si128(sx, _mm_set1_epi32(0xFFFF)), _mm_slli_epi32(sy, 16));
+}
+
+// EncodeOctahedral on 4 lanes, zero length normals give (0, 0).
+static SIMD_FORCEINLINE __m128i EncodeOctahedral_SSE(__m128 x, __m128 y, __m128 z) {
+    __m128 const sign_mask = _mm_set1_ps(-0.0f);
+    __m128 const l1 = _mm_add_ps(_mm_add_ps(_mm_andnot_ps(sign_mask, x), _mm_andnot_ps(sign_mask, y)), _mm_andnot_ps(sign_mask, z));
+    __m128 const inv_l1 = _mm_and_ps(_mm_div_ps(_mm_set1_ps(1.0f), l1), _mm_cmpgt_ps(l1, _mm_setzero_ps()));
+    __m128 const px = _mm_mul_ps(x, inv_l1);
+    __m128 const py = _mm_mul_ps(y, inv_l1);
+
+    // (1 - |p.yx|) with the signs of p.xy, zero counts as positive.
+    __m128 const one = _mm_set1_ps(1.0f);
+    __m128 const sign_x = _mm_and_ps(_mm_cmplt_ps(px, _mm_setzero_ps()), sign_mask);
+    __m128 const sign_y = _mm_and_ps(_mm_cmplt_ps(py, _mm_setzero_ps()), sign_mask);
+    __m128 const fx = _mm_or_ps(_mm_sub_ps(one, _mm_andnot_ps(sign_mask, py)), sign_x);
+    __m128 const fy = _mm_or_ps(_mm_sub_ps(one, _mm_andnot_ps(sign_mask, px)), sign_y);
+
+    __m128 const lower = _mm_cmplt_ps(z, _mm_setzero_ps());
+    __m128 const ox = _mm_or_ps(_mm_and_ps(lower, fx), _mm_andnot_ps(lower, px));
+    __m128 const oy = _mm_or_ps(_mm_and_ps(lower, fy), _mm_andnot_ps(lower, py));
+    return PackSnorm16x2_SSE(ox, oy);
+}
+
+static SIMD_FORCEINLINE __m128i PackRGBA8_SSE(__m128 r, __m128 g, __m128 b, __m128 a) {
+    __m128 const scale = _mm_set1_ps(255.0f);
+    __m128i const ir = _mm_cvtps_epi32(_mm_mul_ps(Clamp_SSE(r, 0.0f, 1.0f), scale));
+    __m128i const ig = _mm_cvtps_epi32(_mm_mul_ps(Clamp_SSE(g, 0.0f, 1.0f), scale));
+    __m128i const ib = _mm_cvtps_epi32(_mm_mul_ps(Clamp_SSE(b, 0.0f, 1.0f), scale));
+    __m128i const ia = _mm_cvtps_epi32(_mm_mul_ps(Clamp_SSE(a, 0.0f, 1.0f), scale));
+    return _mm_or_si128(_mm_or_si128(ir, _mm_slli_epi32(ig, 8)), _mm_or_si128(_mm_slli_epi32(ib, 16), _mm_slli_epi32(ia, 24)));
+}
+
+// Lane l of the four vectors is the PackedFragment at dst[l], written when bit l of `mask` is set.
+static SIMD_FORCEINLINE void StorePackedFragments_SSE(PackedFragment * dst, __m128 depth, __m128i normal, __m128i color, __m128i uv, int mask) {
+    static_assert(sizeof(PackedFragment) == sizeof(__m128));
+    __m128 row0 = depth;
+    __m128 row1 = _mm_castsi128_ps(normal);
+    __m128 row2 = _mm_castsi128_ps(color);
+    __m128 row3 = _mm_castsi128_ps(uv);
+    _MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+    if(0xF == mask) {
+        _mm_storeu_ps(reinterpret_cast<float *>(&dst[0]), row0);
+        _mm_storeu_ps(reinterpret_cast<float *>(&dst[1]), row1);
+        _mm_storeu_ps(reinterpret_cast<float *>(&dst[2]), row2);
+        _mm_storeu_ps(reinterpret_cast<float *>(&dst[3]), row3);
+        return;
+    }
+    __m128 const rows[4] = { row0, row1, row2, row3 };
+    for(int32_t l = 0; l < 4; ++l) {
+        if(0 != (mask & (1 << l))) {
+            _mm_storeu_ps(reinterpret_cast<float *>(&dst[l]), rows[l]);
+        }
+    }
+}
+
+#endif // SIMD_X86
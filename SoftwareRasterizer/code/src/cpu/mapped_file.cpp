@@ -0,0 +1,89 @@
+#include "mapped_file.hpp"
+
+#if defined(_WIN32)
+    #ifndef WIN32_LEAN_AND_MEAN
+        #define WIN32_LEAN_AND_MEAN
+    #endif
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() {
+    Close();
+}
+
+bool MappedFile::Open(char const * path) {
+    Close();
+
+#if defined(_WIN32)
+    HANDLE const file = ::CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if(INVALID_HANDLE_VALUE == file) {
+        ::printf("MappedFile::Open: can't open %s\n", path);
+        return false;
+    }
+    LARGE_INTEGER file_size = {};
+    if(!::GetFileSizeEx(file, &file_size) || 0 == file_size.QuadPart) {
+        ::printf("MappedFile::Open: %s is empty\n", path);
+        ::CloseHandle(file);
+        return false;
+    }
+    HANDLE const mapping = ::CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    void const * mapped = nullptr != mapping ? ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if(nullptr == mapped) {
+        ::printf("MappedFile::Open: can't map %s\n", path);
+        if(nullptr != mapping) {
+            ::CloseHandle(mapping);
+        }
+        ::CloseHandle(file);
+        return false;
+    }
+    file_handle = file;
+    mapping_handle = mapping;
+    size = static_cast<uint64_t>(file_size.QuadPart);
+#else
+    int const file = ::open(path, O_RDONLY);
+    if(file < 0) {
+        ::printf("MappedFile::Open: can't open %s\n", path);
+        return false;
+    }
+    struct stat file_stat = {};
+    if(0 != ::fstat(file, &file_stat) || 0 == file_stat.st_size) {
+        ::printf("MappedFile::Open: %s is empty\n", path);
+        ::close(file);
+        return false;
+    }
+    void * const mapped = ::mmap(nullptr, static_cast<size_t>(file_stat.st_size), PROT_READ, MAP_SHARED, file, 0);
+    // The mapping keeps its own reference to the file
+    ::close(file);
+    if(MAP_FAILED == mapped) {
+        ::printf("MappedFile::Open: can't map %s\n", path);
+        return false;
+    }
+    size = static_cast<uint64_t>(file_stat.st_size);
+#endif
+    data = static_cast<uint8_t const *>(mapped);
+    return true;
+}
+
+void MappedFile::Close() {
+    if(nullptr != data) {
+#if defined(_WIN32)
+        ::UnmapViewOfFile(data);
+        ::CloseHandle(mapping_handle);
+        ::CloseHandle(file_handle);
+        mapping_handle = nullptr;
+        file_handle = nullptr;
+#else
+        ::munmap(const_cast<uint8_t *>(data), static_cast<size_t>(size));
+#endif
+    }
+    data = nullptr;
+    size = 0;
+}
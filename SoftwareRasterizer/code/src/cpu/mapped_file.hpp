@@ -0,0 +1,29 @@
+#pragma once
+
+#include "../base.h"
+
+// Read only memory mapping of a whole file. Pages are faulted in from the file as they're read, so opening costs
+// the same whatever the size and the data never takes heap memory.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(MappedFile const &) = delete;
+    MappedFile & operator=(MappedFile const &) = delete;
+
+    // Returns false when the file can't be opened, is empty or can't be mapped
+    bool Open(char const * path);
+    void Close();
+
+    bool IsOpen() const { return nullptr != data; }
+    uint8_t const * GetData() const { return data; }
+    uint64_t GetSize() const { return size; }
+
+private:
+    uint8_t const * data = nullptr;
+    uint64_t        size = 0;
+#if defined(_WIN32)
+    void *          file_handle = nullptr;
+    void *          mapping_handle = nullptr;
+#endif
+};
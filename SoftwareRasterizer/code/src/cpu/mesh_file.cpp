@@ -0,0 +1,208 @@
+#include "mesh_file.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+static constexpr uint32_t MeshFileMaxSections = 16;
+
+static uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+static MeshBounds ComputeMeshBounds(MeshView const & mesh) {
+    MeshBounds bounds = {};
+    if(0 == mesh.vertex_count) {
+        return bounds;
+    }
+    for(uint32_t c = 0; c < 3; ++c) {
+        bounds.min[c] = mesh.vertices[0].pos[c];
+        bounds.max[c] = mesh.vertices[0].pos[c];
+    }
+    for(uint32_t v = 1; v < mesh.vertex_count; ++v) {
+        for(uint32_t c = 0; c < 3; ++c) {
+            bounds.min[c] = std::min(bounds.min[c], mesh.vertices[v].pos[c]);
+            bounds.max[c] = std::max(bounds.max[c], mesh.vertices[v].pos[c]);
+        }
+    }
+    for(uint32_t c = 0; c < 3; ++c) {
+        bounds.center[c] = (bounds.min[c] + bounds.max[c]) * 0.5f;
+    }
+    float radius2 = 0.0f;
+    for(uint32_t v = 0; v < mesh.vertex_count; ++v) {
+        float const dx = mesh.vertices[v].pos[0] - bounds.center[0];
+        float const dy = mesh.vertices[v].pos[1] - bounds.center[1];
+        float const dz = mesh.vertices[v].pos[2] - bounds.center[2];
+        radius2 = std::max(radius2, dx * dx + dy * dy + dz * dz);
+    }
+    bounds.radius = std::sqrt(radius2);
+    return bounds;
+}
+
+struct MeshFileSectionData {
+    MeshFileSectionType type;
+    uint32_t            element_size;
+    uint64_t            count;
+    void const *        data;
+};
+
+bool WriteMeshFile(char const * path, MeshView const & mesh, MeshletMesh const * meshlets) {
+    MeshBounds const bounds = ComputeMeshBounds(mesh);
+
+    MeshFileSectionData sections[MeshFileMaxSections] = {};
+    uint32_t section_count = 0;
+    sections[section_count++] = { MeshFileSectionType::Vertices, sizeof(Vertex), mesh.vertex_count, mesh.vertices };
+    sections[section_count++] = { MeshFileSectionType::Indices, sizeof(IndexType), mesh.index_count, mesh.indices };
+    sections[section_count++] = { MeshFileSectionType::Bounds, sizeof(MeshBounds), 1, &bounds };
+    if(nullptr != meshlets) {
+        sections[section_count++] = { MeshFileSectionType::Meshlets, sizeof(Meshlet), meshlets->meshlets.size(), meshlets->meshlets.data() };
+        sections[section_count++] = { MeshFileSectionType::MeshletVertices, sizeof(Vertex), meshlets->vertices.size(), meshlets->vertices.data() };
+        sections[section_count++] = { MeshFileSectionType::MeshletTriangles, sizeof(uint8_t), meshlets->triangles.size(), meshlets->triangles.data() };
+    }
+
+    MeshFileHeader header = {};
+    header.magic = MeshFileMagic;
+    header.version = MeshFileVersion;
+    header.section_count = section_count;
+
+    MeshFileSection table[MeshFileMaxSections] = {};
+    uint64_t offset = AlignUp(sizeof(MeshFileHeader) + sizeof(MeshFileSection) * section_count, MeshFileAlignment);
+    for(uint32_t i = 0; i < section_count; ++i) {
+        table[i].type = sections[i].type;
+        table[i].element_size = sections[i].element_size;
+        table[i].offset = offset;
+        table[i].count = sections[i].count;
+        offset = AlignUp(offset + sections[i].element_size * sections[i].count, MeshFileAlignment);
+    }
+    header.file_size = offset;
+
+    FILE * file = ::fopen(path, "wb");
+    if(nullptr == file) {
+        ::printf("WriteMeshFile: can't open %s for writing\n", path);
+        return false;
+    }
+    static constexpr uint8_t padding[MeshFileAlignment] = {};
+    bool ok = 1 == ::fwrite(&header, sizeof(header), 1, file);
+    ok = ok && section_count == ::fwrite(table, sizeof(MeshFileSection), section_count, file);
+    uint64_t written = sizeof(MeshFileHeader) + sizeof(MeshFileSection) * section_count;
+    for(uint32_t i = 0; i < section_count && ok; ++i) {
+        size_t const pad = static_cast<size_t>(table[i].offset - written);
+        ok = 0 == pad || 1 == ::fwrite(padding, pad, 1, file);
+        size_t const bytes = static_cast<size_t>(table[i].element_size * table[i].count);
+        ok = ok && (0 == bytes || 1 == ::fwrite(sections[i].data, bytes, 1, file));
+        written = table[i].offset + bytes;
+    }
+    size_t const pad = static_cast<size_t>(header.file_size - written);
+    ok = ok && (0 == pad || 1 == ::fwrite(padding, pad, 1, file));
+    ok = (0 == ::fclose(file)) && ok;
+    if(!ok) {
+        ::printf("WriteMeshFile: writing %s failed\n", path);
+    }
+    return ok;
+}
+
+MappedMeshFile::~MappedMeshFile() {
+    Close();
+}
+
+bool MappedMeshFile::Open(char const * path) {
+    Close();
+    if(false == file.Open(path)) {
+        return false;
+    }
+    data = file.GetData();
+    size = file.GetSize();
+    if(!Validate(path)) {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void MappedMeshFile::Close() {
+    file.Close();
+    data = nullptr;
+    size = 0;
+    view = {};
+}
+
+bool MappedMeshFile::Validate(char const * path) {
+    if(size < sizeof(MeshFileHeader)) {
+        ::printf("MappedMeshFile::Open: %s is too small for a mesh file\n", path);
+        return false;
+    }
+    MeshFileHeader const & header = *reinterpret_cast<MeshFileHeader const *>(data);
+    if(MeshFileMagic != header.magic) {
+        ::printf("MappedMeshFile::Open: %s is not a mesh file\n", path);
+        return false;
+    }
+    if(MeshFileVersion != header.version) {
+        ::printf("MappedMeshFile::Open: %s has version %u, expected %u\n", path, header.version, MeshFileVersion);
+        return false;
+    }
+    if(header.file_size != size || header.section_count > (size - sizeof(MeshFileHeader)) / sizeof(MeshFileSection)) {
+        ::printf("MappedMeshFile::Open: %s is truncated\n", path);
+        return false;
+    }
+
+    MeshFileSection const * const table = reinterpret_cast<MeshFileSection const *>(data + sizeof(MeshFileHeader));
+    for(uint32_t i = 0; i < header.section_count; ++i) {
+        MeshFileSection const & section = table[i];
+        uint32_t expected_element_size = 0;
+        switch(section.type) {
+            case MeshFileSectionType::Vertices:         expected_element_size = sizeof(Vertex); break;
+            case MeshFileSectionType::Indices:          expected_element_size = sizeof(IndexType); break;
+            case MeshFileSectionType::Bounds:           expected_element_size = sizeof(MeshBounds); break;
+            case MeshFileSectionType::Meshlets:         expected_element_size = sizeof(Meshlet); break;
+            case MeshFileSectionType::MeshletVertices:  expected_element_size = sizeof(Vertex); break;
+            case MeshFileSectionType::MeshletTriangles: expected_element_size = sizeof(uint8_t); break;
+            default: continue;
+        }
+        bool const in_file = section.offset <= size && section.count <= (size - section.offset) / expected_element_size;
+        if(expected_element_size != section.element_size || !in_file || 0 != section.offset % MeshFileAlignment || section.count > UINT32_MAX) {
+            ::printf("MappedMeshFile::Open: %s has an invalid section %u\n", path, i);
+            return false;
+        }
+
+        void const * const section_data = data + section.offset;
+        uint32_t const count = static_cast<uint32_t>(section.count);
+        switch(section.type) {
+            case MeshFileSectionType::Vertices:
+                view.mesh.vertices = static_cast<Vertex const *>(section_data);
+                view.mesh.vertex_count = count;
+                break;
+            case MeshFileSectionType::Indices:
+                view.mesh.indices = static_cast<IndexType const *>(section_data);
+                view.mesh.index_count = count;
+                break;
+            case MeshFileSectionType::Bounds:
+                view.bounds = 0 != count ? static_cast<MeshBounds const *>(section_data) : nullptr;
+                break;
+            case MeshFileSectionType::Meshlets:
+                view.meshlets = static_cast<Meshlet const *>(section_data);
+                view.meshlet_count = count;
+                break;
+            case MeshFileSectionType::MeshletVertices:
+                view.meshlet_vertices = static_cast<Vertex const *>(section_data);
+                view.meshlet_vertex_count = count;
+                break;
+            case MeshFileSectionType::MeshletTriangles:
+                view.meshlet_triangles = static_cast<uint8_t const *>(section_data);
+                view.meshlet_triangle_count = count / 3;
+                break;
+        }
+    }
+
+    if(nullptr == view.mesh.vertices || nullptr == view.mesh.indices) {
+        ::printf("MappedMeshFile::Open: %s has no vertices or indices\n", path);
+        return false;
+    }
+    if(nullptr == view.meshlets || nullptr == view.meshlet_vertices || nullptr == view.meshlet_triangles) {
+        view.meshlets = nullptr;
+        view.meshlet_count = 0;
+        view.meshlet_vertices = nullptr;
+        view.meshlet_vertex_count = 0;
+        view.meshlet_triangles = nullptr;
+        view.meshlet_triangle_count = 0;
+    }
+    return true;
+}
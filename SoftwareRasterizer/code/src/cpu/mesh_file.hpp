@@ -0,0 +1,94 @@
+#pragma once
+
+#include "mapped_file.hpp"
+#include "meshlets.hpp"
+
+// Binary mesh container that is used in place: the file is memory mapped and MeshFileView points straight
+// into the mapping, so opening it costs the same for a few KB or a few GB and nothing is parsed or copied.
+// Only the pages a consumer actually reads are faulted in, and they're backed by the file, not the heap.
+//
+// Layout (little endian, what every target of this project is):
+//   MeshFileHeader
+//   MeshFileSection[section_count]
+//   section data, each section starting at a multiple of MeshFileAlignment
+// Sections hold arrays of the in-memory types (Vertex, IndexType, ...) as is, element_size is checked against
+// their sizeof on open. Vertices and Indices are required, the others are optional, unknown types are skipped
+// so newer writers stay readable as long as the version doesn't change.
+constexpr uint32_t MeshFileMagic = 0x48534D52; // "RMSH"
+constexpr uint32_t MeshFileVersion = 1;
+constexpr uint32_t MeshFileAlignment = 64;
+
+enum class MeshFileSectionType : uint32_t {
+    Vertices = 0,           // Vertex
+    Indices,                // IndexType
+    Bounds,                 // one MeshBounds
+    Meshlets,               // Meshlet
+    MeshletVertices,        // Vertex, MeshletMesh::vertices
+    MeshletTriangles,       // uint8_t, MeshletMesh::triangles
+};
+
+struct MeshFileHeader {
+    uint32_t    magic;
+    uint32_t    version;
+    uint64_t    file_size;
+    uint32_t    section_count;
+    uint32_t    reserved;
+};
+
+struct MeshFileSection {
+    MeshFileSectionType type;
+    uint32_t    element_size;
+    uint64_t    offset;             // from the start of the file
+    uint64_t    count;              // elements
+};
+
+// Object space bounds of all vertices
+struct MeshBounds {
+    float       min[3];
+    float       max[3];
+    float       center[3];          // bounding sphere
+    float       radius;
+};
+
+// Everything points into the mapping, valid until the MappedMeshFile is closed. Missing optional sections
+// are nullptr / 0.
+struct MeshFileView {
+    MeshView            mesh;
+    MeshBounds const *  bounds;
+    Meshlet const *     meshlets;
+    uint32_t            meshlet_count;
+    Vertex const *      meshlet_vertices;
+    uint32_t            meshlet_vertex_count;
+    uint8_t const *     meshlet_triangles;      // 3 per triangle
+    uint32_t            meshlet_triangle_count;
+};
+
+// Writes `mesh`, its bounds and, when `meshlets` isn't nullptr, its meshlets. Returns false when the file
+// can't be written.
+bool WriteMeshFile(char const * path, MeshView const & mesh, MeshletMesh const * meshlets);
+
+// Read only mapping of a mesh file.
+// Open only checks the structure (header, section table, sizes and alignment of the sections), it never reads
+// the section data, so index values are trusted like those of any other Mesh.
+class MappedMeshFile {
+public:
+    MappedMeshFile() = default;
+    ~MappedMeshFile();
+    MappedMeshFile(MappedMeshFile const &) = delete;
+    MappedMeshFile & operator=(MappedMeshFile const &) = delete;
+
+    bool Open(char const * path);
+    void Close();
+
+    bool IsOpen() const { return nullptr != data; }
+    MeshFileView const & GetView() const { return view; }
+    uint64_t GetFileSize() const { return size; }
+
+private:
+    bool Validate(char const * path);
+
+    MappedFile      file;
+    uint8_t const * data = nullptr;
+    uint64_t        size = 0;
+    MeshFileView    view = {};
+};
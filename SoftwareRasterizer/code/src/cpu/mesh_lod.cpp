@@ -0,0 +1,521 @@
+#include "mesh_lod.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+static constexpr uint32_t InvalidVertex = ~0u;
+// Border planes against face planes: high enough that borders only move when nothing else is left
+static constexpr double BorderPlaneWeight = 10.0;
+// A LOD that keeps more than this of the previous one's indices isn't worth a level
+static constexpr float MeshLodMinProgress = 0.85f;
+
+enum class LodVertexKind : uint8_t {
+    Manifold,       // collapses onto any neighbor
+    Border,         // one open border passes through it, collapses onto its border neighbors
+    Locked,         // seam, non-manifold or several borders, never moves
+};
+
+// Sum of w * (n . p + d)^2 over planes, as the symmetric matrix, vector and constant of p^T A p + 2 b . p + c
+struct Quadric {
+    double      a00, a01, a02, a11, a12, a22;
+    double      b0, b1, b2;
+    double      c;
+    double      weight;
+};
+
+static void AddPlane(Quadric & q, double const n[3], double d, double w) {
+    q.a00 += w * n[0] * n[0];
+    q.a01 += w * n[0] * n[1];
+    q.a02 += w * n[0] * n[2];
+    q.a11 += w * n[1] * n[1];
+    q.a12 += w * n[1] * n[2];
+    q.a22 += w * n[2] * n[2];
+    q.b0 += w * n[0] * d;
+    q.b1 += w * n[1] * d;
+    q.b2 += w * n[2] * d;
+    q.c += w * d * d;
+    q.weight += w;
+}
+
+static Quadric AddQuadrics(Quadric const & a, Quadric const & b) {
+    return {
+        a.a00 + b.a00, a.a01 + b.a01, a.a02 + b.a02, a.a11 + b.a11, a.a12 + b.a12, a.a22 + b.a22,
+        a.b0 + b.b0, a.b1 + b.b1, a.b2 + b.b2,
+        a.c + b.c,
+        a.weight + b.weight,
+    };
+}
+
+// Distance like error: root of the weighted mean squared distance to the planes
+static float GetQuadricError(Quadric const & q, float const p[3]) {
+    if(!(q.weight > 0.0)) {
+        return 0.0f;
+    }
+    double const x = p[0], y = p[1], z = p[2];
+    double const r = q.a00 * x * x + q.a11 * y * y + q.a22 * z * z
+        + 2.0 * (q.a01 * x * y + q.a02 * x * z + q.a12 * y * z)
+        + 2.0 * (q.b0 * x + q.b1 * y + q.b2 * z)
+        + q.c;
+    return static_cast<float>(std::sqrt(std::max(r, 0.0) / q.weight));
+}
+
+static void GetTriangleNormal(float const * p0, float const * p1, float const * p2, double out[3]) {
+    double const e1[3] = { static_cast<double>(p1[0]) - p0[0], static_cast<double>(p1[1]) - p0[1], static_cast<double>(p1[2]) - p0[2] };
+    double const e2[3] = { static_cast<double>(p2[0]) - p0[0], static_cast<double>(p2[1]) - p0[1], static_cast<double>(p2[2]) - p0[2] };
+    out[0] = e1[1] * e2[2] - e1[2] * e2[1];
+    out[1] = e1[2] * e2[0] - e1[0] * e2[2];
+    out[2] = e1[0] * e2[1] - e1[1] * e2[0];
+}
+
+static uint32_t HashPosition(float const * p) {
+    uint32_t bits[3] = {};
+    ::memcpy(bits, p, sizeof(bits));
+    uint32_t h = bits[0] * 0x9E3779B1u;
+    h = (h ^ (h >> 15)) + bits[1] * 0x85EBCA77u;
+    h = (h ^ (h >> 13)) + bits[2] * 0xC2B2AE3Du;
+    return h ^ (h >> 16);
+}
+
+// Every referenced vertex to the first referenced vertex with the same position, and the number of vertices
+// (wedges) sharing each position.
+static void BuildPositionRemap(MeshView const & mesh, IndexType const * indices, uint32_t index_count, std::vector<uint32_t> & remap, std::vector<uint32_t> & wedge_count) {
+    uint32_t const vertex_count = mesh.vertex_count;
+    remap.assign(vertex_count, InvalidVertex);
+    wedge_count.assign(vertex_count, 0);
+    std::vector<uint8_t> referenced(vertex_count, 0);
+    for(uint32_t i = 0; i < index_count; ++i) {
+        ASSERT(indices[i] < vertex_count);
+        referenced[indices[i]] = 1;
+    }
+
+    uint32_t table_size = 1024;
+    while(table_size < vertex_count * 2ull) {
+        table_size *= 2;
+    }
+    std::vector<uint32_t> table(table_size, InvalidVertex);
+    for(uint32_t v = 0; v < vertex_count; ++v) {
+        if(0 == referenced[v]) {
+            continue;
+        }
+        float const * p = mesh.vertices[v].pos;
+        uint32_t slot = HashPosition(p) & (table_size - 1);
+        while(InvalidVertex != table[slot] && 0 != ::memcmp(mesh.vertices[table[slot]].pos, p, sizeof(float) * 3)) {
+            slot = (slot + 1) & (table_size - 1);
+        }
+        if(InvalidVertex == table[slot]) {
+            table[slot] = v;
+        }
+        remap[v] = table[slot];
+        wedge_count[table[slot]]++;
+    }
+}
+
+// Topology of the current triangles over position (remapped) vertices
+struct LodTopology {
+    std::vector<uint32_t>       offsets;        // per vertex, into triangles
+    std::vector<uint32_t>       triangles;      // triangles using the vertex
+    std::vector<LodVertexKind>  kinds;
+    std::vector<uint32_t>       border_next;    // along the outgoing border edge
+    std::vector<uint32_t>       border_prev;    // along the incoming border edge
+};
+
+static uint32_t CountDirectedEdges(LodTopology const & topology, uint32_t const * corners, uint32_t a, uint32_t b) {
+    uint32_t count = 0;
+    for(uint32_t i = topology.offsets[a]; i < topology.offsets[a + 1]; ++i) {
+        uint32_t const * tri = &corners[topology.triangles[i] * 3];
+        for(uint32_t k = 0; k < 3; ++k) {
+            count += a == tri[k] && b == tri[(k + 1) % 3] ? 1 : 0;
+        }
+    }
+    return count;
+}
+
+// `corners` are the position vertices of the triangles.
+static void BuildTopology(std::vector<uint32_t> const & corners, std::vector<uint32_t> const & wedge_count, LodTopology & topology) {
+    uint32_t const vertex_count = static_cast<uint32_t>(wedge_count.size());
+    uint32_t const triangle_count = static_cast<uint32_t>(corners.size() / 3);
+
+    topology.offsets.assign(vertex_count + 1, 0);
+    for(uint32_t c : corners) {
+        topology.offsets[c + 1]++;
+    }
+    for(uint32_t v = 0; v < vertex_count; ++v) {
+        topology.offsets[v + 1] += topology.offsets[v];
+    }
+    topology.triangles.resize(corners.size());
+    std::vector<uint32_t> cursor(topology.offsets.begin(), topology.offsets.end() - 1);
+    for(uint32_t t = 0; t < triangle_count; ++t) {
+        for(uint32_t k = 0; k < 3; ++k) {
+            topology.triangles[cursor[corners[t * 3 + k]]++] = t;
+        }
+    }
+
+    std::vector<uint8_t> locked(vertex_count, 0);
+    topology.border_next.assign(vertex_count, InvalidVertex);
+    topology.border_prev.assign(vertex_count, InvalidVertex);
+    for(uint32_t t = 0; t < triangle_count; ++t) {
+        for(uint32_t k = 0; k < 3; ++k) {
+            uint32_t const a = corners[t * 3 + k];
+            uint32_t const b = corners[t * 3 + (k + 1) % 3];
+            uint32_t const same = CountDirectedEdges(topology, corners.data(), a, b);
+            uint32_t const opposite = CountDirectedEdges(topology, corners.data(), b, a);
+            if(same > 1 || opposite > 1) {
+                locked[a] = 1;
+                locked[b] = 1;
+            } else if(0 == opposite) {
+                // A second border through the same vertex makes it non-manifold
+                if(InvalidVertex != topology.border_next[a]) {
+                    locked[a] = 1;
+                }
+                if(InvalidVertex != topology.border_prev[b]) {
+                    locked[b] = 1;
+                }
+                topology.border_next[a] = b;
+                topology.border_prev[b] = a;
+            }
+        }
+    }
+
+    topology.kinds.resize(vertex_count);
+    for(uint32_t v = 0; v < vertex_count; ++v) {
+        bool const next = InvalidVertex != topology.border_next[v];
+        bool const prev = InvalidVertex != topology.border_prev[v];
+        if(0 != locked[v] || wedge_count[v] > 1 || next != prev) {
+            topology.kinds[v] = LodVertexKind::Locked;
+        } else {
+            topology.kinds[v] = next ? LodVertexKind::Border : LodVertexKind::Manifold;
+        }
+    }
+}
+
+static bool CanCollapse(LodTopology const & topology, uint32_t from, uint32_t to) {
+    LodVertexKind const kind = topology.kinds[from];
+    return LodVertexKind::Manifold == kind
+        || (LodVertexKind::Border == kind && (topology.border_next[from] == to || topology.border_prev[from] == to));
+}
+
+struct LodCollapse {
+    uint32_t    from;
+    uint32_t    to;
+    float       error;
+};
+
+struct LodCollapseCheck {
+    std::vector<uint32_t>   marks;
+    uint32_t                stamp = 0;
+};
+
+// Rejects collapses that flip a triangle around `from` or join two vertices with more common neighbors than
+// triangles on their edge, which would leave non-manifold edges behind. Returns the triangles the collapse removes.
+static bool CheckCollapse(MeshView const & mesh, LodTopology const & topology, uint32_t const * corners, uint32_t from, uint32_t to, LodCollapseCheck & check, uint32_t & out_removed) {
+    uint32_t removed = 0;
+    for(uint32_t i = topology.offsets[from]; i < topology.offsets[from + 1]; ++i) {
+        uint32_t const * tri = &corners[topology.triangles[i] * 3];
+        if(to == tri[0] || to == tri[1] || to == tri[2]) {
+            ++removed;
+            continue;
+        }
+        float const * before[3] = { mesh.vertices[tri[0]].pos, mesh.vertices[tri[1]].pos, mesh.vertices[tri[2]].pos };
+        float const * after[3];
+        for(uint32_t k = 0; k < 3; ++k) {
+            after[k] = from == tri[k] ? mesh.vertices[to].pos : before[k];
+        }
+        double normal_before[3], normal_after[3];
+        GetTriangleNormal(before[0], before[1], before[2], normal_before);
+        GetTriangleNormal(after[0], after[1], after[2], normal_after);
+        if(!(normal_before[0] * normal_after[0] + normal_before[1] * normal_after[1] + normal_before[2] * normal_after[2] > 0.0)) {
+            return false;
+        }
+    }
+
+    // Neighbors of `to` get the stamp, the ones of `from` found with it get the next one so they count once
+    check.stamp += 2;
+    uint32_t const to_stamp = check.stamp;
+    uint32_t const counted_stamp = check.stamp + 1;
+    for(uint32_t i = topology.offsets[to]; i < topology.offsets[to + 1]; ++i) {
+        uint32_t const * tri = &corners[topology.triangles[i] * 3];
+        for(uint32_t k = 0; k < 3; ++k) {
+            check.marks[tri[k]] = to_stamp;
+        }
+    }
+    uint32_t common = 0;
+    for(uint32_t i = topology.offsets[from]; i < topology.offsets[from + 1]; ++i) {
+        uint32_t const * tri = &corners[topology.triangles[i] * 3];
+        for(uint32_t k = 0; k < 3; ++k) {
+            uint32_t const v = tri[k];
+            if(v != from && v != to && to_stamp == check.marks[v]) {
+                check.marks[v] = counted_stamp;
+                ++common;
+            }
+        }
+    }
+    out_removed = removed;
+    return common <= removed;
+}
+
+uint32_t SimplifyMesh(
+    MeshView const & mesh,
+    IndexType const * indices,
+    uint32_t index_count,
+    uint32_t target_index_count,
+    float max_error,
+    IndexType * out_indices,
+    float * out_error)
+{
+    uint32_t const vertex_count = mesh.vertex_count;
+    std::vector<IndexType> result(indices, indices + index_count - index_count % 3);
+    std::vector<uint32_t> remap;
+    std::vector<uint32_t> wedge_count;
+    BuildPositionRemap(mesh, indices, index_count, remap, wedge_count);
+
+    std::vector<uint32_t> corners(result.size());
+    for(size_t i = 0; i < result.size(); ++i) {
+        corners[i] = remap[result[i]];
+    }
+
+    // Face planes
+    std::vector<Quadric> quadrics(vertex_count, Quadric{});
+    for(size_t t = 0; t < corners.size() / 3; ++t) {
+        float const * p0 = mesh.vertices[corners[t * 3 + 0]].pos;
+        double normal[3];
+        GetTriangleNormal(p0, mesh.vertices[corners[t * 3 + 1]].pos, mesh.vertices[corners[t * 3 + 2]].pos, normal);
+        double const length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        if(!(length > 0.0)) {
+            continue;
+        }
+        double const n[3] = { normal[0] / length, normal[1] / length, normal[2] / length };
+        double const d = -(n[0] * p0[0] + n[1] * p0[1] + n[2] * p0[2]);
+        for(uint32_t k = 0; k < 3; ++k) {
+            AddPlane(quadrics[corners[t * 3 + k]], n, d, length * 0.5);
+        }
+    }
+
+    LodTopology topology = {};
+    LodCollapseCheck check = {};
+    check.marks.assign(vertex_count, 0);
+    std::vector<uint32_t> best_to(vertex_count, InvalidVertex);
+    std::vector<float> best_error(vertex_count);
+    std::vector<uint8_t> touched(vertex_count, 0);
+    std::vector<uint32_t> vertex_collapse(vertex_count, InvalidVertex);
+    std::vector<LodCollapse> collapses;
+    float result_error = 0.0f;
+    uint32_t const target_triangles = target_index_count / 3;
+
+    for(uint32_t pass = 0; result.size() / 3 > target_triangles; ++pass) {
+        uint32_t const triangle_count = static_cast<uint32_t>(result.size() / 3);
+        BuildTopology(corners, wedge_count, topology);
+
+        // Border planes, from the input borders only: later passes keep them where they are
+        if(0 == pass) {
+            for(uint32_t t = 0; t < triangle_count; ++t) {
+                for(uint32_t k = 0; k < 3; ++k) {
+                    uint32_t const a = corners[t * 3 + k];
+                    uint32_t const b = corners[t * 3 + (k + 1) % 3];
+                    if(topology.border_next[a] != b) {
+                        continue;
+                    }
+                    float const * pa = mesh.vertices[a].pos;
+                    float const * pb = mesh.vertices[b].pos;
+                    double face[3];
+                    GetTriangleNormal(pa, pb, mesh.vertices[corners[t * 3 + (k + 2) % 3]].pos, face);
+                    double const edge[3] = { static_cast<double>(pb[0]) - pa[0], static_cast<double>(pb[1]) - pa[1], static_cast<double>(pb[2]) - pa[2] };
+                    double n[3] = { edge[1] * face[2] - edge[2] * face[1], edge[2] * face[0] - edge[0] * face[2], edge[0] * face[1] - edge[1] * face[0] };
+                    double const length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+                    if(!(length > 0.0)) {
+                        continue;
+                    }
+                    n[0] /= length;
+                    n[1] /= length;
+                    n[2] /= length;
+                    double const d = -(n[0] * pa[0] + n[1] * pa[1] + n[2] * pa[2]);
+                    double const weight = (edge[0] * edge[0] + edge[1] * edge[1] + edge[2] * edge[2]) * BorderPlaneWeight;
+                    AddPlane(quadrics[a], n, d, weight);
+                    AddPlane(quadrics[b], n, d, weight);
+                }
+            }
+        }
+
+        // Cheapest collapse of every vertex
+        std::fill(best_to.begin(), best_to.end(), InvalidVertex);
+        for(uint32_t t = 0; t < triangle_count; ++t) {
+            for(uint32_t k = 0; k < 3; ++k) {
+                uint32_t const edge[2] = { corners[t * 3 + k], corners[t * 3 + (k + 1) % 3] };
+                for(uint32_t e = 0; e < 2; ++e) {
+                    uint32_t const from = edge[e];
+                    uint32_t const to = edge[1 - e];
+                    if(!CanCollapse(topology, from, to)) {
+                        continue;
+                    }
+                    float const error = GetQuadricError(AddQuadrics(quadrics[from], quadrics[to]), mesh.vertices[to].pos);
+                    if(InvalidVertex == best_to[from] || error < best_error[from] || (error == best_error[from] && to < best_to[from])) {
+                        best_to[from] = to;
+                        best_error[from] = error;
+                    }
+                }
+            }
+        }
+        collapses.clear();
+        for(uint32_t v = 0; v < vertex_count; ++v) {
+            if(InvalidVertex != best_to[v] && best_error[v] <= max_error) {
+                collapses.push_back({ v, best_to[v], best_error[v] });
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(), [](LodCollapse const & a, LodCollapse const & b) {
+            return a.error < b.error || (a.error == b.error && a.from < b.from);
+        });
+
+        // Apply the cheapest ones that don't overlap
+        std::fill(touched.begin(), touched.end(), uint8_t(0));
+        uint32_t removed = 0;
+        uint32_t applied = 0;
+        for(LodCollapse const & collapse : collapses) {
+            if(triangle_count - removed <= target_triangles) {
+                break;
+            }
+            uint32_t const from = collapse.from;
+            uint32_t const to = collapse.to;
+            uint32_t collapse_removed = 0;
+            if(0 != touched[from] || 0 != touched[to] || !CheckCollapse(mesh, topology, corners.data(), from, to, check, collapse_removed)) {
+                continue;
+            }
+
+            // `from` has a single wedge, so it's the vertex itself. Its corners take the wedge of `to` on its side of
+            // any seam through `to`: the one of a triangle on their common edge.
+            uint32_t to_wedge = to;
+            for(uint32_t i = topology.offsets[from]; i < topology.offsets[from + 1]; ++i) {
+                uint32_t const t = topology.triangles[i];
+                for(uint32_t k = 0; k < 3; ++k) {
+                    to_wedge = to == corners[t * 3 + k] ? result[t * 3 + k] : to_wedge;
+                }
+            }
+            vertex_collapse[from] = to_wedge;
+            quadrics[to] = AddQuadrics(quadrics[from], quadrics[to]);
+            result_error = std::max(result_error, collapse.error);
+
+            // The triangles around `from` change, so nothing of them can be checked again in this pass
+            for(uint32_t i = topology.offsets[from]; i < topology.offsets[from + 1]; ++i) {
+                uint32_t const t = topology.triangles[i];
+                touched[corners[t * 3 + 0]] = 1;
+                touched[corners[t * 3 + 1]] = 1;
+                touched[corners[t * 3 + 2]] = 1;
+            }
+            removed += collapse_removed;
+            ++applied;
+        }
+        if(0 == applied) {
+            break;
+        }
+
+        // Remap and drop the triangles that became degenerate
+        size_t write = 0;
+        for(size_t t = 0; t < triangle_count; ++t) {
+            uint32_t tri[3];
+            uint32_t c[3];
+            for(uint32_t k = 0; k < 3; ++k) {
+                uint32_t const v = result[t * 3 + k];
+                tri[k] = InvalidVertex != vertex_collapse[v] ? vertex_collapse[v] : v;
+                c[k] = remap[tri[k]];
+            }
+            if(c[0] == c[1] || c[1] == c[2] || c[0] == c[2]) {
+                continue;
+            }
+            for(uint32_t k = 0; k < 3; ++k) {
+                result[write * 3 + k] = tri[k];
+                corners[write * 3 + k] = c[k];
+            }
+            ++write;
+        }
+        result.resize(write * 3);
+        corners.resize(write * 3);
+        for(LodCollapse const & collapse : collapses) {
+            vertex_collapse[collapse.from] = InvalidVertex;
+        }
+    }
+
+    std::copy(result.begin(), result.end(), out_indices);
+    if(nullptr != out_error) {
+        *out_error = result_error;
+    }
+    return static_cast<uint32_t>(result.size());
+}
+
+void BuildMeshLods(MeshView const & mesh, MeshLodChain & out) {
+    out.indices.assign(mesh.indices, mesh.indices + mesh.index_count);
+    out.lods.clear();
+    out.lods.push_back({ 0, mesh.index_count, 0.0f });
+
+    // Bounding sphere around the center of the bounding box
+    float min[3] = {}, max[3] = {};
+    for(uint32_t v = 0; v < mesh.vertex_count; ++v) {
+        for(uint32_t c = 0; c < 3; ++c) {
+            min[c] = 0 == v ? mesh.vertices[v].pos[c] : std::min(min[c], mesh.vertices[v].pos[c]);
+            max[c] = 0 == v ? mesh.vertices[v].pos[c] : std::max(max[c], mesh.vertices[v].pos[c]);
+        }
+    }
+    float radius2 = 0.0f;
+    for(uint32_t c = 0; c < 3; ++c) {
+        out.center[c] = (min[c] + max[c]) * 0.5f;
+    }
+    for(uint32_t v = 0; v < mesh.vertex_count; ++v) {
+        float const * p = mesh.vertices[v].pos;
+        float const d[3] = { p[0] - out.center[0], p[1] - out.center[1], p[2] - out.center[2] };
+        radius2 = std::max(radius2, d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+    }
+    out.radius = std::sqrt(radius2);
+
+    std::vector<IndexType> lod_indices;
+    while(out.lods.size() < MeshLodMaxCount) {
+        MeshLod const previous = out.lods.back();
+        if(previous.index_count / 3 <= MeshLodMinTriangles) {
+            break;
+        }
+        uint32_t const target_index_count = static_cast<uint32_t>(static_cast<float>(previous.index_count / 3) * MeshLodReduction) * 3;
+        lod_indices.resize(previous.index_count);
+        float error = 0.0f;
+        uint32_t const index_count = SimplifyMesh(mesh, &out.indices[previous.index_offset], previous.index_count, target_index_count,
+            std::numeric_limits<float>::max(), lod_indices.data(), &error);
+        if(0 == index_count || static_cast<float>(index_count) > static_cast<float>(previous.index_count) * MeshLodMinProgress) {
+            break;
+        }
+        out.lods.push_back({ static_cast<uint32_t>(out.indices.size()), index_count, previous.error + error });
+        out.indices.insert(out.indices.end(), lod_indices.begin(), lod_indices.begin() + index_count);
+    }
+}
+
+float GetMeshLodPixelError(MeshLodChain const & chain, uint32_t lod, VertexTransforms const & transforms, float viewport_height) {
+    float const error = chain.lods[lod].error;
+    if(0.0f == error) {
+        return 0.0f;
+    }
+    // Largest scale of the model matrix, the view matrix doesn't scale
+    float scale2 = 0.0f;
+    for(uint32_t r = 0; r < 3; ++r) {
+        float const * row = transforms.model.m[r];
+        scale2 = std::max(scale2, row[0] * row[0] + row[1] * row[1] + row[2] * row[2]);
+    }
+    float const scale = std::sqrt(scale2);
+
+    // Clip w of the center and of the nearest point of the sphere: the view depth for perspective projections,
+    // constant for orthographic ones.
+    float const center[4] = { chain.center[0], chain.center[1], chain.center[2], 1.0f };
+    float center_view[4];
+    TransformPoint(MultiplyMatrix(transforms.model, transforms.view), center, center_view);
+    Matrix4x4 const & proj = transforms.proj;
+    float const w = center_view[2] * proj.m[2][3] + center_view[3] * proj.m[3][3];
+    float const nearest_w = w - chain.radius * scale * std::fabs(proj.m[2][3]);
+    if(!(nearest_w > 0.0f)) {
+        return std::numeric_limits<float>::infinity();
+    }
+    return error * scale * std::fabs(proj.m[1][1]) * 0.5f * viewport_height / nearest_w;
+}
+
+uint32_t SelectMeshLod(MeshLodChain const & chain, VertexTransforms const & transforms, float viewport_height, float max_pixel_error) {
+    for(uint32_t lod = static_cast<uint32_t>(chain.lods.size()); lod-- > 1;) {
+        if(GetMeshLodPixelError(chain, lod, transforms, viewport_height) <= max_pixel_error) {
+            return lod;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "pipeline_types.hpp"
+
+// Levels of detail of a Mesh as a chain of simplified index buffers over the mesh's own vertices: a coarser
+// LOD only drops vertices, so every LOD draws with the same vertex buffer, vertex shading and streams.
+//
+// SimplifyMesh is quadric error edge collapse (Garland & Heckbert) restricted to collapsing a vertex onto one
+// of its neighbors:
+//   - every vertex accumulates the area weighted planes of its triangles, plus planes through border edges
+//     perpendicular to the surface so open borders keep their outline
+//   - each pass picks the cheapest collapse of every vertex, sorts them and applies as many as possible that
+//     don't touch a vertex already changed in the pass, don't flip a triangle and keep the surface manifold
+//   - vertices with more than one wedge (same position, different attributes: UV or normal seams) and
+//     non-manifold vertices never move, border vertices only slide along their border
+// Errors are distances in object space: the square root of the area weighted mean squared distance of a
+// vertex to the planes it absorbed.
+constexpr uint32_t MeshLodMaxCount = 12;
+// Target triangle count of each LOD relative to the previous one
+constexpr float MeshLodReduction = 0.5f;
+// Smallest LOD that's still worth a level
+constexpr uint32_t MeshLodMinTriangles = 64;
+
+struct MeshLod {
+    uint32_t    index_offset;       // in MeshLodChain::indices
+    uint32_t    index_count;
+    float       error;              // object space, 0 for LOD 0
+};
+
+struct MeshLodChain {
+    std::vector<IndexType>  indices;        // every LOD, LOD 0 (the mesh's own indices) first
+    std::vector<MeshLod>    lods;           // finest first, errors increase
+    float                   center[3];      // bounding sphere of the vertices
+    float                   radius;
+};
+
+// Simplifies the triangles `indices` of `mesh` down to `target_index_count` indices or until the next collapse
+// would exceed `max_error`, whichever comes first. Writes at most `index_count` indices to `out_indices` (can be
+// `indices`) and returns how many. `out_error` (can be nullptr) gets the error of the result.
+uint32_t SimplifyMesh(
+    MeshView const & mesh,
+    IndexType const * indices,
+    uint32_t index_count,
+    uint32_t target_index_count,
+    float max_error,
+    IndexType * out_indices,
+    float * out_error);
+
+// LOD 0 is `mesh` as is, every next LOD simplifies the previous one to MeshLodReduction of its triangles. The
+// chain stops at MeshLodMaxCount LODs, below MeshLodMinTriangles or when a LOD can't be reduced much further.
+// LOD errors add up along the chain, so they're a bound on the distance to LOD 0.
+void BuildMeshLods(MeshView const & mesh, MeshLodChain & out);
+
+// Error of `lod` in pixels when drawn with `transforms` on a viewport `viewport_height` pixels high, taken at the
+// point of the bounding sphere nearest to the camera. Infinite when the camera is inside the sphere.
+float GetMeshLodPixelError(MeshLodChain const & chain, uint32_t lod, VertexTransforms const & transforms, float viewport_height);
+
+// Coarsest LOD whose pixel error is at most `max_pixel_error`, 0 when none is.
+uint32_t SelectMeshLod(MeshLodChain const & chain, VertexTransforms const & transforms, float viewport_height, float max_pixel_error);
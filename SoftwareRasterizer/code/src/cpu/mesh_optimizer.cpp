@@ -0,0 +1,257 @@
+#include "mesh_optimizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+static constexpr uint32_t InvalidTriangle = ~0u;
+static constexpr uint32_t InvalidVertex = ~0u;
+
+// Forsyth's constants: the LRU cache being optimized for, the three vertices of the last triangle get a
+// fixed score (they were just used, which doesn't mean the next triangle should use all of them), the others
+// decay with their age. Vertices with few triangles left are boosted so they get finished.
+static constexpr uint32_t ForsythCacheSize = 32;
+static constexpr float ForsythCacheDecayPower = 1.5f;
+static constexpr float ForsythLastTriangleScore = 0.75f;
+static constexpr float ForsythValenceBoostScale = 2.0f;
+static constexpr float ForsythValenceBoostPower = 0.5f;
+static constexpr uint32_t ForsythValenceTableSize = 32;
+
+struct ForsythScoreTables {
+    float       cache[ForsythCacheSize];
+    float       valence[ForsythValenceTableSize];
+};
+
+static ForsythScoreTables GetForsythScoreTables() {
+    ForsythScoreTables tables = {};
+    for(uint32_t i = 0; i < ForsythCacheSize; ++i) {
+        if(i < 3) {
+            tables.cache[i] = ForsythLastTriangleScore;
+        } else {
+            float const scale = 1.0f / static_cast<float>(ForsythCacheSize - 3);
+            tables.cache[i] = std::pow(1.0f - static_cast<float>(i - 3) * scale, ForsythCacheDecayPower);
+        }
+    }
+    tables.valence[0] = 0.0f;
+    for(uint32_t i = 1; i < ForsythValenceTableSize; ++i) {
+        tables.valence[i] = ForsythValenceBoostScale * std::pow(static_cast<float>(i), -ForsythValenceBoostPower);
+    }
+    return tables;
+}
+
+// `cache_position` < 0 when not in the cache, `valence` is the number of triangles not emitted yet.
+static float GetVertexScore(ForsythScoreTables const & tables, int32_t cache_position, uint32_t valence) {
+    if(0 == valence) {
+        // Done, its score doesn't matter to any triangle
+        return 0.0f;
+    }
+    float score = cache_position < 0 ? 0.0f : tables.cache[cache_position];
+    score += tables.valence[std::min(valence, ForsythValenceTableSize - 1)];
+    return score;
+}
+
+VertexCacheStats AnalyzeVertexCache(IndexType const * indices, uint32_t index_count, uint32_t vertex_count, uint32_t vertex_stride) {
+    VertexCacheStats stats = {};
+    stats.triangles = index_count / 3;
+
+    // FIFO caches: an entry is still there when fewer than cache size misses happened since it was loaded.
+    // Timestamps start above the cache size so the zero initialized ones are all misses.
+    std::vector<uint32_t> vertex_timestamps(vertex_count, 0);
+    uint32_t vertex_time = VertexCacheAnalysisSize + 1;
+    uint32_t const line_count = static_cast<uint32_t>((static_cast<uint64_t>(vertex_count) * vertex_stride + VertexFetchLineSize - 1) / VertexFetchLineSize);
+    std::vector<uint32_t> line_timestamps(line_count, 0);
+    uint32_t line_time = VertexFetchCacheLines + 1;
+    std::vector<uint8_t> referenced(vertex_count, 0);
+
+    for(uint32_t i = 0; i < stats.triangles * 3; ++i) {
+        IndexType const index = indices[i];
+        ASSERT(index < vertex_count);
+        stats.vertices += 0 == referenced[index] ? 1 : 0;
+        referenced[index] = 1;
+
+        if(vertex_time - vertex_timestamps[index] > VertexCacheAnalysisSize) {
+            vertex_timestamps[index] = vertex_time++;
+            stats.transformed++;
+
+            // Only cache misses read the vertex
+            uint64_t const begin = static_cast<uint64_t>(index) * vertex_stride;
+            uint32_t const first_line = static_cast<uint32_t>(begin / VertexFetchLineSize);
+            uint32_t const last_line = static_cast<uint32_t>((begin + vertex_stride - 1) / VertexFetchLineSize);
+            for(uint32_t line = first_line; line <= last_line; ++line) {
+                if(line_time - line_timestamps[line] > VertexFetchCacheLines) {
+                    line_timestamps[line] = line_time++;
+                    stats.fetched_lines++;
+                }
+            }
+        }
+    }
+
+    if(0 != stats.triangles) {
+        stats.acmr = static_cast<float>(stats.transformed) / static_cast<float>(stats.triangles);
+    }
+    if(0 != stats.vertices) {
+        stats.atvr = static_cast<float>(stats.transformed) / static_cast<float>(stats.vertices);
+        stats.overfetch = static_cast<float>(static_cast<uint64_t>(stats.fetched_lines) * VertexFetchLineSize) / static_cast<float>(static_cast<uint64_t>(stats.vertices) * vertex_stride);
+    }
+    return stats;
+}
+
+void OptimizeVertexCache(IndexType * indices, uint32_t index_count, uint32_t vertex_count) {
+    uint32_t const triangle_count = index_count / 3;
+    if(0 == triangle_count) {
+        return;
+    }
+    ForsythScoreTables const tables = GetForsythScoreTables();
+
+    // Triangles using each vertex, the first live_count[v] of a vertex are the ones not emitted yet.
+    std::vector<uint32_t> adjacency_offsets(vertex_count + 1, 0);
+    for(uint32_t i = 0; i < triangle_count * 3; ++i) {
+        ASSERT(indices[i] < vertex_count);
+        adjacency_offsets[indices[i] + 1]++;
+    }
+    for(uint32_t v = 0; v < vertex_count; ++v) {
+        adjacency_offsets[v + 1] += adjacency_offsets[v];
+    }
+    std::vector<uint32_t> adjacency(triangle_count * 3);
+    std::vector<uint32_t> live_count(vertex_count, 0);
+    for(uint32_t i = 0; i < triangle_count * 3; ++i) {
+        IndexType const v = indices[i];
+        adjacency[adjacency_offsets[v] + live_count[v]++] = i / 3;
+    }
+
+    std::vector<int32_t> cache_position(vertex_count, -1);
+    std::vector<float> vertex_score(vertex_count);
+    for(uint32_t v = 0; v < vertex_count; ++v) {
+        vertex_score[v] = GetVertexScore(tables, -1, live_count[v]);
+    }
+    std::vector<float> triangle_score(triangle_count);
+    for(uint32_t t = 0; t < triangle_count; ++t) {
+        triangle_score[t] = vertex_score[indices[t * 3 + 0]] + vertex_score[indices[t * 3 + 1]] + vertex_score[indices[t * 3 + 2]];
+    }
+
+    std::vector<uint8_t> emitted(triangle_count, 0);
+    std::vector<IndexType> output(triangle_count * 3);
+    // Cache before and after emitting a triangle, 3 more entries for the vertices pushed out by it.
+    uint32_t cache[ForsythCacheSize + 3];
+    uint32_t new_cache[ForsythCacheSize + 3];
+    uint32_t cache_count = 0;
+
+    uint32_t scan = 0;
+    uint32_t best = InvalidTriangle;
+    for(uint32_t emitted_count = 0; emitted_count < triangle_count; ++emitted_count) {
+        if(InvalidTriangle == best) {
+            // Nothing in the cache has triangles left: the next one in input order.
+            while(0 != emitted[scan]) {
+                ++scan;
+            }
+            best = scan;
+        }
+
+        IndexType const * const tri = &indices[best * 3];
+        output[emitted_count * 3 + 0] = tri[0];
+        output[emitted_count * 3 + 1] = tri[1];
+        output[emitted_count * 3 + 2] = tri[2];
+        emitted[best] = 1;
+
+        for(uint32_t k = 0; k < 3; ++k) {
+            uint32_t * const adjacent = &adjacency[adjacency_offsets[tri[k]]];
+            uint32_t & count = live_count[tri[k]];
+            for(uint32_t a = 0; a < count; ++a) {
+                if(adjacent[a] == best) {
+                    adjacent[a] = adjacent[count - 1];
+                    --count;
+                    break;
+                }
+            }
+        }
+
+        // The triangle's vertices move to the front, the rest keep their order.
+        uint32_t new_cache_count = 0;
+        for(uint32_t k = 0; k < 3; ++k) {
+            bool duplicate = false;
+            for(uint32_t i = 0; i < new_cache_count; ++i) {
+                duplicate |= new_cache[i] == tri[k];
+            }
+            if(!duplicate) {
+                new_cache[new_cache_count++] = tri[k];
+            }
+        }
+        for(uint32_t i = 0; i < cache_count; ++i) {
+            uint32_t const v = cache[i];
+            if(v != tri[0] && v != tri[1] && v != tri[2]) {
+                new_cache[new_cache_count++] = v;
+            }
+        }
+
+        // New scores of everything that was or is in the cache, passed on to the triangles still using them,
+        // then the best of those triangles.
+        for(uint32_t i = 0; i < new_cache_count; ++i) {
+            uint32_t const v = new_cache[i];
+            cache_position[v] = i < ForsythCacheSize ? static_cast<int32_t>(i) : -1;
+            float const score = GetVertexScore(tables, cache_position[v], live_count[v]);
+            float const delta = score - vertex_score[v];
+            vertex_score[v] = score;
+            uint32_t const * const adjacent = &adjacency[adjacency_offsets[v]];
+            for(uint32_t a = 0; a < live_count[v]; ++a) {
+                triangle_score[adjacent[a]] += delta;
+            }
+        }
+        best = InvalidTriangle;
+        float best_score = 0.0f;
+        for(uint32_t i = 0; i < new_cache_count; ++i) {
+            uint32_t const v = new_cache[i];
+            uint32_t const * const adjacent = &adjacency[adjacency_offsets[v]];
+            for(uint32_t a = 0; a < live_count[v]; ++a) {
+                uint32_t const t = adjacent[a];
+                if(triangle_score[t] > best_score || (triangle_score[t] == best_score && t < best)) {
+                    best = t;
+                    best_score = triangle_score[t];
+                }
+            }
+        }
+
+        cache_count = std::min(new_cache_count, ForsythCacheSize);
+        std::copy_n(new_cache, cache_count, cache);
+    }
+
+    std::copy(output.begin(), output.end(), indices);
+}
+
+void OptimizeVertexFetch(Mesh & mesh) {
+    uint32_t const vertex_count = static_cast<uint32_t>(mesh.vertices.size());
+    std::vector<uint32_t> remap(vertex_count, InvalidVertex);
+    uint32_t next = 0;
+    for(IndexType & index : mesh.indices) {
+        ASSERT(index < vertex_count);
+        if(InvalidVertex == remap[index]) {
+            remap[index] = next++;
+        }
+        index = static_cast<IndexType>(remap[index]);
+    }
+    for(uint32_t v = 0; v < vertex_count; ++v) {
+        if(InvalidVertex == remap[v]) {
+            remap[v] = next++;
+        }
+    }
+
+    std::vector<Vertex> vertices(vertex_count);
+    for(uint32_t v = 0; v < vertex_count; ++v) {
+        vertices[remap[v]] = mesh.vertices[v];
+    }
+    mesh.vertices.swap(vertices);
+}
+
+void OptimizeMesh(Mesh & mesh, MeshOptimizationStats * out_stats) {
+    uint32_t const vertex_count = static_cast<uint32_t>(mesh.vertices.size());
+    uint32_t const index_count = static_cast<uint32_t>(mesh.indices.size());
+    // Primitive assembly and the rasterizer are the ones reading vertices in index order
+    uint32_t const vertex_stride = sizeof(OutputVertexAttributes);
+
+    if(nullptr != out_stats) {
+        out_stats->before = AnalyzeVertexCache(mesh.indices.data(), index_count, vertex_count, vertex_stride);
+    }
+    OptimizeVertexCache(mesh.indices.data(), index_count, vertex_count);
+    OptimizeVertexFetch(mesh);
+    if(nullptr != out_stats) {
+        out_stats->after = AnalyzeVertexCache(mesh.indices.data(), index_count, vertex_count, vertex_stride);
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "pipeline_types.hpp"
+
+// Load time reordering of a Mesh for the two caches its index buffer goes through:
+//   - post-transform vertex cache: triangles sharing vertices are brought close together in the index buffer
+//     (OptimizeVertexCache), so a vertex shaded for one triangle is still around for the next ones.
+//   - vertex fetch: vertices are renumbered in the order the index buffer first uses them
+//     (OptimizeVertexFetch), so ShadeVertices' linear pass and the indexed reads of primitive assembly and
+//     the rasterizer walk the vertex arrays mostly forward instead of jumping around.
+// Neither changes what is drawn: the same triangles with the same winding, in a different order.
+
+// Entries of the simulated post-transform cache, FIFO like the hardware the metrics are usually quoted for.
+constexpr uint32_t VertexCacheAnalysisSize = 16;
+// Cache line and cache size of the simulated vertex fetch cache.
+constexpr uint32_t VertexFetchLineSize = 64;
+constexpr uint32_t VertexFetchCacheLines = 64;
+
+struct VertexCacheStats {
+    uint32_t    triangles;
+    uint32_t    vertices;           // referenced by the index buffer
+    uint32_t    transformed;        // cache misses, the vertices shaded with a post-transform cache
+    uint32_t    fetched_lines;      // vertex fetch cache misses
+    float       acmr;               // average cache miss ratio: transformed / triangles, 0.5 at best, 3 at worst
+    float       atvr;               // average transformed vertex ratio: transformed / vertices, 1 at best
+    float       overfetch;          // bytes fetched / bytes of the referenced vertices, 1 at best
+};
+
+struct MeshOptimizationStats {
+    VertexCacheStats    before;
+    VertexCacheStats    after;
+};
+
+// Simulates both caches over `indices`. `vertex_stride` is the size of one vertex in the array that is read
+// in index order, e.g. sizeof(OutputVertexAttributes) for primitive assembly.
+VertexCacheStats AnalyzeVertexCache(IndexType const * indices, uint32_t index_count, uint32_t vertex_count, uint32_t vertex_stride);
+
+// Reorders the triangles of `indices` in place with Tom Forsyth's linear speed vertex cache optimization:
+// every vertex gets a score from its position in a simulated LRU cache and from how many triangles still use
+// it (low valence first, so no lonely triangles are left behind), and the triangle with the best sum of
+// vertex scores among those touching the cache is emitted next. The vertex order inside a triangle is kept.
+void OptimizeVertexCache(IndexType * indices, uint32_t index_count, uint32_t vertex_count);
+
+// Renumbers the vertices of `mesh` in order of first use by its index buffer. Unreferenced vertices are
+// moved to the end, the vertex count stays the same.
+void OptimizeVertexFetch(Mesh & mesh);
+
+// OptimizeVertexCache then OptimizeVertexFetch, with the analysis before and after (can be nullptr).
+void OptimizeMesh(Mesh & mesh, MeshOptimizationStats * out_stats);
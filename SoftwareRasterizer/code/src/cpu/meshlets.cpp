@@ -0,0 +1,434 @@
+#include "meshlets.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+static constexpr uint32_t InvalidTriangle = ~0u;
+static constexpr uint8_t NotInMeshlet = 0xFF;
+
+static constexpr uint32_t MeshletsPerChunk = 256;
+
+// Culling results
+static constexpr uint8_t MeshletVisible = 0;
+static constexpr uint8_t MeshletCulledFrustum = 1;
+static constexpr uint8_t MeshletCulledCone = 2;
+
+// Angular slack of the cone test (about 0.06°), absorbs the rounding of the inverse matrix and the face normals.
+static constexpr float ConeEpsilon = 1e-3f;
+
+static float Dot3(float const * a, float const * b) {
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+static float Length3(float const * a) {
+    return std::sqrt(Dot3(a, a));
+}
+
+static void Cross3(float const * a, float const * b, float * out) {
+    out[0] = a[1] * b[2] - a[2] * b[1];
+    out[1] = a[2] * b[0] - a[0] * b[2];
+    out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+static void Sub3(float const * a, float const * b, float * out) {
+    out[0] = a[0] - b[0];
+    out[1] = a[1] - b[1];
+    out[2] = a[2] - b[2];
+}
+
+static float Distance3(float const * a, float const * b) {
+    float d[3];
+    Sub3(a, b, d);
+    return Length3(d);
+}
+
+// Ritter's sphere: a first guess from two far apart points, grown by every point still outside.
+static void ComputeBoundingSphere(Vertex const * vertices, uint32_t vertex_count, Meshlet & meshlet) {
+    float const * a = vertices[0].pos;
+    for(uint32_t i = 1; i < vertex_count; ++i) {
+        if(Distance3(vertices[i].pos, vertices[0].pos) > Distance3(a, vertices[0].pos)) {
+            a = vertices[i].pos;
+        }
+    }
+    float const * b = a;
+    for(uint32_t i = 0; i < vertex_count; ++i) {
+        if(Distance3(vertices[i].pos, a) > Distance3(b, a)) {
+            b = vertices[i].pos;
+        }
+    }
+    float center[3] = { 0.5f * (a[0] + b[0]), 0.5f * (a[1] + b[1]), 0.5f * (a[2] + b[2]) };
+    float radius = 0.5f * Distance3(a, b);
+    for(uint32_t i = 0; i < vertex_count; ++i) {
+        float const distance = Distance3(vertices[i].pos, center);
+        if(distance > radius) {
+            // Moves the far side of the sphere out to the point, the opposite side stays put.
+            float const new_radius = 0.5f * (radius + distance);
+            float const shift = (new_radius - radius) / distance;
+            for(uint32_t c = 0; c < 3; ++c) {
+                center[c] += (vertices[i].pos[c] - center[c]) * shift;
+            }
+            radius = new_radius;
+        }
+    }
+    // Rounding of the last updates
+    float max_distance = 0.0f;
+    for(uint32_t i = 0; i < vertex_count; ++i) {
+        max_distance = std::max(max_distance, Distance3(vertices[i].pos, center));
+    }
+    meshlet.center[0] = center[0];
+    meshlet.center[1] = center[1];
+    meshlet.center[2] = center[2];
+    meshlet.radius = std::max(radius, max_distance) * (1.0f + 1e-5f);
+}
+
+// Face normals from the positions (the winding is what decides facing, not the vertex normals).
+// The axis is the normalized mean of the unit face normals, the half angle reaches the farthest one.
+static void ComputeNormalCone(Vertex const * vertices, uint8_t const * triangles, uint32_t triangle_count, Meshlet & meshlet) {
+    meshlet.cone_axis[0] = 0.0f;
+    meshlet.cone_axis[1] = 0.0f;
+    meshlet.cone_axis[2] = 0.0f;
+    meshlet.cone_sin = 1.0f;
+
+    float normals[MeshletMaxTriangles][3];
+    bool valid[MeshletMaxTriangles] = {};
+    float axis[3] = {};
+    for(uint32_t t = 0; t < triangle_count; ++t) {
+        float const * p0 = vertices[triangles[t * 3 + 0]].pos;
+        float const * p1 = vertices[triangles[t * 3 + 1]].pos;
+        float const * p2 = vertices[triangles[t * 3 + 2]].pos;
+        float e1[3], e2[3];
+        Sub3(p1, p0, e1);
+        Sub3(p2, p0, e2);
+        Cross3(e1, e2, normals[t]);
+        float const length = Length3(normals[t]);
+        // Zero area triangles are never rasterized, they don't widen the cone.
+        if(!(length > 0.0f)) {
+            continue;
+        }
+        valid[t] = true;
+        for(uint32_t c = 0; c < 3; ++c) {
+            normals[t][c] /= length;
+            axis[c] += normals[t][c];
+        }
+    }
+    float const axis_length = Length3(axis);
+    if(!(axis_length > 0.0f)) {
+        return;
+    }
+    for(uint32_t c = 0; c < 3; ++c) {
+        axis[c] /= axis_length;
+    }
+
+    float min_cos = 1.0f;
+    for(uint32_t t = 0; t < triangle_count; ++t) {
+        if(valid[t]) {
+            min_cos = std::min(min_cos, Dot3(axis, normals[t]));
+        }
+    }
+    meshlet.cone_axis[0] = axis[0];
+    meshlet.cone_axis[1] = axis[1];
+    meshlet.cone_axis[2] = axis[2];
+    // A half angle of 90° or more can face the camera from anywhere.
+    meshlet.cone_sin = min_cos > 0.0f ? std::min(1.0f, std::sqrt(1.0f - min_cos * min_cos)) : 1.0f;
+}
+
+void BuildMeshlets(MeshView const & mesh, MeshletMesh & out) {
+    uint32_t const vertex_count = mesh.vertex_count;
+    uint32_t const triangle_count = mesh.index_count / 3;
+    IndexType const * const indices = mesh.indices;
+
+    out.meshlets.clear();
+    out.vertices.clear();
+    out.triangles.clear();
+
+    // Triangles using each vertex
+    std::vector<uint32_t> adjacency_offsets(vertex_count + 1, 0);
+    for(uint32_t i = 0; i < triangle_count * 3; ++i) {
+        ASSERT(indices[i] < vertex_count);
+        adjacency_offsets[indices[i] + 1]++;
+    }
+    for(uint32_t v = 0; v < vertex_count; ++v) {
+        adjacency_offsets[v + 1] += adjacency_offsets[v];
+    }
+    std::vector<uint32_t> adjacency(triangle_count * 3);
+    {
+        std::vector<uint32_t> cursor(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+        for(uint32_t i = 0; i < triangle_count * 3; ++i) {
+            adjacency[cursor[indices[i]]++] = i / 3;
+        }
+    }
+
+    std::vector<uint8_t> emitted(triangle_count, 0);
+    std::vector<uint8_t> local_index(vertex_count, NotInMeshlet);
+    std::vector<uint32_t> meshlet_vertices;     // source vertex per local index
+    std::vector<uint8_t> meshlet_triangles;
+    meshlet_vertices.reserve(MeshletMaxVertices);
+    meshlet_triangles.reserve(MeshletMaxTriangles * 3);
+
+    auto new_vertex_count = [&](uint32_t tri) {
+        uint32_t count = 0;
+        for(uint32_t k = 0; k < 3; ++k) {
+            count += NotInMeshlet == local_index[indices[tri * 3 + k]] ? 1 : 0;
+        }
+        return count;
+    };
+
+    auto fits = [&](uint32_t tri) {
+        return meshlet_triangles.size() / 3 < MeshletMaxTriangles && meshlet_vertices.size() + new_vertex_count(tri) <= MeshletMaxVertices;
+    };
+
+    // Best unused triangle around `vertex` that fits: fewest new vertices, then lowest index.
+    // `blocked` gets an unused one that doesn't fit, in case none does.
+    auto pick_around = [&](uint32_t vertex, uint32_t & best, uint32_t & best_new, uint32_t & blocked) {
+        for(uint32_t a = adjacency_offsets[vertex]; a < adjacency_offsets[vertex + 1]; ++a) {
+            uint32_t const tri = adjacency[a];
+            if(0 != emitted[tri]) {
+                continue;
+            }
+            if(!fits(tri)) {
+                blocked = std::min(blocked, tri);
+                continue;
+            }
+            uint32_t const new_vertices = new_vertex_count(tri);
+            if(new_vertices < best_new || (new_vertices == best_new && tri < best)) {
+                best = tri;
+                best_new = new_vertices;
+            }
+        }
+    };
+
+    auto flush = [&]() {
+        if(meshlet_vertices.empty()) {
+            return;
+        }
+        Meshlet meshlet = {};
+        meshlet.vertex_offset = static_cast<uint32_t>(out.vertices.size());
+        meshlet.triangle_offset = static_cast<uint32_t>(out.triangles.size() / 3);
+        meshlet.vertex_count = static_cast<uint32_t>(meshlet_vertices.size());
+        meshlet.triangle_count = static_cast<uint32_t>(meshlet_triangles.size() / 3);
+        for(uint32_t v : meshlet_vertices) {
+            out.vertices.push_back(mesh.vertices[v]);
+            local_index[v] = NotInMeshlet;
+        }
+        out.triangles.insert(out.triangles.end(), meshlet_triangles.begin(), meshlet_triangles.end());
+        ComputeBoundingSphere(&out.vertices[meshlet.vertex_offset], meshlet.vertex_count, meshlet);
+        ComputeNormalCone(&out.vertices[meshlet.vertex_offset], &out.triangles[meshlet.triangle_offset * 3], meshlet.triangle_count, meshlet);
+        out.meshlets.push_back(meshlet);
+        meshlet_vertices.clear();
+        meshlet_triangles.clear();
+    };
+
+    uint32_t scan = 0;
+    uint32_t last = InvalidTriangle;
+    for(uint32_t emitted_count = 0; emitted_count < triangle_count; ++emitted_count) {
+        uint32_t next = InvalidTriangle;
+        uint32_t next_new = 4;
+        uint32_t blocked = InvalidTriangle;
+        // Around the last triangle first, then around the whole meshlet when that is a dead end.
+        if(InvalidTriangle != last) {
+            for(uint32_t k = 0; k < 3; ++k) {
+                pick_around(indices[last * 3 + k], next, next_new, blocked);
+            }
+            if(InvalidTriangle == next) {
+                for(uint32_t v : meshlet_vertices) {
+                    pick_around(v, next, next_new, blocked);
+                }
+            }
+        }
+        if(InvalidTriangle == next && InvalidTriangle != blocked) {
+            // Full: the next meshlet starts next to this one.
+            flush();
+            next = blocked;
+        } else if(InvalidTriangle == next) {
+            // Nothing left around the meshlet: the next disconnected piece in index order.
+            while(0 != emitted[scan]) {
+                ++scan;
+            }
+            next = scan;
+            if(!fits(next)) {
+                flush();
+            }
+        }
+
+        for(uint32_t k = 0; k < 3; ++k) {
+            uint32_t const v = indices[next * 3 + k];
+            if(NotInMeshlet == local_index[v]) {
+                local_index[v] = static_cast<uint8_t>(meshlet_vertices.size());
+                meshlet_vertices.push_back(v);
+            }
+            meshlet_triangles.push_back(local_index[v]);
+        }
+        emitted[next] = 1;
+        last = next;
+    }
+    flush();
+}
+
+void MeshletCuller::Init(ThreadPool * in_pool) {
+    ASSERT(nullptr != in_pool);
+    pool = in_pool;
+}
+
+void MeshletCuller::Exit() {
+    results.clear();
+    results.shrink_to_fit();
+    visible_meshlets.clear();
+    visible_meshlets.shrink_to_fit();
+    index_offsets.clear();
+    index_offsets.shrink_to_fit();
+    pool = nullptr;
+}
+
+void MeshletCuller::Cull(
+    MeshletMesh const & mesh,
+    VertexTransforms const & transforms,
+    std::vector<VertexRange> & out_vertex_ranges,
+    std::vector<IndexType> & out_indices)
+{
+    ASSERT(nullptr != pool);
+    uint32_t const meshlet_count = static_cast<uint32_t>(mesh.meshlets.size());
+    uint32_t const chunk_count = (meshlet_count + MeshletsPerChunk - 1) / MeshletsPerChunk;
+
+    Matrix4x4 const model_view_proj = MultiplyMatrix(MultiplyMatrix(transforms.model, transforms.view), transforms.proj);
+    Matrix4x4 inv_model_view_proj = {};
+    bool const invertible = InvertMatrix(model_view_proj, inv_model_view_proj);
+
+    // Object space frustum planes: a clip space plane dot(clip, p) >= 0 is dot(pos, model_view_proj * p) >= 0.
+    // Normalized, so the sphere test works with object space distances.
+    float const plane_weights[6][4] = {
+        {  1.0f,  0.0f,  0.0f, 1.0f },     // left:    w + x
+        { -1.0f,  0.0f,  0.0f, 1.0f },     // right:   w - x
+        {  0.0f,  1.0f,  0.0f, 1.0f },     // bottom:  w + y
+        {  0.0f, -1.0f,  0.0f, 1.0f },     // top:     w - y
+        {  0.0f,  0.0f,  1.0f, 0.0f },     // near:    z
+        {  0.0f,  0.0f, -1.0f, 1.0f },     // far:     w - z
+    };
+    float planes[6][4] = {};
+    for(uint32_t p = 0; p < 6; ++p) {
+        for(uint32_t r = 0; r < 4; ++r) {
+            planes[p][r] = Dot3(model_view_proj.m[r], plane_weights[p]) + model_view_proj.m[r][3] * plane_weights[p][3];
+        }
+        float const length = Length3(planes[p]);
+        if(length > 0.0f) {
+            for(uint32_t r = 0; r < 4; ++r) {
+                planes[p][r] /= length;
+            }
+        } else {
+            // Degenerate plane, never culls
+            planes[p][3] = 1.0f;
+        }
+    }
+
+    // The camera is the object space point that projects to clip (0, 0, 1, 0): a point for perspective
+    // projections, a direction (w = 0) for orthographic ones. For a triangle with face normal n through p,
+    //     f = dot(n, eye.xyz - eye.w * p)
+    // has the same sign for every triangle facing the same way on screen. The reference triangle is
+    // counterclockwise on screen, so a back face (see CullMode) in this projection, and sets which sign culls.
+    bool cone_culling = invertible && CullMode::None != cull_mode;
+    float eye[4] = {};
+    if(cone_culling) {
+        float const clip_eye[4] = { 0.0f, 0.0f, 1.0f, 0.0f };
+        TransformPoint(inv_model_view_proj, clip_eye, eye);
+
+        float const clip_reference[3][4] = {
+            { 0.0f, 0.0f, 0.5f, 1.0f },
+            { 1.0f, 0.0f, 0.5f, 1.0f },
+            { 0.0f, 1.0f, 0.5f, 1.0f },
+        };
+        float reference[3][4] = {};
+        for(uint32_t i = 0; i < 3; ++i) {
+            TransformPoint(inv_model_view_proj, clip_reference[i], reference[i]);
+            for(uint32_t c = 0; c < 3; ++c) {
+                reference[i][c] /= reference[i][3];
+            }
+        }
+        float e1[3], e2[3], normal[3], to_eye[3];
+        Sub3(reference[1], reference[0], e1);
+        Sub3(reference[2], reference[0], e2);
+        Cross3(e1, e2, normal);
+        for(uint32_t c = 0; c < 3; ++c) {
+            to_eye[c] = eye[c] - eye[3] * reference[0][c];
+        }
+        float const back_face_sign = Dot3(normal, to_eye);
+        cone_culling = std::isfinite(back_face_sign) && 0.0f != back_face_sign;
+        // Flipped so that f < 0 for the faces to cull.
+        float const flip = (back_face_sign > 0.0f) == (CullMode::Back == cull_mode) ? -1.0f : 1.0f;
+        for(uint32_t c = 0; c < 4; ++c) {
+            eye[c] *= flip;
+        }
+    }
+
+    // 1. Test every meshlet
+    results.resize(meshlet_count);
+    pool->ParallelFor(chunk_count, [&](uint32_t chunk_index, uint32_t) {
+        uint32_t const begin = chunk_index * MeshletsPerChunk;
+        uint32_t const end = std::min(meshlet_count, begin + MeshletsPerChunk);
+        for(uint32_t m = begin; m < end; ++m) {
+            Meshlet const & meshlet = mesh.meshlets[m];
+            uint8_t result = MeshletVisible;
+            if(invertible) {
+                for(uint32_t p = 0; p < 6; ++p) {
+                    if(Dot3(planes[p], meshlet.center) + planes[p][3] < -meshlet.radius) {
+                        result = MeshletCulledFrustum;
+                        break;
+                    }
+                }
+            }
+            // All faces culled when f < 0 for every normal n of the cone and every point p of the sphere.
+            // With v = eye.xyz - eye.w * center that holds if the cone around the axis, widened by its half
+            // angle, misses v moved anywhere within |eye.w| * radius:
+            //     dot(axis, v) + sin * |v| + |eye.w| * radius * (1 + sin) < 0
+            if(MeshletVisible == result && cone_culling && meshlet.cone_sin < 1.0f) {
+                float v[3];
+                for(uint32_t c = 0; c < 3; ++c) {
+                    v[c] = eye[c] - eye[3] * meshlet.center[c];
+                }
+                float const v_length = Length3(v);
+                float const extent = std::fabs(eye[3]) * meshlet.radius;
+                if(Dot3(meshlet.cone_axis, v) + (meshlet.cone_sin + ConeEpsilon) * v_length + extent * (1.0f + meshlet.cone_sin) < 0.0f) {
+                    result = MeshletCulledCone;
+                }
+            }
+            results[m] = result;
+        }
+    });
+
+    // 2. Ranges and index offsets of the visible meshlets, in meshlet order
+    stats = {};
+    out_vertex_ranges.clear();
+    visible_meshlets.clear();
+    index_offsets.clear();
+    uint32_t total_indices = 0;
+    for(uint32_t m = 0; m < meshlet_count; ++m) {
+        Meshlet const & meshlet = mesh.meshlets[m];
+        switch(results[m]) {
+            case MeshletCulledFrustum:  stats.culled_frustum++; continue;
+            case MeshletCulledCone:     stats.culled_cone++; continue;
+        }
+        stats.visible++;
+        stats.visible_vertices += meshlet.vertex_count;
+        stats.visible_triangles += meshlet.triangle_count;
+        out_vertex_ranges.push_back({ meshlet.vertex_offset, meshlet.vertex_count });
+        visible_meshlets.push_back(m);
+        index_offsets.push_back(total_indices);
+        total_indices += meshlet.triangle_count * 3;
+    }
+
+    // 3. Triangles, rebased from meshlet local to MeshletMesh::vertices
+    out_indices.resize(total_indices);
+    uint32_t const visible_count = stats.visible;
+    uint32_t const visible_chunk_count = (visible_count + MeshletsPerChunk - 1) / MeshletsPerChunk;
+    pool->ParallelFor(visible_chunk_count, [&](uint32_t chunk_index, uint32_t) {
+        uint32_t const begin = chunk_index * MeshletsPerChunk;
+        uint32_t const end = std::min(visible_count, begin + MeshletsPerChunk);
+        for(uint32_t i = begin; i < end; ++i) {
+            Meshlet const & meshlet = mesh.meshlets[visible_meshlets[i]];
+            uint8_t const * src = &mesh.triangles[meshlet.triangle_offset * 3];
+            IndexType * dst = &out_indices[index_offsets[i]];
+            for(uint32_t k = 0; k < meshlet.triangle_count * 3; ++k) {
+                dst[k] = meshlet.vertex_offset + src[k];
+            }
+        }
+    });
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "pipeline_types.hpp"
+#include "primitive_assembly.hpp"
+#include "vertex_shading.hpp"
+
+class ThreadPool;
+
+// Meshlets (clusters) of a Mesh, so culling can drop whole groups of triangles before any vertex is shaded.
+//
+// Limits are the usual mesh shader ones: local indices fit a byte and 64 vertices / 124 triangles keep the
+// per meshlet output small. Every meshlet owns a contiguous range of MeshletMesh::vertices (vertices shared
+// between meshlets are duplicated), so shading a visible meshlet is one ShadeVertexRanges range over SoA streams.
+constexpr uint32_t MeshletMaxVertices = 64;
+constexpr uint32_t MeshletMaxTriangles = 124;
+
+struct Meshlet {
+    uint32_t    vertex_offset;      // first vertex in MeshletMesh::vertices
+    uint32_t    triangle_offset;    // first triangle in MeshletMesh::triangles
+    uint32_t    vertex_count;
+    uint32_t    triangle_count;
+
+    // Bounds in object space
+    float       center[3];          // bounding sphere
+    float       radius;
+    float       cone_axis[3];       // normal cone: every face normal is within the cone's half angle of the axis
+    float       cone_sin;           // sin of the half angle, 1 when the normals don't fit in a cone narrower than 180°
+};
+
+struct MeshletMesh {
+    std::vector<Meshlet>    meshlets;
+    std::vector<Vertex>     vertices;
+    std::vector<uint8_t>    triangles;      // 3 meshlet local vertex indices per triangle
+};
+
+// Splits `mesh` into meshlets. Triangles are added greedily: the next one is the unused neighbor of the last
+// added triangle that brings the fewest new vertices, so meshlets grow as compact patches of the surface
+// whatever the order of the index buffer. Disconnected pieces are picked up in index buffer order.
+// Runs at load time, the result only depends on the mesh.
+void BuildMeshlets(MeshView const & mesh, MeshletMesh & out);
+
+struct MeshletCullStats {
+    uint32_t    culled_frustum;     // bounding sphere outside a frustum plane
+    uint32_t    culled_cone;        // every triangle faces the culled way (see CullMode) from the camera
+    uint32_t    visible;
+    uint32_t    visible_vertices;
+    uint32_t    visible_triangles;
+};
+
+// Per meshlet culling in front of ShadeVertexRanges and PrimitiveAssembler::Assemble.
+//
+// Both tests are conservative and done in object space, so no meshlet bound is transformed per frame:
+//   - frustum: the bounding sphere against the frustum planes taken from model * view * proj
+//   - normal cone: with the camera from the inverse of that matrix (a point for perspective, a direction for
+//     orthographic projections), a meshlet is culled when no point of its bounding sphere can see any normal
+//     of its cone from the front. Which side is the front comes from the same matrix, so mirroring transforms
+//     keep the winding rule of primitive assembly (front faces are clockwise on screen).
+// Triangles of the surviving meshlets still go through the per triangle culling of primitive assembly.
+class MeshletCuller {
+public:
+    void Init(ThreadPool * pool);
+    void Exit();
+
+    // Writes the vertex ranges of the visible meshlets (to shade with ShadeVertexRanges) and their triangles
+    // as indices into `mesh.vertices` (to assemble after shading).
+    void Cull(
+        MeshletMesh const & mesh,
+        VertexTransforms const & transforms,
+        std::vector<VertexRange> & out_vertex_ranges,
+        std::vector<IndexType> & out_indices);
+
+    void SetCullMode(CullMode mode) { cull_mode = mode; }
+    CullMode GetCullMode() const { return cull_mode; }
+
+    // Of the last Cull
+    MeshletCullStats const & GetStats() const { return stats; }
+
+private:
+    ThreadPool *            pool = nullptr;
+    CullMode                cull_mode = CullMode::Back;
+    std::vector<uint8_t>    results;        // per meshlet
+    std::vector<uint32_t>   visible_meshlets;
+    std::vector<uint32_t>   index_offsets;  // per visible meshlet
+    MeshletCullStats        stats = {};
+};
@@ -0,0 +1,576 @@
+#include "obj_importer.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+
+// Big enough that a chunk is mostly parsing, small enough that a few hundred MB keep every worker busy.
+static constexpr size_t ObjChunkBytes = 1 << 20;
+// Elements per job in the passes after parsing
+static constexpr uint32_t ObjBatchSize = 1 << 16;
+// Texcoord or normal not given by the face
+static constexpr uint32_t ObjMissing = ~0u;
+// Limit of every kind of element (positions, ..., triangle corners)
+static constexpr uint32_t ObjMaxElements = 1u << 30;
+// Longest polygon fanned into triangles, longer ones are malformed
+static constexpr uint32_t ObjMaxPolygonCorners = 64;
+
+// One triangle corner: position, texcoord and normal index. While parsing, relative (negative) OBJ indices are
+// stored relative to the chunk's first element and flagged in `relative`, they're made file-global once the
+// chunk bases are known. The arithmetic wraps, so relative indices pointing into earlier chunks resolve too.
+struct ObjCorner {
+    uint32_t    index[3];
+    uint32_t    relative;           // bit i: index[i] is chunk relative
+};
+
+struct ObjChunk {
+    char const *            begin;
+    char const *            end;
+
+    std::vector<float>      positions;      // xyz
+    std::vector<float>      colors;         // rgb per position, empty when no v of the chunk has a color
+    std::vector<float>      texcoords;      // uv
+    std::vector<float>      normals;        // xyz
+    std::vector<ObjCorner>  corners;        // 3 per triangle
+
+    // First element of this chunk in the merged arrays
+    uint32_t                position_base;
+    uint32_t                texcoord_base;
+    uint32_t                normal_base;
+    uint32_t                corner_base;
+
+    char const *            error;          // where parsing failed, nullptr if it didn't
+};
+
+using ObjClock = std::chrono::steady_clock;
+
+static float MillisecondsSince(ObjClock::time_point start) {
+    return std::chrono::duration<float, std::milli>(ObjClock::now() - start).count();
+}
+
+static void RunJobs(ThreadPool * pool, uint32_t count, ThreadPool::Job const & job) {
+    if(nullptr != pool && count > 1) {
+        pool->ParallelFor(count, job);
+    } else {
+        for(uint32_t i = 0; i < count; ++i) {
+            job(i, 0);
+        }
+    }
+}
+
+static uint32_t GetBatchCount(uint32_t count) {
+    return (count + ObjBatchSize - 1) / ObjBatchSize;
+}
+
+static bool IsBlank(char c) {
+    return ' ' == c || '\t' == c || '\r' == c;
+}
+
+static char const * SkipBlanks(char const * p, char const * end) {
+    while(p < end && IsBlank(*p)) {
+        ++p;
+    }
+    return p;
+}
+
+static char const * SkipLine(char const * p, char const * end) {
+    while(p < end && '\n' != *p) {
+        ++p;
+    }
+    return p < end ? p + 1 : end;
+}
+
+// Parses up to `max_count` floats separated by blanks, returns how many.
+static uint32_t ParseFloats(char const * & p, char const * end, float * out, uint32_t max_count) {
+    uint32_t count = 0;
+    while(count < max_count) {
+        p = SkipBlanks(p, end);
+        if(p >= end || '\n' == *p || '#' == *p) {
+            break;
+        }
+        std::from_chars_result const result = std::from_chars(p, end, out[count]);
+        if(std::errc() != result.ec) {
+            break;
+        }
+        p = result.ptr;
+        ++count;
+    }
+    return count;
+}
+
+static bool ParseIndex(char const * & p, char const * end, int32_t & out) {
+    bool const negative = p < end && '-' == *p;
+    p += negative ? 1 : 0;
+    if(p >= end || *p < '0' || *p > '9') {
+        return false;
+    }
+    int64_t value = 0;
+    while(p < end && *p >= '0' && *p <= '9' && value <= INT32_MAX) {
+        value = value * 10 + (*p - '0');
+        ++p;
+    }
+    if(0 == value || value > INT32_MAX) {
+        return false;
+    }
+    out = static_cast<int32_t>(negative ? -value : value);
+    return true;
+}
+
+// OBJ index `value` (1 based, or negative from the end) into the chunk's ObjCorner encoding. `local_count` is
+// the number of elements of that kind the chunk parsed so far.
+static void EncodeIndex(int32_t value, uint32_t local_count, uint32_t component, ObjCorner & corner) {
+    if(value > 0) {
+        corner.index[component] = static_cast<uint32_t>(value - 1);
+    } else {
+        corner.index[component] = local_count + static_cast<uint32_t>(value);
+        corner.relative |= 1u << component;
+    }
+}
+
+// "p", "p/t", "p//n" or "p/t/n"
+static bool ParseCorner(char const * & p, char const * end, ObjChunk const & chunk, ObjCorner & out) {
+    out = { { ObjMissing, ObjMissing, ObjMissing }, 0 };
+    uint32_t const local_counts[3] = {
+        static_cast<uint32_t>(chunk.positions.size() / 3),
+        static_cast<uint32_t>(chunk.texcoords.size() / 2),
+        static_cast<uint32_t>(chunk.normals.size() / 3),
+    };
+    int32_t value = 0;
+    if(!ParseIndex(p, end, value)) {
+        return false;
+    }
+    EncodeIndex(value, local_counts[0], 0, out);
+    for(uint32_t component = 1; component < 3; ++component) {
+        if(p >= end || '/' != *p) {
+            break;
+        }
+        ++p;
+        bool const empty = p < end && '/' == *p && 1 == component;
+        if(!empty) {
+            if(!ParseIndex(p, end, value)) {
+                return false;
+            }
+            EncodeIndex(value, local_counts[component], component, out);
+        }
+    }
+    return true;
+}
+
+static void ParseChunk(ObjChunk & chunk) {
+    char const * p = chunk.begin;
+    char const * const end = chunk.end;
+    ObjCorner polygon[ObjMaxPolygonCorners];
+
+    while(p < end) {
+        char const * const line = SkipBlanks(p, end);
+        p = line;
+        if(p + 1 >= end || '\n' == *p) {
+            p = SkipLine(p, end);
+            continue;
+        }
+
+        if('v' == p[0] && IsBlank(p[1])) {
+            p += 2;
+            // x y z, optionally w, optionally r g b
+            float values[7] = {};
+            uint32_t const count = ParseFloats(p, end, values, 7);
+            if(count < 3) {
+                chunk.error = line;
+                return;
+            }
+            size_t const position_count = chunk.positions.size() / 3;
+            chunk.positions.insert(chunk.positions.end(), values, values + 3);
+            bool const has_color = count >= 6;
+            if(has_color && chunk.colors.empty()) {
+                chunk.colors.resize(position_count * 3, 1.0f);
+            }
+            if(has_color) {
+                chunk.colors.insert(chunk.colors.end(), values + count - 3, values + count);
+            } else if(!chunk.colors.empty()) {
+                chunk.colors.insert(chunk.colors.end(), 3, 1.0f);
+            }
+        } else if('v' == p[0] && 't' == p[1] && p + 2 < end && IsBlank(p[2])) {
+            p += 3;
+            float values[3] = {};
+            if(0 == ParseFloats(p, end, values, 3)) {
+                chunk.error = line;
+                return;
+            }
+            chunk.texcoords.push_back(values[0]);
+            chunk.texcoords.push_back(1.0f - values[1]);
+        } else if('v' == p[0] && 'n' == p[1] && p + 2 < end && IsBlank(p[2])) {
+            p += 3;
+            float values[3] = {};
+            if(3 != ParseFloats(p, end, values, 3)) {
+                chunk.error = line;
+                return;
+            }
+            chunk.normals.insert(chunk.normals.end(), values, values + 3);
+        } else if('f' == p[0] && IsBlank(p[1])) {
+            p += 2;
+            uint32_t corner_count = 0;
+            for(;;) {
+                p = SkipBlanks(p, end);
+                if(p >= end || '\n' == *p || '#' == *p) {
+                    break;
+                }
+                if(corner_count == ObjMaxPolygonCorners || !ParseCorner(p, end, chunk, polygon[corner_count])) {
+                    chunk.error = line;
+                    return;
+                }
+                ++corner_count;
+            }
+            if(corner_count < 3) {
+                chunk.error = line;
+                return;
+            }
+            for(uint32_t i = 2; i < corner_count; ++i) {
+                chunk.corners.push_back(polygon[0]);
+                chunk.corners.push_back(polygon[i - 1]);
+                chunk.corners.push_back(polygon[i]);
+            }
+        }
+        p = SkipLine(p, end);
+    }
+}
+
+static uint32_t HashCorner(ObjCorner const & corner) {
+    uint32_t h = corner.index[0] * 0x9E3779B1u;
+    h = (h ^ (h >> 15)) + corner.index[1] * 0x85EBCA77u;
+    h = (h ^ (h >> 13)) + corner.index[2] * 0xC2B2AE3Du;
+    return h ^ (h >> 16);
+}
+
+static bool SameCorner(ObjCorner const & a, ObjCorner const & b) {
+    return a.index[0] == b.index[0] && a.index[1] == b.index[1] && a.index[2] == b.index[2];
+}
+
+// Smooth normal of every position: normalized sum of the area weighted normals of the triangles using it.
+// The triangles of a position are summed in triangle order whatever thread found them, so the result is the
+// same for every thread count.
+static void GeneratePositionNormals(std::vector<float> const & positions, std::vector<ObjCorner> const & corners, std::vector<float> & out, ThreadPool * pool) {
+    uint32_t const position_count = static_cast<uint32_t>(positions.size() / 3);
+    uint32_t const triangle_count = static_cast<uint32_t>(corners.size() / 3);
+
+    std::vector<float> face_normals(static_cast<size_t>(triangle_count) * 3);
+    std::vector<std::atomic<uint32_t>> counts(position_count);
+    RunJobs(pool, GetBatchCount(triangle_count), [&](uint32_t batch, uint32_t) {
+        uint32_t const begin = batch * ObjBatchSize;
+        uint32_t const end = std::min(triangle_count, begin + ObjBatchSize);
+        for(uint32_t t = begin; t < end; ++t) {
+            float const * p0 = &positions[corners[t * 3 + 0].index[0] * 3];
+            float const * p1 = &positions[corners[t * 3 + 1].index[0] * 3];
+            float const * p2 = &positions[corners[t * 3 + 2].index[0] * 3];
+            float const e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+            float const e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+            face_normals[t * 3 + 0] = e1[1] * e2[2] - e1[2] * e2[1];
+            face_normals[t * 3 + 1] = e1[2] * e2[0] - e1[0] * e2[2];
+            face_normals[t * 3 + 2] = e1[0] * e2[1] - e1[1] * e2[0];
+            for(uint32_t k = 0; k < 3; ++k) {
+                counts[corners[t * 3 + k].index[0]].fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    });
+
+    std::vector<uint32_t> offsets(position_count + 1, 0);
+    for(uint32_t i = 0; i < position_count; ++i) {
+        offsets[i + 1] = offsets[i] + counts[i].load(std::memory_order_relaxed);
+        counts[i].store(offsets[i], std::memory_order_relaxed);
+    }
+
+    std::vector<uint32_t> adjacency(offsets[position_count]);
+    RunJobs(pool, GetBatchCount(triangle_count), [&](uint32_t batch, uint32_t) {
+        uint32_t const begin = batch * ObjBatchSize;
+        uint32_t const end = std::min(triangle_count, begin + ObjBatchSize);
+        for(uint32_t t = begin; t < end; ++t) {
+            for(uint32_t k = 0; k < 3; ++k) {
+                adjacency[counts[corners[t * 3 + k].index[0]].fetch_add(1, std::memory_order_relaxed)] = t;
+            }
+        }
+    });
+
+    out.assign(static_cast<size_t>(position_count) * 3, 0.0f);
+    RunJobs(pool, GetBatchCount(position_count), [&](uint32_t batch, uint32_t) {
+        uint32_t const begin = batch * ObjBatchSize;
+        uint32_t const end = std::min(position_count, begin + ObjBatchSize);
+        for(uint32_t i = begin; i < end; ++i) {
+            std::sort(adjacency.begin() + offsets[i], adjacency.begin() + offsets[i + 1]);
+            float normal[3] = {};
+            for(uint32_t a = offsets[i]; a < offsets[i + 1]; ++a) {
+                for(uint32_t c = 0; c < 3; ++c) {
+                    normal[c] += face_normals[adjacency[a] * 3 + c];
+                }
+            }
+            float const length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+            float const scale = length > 0.0f ? 1.0f / length : 0.0f;
+            for(uint32_t c = 0; c < 3; ++c) {
+                out[i * 3 + c] = normal[c] * scale;
+            }
+        }
+    });
+}
+
+bool ImportObjFromMemory(char const * text, size_t size, Mesh & out, ThreadPool * pool, ObjImportStats * out_stats) {
+    ObjClock::time_point const start = ObjClock::now();
+    ObjImportStats stats = {};
+    stats.file_bytes = size;
+    out.vertices.clear();
+    out.indices.clear();
+
+    // Chunks start after the first line break past every multiple of ObjChunkBytes
+    std::vector<ObjChunk> chunks;
+    char const * const text_end = text + size;
+    for(char const * begin = text; begin < text_end;) {
+        char const * end = text_end - begin > static_cast<ptrdiff_t>(ObjChunkBytes) ? SkipLine(begin + ObjChunkBytes, text_end) : text_end;
+        ObjChunk chunk = {};
+        chunk.begin = begin;
+        chunk.end = end;
+        chunks.push_back(std::move(chunk));
+        begin = end;
+    }
+    uint32_t const chunk_count = static_cast<uint32_t>(chunks.size());
+    stats.chunks = chunk_count;
+
+    RunJobs(pool, chunk_count, [&](uint32_t c, uint32_t) {
+        ParseChunk(chunks[c]);
+    });
+
+    bool has_colors = false;
+    uint64_t totals[4] = {};
+    for(ObjChunk & chunk : chunks) {
+        if(nullptr != chunk.error) {
+            char const * const line_end = std::find(chunk.error, text_end, '\n');
+            ::printf("ImportObj: can't parse \"%.*s\" at byte %llu\n", static_cast<int>(std::min<ptrdiff_t>(line_end - chunk.error, 80)), chunk.error,
+                static_cast<unsigned long long>(chunk.error - text));
+            return false;
+        }
+        chunk.position_base = static_cast<uint32_t>(totals[0]);
+        chunk.texcoord_base = static_cast<uint32_t>(totals[1]);
+        chunk.normal_base = static_cast<uint32_t>(totals[2]);
+        chunk.corner_base = static_cast<uint32_t>(totals[3]);
+        totals[0] += chunk.positions.size() / 3;
+        totals[1] += chunk.texcoords.size() / 2;
+        totals[2] += chunk.normals.size() / 3;
+        totals[3] += chunk.corners.size();
+        has_colors |= !chunk.colors.empty();
+    }
+    // Keeps element offsets (index * 3) and the weld table size in 32 bits
+    if(totals[0] > ObjMaxElements || totals[1] > ObjMaxElements || totals[2] > ObjMaxElements || totals[3] > ObjMaxElements) {
+        ::printf("ImportObj: too many elements\n");
+        return false;
+    }
+    stats.positions = static_cast<uint32_t>(totals[0]);
+    stats.texcoords = static_cast<uint32_t>(totals[1]);
+    stats.normals = static_cast<uint32_t>(totals[2]);
+    uint32_t const corner_count = static_cast<uint32_t>(totals[3]);
+    stats.triangles = corner_count / 3;
+
+    // Merge the chunks and make every index file-global, chunk arrays are freed as soon as they're copied.
+    std::vector<float> positions(static_cast<size_t>(stats.positions) * 3);
+    std::vector<float> colors(has_colors ? positions.size() : 0);
+    std::vector<float> texcoords(static_cast<size_t>(stats.texcoords) * 2);
+    std::vector<float> normals(static_cast<size_t>(stats.normals) * 3);
+    std::vector<ObjCorner> corners(corner_count);
+    std::atomic<bool> invalid_index = false;
+    std::atomic<bool> missing_normals = false;
+    RunJobs(pool, chunk_count, [&](uint32_t c, uint32_t) {
+        ObjChunk & chunk = chunks[c];
+        std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + chunk.position_base * 3);
+        if(has_colors) {
+            if(chunk.colors.empty()) {
+                std::fill_n(colors.begin() + chunk.position_base * 3, chunk.positions.size(), 1.0f);
+            } else {
+                std::copy(chunk.colors.begin(), chunk.colors.end(), colors.begin() + chunk.position_base * 3);
+            }
+        }
+        std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), texcoords.begin() + chunk.texcoord_base * 2);
+        std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + chunk.normal_base * 3);
+
+        uint32_t const bases[3] = { chunk.position_base, chunk.texcoord_base, chunk.normal_base };
+        uint32_t const limits[3] = { stats.positions, stats.texcoords, stats.normals };
+        bool invalid = false;
+        bool missing = false;
+        for(size_t i = 0; i < chunk.corners.size(); ++i) {
+            ObjCorner corner = chunk.corners[i];
+            for(uint32_t k = 0; k < 3; ++k) {
+                if(0 != (corner.relative & (1u << k))) {
+                    corner.index[k] += bases[k];
+                }
+                invalid |= ObjMissing != corner.index[k] && corner.index[k] >= limits[k];
+            }
+            missing |= ObjMissing == corner.index[2];
+            invalid |= ObjMissing == corner.index[0];
+            corner.relative = 0;
+            corners[chunk.corner_base + i] = corner;
+        }
+        if(invalid) {
+            invalid_index.store(true, std::memory_order_relaxed);
+        }
+        if(missing) {
+            missing_normals.store(true, std::memory_order_relaxed);
+        }
+        chunk = {};
+    });
+    stats.parse_ms = MillisecondsSince(start);
+    if(invalid_index) {
+        ::printf("ImportObj: a face uses a vertex that doesn't exist\n");
+        return false;
+    }
+
+    ObjClock::time_point const normals_start = ObjClock::now();
+    std::vector<float> generated_normals;
+    stats.generated_normals = missing_normals;
+    if(stats.generated_normals) {
+        GeneratePositionNormals(positions, corners, generated_normals, pool);
+    }
+    stats.normals_ms = MillisecondsSince(normals_start);
+
+    // Weld: open addressing table of corner ids (index + 1, 0 is empty). A slot goes from empty to the id of a
+    // corner and after that only to lower ids of corners with the same triple, so once every corner is in, each
+    // slot holds the first corner of its triple, whichever thread inserted first.
+    ObjClock::time_point const weld_start = ObjClock::now();
+    uint32_t table_size = 1024;
+    while(table_size < corner_count * 2) {
+        table_size *= 2;
+    }
+    uint32_t const table_mask = table_size - 1;
+    std::vector<std::atomic<uint32_t>> table(table_size);
+    std::vector<uint32_t> corner_slots(corner_count);
+    uint32_t const batch_count = GetBatchCount(corner_count);
+    RunJobs(pool, batch_count, [&](uint32_t batch, uint32_t) {
+        uint32_t const begin = batch * ObjBatchSize;
+        uint32_t const end = std::min(corner_count, begin + ObjBatchSize);
+        for(uint32_t c = begin; c < end; ++c) {
+            uint32_t const id = c + 1;
+            uint32_t slot = HashCorner(corners[c]) & table_mask;
+            for(;;) {
+                uint32_t current = table[slot].load(std::memory_order_relaxed);
+                if(0 == current && table[slot].compare_exchange_strong(current, id, std::memory_order_relaxed)) {
+                    break;
+                }
+                // Occupied, `current` is the occupant
+                if(SameCorner(corners[current - 1], corners[c])) {
+                    while(id < current && !table[slot].compare_exchange_weak(current, id, std::memory_order_relaxed)) {
+                    }
+                    break;
+                }
+                slot = (slot + 1) & table_mask;
+            }
+            corner_slots[c] = slot;
+        }
+    });
+
+    // Vertices in order of the first corner of each triple. The slots are only read once: from here on
+    // corner_slots holds the id of the first corner instead.
+    std::vector<uint32_t> batch_vertex_base(batch_count + 1, 0);
+    RunJobs(pool, batch_count, [&](uint32_t batch, uint32_t) {
+        uint32_t const begin = batch * ObjBatchSize;
+        uint32_t const end = std::min(corner_count, begin + ObjBatchSize);
+        uint32_t count = 0;
+        for(uint32_t c = begin; c < end; ++c) {
+            corner_slots[c] = table[corner_slots[c]].load(std::memory_order_relaxed);
+            count += corner_slots[c] == c + 1 ? 1 : 0;
+        }
+        batch_vertex_base[batch + 1] = count;
+    });
+    for(uint32_t b = 0; b < batch_count; ++b) {
+        batch_vertex_base[b + 1] += batch_vertex_base[b];
+    }
+    stats.vertices = batch_vertex_base[batch_count];
+    std::vector<std::atomic<uint32_t>>().swap(table);
+
+    out.vertices.resize(stats.vertices);
+    out.indices.resize(corner_count);
+    // First corners write their vertex and index...
+    RunJobs(pool, batch_count, [&](uint32_t batch, uint32_t) {
+        uint32_t const begin = batch * ObjBatchSize;
+        uint32_t const end = std::min(corner_count, begin + ObjBatchSize);
+        uint32_t v = batch_vertex_base[batch];
+        for(uint32_t c = begin; c < end; ++c) {
+            if(corner_slots[c] != c + 1) {
+                continue;
+            }
+            ObjCorner const & corner = corners[c];
+            Vertex & vertex = out.vertices[v];
+            vertex = {};
+            uint32_t const p = corner.index[0];
+            vertex.pos[0] = positions[p * 3 + 0];
+            vertex.pos[1] = positions[p * 3 + 1];
+            vertex.pos[2] = positions[p * 3 + 2];
+            vertex.pos[3] = 1.0f;
+            float const * normal = ObjMissing != corner.index[2] ? &normals[corner.index[2] * 3] : &generated_normals[p * 3];
+            vertex.normal[0] = normal[0];
+            vertex.normal[1] = normal[1];
+            vertex.normal[2] = normal[2];
+            for(uint32_t k = 0; k < 3; ++k) {
+                vertex.col[k] = has_colors ? colors[p * 3 + k] : 1.0f;
+            }
+            vertex.col[3] = 1.0f;
+            if(ObjMissing != corner.index[1]) {
+                vertex.uv[0] = texcoords[corner.index[1] * 2 + 0];
+                vertex.uv[1] = texcoords[corner.index[1] * 2 + 1];
+            }
+            out.indices[c] = v++;
+        }
+    });
+    // ...then the others copy the index of their first corner.
+    RunJobs(pool, batch_count, [&](uint32_t batch, uint32_t) {
+        uint32_t const begin = batch * ObjBatchSize;
+        uint32_t const end = std::min(corner_count, begin + ObjBatchSize);
+        for(uint32_t c = begin; c < end; ++c) {
+            uint32_t const first = corner_slots[c] - 1;
+            if(first != c) {
+                out.indices[c] = out.indices[first];
+            }
+        }
+    });
+    stats.weld_ms = MillisecondsSince(weld_start);
+
+    stats.total_ms = MillisecondsSince(start);
+    float const megabytes = static_cast<float>(static_cast<double>(size) / (1024.0 * 1024.0));
+    stats.parse_mb_per_s = stats.parse_ms > 0.0f ? megabytes * 1000.0f / stats.parse_ms : 0.0f;
+    stats.total_mb_per_s = stats.total_ms > 0.0f ? megabytes * 1000.0f / stats.total_ms : 0.0f;
+    if(nullptr != out_stats) {
+        *out_stats = stats;
+    }
+    return true;
+}
+
+bool ImportObj(char const * path, Mesh & out, ThreadPool * pool, ObjImportStats * out_stats) {
+    ObjClock::time_point const start = ObjClock::now();
+    out.vertices.clear();
+    out.indices.clear();
+
+    std::error_code error;
+    uintmax_t const file_size = std::filesystem::file_size(path, error);
+    FILE * file = error ? nullptr : ::fopen(path, "rb");
+    if(nullptr == file) {
+        ::printf("ImportObj: can't open %s\n", path);
+        return false;
+    }
+    std::vector<char> text(static_cast<size_t>(file_size));
+    size_t const read = text.empty() ? 0 : ::fread(text.data(), 1, text.size(), file);
+    ::fclose(file);
+    if(read != text.size()) {
+        ::printf("ImportObj: reading %s failed\n", path);
+        return false;
+    }
+    float const read_ms = MillisecondsSince(start);
+
+    ObjImportStats stats = {};
+    if(!ImportObjFromMemory(text.data(), text.size(), out, pool, &stats)) {
+        return false;
+    }
+    stats.read_ms = read_ms;
+    stats.total_ms = MillisecondsSince(start);
+    float const megabytes = static_cast<float>(static_cast<double>(text.size()) / (1024.0 * 1024.0));
+    stats.total_mb_per_s = stats.total_ms > 0.0f ? megabytes * 1000.0f / stats.total_ms : 0.0f;
+    if(nullptr != out_stats) {
+        *out_stats = stats;
+    }
+    return true;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "../base.h"
+
+class ThreadPool;
+
+// Wavefront OBJ to a welded, indexed Mesh, parsed in parallel.
+//
+// The file is split into chunks at line boundaries and every chunk is parsed on its own into local position /
+// texcoord / normal arrays and triangle corners (polygons are fanned). Counts are prefix summed afterwards to
+// resolve the file-global (and relative, negative) OBJ indices. Corners are then welded through a lock free hash
+// map on their (position, texcoord, normal) triple: every distinct triple becomes one Vertex, numbered in order of
+// first use so the result doesn't depend on the thread count. When some corners have no normal, smooth normals
+// are generated per position from the area weighted face normals.
+//
+// Supported: v (with the optional "r g b" vertex color extension), vt, vn, f. Everything else (objects, groups,
+// smoothing groups, materials, lines, points) is skipped. Winding is kept as in the file, texcoord v is flipped
+// to the top-left origin the samplers use.
+struct ObjImportStats {
+    uint64_t    file_bytes;
+    uint32_t    chunks;
+    uint32_t    positions;
+    uint32_t    texcoords;
+    uint32_t    normals;
+    uint32_t    triangles;
+    uint32_t    vertices;           // after welding
+    bool        generated_normals;
+    float       read_ms;            // file to memory
+    float       parse_ms;           // text to chunk arrays, including the merge and index resolve
+    float       weld_ms;
+    float       normals_ms;
+    float       total_ms;
+    float       parse_mb_per_s;     // file_bytes / parse_ms
+    float       total_mb_per_s;     // file_bytes / total_ms, read included
+};
+
+// Imports `path` into `out` (replaced). `pool` can be nullptr to run on the calling thread, `out_stats` can be
+// nullptr. Returns false and leaves `out` empty when the file can't be read or is malformed (a face using a
+// missing vertex, a number that doesn't parse).
+bool ImportObj(char const * path, Mesh & out, ThreadPool * pool, ObjImportStats * out_stats);
+
+// Same, from OBJ text already in memory. read_ms is 0.
+bool ImportObjFromMemory(char const * text, size_t size, Mesh & out, ThreadPool * pool, ObjImportStats * out_stats);
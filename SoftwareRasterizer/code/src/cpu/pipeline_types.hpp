@@ -0,0 +1,105 @@
+#pragma once
+
+#include "../base.h"
+
+// Data passed between the stages of the cpu/ pipeline.
+// OutputVertexAttributes and Fragment match the structs in shaders/demo003/rasterization/*.comp.hlsl
+// byte for byte, so a Fragment buffer written on the CPU can be consumed by fragment_shading.comp.hlsl as is.
+
+// Row-major, row-vector convention (same as DirectX::XMMATRIX).
+// Transforming with it gives the same result as `mul(M, v)` in HLSL on a matrix memcpy'd into a constant buffer.
+struct Matrix4x4 {
+    float       m[4][4];
+};
+
+struct VertexTransforms {
+    Matrix4x4   model;
+    Matrix4x4   view;
+    Matrix4x4   proj;
+};
+
+// Vertex Shader Output
+// Primitive Assembly Input
+struct OutputVertexAttributes {
+    float       pos_ndc[4];     // the CPU pipeline keeps 1 / w_clip in w for perspective correct interpolation
+    float       pos_world[4];
+    float       normal_world[4];
+    float       col[4];
+    float       uv[2];
+};
+
+// Homogeneous clip space position of a shaded vertex, kept next to OutputVertexAttributes for primitive assembly
+// (the HLSL structs have no room for it: pos_ndc is already divided by w there).
+struct ClipPosition {
+    float       pos_clip[4];
+};
+
+// Rasterization Output
+// Fragment Shader Input
+struct Fragment {
+    // Interpolated Values from OutputVertexAttributes
+    float       pos_ndc[4];
+    float       pos_world[4];
+    float       normal_world[4];
+    float       col[4];
+    float       uv[2];
+};
+static_assert(sizeof(Fragment) == 72);
+
+// Compact Fragment, see fragment_packing.hpp. pos_ndc.xy comes from the pixel position, pos_world from
+// pos_ndc and the inverse view projection, so only depth is stored of the positions.
+struct PackedFragment {
+    float       depth;      // pos_ndc.z
+    uint32_t    normal;     // octahedral, 2 x snorm16 (x in the low bits)
+    uint32_t    color;      // RGBA8 unorm (r in the low bits)
+    uint32_t    uv;         // 2 x half (u in the low bits)
+};
+static_assert(sizeof(PackedFragment) == 16);
+
+inline void TransformPoint(Matrix4x4 const & mat, float const in[4], float out[4]) {
+    float const x = in[0], y = in[1], z = in[2], w = in[3];
+    for(uint32_t i = 0; i < 4; ++i) {
+        out[i] = x * mat.m[0][i] + y * mat.m[1][i] + z * mat.m[2][i] + w * mat.m[3][i];
+    }
+}
+
+// a then b: TransformPoint(MultiplyMatrix(a, b), v) == TransformPoint(b, TransformPoint(a, v))
+inline Matrix4x4 MultiplyMatrix(Matrix4x4 const & a, Matrix4x4 const & b) {
+    Matrix4x4 ret = {};
+    for(uint32_t r = 0; r < 4; ++r) {
+        TransformPoint(b, a.m[r], ret.m[r]);
+    }
+    return ret;
+}
+
+// General inverse through cofactors, returns false for singular matrices.
+inline bool InvertMatrix(Matrix4x4 const & mat, Matrix4x4 & out) {
+    float const * m = &mat.m[0][0];
+    float inv[16];
+    inv[0]  =  m[5] * m[10] * m[15] - m[5] * m[11] * m[14] - m[9] * m[6] * m[15] + m[9] * m[7] * m[14] + m[13] * m[6] * m[11] - m[13] * m[7] * m[10];
+    inv[4]  = -m[4] * m[10] * m[15] + m[4] * m[11] * m[14] + m[8] * m[6] * m[15] - m[8] * m[7] * m[14] - m[12] * m[6] * m[11] + m[12] * m[7] * m[10];
+    inv[8]  =  m[4] * m[9]  * m[15] - m[4] * m[11] * m[13] - m[8] * m[5] * m[15] + m[8] * m[7] * m[13] + m[12] * m[5] * m[11] - m[12] * m[7] * m[9];
+    inv[12] = -m[4] * m[9]  * m[14] + m[4] * m[10] * m[13] + m[8] * m[5] * m[14] - m[8] * m[6] * m[13] - m[12] * m[5] * m[10] + m[12] * m[6] * m[9];
+    inv[1]  = -m[1] * m[10] * m[15] + m[1] * m[11] * m[14] + m[9] * m[2] * m[15] - m[9] * m[3] * m[14] - m[13] * m[2] * m[11] + m[13] * m[3] * m[10];
+    inv[5]  =  m[0] * m[10] * m[15] - m[0] * m[11] * m[14] - m[8] * m[2] * m[15] + m[8] * m[3] * m[14] + m[12] * m[2] * m[11] - m[12] * m[3] * m[10];
+    inv[9]  = -m[0] * m[9]  * m[15] + m[0] * m[11] * m[13] + m[8] * m[1] * m[15] - m[8] * m[3] * m[13] - m[12] * m[1] * m[11] + m[12] * m[3] * m[9];
+    inv[13] =  m[0] * m[9]  * m[14] - m[0] * m[10] * m[13] - m[8] * m[1] * m[14] + m[8] * m[2] * m[13] + m[12] * m[1] * m[10] - m[12] * m[2] * m[9];
+    inv[2]  =  m[1] * m[6]  * m[15] - m[1] * m[7]  * m[14] - m[5] * m[2] * m[15] + m[5] * m[3] * m[14] + m[13] * m[2] * m[7]  - m[13] * m[3] * m[6];
+    inv[6]  = -m[0] * m[6]  * m[15] + m[0] * m[7]  * m[14] + m[4] * m[2] * m[15] - m[4] * m[3] * m[14] - m[12] * m[2] * m[7]  + m[12] * m[3] * m[6];
+    inv[10] =  m[0] * m[5]  * m[15] - m[0] * m[7]  * m[13] - m[4] * m[1] * m[15] + m[4] * m[3] * m[13] + m[12] * m[1] * m[7]  - m[12] * m[3] * m[5];
+    inv[14] = -m[0] * m[5]  * m[14] + m[0] * m[6]  * m[13] + m[4] * m[1] * m[14] - m[4] * m[2] * m[13] - m[12] * m[1] * m[6]  + m[12] * m[2] * m[5];
+    inv[3]  = -m[1] * m[6]  * m[11] + m[1] * m[7]  * m[10] + m[5] * m[2] * m[11] - m[5] * m[3] * m[10] - m[9]  * m[2] * m[7]  + m[9]  * m[3] * m[6];
+    inv[7]  =  m[0] * m[6]  * m[11] - m[0] * m[7]  * m[10] - m[4] * m[2] * m[11] + m[4] * m[3] * m[10] + m[8]  * m[2] * m[7]  - m[8]  * m[3] * m[6];
+    inv[11] = -m[0] * m[5]  * m[11] + m[0] * m[7]  * m[9]  + m[4] * m[1] * m[11] - m[4] * m[3] * m[9]  - m[8]  * m[1] * m[7]  + m[8]  * m[3] * m[5];
+    inv[15] =  m[0] * m[5]  * m[10] - m[0] * m[6]  * m[9]  - m[4] * m[1] * m[10] + m[4] * m[2] * m[9]  + m[8]  * m[1] * m[6]  - m[8]  * m[2] * m[5];
+
+    float const det = m[0] * inv[0] + m[1] * inv[4] + m[2] * inv[8] + m[3] * inv[12];
+    if(0.0f == det) {
+        return false;
+    }
+    float const inv_det = 1.0f / det;
+    for(uint32_t i = 0; i < 16; ++i) {
+        (&out.m[0][0])[i] = inv[i] * inv_det;
+    }
+    return true;
+}
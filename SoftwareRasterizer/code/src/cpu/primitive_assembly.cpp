@@ -0,0 +1,305 @@
+#include "primitive_assembly.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+static constexpr uint32_t TrianglesPerChunk = 4096;
+
+// Marks chunk local indices of clipped vertices until they are rebased into the output.
+static constexpr IndexType ClippedVertexBit = 0x80000000u;
+
+// Outcode bits, one per plane. A vertex is outside a plane when its distance to it is negative (or NaN).
+static constexpr uint32_t ClipLeft          = 1u << 0;
+static constexpr uint32_t ClipRight         = 1u << 1;
+static constexpr uint32_t ClipBottom        = 1u << 2;
+static constexpr uint32_t ClipTop           = 1u << 3;
+static constexpr uint32_t ClipNear          = 1u << 4;
+static constexpr uint32_t ClipFar           = 1u << 5;
+static constexpr uint32_t ClipGuardLeft     = 1u << 6;
+static constexpr uint32_t ClipGuardRight    = 1u << 7;
+static constexpr uint32_t ClipGuardBottom   = 1u << 8;
+static constexpr uint32_t ClipGuardTop      = 1u << 9;
+static constexpr uint32_t ClipNonFinite     = 1u << 10;
+static constexpr uint32_t ClipPlaneCount    = 10;
+
+static constexpr uint32_t FrustumPlanes = ClipLeft | ClipRight | ClipBottom | ClipTop | ClipNear | ClipFar;
+// Planes that are actually clipped against. Far is left to the depth test, the frustum sides to the rasterizer.
+static constexpr uint32_t ClippingPlanes = ClipNear | ClipGuardLeft | ClipGuardRight | ClipGuardBottom | ClipGuardTop;
+
+// Every clipping plane adds at most one vertex to the polygon.
+static constexpr uint32_t MaxPolygonVertices = 3 + 5;
+
+struct GuardBand {
+    float x;
+    float y;
+};
+
+static float GetPlaneDistance(uint32_t plane, float const (&pos)[4], GuardBand const & guard_band) {
+    float const x = pos[0], y = pos[1], z = pos[2], w = pos[3];
+    switch(plane) {
+        case ClipLeft:          return w + x;
+        case ClipRight:         return w - x;
+        case ClipBottom:        return w + y;
+        case ClipTop:           return w - y;
+        case ClipNear:          return z;
+        case ClipFar:           return w - z;
+        case ClipGuardLeft:     return guard_band.x * w + x;
+        case ClipGuardRight:    return guard_band.x * w - x;
+        case ClipGuardBottom:   return guard_band.y * w + y;
+        case ClipGuardTop:      return guard_band.y * w - y;
+    }
+    ASSERT(false);
+    return 0.0f;
+}
+
+static uint32_t GetOutcode(float const (&pos)[4], GuardBand const & guard_band) {
+    if(!(std::isfinite(pos[0]) && std::isfinite(pos[1]) && std::isfinite(pos[2]) && std::isfinite(pos[3]))) {
+        return ClipNonFinite;
+    }
+    uint32_t code = 0;
+    for(uint32_t i = 0; i < ClipPlaneCount; ++i) {
+        uint32_t const plane = 1u << i;
+        if(!(GetPlaneDistance(plane, pos, guard_band) >= 0.0f)) {
+            code |= plane;
+        }
+    }
+    return code;
+}
+
+// Vertex of the polygon being clipped: clip space position and weights of the triangle's original vertices.
+struct PolygonVertex {
+    float pos[4];
+    float weights[3];
+};
+
+static PolygonVertex LerpPolygonVertex(PolygonVertex const & a, PolygonVertex const & b, float t) {
+    PolygonVertex ret = {};
+    for(uint32_t i = 0; i < 4; ++i) {
+        ret.pos[i] = a.pos[i] + (b.pos[i] - a.pos[i]) * t;
+    }
+    for(uint32_t i = 0; i < 3; ++i) {
+        ret.weights[i] = a.weights[i] + (b.weights[i] - a.weights[i]) * t;
+    }
+    return ret;
+}
+
+// Sutherland-Hodgman against one plane, returns the new vertex count.
+static uint32_t ClipPolygon(
+    PolygonVertex const (&in)[MaxPolygonVertices], uint32_t in_count,
+    uint32_t plane, GuardBand const & guard_band,
+    PolygonVertex (&out)[MaxPolygonVertices])
+{
+    uint32_t out_count = 0;
+    for(uint32_t i = 0; i < in_count; ++i) {
+        PolygonVertex const & cur = in[i];
+        PolygonVertex const & next = in[(i + 1) % in_count];
+        float const d_cur = GetPlaneDistance(plane, cur.pos, guard_band);
+        float const d_next = GetPlaneDistance(plane, next.pos, guard_band);
+        bool const cur_inside = d_cur >= 0.0f;
+        bool const next_inside = d_next >= 0.0f;
+        if(cur_inside) {
+            out[out_count++] = cur;
+        }
+        // Always interpolate from the inside vertex, so the neighbour sharing this edge gets the same point.
+        if(cur_inside && !next_inside) {
+            out[out_count++] = LerpPolygonVertex(cur, next, d_cur / (d_cur - d_next));
+        } else if(!cur_inside && next_inside) {
+            out[out_count++] = LerpPolygonVertex(next, cur, d_next / (d_next - d_cur));
+        }
+    }
+    return out_count;
+}
+
+// Returns true when the triangle is kept, otherwise counts why it was dropped.
+static bool CullTriangle(
+    OutputVertexAttributes const & v0,
+    OutputVertexAttributes const & v1,
+    OutputVertexAttributes const & v2,
+    RasterViewport const & viewport,
+    CullMode cull_mode,
+    PrimitiveAssemblyStats & stats)
+{
+    SnappedTriangle snapped = {};
+    if(!SnapTriangle(v0, v1, v2, viewport, snapped)) {
+        // Can't happen after guard band clipping, apart from rounding right at its border.
+        stats.rejected++;
+        return false;
+    }
+    if(0 == snapped.area2) {
+        stats.culled_zero_area++;
+        return false;
+    }
+    bool const front_facing = snapped.area2 < 0;
+    if((CullMode::Back == cull_mode && !front_facing) || (CullMode::Front == cull_mode && front_facing)) {
+        stats.culled_backface++;
+        return false;
+    }
+    if(snapped.bounds.min_x >= snapped.bounds.max_x || snapped.bounds.min_y >= snapped.bounds.max_y) {
+        stats.culled_small++;
+        return false;
+    }
+    return true;
+}
+
+template<uint32_t N>
+static void WeightedSum(float const (&w)[3], float const (&a)[N], float const (&b)[N], float const (&c)[N], float (&out)[N]) {
+    for(uint32_t i = 0; i < N; ++i) {
+        out[i] = w[0] * a[i] + w[1] * b[i] + w[2] * c[i];
+    }
+}
+
+void PrimitiveAssembler::Init(ThreadPool * in_pool) {
+    ASSERT(nullptr != in_pool);
+    pool = in_pool;
+}
+
+void PrimitiveAssembler::Exit() {
+    chunks.clear();
+    chunks.shrink_to_fit();
+    pool = nullptr;
+}
+
+void PrimitiveAssembler::Assemble(
+    std::vector<OutputVertexAttributes> & vertices,
+    ClipPosition const * clip_positions,
+    uint32_t vertex_count,
+    IndexType const * indices,
+    uint32_t index_count,
+    RasterViewport const & viewport,
+    std::vector<IndexType> & out_indices)
+{
+    ASSERT(nullptr != pool);
+    ASSERT(vertices.size() >= vertex_count);
+    ASSERT(vertex_count < ClippedVertexBit);
+
+    GuardBand const guard_band = {
+        GetRasterGuardBandNDC(viewport.width, viewport.subpixel_bits),
+        GetRasterGuardBandNDC(viewport.height, viewport.subpixel_bits),
+    };
+    uint32_t const triangle_count = index_count / 3;
+    uint32_t const chunk_count = (triangle_count + TrianglesPerChunk - 1) / TrianglesPerChunk;
+    if(chunks.size() < chunk_count) {
+        chunks.resize(chunk_count);
+    }
+
+    // 1. Classify and clip, every chunk collects its output separately.
+    OutputVertexAttributes const * const in_vertices = vertices.data();
+    pool->ParallelFor(chunk_count, [&](uint32_t chunk_index, uint32_t) {
+        Chunk & chunk = chunks[chunk_index];
+        chunk.indices.clear();
+        chunk.vertices.clear();
+        chunk.stats = {};
+
+        uint32_t const begin = chunk_index * TrianglesPerChunk;
+        uint32_t const end = std::min(triangle_count, begin + TrianglesPerChunk);
+        for(uint32_t tri = begin; tri < end; ++tri) {
+            IndexType const i0 = indices[3 * tri + 0];
+            IndexType const i1 = indices[3 * tri + 1];
+            IndexType const i2 = indices[3 * tri + 2];
+            uint32_t const code0 = GetOutcode(clip_positions[i0].pos_clip, guard_band);
+            uint32_t const code1 = GetOutcode(clip_positions[i1].pos_clip, guard_band);
+            uint32_t const code2 = GetOutcode(clip_positions[i2].pos_clip, guard_band);
+
+            if(0 != ((code0 | code1 | code2) & ClipNonFinite) || 0 != (code0 & code1 & code2 & FrustumPlanes)) {
+                chunk.stats.rejected++;
+                continue;
+            }
+
+            uint32_t const planes = (code0 | code1 | code2) & ClippingPlanes;
+            if(0 == planes) {
+                chunk.stats.accepted++;
+                if(!CullTriangle(in_vertices[i0], in_vertices[i1], in_vertices[i2], viewport, cull_mode, chunk.stats)) {
+                    continue;
+                }
+                chunk.indices.push_back(i0);
+                chunk.indices.push_back(i1);
+                chunk.indices.push_back(i2);
+                continue;
+            }
+
+            chunk.stats.clipped++;
+            PolygonVertex polygon[2][MaxPolygonVertices] = {};
+            IndexType const tri_indices[3] = { i0, i1, i2 };
+            for(uint32_t v = 0; v < 3; ++v) {
+                memcpy(polygon[0][v].pos, clip_positions[tri_indices[v]].pos_clip, sizeof(float) * 4);
+                polygon[0][v].weights[v] = 1.0f;
+            }
+            uint32_t count = 3;
+            uint32_t current = 0;
+            for(uint32_t i = 0; i < ClipPlaneCount && count >= 3; ++i) {
+                uint32_t const plane = 1u << i;
+                if(0 != (planes & plane)) {
+                    count = ClipPolygon(polygon[current], count, plane, guard_band, polygon[current ^ 1]);
+                    current ^= 1;
+                }
+            }
+            if(count < 3) {
+                continue;
+            }
+
+            OutputVertexAttributes const & v0 = in_vertices[i0];
+            OutputVertexAttributes const & v1 = in_vertices[i1];
+            OutputVertexAttributes const & v2 = in_vertices[i2];
+            IndexType const first_vertex = ClippedVertexBit | static_cast<IndexType>(chunk.vertices.size());
+            for(uint32_t v = 0; v < count; ++v) {
+                PolygonVertex const & pv = polygon[current][v];
+                OutputVertexAttributes out = {};
+                out.pos_ndc[0] = pv.pos[0] / pv.pos[3];
+                out.pos_ndc[1] = pv.pos[1] / pv.pos[3];
+                out.pos_ndc[2] = pv.pos[2] / pv.pos[3];
+                out.pos_ndc[3] = 1.0f / pv.pos[3];
+                WeightedSum(pv.weights, v0.pos_world, v1.pos_world, v2.pos_world, out.pos_world);
+                WeightedSum(pv.weights, v0.normal_world, v1.normal_world, v2.normal_world, out.normal_world);
+                WeightedSum(pv.weights, v0.col, v1.col, v2.col, out.col);
+                WeightedSum(pv.weights, v0.uv, v1.uv, v2.uv, out.uv);
+                chunk.vertices.push_back(out);
+            }
+            // Fan, keeps the winding of the input triangle
+            OutputVertexAttributes const * const fan = &chunk.vertices[chunk.vertices.size() - count];
+            for(uint32_t v = 1; v + 1 < count; ++v) {
+                chunk.stats.clipped_output++;
+                if(!CullTriangle(fan[0], fan[v], fan[v + 1], viewport, cull_mode, chunk.stats)) {
+                    continue;
+                }
+                chunk.indices.push_back(first_vertex);
+                chunk.indices.push_back(first_vertex + v);
+                chunk.indices.push_back(first_vertex + v + 1);
+            }
+        }
+    });
+
+    // 2. Concatenate in submission order
+    stats = {};
+    uint32_t total_indices = 0;
+    uint32_t total_vertices = vertex_count;
+    std::vector<uint32_t> index_offsets(chunk_count);
+    std::vector<uint32_t> vertex_offsets(chunk_count);
+    for(uint32_t c = 0; c < chunk_count; ++c) {
+        index_offsets[c] = total_indices;
+        vertex_offsets[c] = total_vertices;
+        total_indices += static_cast<uint32_t>(chunks[c].indices.size());
+        total_vertices += static_cast<uint32_t>(chunks[c].vertices.size());
+        stats.accepted += chunks[c].stats.accepted;
+        stats.rejected += chunks[c].stats.rejected;
+        stats.clipped += chunks[c].stats.clipped;
+        stats.clipped_output += chunks[c].stats.clipped_output;
+        stats.culled_backface += chunks[c].stats.culled_backface;
+        stats.culled_zero_area += chunks[c].stats.culled_zero_area;
+        stats.culled_small += chunks[c].stats.culled_small;
+    }
+    ASSERT(total_vertices < ClippedVertexBit);
+    stats.output = total_indices / 3;
+
+    out_indices.resize(total_indices);
+    vertices.resize(total_vertices);
+    pool->ParallelFor(chunk_count, [&](uint32_t chunk_index, uint32_t) {
+        Chunk const & chunk = chunks[chunk_index];
+        IndexType * dst = out_indices.data() + index_offsets[chunk_index];
+        for(IndexType index : chunk.indices) {
+            *dst++ = 0 != (index & ClippedVertexBit) ? (index & ~ClippedVertexBit) + vertex_offsets[chunk_index] : index;
+        }
+        std::copy(chunk.vertices.begin(), chunk.vertices.end(), vertices.begin() + vertex_offsets[chunk_index]);
+    });
+}
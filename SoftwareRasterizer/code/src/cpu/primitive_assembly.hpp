@@ -0,0 +1,76 @@
+#pragma once
+
+#include "pipeline_types.hpp"
+#include "raster_kernels.hpp"
+
+class ThreadPool;
+
+// Front faces are clockwise on screen, same as FrontCounterClockwise = FALSE in the D3D12 pipelines.
+enum class CullMode {
+    None,
+    Back,
+    Front,
+};
+
+struct PrimitiveAssemblyStats {
+    uint32_t    accepted;           // inside the guard band, passed through as is
+    uint32_t    rejected;           // fully outside one frustum plane (or non-finite)
+    uint32_t    clipped;            // crossing the near plane or the guard band
+    uint32_t    clipped_output;     // triangles emitted for the clipped ones
+    uint32_t    culled_backface;
+    uint32_t    culled_zero_area;   // after snapping
+    uint32_t    culled_small;       // no pixel center inside the bounding box
+    uint32_t    output;             // triangles in the compacted list
+};
+
+// Clip space primitive assembly between ShadeVertices and TileRasterizer::Draw.
+//
+// vertex_shading.comp.hlsl divides by w unconditionally, so triangles crossing the camera plane turn inside out
+// and far off screen ones hand the rasterizer huge bounding boxes. Here every triangle is tested against the
+// frustum and the guard band (the region the fixed point rasterizer can represent, see GetRasterGuardBand):
+//   - all vertices inside the guard band and in front of the near plane: accepted, indices copied as is
+//   - all vertices outside the same frustum plane: rejected
+//   - otherwise Sutherland-Hodgman against the near plane and the crossed guard band planes, the polygon
+//     is fanned into new triangles whose vertices are appended to the vertex array.
+// Guard band planes are far outside the screen, so in practice only near plane crossers get clipped.
+//
+// Accepted and clipped triangles are then snapped like the rasterizer does and culled when they face away
+// (see CullMode), have zero area, or miss all pixel centers. Only the survivors end up in the compacted
+// index list, with a counter per reason a triangle was dropped.
+//
+// Triangles are processed in parallel chunks but written out in submission order.
+class PrimitiveAssembler {
+public:
+    void Init(ThreadPool * pool);
+    void Exit();
+
+    // `vertices` holds the `vertex_count` shaded vertices (with `clip_positions`), clipped vertices are appended
+    // after them. The triangles to rasterize are written to `out_indices`.
+    // `viewport` is the one of the rasterizer the output goes to (TileRasterizer::GetViewport).
+    void Assemble(
+        std::vector<OutputVertexAttributes> & vertices,
+        ClipPosition const * clip_positions,
+        uint32_t vertex_count,
+        IndexType const * indices,
+        uint32_t index_count,
+        RasterViewport const & viewport,
+        std::vector<IndexType> & out_indices);
+
+    void SetCullMode(CullMode mode) { cull_mode = mode; }
+    CullMode GetCullMode() const { return cull_mode; }
+
+    // Of the last Assemble
+    PrimitiveAssemblyStats const & GetStats() const { return stats; }
+
+private:
+    struct Chunk {
+        std::vector<IndexType>              indices;    // ClippedVertexBit set: index into `vertices` below
+        std::vector<OutputVertexAttributes> vertices;
+        PrimitiveAssemblyStats              stats;
+    };
+
+    ThreadPool *            pool = nullptr;
+    CullMode                cull_mode = CullMode::Back;
+    std::vector<Chunk>      chunks;
+    PrimitiveAssemblyStats  stats = {};
+};
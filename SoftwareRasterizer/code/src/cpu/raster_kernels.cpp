@@ -0,0 +1,356 @@
+#include "raster_kernels.hpp"
+#include "raster_kernels_common.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+bool SnapTriangle(
+    OutputVertexAttributes const & v0,
+    OutputVertexAttributes const & v1,
+    OutputVertexAttributes const & v2,
+    RasterViewport const & viewport,
+    SnappedTriangle & out)
+{
+    uint32_t const subpixel_bits = viewport.subpixel_bits;
+    ASSERT(subpixel_bits >= 1 && subpixel_bits <= MaxSubpixelBits);
+
+    // The comparison also rejects NaNs coming from w == 0 vertices.
+    float const scale = static_cast<float>(1 << subpixel_bits);
+    float const half_width = 0.5f * static_cast<float>(viewport.width) * scale;
+    float const half_height = 0.5f * static_cast<float>(viewport.height) * scale;
+    float const limit = static_cast<float>(1 << MaxSnappedCoordBits);
+    OutputVertexAttributes const * const v[3] = { &v0, &v1, &v2 };
+    for(uint32_t i = 0; i < 3; ++i) {
+        float const sx = (v[i]->pos_ndc[0] + 1.0f) * half_width;
+        float const sy = (v[i]->pos_ndc[1] + 1.0f) * half_height;
+        if(!(std::fabs(sx) < limit && std::fabs(sy) < limit)) {
+            return false;
+        }
+        out.x[i] = static_cast<int32_t>(std::floor(sx + 0.5f));
+        out.y[i] = static_cast<int32_t>(std::floor(sy + 0.5f));
+    }
+
+    int32_t const * x = out.x;
+    int32_t const * y = out.y;
+    out.area2 = static_cast<int64_t>(x[1] - x[0]) * (y[2] - y[0]) - static_cast<int64_t>(x[2] - x[0]) * (y[1] - y[0]);
+
+    // Pixel centers are at p * 2^bits + half_pixel in subpixels.
+    int32_t const half_pixel = 1 << (subpixel_bits - 1);
+    int32_t const min_x = std::min(x[0], std::min(x[1], x[2]));
+    int32_t const min_y = std::min(y[0], std::min(y[1], y[2]));
+    int32_t const max_x = std::max(x[0], std::max(x[1], x[2]));
+    int32_t const max_y = std::max(y[0], std::max(y[1], y[2]));
+    out.bounds.min_x = std::max(0, (min_x - half_pixel + (1 << subpixel_bits) - 1) >> subpixel_bits);
+    out.bounds.min_y = std::max(0, (min_y - half_pixel + (1 << subpixel_bits) - 1) >> subpixel_bits);
+    out.bounds.max_x = std::min(static_cast<int32_t>(viewport.width), ((max_x - half_pixel) >> subpixel_bits) + 1);
+    out.bounds.max_y = std::min(static_cast<int32_t>(viewport.height), ((max_y - half_pixel) >> subpixel_bits) + 1);
+    return true;
+}
+
+bool SetupRasterTriangle(
+    OutputVertexAttributes const & v0,
+    OutputVertexAttributes const & v1,
+    OutputVertexAttributes const & v2,
+    RasterViewport const & viewport,
+    RasterTriangle & out)
+{
+    SnappedTriangle snapped = {};
+    if(!SnapTriangle(v0, v1, v2, viewport, snapped)) {
+        return false;
+    }
+    if(0 == snapped.area2) {
+        return false;
+    }
+    out.bounds = snapped.bounds;
+    if(out.bounds.min_x >= out.bounds.max_x || out.bounds.min_y >= out.bounds.max_y) {
+        return false;
+    }
+
+    uint32_t const subpixel_bits = viewport.subpixel_bits;
+    int32_t const half_pixel = 1 << (subpixel_bits - 1);
+    int32_t const * x = snapped.x;
+    int32_t const * y = snapped.y;
+    int64_t const area2 = snapped.area2;
+
+    // Edge i is opposite of vertex i. Both windings are drawn, the edges of clockwise triangles are flipped so
+    // inside is positive. In subpixels the edge function is
+    //     E_i(X, Y) = a_i * (X - x[i1]) + b_i * (Y - y[i1])
+    // stepping one pixel adds a_i << bits, so dividing by 2^bits gives integer per pixel steps a_i, b_i and
+    //     c_i = floor((E_i(half_pixel, half_pixel) - bias) / 2^bits)
+    // bias is 1 for edges that are neither top nor left, which makes samples exactly on them fail e_i >= 0.
+    // The floor is exact for the test since e_i * 2^bits + remainder = E_i - bias with 0 <= remainder < 2^bits.
+    int32_t const sign = area2 > 0 ? 1 : -1;
+    for(uint32_t i = 0; i < 3; ++i) {
+        uint32_t const i1 = (i + 1) % 3;
+        uint32_t const i2 = (i + 2) % 3;
+        int32_t const a = sign * (y[i1] - y[i2]);
+        int32_t const b = sign * (x[i2] - x[i1]);
+        // y points up: left edges have the inside on their +x side, top edges are horizontal with the inside below.
+        bool const top_left = a > 0 || (0 == a && b < 0);
+        int64_t const e_origin = static_cast<int64_t>(a) * (half_pixel - x[i1]) + static_cast<int64_t>(b) * (half_pixel - y[i1]);
+        out.edge_a[i] = a;
+        out.edge_b[i] = b;
+        out.edge_c[i] = (e_origin - (top_left ? 0 : 1)) >> subpixel_bits;
+    }
+
+    out.z_min = std::min(v0.pos_ndc[2], std::min(v1.pos_ndc[2], v2.pos_ndc[2]));
+    out.z_max = std::max(v0.pos_ndc[2], std::max(v1.pos_ndc[2], v2.pos_ndc[2]));
+
+    // E_i / area2 is the barycentric weight of vertex i, so a value given per vertex has the plane
+    //     origin = sum(value_i * E_i(bounds.min)) / area2,  ddx = sum(value_i * a_i) * 2^bits / area2,  ddy likewise
+    // E_i is evaluated exactly at the pixel center: c_i carries the fill rule bias and the floor, which are up
+    // to one per pixel step off and would push the weights of small triangles well outside [0, 1].
+    // Done in double, E_i at the origin can be large for triangles reaching into the guard band.
+    double const inv_area = 1.0 / static_cast<double>(area2 * sign);
+    double const step = static_cast<double>(1 << subpixel_bits);
+    int64_t const origin_x = (static_cast<int64_t>(out.bounds.min_x) << subpixel_bits) + half_pixel;
+    int64_t const origin_y = (static_cast<int64_t>(out.bounds.min_y) << subpixel_bits) + half_pixel;
+    double weight_origin[3];
+    double weight_ddx[3];
+    double weight_ddy[3];
+    for(uint32_t i = 0; i < 3; ++i) {
+        uint32_t const i1 = (i + 1) % 3;
+        int64_t const e = out.edge_a[i] * (origin_x - x[i1]) + out.edge_b[i] * (origin_y - y[i1]);
+        weight_origin[i] = static_cast<double>(e) * inv_area;
+        weight_ddx[i] = static_cast<double>(out.edge_a[i]) * step * inv_area;
+        weight_ddy[i] = static_cast<double>(out.edge_b[i]) * step * inv_area;
+    }
+    auto const setup_plane = [&](uint32_t plane, double value0, double value1, double value2) {
+        out.plane_origin[plane] = static_cast<float>(value0 * weight_origin[0] + value1 * weight_origin[1] + value2 * weight_origin[2]);
+        out.plane_ddx[plane] = static_cast<float>(value0 * weight_ddx[0] + value1 * weight_ddx[1] + value2 * weight_ddx[2]);
+        out.plane_ddy[plane] = static_cast<float>(value0 * weight_ddy[0] + value1 * weight_ddy[1] + value2 * weight_ddy[2]);
+    };
+
+    setup_plane(RasterInterpolantZ, v0.pos_ndc[2], v1.pos_ndc[2], v2.pos_ndc[2]);
+
+    double inv_w[3] = { v0.pos_ndc[3], v1.pos_ndc[3], v2.pos_ndc[3] };
+    if(!(inv_w[0] > 0.0 && inv_w[1] > 0.0 && inv_w[2] > 0.0)) {
+        inv_w[0] = inv_w[1] = inv_w[2] = 1.0;
+    }
+    setup_plane(RasterInterpolantInvW, inv_w[0], inv_w[1], inv_w[2]);
+
+    static_assert(offsetof(OutputVertexAttributes, pos_world) + RasterAttributeCount * sizeof(float) == sizeof(OutputVertexAttributes));
+    OutputVertexAttributes const * const v[3] = { &v0, &v1, &v2 };
+    float attributes[3][RasterAttributeCount];
+    for(uint32_t i = 0; i < 3; ++i) {
+        memcpy(attributes[i], reinterpret_cast<uint8_t const *>(v[i]) + offsetof(OutputVertexAttributes, pos_world), sizeof(attributes[i]));
+    }
+    for(uint32_t a = 0; a < RasterAttributeCount; ++a) {
+        setup_plane(RasterInterpolantAttributes + a, attributes[0][a] * inv_w[0], attributes[1][a] * inv_w[1], attributes[2][a] * inv_w[2]);
+    }
+    return true;
+}
+
+static SIMD_FORCEINLINE bool RasterizeBlockRow_Scalar(RasterTriangle const & tri, RasterTarget const & target, int32_t min_x, int32_t max_x, int32_t y, int64_t const (&row)[3], bool test_edges, bool test_depth) {
+    // depth_row[0] is the depth of (min_x, y), a block row is contiguous in every layout
+    float * depth_row = nullptr != target.depth ? &target.depth[GetTargetPixelIndex(target, min_x, y)] : nullptr;
+    bool written = false;
+    int64_t e0 = row[0];
+    int64_t e1 = row[1];
+    int64_t e2 = row[2];
+    PixelInterpolants p;
+    EvalInterpolants(tri, min_x, y, p);
+    for(int32_t x = min_x; x < max_x; ++x) {
+        if(!test_edges || (e0 >= 0 && e1 >= 0 && e2 >= 0)) {
+            float const z = p.values[RasterInterpolantZ];
+            if(nullptr != target.visibility) {
+                written |= WriteVisibility(target, x, y, z, tri.id);
+            } else if(!test_depth || z < depth_row[x - min_x]) {
+                if(nullptr != depth_row) {
+                    depth_row[x - min_x] = z;
+                }
+                WriteFragment(target, x, y, p);
+                written = true;
+            }
+        }
+        StepInterpolantsX(tri, p);
+        e0 += tri.edge_a[0];
+        e1 += tri.edge_a[1];
+        e2 += tri.edge_a[2];
+    }
+    return written;
+}
+
+bool RasterizeTriangle_Scalar(RasterTriangle const & tri, ScreenRect const & rect, RasterTarget const & target) {
+    bool written = false;
+    for(int32_t block_y = AlignDownToBlock(rect.min_y); block_y < rect.max_y; block_y += RasterBlockSize) {
+        for(int32_t block_x = AlignDownToBlock(rect.min_x); block_x < rect.max_x; block_x += RasterBlockSize) {
+            ScreenRect const block = GetClippedBlock(rect, block_x, block_y);
+            BlockCoverage const coverage = ClassifyBlock(tri, block);
+            if(coverage.outside) {
+                continue;
+            }
+            BlockDepth const depth = TestBlockDepth(tri, target, block);
+            if(depth.reject) {
+                continue;
+            }
+            bool block_written = false;
+            int64_t row[3] = { coverage.corner[0], coverage.corner[1], coverage.corner[2] };
+            for(int32_t y = block.min_y; y < block.max_y; ++y) {
+                block_written |= RasterizeBlockRow_Scalar(tri, target, block.min_x, block.max_x, y, row, 0 != coverage.test_mask, depth.test_pixels);
+                row[0] += tri.edge_b[0];
+                row[1] += tri.edge_b[1];
+                row[2] += tri.edge_b[2];
+            }
+            if(block_written && target.depth_test) {
+                UpdateBlockDepth(target, block, depth.z_min);
+            }
+            written |= block_written;
+        }
+    }
+    return written;
+}
+
+#if SIMD_X86
+
+// Block rows are RasterBlockSize = 2 x 4 lanes wide.
+static SIMD_FORCEINLINE bool RasterizeBlock_SSE(RasterTriangle const & tri, RasterTarget const & target, ScreenRect const & block, BlockCoverage const & coverage, bool test_depth) {
+    constexpr int32_t Lanes = 4;
+    bool written = false;
+
+    // Edges that don't cross the block are left out of the coverage test by keeping them at 0.
+    __m128i test_lanes[3];
+    __m128i test_step[3];
+    int64_t row[3];
+    for(uint32_t i = 0; i < 3; ++i) {
+        int32_t const a = 0 != (coverage.test_mask & (1u << i)) ? tri.edge_a[i] : 0;
+        test_lanes[i] = _mm_setr_epi32(0, a, 2 * a, 3 * a);
+        test_step[i] = _mm_set1_epi32(Lanes * a);
+        row[i] = coverage.corner[i];
+    }
+
+    // Planes at the first 4 pixels of the block row, stepped down by ddy.
+    __m128 const lane_offsets = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+    __m128 row_values[RasterInterpolantCount];
+    for(uint32_t i = 0; i < RasterInterpolantCount; ++i) {
+        row_values[i] = _mm_add_ps(_mm_set1_ps(EvalPlane(tri, i, block.min_x, block.min_y)), _mm_mul_ps(_mm_set1_ps(tri.plane_ddx[i]), lane_offsets));
+    }
+
+    for(int32_t y = block.min_y; y < block.max_y; ++y) {
+        // depth_row[0] is the depth of (block.min_x, y)
+        float * depth_row = nullptr != target.depth ? &target.depth[GetTargetPixelIndex(target, block.min_x, y)] : nullptr;
+        __m128i e[3];
+        for(uint32_t i = 0; i < 3; ++i) {
+            int32_t const test_row = 0 != (coverage.test_mask & (1u << i)) ? static_cast<int32_t>(row[i]) : 0;
+            e[i] = _mm_add_epi32(_mm_set1_epi32(test_row), test_lanes[i]);
+            row[i] += tri.edge_b[i];
+        }
+        __m128 values[RasterInterpolantCount];
+        for(uint32_t i = 0; i < RasterInterpolantCount; ++i) {
+            values[i] = row_values[i];
+            row_values[i] = _mm_add_ps(row_values[i], _mm_set1_ps(tri.plane_ddy[i]));
+        }
+
+        for(int32_t x = block.min_x; x < block.max_x; x += Lanes) {
+            // A lane is covered when no edge value has its sign bit set.
+            __m128i const any_negative = _mm_or_si128(_mm_or_si128(e[0], e[1]), e[2]);
+            int mask = _mm_movemask_ps(_mm_castsi128_ps(any_negative)) ^ ((1 << Lanes) - 1);
+            int32_t const remaining = block.max_x - x;
+            if(remaining < Lanes) {
+                mask &= (1 << remaining) - 1;
+            }
+
+            __m128 const vz = values[RasterInterpolantZ];
+            if(0 != mask && test_depth && nullptr == target.visibility) {
+                // Lanes past the block may belong to a tile of another thread, don't read them.
+                __m128 depth = _mm_set1_ps(0.0f);
+                if(remaining >= Lanes) {
+                    depth = _mm_loadu_ps(&depth_row[x - block.min_x]);
+                } else {
+                    alignas(16) float partial[Lanes] = {};
+                    for(int32_t l = 0; l < remaining; ++l) {
+                        partial[l] = depth_row[x - block.min_x + l];
+                    }
+                    depth = _mm_load_ps(partial);
+                }
+                mask &= _mm_movemask_ps(_mm_cmplt_ps(vz, depth));
+            }
+
+            if(0 != mask) {
+                alignas(16) float z[Lanes];
+                _mm_store_ps(z, vz);
+                if(nullptr != target.visibility) {
+                    for(int32_t l = 0; l < Lanes; ++l) {
+                        if(0 != (mask & (1 << l))) {
+                            written |= WriteVisibility(target, x + l, y, z[l], tri.id);
+                        }
+                    }
+                } else {
+                    if(nullptr != depth_row) {
+                        for(int32_t l = 0; l < Lanes; ++l) {
+                            if(0 != (mask & (1 << l))) {
+                                depth_row[x - block.min_x + l] = z[l];
+                            }
+                        }
+                    }
+                    __m128 const w = _mm_div_ps(_mm_set1_ps(1.0f), values[RasterInterpolantInvW]);
+                    __m128 attributes[RasterAttributeCount];
+                    for(uint32_t a = 0; a < RasterAttributeCount; ++a) {
+                        attributes[a] = _mm_mul_ps(values[RasterInterpolantAttributes + a], w);
+                    }
+                    if(nullptr != target.packed_fragments) {
+                        WritePackedFragments_SSE(target, x, y, vz, attributes, mask);
+                    } else {
+                        WriteFragments_SSE(target, x, y, vz, attributes, mask);
+                    }
+                    written = true;
+                }
+            }
+
+            for(uint32_t i = 0; i < 3; ++i) {
+                e[i] = _mm_add_epi32(e[i], test_step[i]);
+            }
+            for(uint32_t i = 0; i < RasterInterpolantCount; ++i) {
+                values[i] = _mm_add_ps(values[i], _mm_set1_ps(tri.plane_ddx[i] * static_cast<float>(Lanes)));
+            }
+        }
+    }
+    return written;
+}
+
+bool RasterizeTriangle_SSE(RasterTriangle const & tri, ScreenRect const & rect, RasterTarget const & target) {
+    bool written = false;
+    for(int32_t block_y = AlignDownToBlock(rect.min_y); block_y < rect.max_y; block_y += RasterBlockSize) {
+        for(int32_t block_x = AlignDownToBlock(rect.min_x); block_x < rect.max_x; block_x += RasterBlockSize) {
+            ScreenRect const block = GetClippedBlock(rect, block_x, block_y);
+            BlockCoverage const coverage = ClassifyBlock(tri, block);
+            if(coverage.outside) {
+                continue;
+            }
+            BlockDepth const depth = TestBlockDepth(tri, target, block);
+            if(depth.reject) {
+                continue;
+            }
+            if(RasterizeBlock_SSE(tri, target, block, coverage, depth.test_pixels)) {
+                if(target.depth_test) {
+                    UpdateBlockDepth(target, block, depth.z_min);
+                }
+                written = true;
+            }
+        }
+    }
+    return written;
+}
+
+#endif // SIMD_X86
+
+void ResolveFragment(RasterTriangle const & tri, RasterTarget const & target, int32_t x, int32_t y) {
+    PixelInterpolants p;
+    EvalInterpolants(tri, x, y, p);
+    WriteFragment(target, x, y, p);
+}
+
+RasterizeTriangleFn GetRasterizeTriangleFn(SimdLevel level) {
+#if SIMD_X86
+    switch(level) {
+        case SimdLevel::AVX512:
+        case SimdLevel::AVX2:   return &RasterizeTriangle_AVX2;
+        case SimdLevel::SSE:    return &RasterizeTriangle_SSE;
+        case SimdLevel::Scalar: break;
+    }
+#else
+    CONSUME_VAR(level);
+#endif
+    return &RasterizeTriangle_Scalar;
+}
@@ -0,0 +1,214 @@
+#pragma once
+
+#include "pipeline_types.hpp"
+#include "simd.hpp"
+
+#include <cstring>
+
+// Per-pixel part of the TileRasterizer.
+//
+// Vertices are snapped to a fixed-point grid with `subpixel_bits` fractional bits and a triangle is set up once
+// as three integer edge functions
+//     e_i(x, y) = a_i * x + b_i * y + c_i      (x, y in pixels, sampled at the pixel center)
+// oriented so they are >= 0 inside. The top-left fill rule is folded into c_i: samples exactly on an edge
+// only count for top and left edges, so a pixel on an edge shared by two triangles of a mesh is written by
+// exactly one of them. Coverage is exact integer math, so it doesn't depend on SIMD width or thread count.
+//
+// Everything else a kernel needs is set up once per triangle too (SetupRasterTriangle, run while binning):
+// depth, 1/w and every attribute divided by w are planes over the screen, value = origin + ddx * dx + ddy * dy.
+// Kernels step them across a row by adding ddx, so the inner loop never touches the vertices and pays no
+// barycentric weights like CalculateBarycentricCoordinates in rasterizer.comp.hlsl. Attributes are perspective
+// correct: the plane of attribute / w is divided by the plane of 1 / w per pixel. Depth is interpolated
+// linearly in screen space, like the hardware does.
+//
+// The bounding box is walked in RasterBlockSize x RasterBlockSize blocks. Each block is first classified
+// against the edges from its corners: blocks fully outside are skipped, blocks fully inside are filled
+// without any per-pixel edge test, and only blocks crossed by an edge go down to per-pixel coverage.
+// Long thin triangles only pay for the blocks along their edges instead of their whole bounding box.
+// Edge values inside a crossed block are small, so the per-pixel tests run on 32-bit lanes.
+//
+// Depth is NDC z (0 near, 1 far) interpolated with the same weights, tested with LESS against a float depth
+// buffer. Every block also has a min/max of its depth values (the lower level of the hierarchical Z, the
+// TileRasterizer keeps the tile level): blocks where the triangle's depth range is behind the block max are
+// skipped before any attribute interpolation, and blocks where it is in front of the block min write without
+// per-pixel depth tests.
+//
+// In visibility buffer mode the kernels write no Fragment: every pixel is one 64-bit value, depth bits on top
+// and the triangle ID below, so a single 64-bit min is depth test and write at once (ties go to the lower ID,
+// i.e. the triangle submitted first). ResolveFragment rebuilds the Fragment of the winning triangle afterwards.
+//
+// With a PackedFragment target the kernels interpolate attributes for a whole vector of pixels and encode them
+// (fragment_packing.hpp) before writing 16 bytes per pixel instead of 72.
+//
+// Target buffers (fragments, depth, visibility) are either linear images or tiled: in RasterTargetLayout::Tiled
+// every RasterBlockSize x RasterBlockSize block of the screen is a tile of 64 contiguous pixels (row-major inside,
+// y up), tiles stored row-major. A block the kernels work on is then a few KB in one place instead of 8 rows a
+// whole image row apart, and the pixels of a block row are still adjacent for the vector stores. Tiled buffers
+// are padded to whole tiles (GetRasterTargetPixelCount) and turned into linear images once, when they're read back.
+
+static constexpr int32_t RasterBlockSize = 8;
+
+static constexpr uint32_t DefaultSubpixelBits = 8;
+static constexpr uint32_t MaxSubpixelBits = 8;
+
+// Snapped vertex coordinates have to stay within +-2^MaxSnappedCoordBits (in subpixels) so edge values
+// inside a block fit in 32 bits; SetupRasterTriangle rejects triangles outside of it.
+static constexpr uint32_t MaxSnappedCoordBits = 26;
+
+struct RasterViewport {
+    uint32_t    width;
+    uint32_t    height;
+    uint32_t    subpixel_bits;
+};
+
+// Guard band in NDC along an axis of `size` pixels: triangles with vertices inside [-g, g] are rasterized
+// without clipping. Half of what the snapped coordinates can hold, so the screen offset and rounding always fit.
+inline float GetRasterGuardBandNDC(uint32_t size, uint32_t subpixel_bits) {
+    return static_cast<float>(1 << (MaxSnappedCoordBits - subpixel_bits)) / static_cast<float>(size > 0 ? size : 1);
+}
+
+struct ScreenRect {
+    int32_t min_x, min_y; // inclusive
+    int32_t max_x, max_y; // exclusive
+};
+
+// Triangle with its vertices snapped to the subpixel grid.
+struct SnappedTriangle {
+    int32_t     x[3];
+    int32_t     y[3];
+    int64_t     area2;  // twice the signed area in subpixels, > 0 for counter-clockwise (y up)
+    ScreenRect  bounds; // pixels whose center is inside the bounding box, clipped to the viewport, may be empty
+};
+
+// Interpolated attributes: the floats of Fragment after pos_ndc (pos_world, normal_world, col, uv).
+// OutputVertexAttributes has them at the same offsets.
+static constexpr uint32_t RasterAttributeCount = 14;
+
+// Planes of a RasterTriangle
+static constexpr uint32_t RasterInterpolantZ = 0;           // NDC depth
+static constexpr uint32_t RasterInterpolantInvW = 1;        // 1 / w_clip
+static constexpr uint32_t RasterInterpolantAttributes = 2;  // first of the attributes divided by w_clip
+static constexpr uint32_t RasterInterpolantCount = RasterInterpolantAttributes + RasterAttributeCount;
+
+// Setup record of a triangle, everything the kernels read.
+struct RasterTriangle {
+    int64_t     edge_c[3];
+    int32_t     edge_a[3];
+    int32_t     edge_b[3];
+    ScreenRect  bounds;     // pixels that may be covered, clipped to the target
+    float       z_min;      // NDC depth range of the vertices
+    float       z_max;
+    uint32_t    id;         // written to the visibility buffer, set by the caller
+
+    // value(x, y) = origin + ddx * (x - bounds.min_x) + ddy * (y - bounds.min_y), x and y in pixels.
+    // One array per plane term, indexed by RasterInterpolant*.
+    float       plane_origin[RasterInterpolantCount];
+    float       plane_ddx[RasterInterpolantCount];
+    float       plane_ddy[RasterInterpolantCount];
+};
+
+enum class RasterTargetLayout : uint8_t {
+    Linear,     // fragments bottom row first (what fragment_shading.comp.hlsl reads), depth / visibility row y at y * width
+    Tiled,      // RasterBlockSize x RasterBlockSize tiles, y up for all buffers
+};
+
+// Pixels of a target buffer, tiled buffers are padded to whole tiles
+static SIMD_FORCEINLINE size_t GetRasterTargetPixelCount(RasterTargetLayout layout, uint32_t width, uint32_t height) {
+    if(RasterTargetLayout::Tiled == layout) {
+        size_t const tiles_x = (width + RasterBlockSize - 1) / RasterBlockSize;
+        size_t const tiles_y = (height + RasterBlockSize - 1) / RasterBlockSize;
+        return tiles_x * tiles_y * RasterBlockSize * RasterBlockSize;
+    }
+    return static_cast<size_t>(width) * height;
+}
+
+// Index of pixel (x, y) (y up) in a tiled buffer with `tiles_x` tiles per row
+static SIMD_FORCEINLINE size_t GetTiledPixelIndex(uint32_t tiles_x, int32_t x, int32_t y) {
+    size_t const tile = static_cast<size_t>(y / RasterBlockSize) * tiles_x + static_cast<size_t>(x / RasterBlockSize);
+    return tile * (RasterBlockSize * RasterBlockSize) + static_cast<size_t>((y % RasterBlockSize) * RasterBlockSize + (x % RasterBlockSize));
+}
+
+struct RasterTarget {
+    Fragment *  fragments;      // GetRasterTargetPixelCount(layout, width, height), bottom row first when Linear
+    PackedFragment * packed_fragments;  // replaces fragments when not nullptr, same layout
+    uint32_t    width;
+    uint32_t    height;
+    RasterTargetLayout layout;  // of every buffer below too, Tiled has blocks_x tiles per row
+
+    // Only used with depth_test
+    bool        depth_test;
+    float *     depth;          // row y at y * width when Linear (y up, unlike fragments), nullptr with visibility
+    float *     block_z_min;    // per RasterBlockSize block, blocks_x * ceil(height / RasterBlockSize)
+    float *     block_z_max;
+    uint32_t    blocks_x;       // always set, the tiles per row of a Tiled target
+
+    // Visibility buffer mode when not nullptr: replaces depth and fragments, needs depth_test.
+    uint64_t *  visibility;     // same layout as depth
+};
+
+// Index of pixel (x, y) in the depth and visibility buffers
+static SIMD_FORCEINLINE size_t GetTargetPixelIndex(RasterTarget const & target, int32_t x, int32_t y) {
+    if(RasterTargetLayout::Tiled == target.layout) {
+        return GetTiledPixelIndex(target.blocks_x, x, y);
+    }
+    return static_cast<size_t>(y) * target.width + static_cast<size_t>(x);
+}
+
+// Index of pixel (x, y) in the fragment buffer, bottom row first when Linear
+static SIMD_FORCEINLINE size_t GetTargetFragmentIndex(RasterTarget const & target, int32_t x, int32_t y) {
+    if(RasterTargetLayout::Tiled == target.layout) {
+        return GetTiledPixelIndex(target.blocks_x, x, y);
+    }
+    return static_cast<size_t>(target.height - y - 1) * target.width + static_cast<size_t>(x);
+}
+
+// Visibility value of a pixel cleared to `depth`, triangle ID 0. The depth test is LESS, so a triangle at the clear
+// depth fails it like in the depth buffer and nothing is ever written with this value.
+static SIMD_FORCEINLINE uint64_t GetVisibilityClearValue(float depth) {
+    uint32_t z_bits = 0;
+    if(depth > 0.0f) {
+        memcpy(&z_bits, &depth, sizeof(z_bits));
+    }
+    return static_cast<uint64_t>(z_bits) << 32;
+}
+
+inline uint32_t GetVisibilityTriangleID(uint64_t value) {
+    return static_cast<uint32_t>(value);
+}
+
+// Float error allowed between the block depth range and the per-pixel depths.
+static constexpr float HiZEpsilon = 1.0f / (1 << 18);
+
+// Returns false when a vertex is outside the guard band (or NaN).
+bool SnapTriangle(
+    OutputVertexAttributes const & v0,
+    OutputVertexAttributes const & v1,
+    OutputVertexAttributes const & v2,
+    RasterViewport const & viewport,
+    SnappedTriangle & out);
+
+// Returns false for triangles that can't cover a pixel center, have zero area after snapping,
+// or have a vertex outside the guard band (or NaN).
+// 1/w comes from pos_ndc[3] of the vertices, when that isn't positive on all three attributes are
+// interpolated linearly in screen space.
+bool SetupRasterTriangle(
+    OutputVertexAttributes const & v0,
+    OutputVertexAttributes const & v1,
+    OutputVertexAttributes const & v2,
+    RasterViewport const & viewport,
+    RasterTriangle & out);
+
+// Rasterizes the part of `tri` inside `rect` (already clipped to tri.bounds).
+// Returns true when at least one pixel was written.
+using RasterizeTriangleFn = bool (*)(RasterTriangle const & tri, ScreenRect const & rect, RasterTarget const & target);
+
+bool RasterizeTriangle_Scalar(RasterTriangle const & tri, ScreenRect const & rect, RasterTarget const & target);
+#if SIMD_X86
+bool RasterizeTriangle_SSE(RasterTriangle const & tri, ScreenRect const & rect, RasterTarget const & target);
+bool RasterizeTriangle_AVX2(RasterTriangle const & tri, ScreenRect const & rect, RasterTarget const & target);
+#endif
+
+RasterizeTriangleFn GetRasterizeTriangleFn(SimdLevel level);
+
+// Writes the Fragment of `tri` at pixel (x, y), with the same planes as the raster kernels.
+void ResolveFragment(RasterTriangle const & tri, RasterTarget const & target, int32_t x, int32_t y);
@@ -0,0 +1,189 @@
+#include "raster_kernels.hpp"
+#include "raster_kernels_common.hpp"
+
+#if SIMD_X86
+
+static_assert(RasterBlockSize == 8, "AVX2 kernel does one block row per vector");
+
+SIMD_TARGET_AVX2
+static SIMD_FORCEINLINE __m256 Clamp_AVX2(__m256 value, float min_value, float max_value) {
+    return _mm256_min_ps(_mm256_max_ps(value, _mm256_set1_ps(min_value)), _mm256_set1_ps(max_value));
+}
+
+// EncodeOctahedral_SSE on 8 lanes.
+SIMD_TARGET_AVX2
+static SIMD_FORCEINLINE __m256i EncodeOctahedral_AVX2(__m256 x, __m256 y, __m256 z) {
+    __m256 const zero = _mm256_setzero_ps();
+    __m256 const sign_mask = _mm256_set1_ps(-0.0f);
+    __m256 const l1 = _mm256_add_ps(_mm256_add_ps(_mm256_andnot_ps(sign_mask, x), _mm256_andnot_ps(sign_mask, y)), _mm256_andnot_ps(sign_mask, z));
+    __m256 const inv_l1 = _mm256_and_ps(_mm256_div_ps(_mm256_set1_ps(1.0f), l1), _mm256_cmp_ps(l1, zero, _CMP_GT_OQ));
+    __m256 const px = _mm256_mul_ps(x, inv_l1);
+    __m256 const py = _mm256_mul_ps(y, inv_l1);
+
+    __m256 const one = _mm256_set1_ps(1.0f);
+    __m256 const sign_x = _mm256_and_ps(_mm256_cmp_ps(px, zero, _CMP_LT_OQ), sign_mask);
+    __m256 const sign_y = _mm256_and_ps(_mm256_cmp_ps(py, zero, _CMP_LT_OQ), sign_mask);
+    __m256 const fx = _mm256_or_ps(_mm256_sub_ps(one, _mm256_andnot_ps(sign_mask, py)), sign_x);
+    __m256 const fy = _mm256_or_ps(_mm256_sub_ps(one, _mm256_andnot_ps(sign_mask, px)), sign_y);
+
+    __m256 const lower = _mm256_cmp_ps(z, zero, _CMP_LT_OQ);
+    __m256 const scale = _mm256_set1_ps(Snorm16Steps);
+    __m256i const sx = _mm256_cvtps_epi32(_mm256_mul_ps(Clamp_AVX2(_mm256_blendv_ps(px, fx, lower), -1.0f, 1.0f), scale));
+    __m256i const sy = _mm256_cvtps_epi32(_mm256_mul_ps(Clamp_AVX2(_mm256_blendv_ps(py, fy, lower), -1.0f, 1.0f), scale));
+    return _mm256_or_si256(_mm256_and_si256(sx, _mm256_set1_epi32(0xFFFF)), _mm256_slli_epi32(sy, 16));
+}
+
+SIMD_TARGET_AVX2
+static SIMD_FORCEINLINE __m256i PackRGBA8_AVX2(__m256 r, __m256 g, __m256 b, __m256 a) {
+    __m256 const scale = _mm256_set1_ps(255.0f);
+    __m256i const ir = _mm256_cvtps_epi32(_mm256_mul_ps(Clamp_AVX2(r, 0.0f, 1.0f), scale));
+    __m256i const ig = _mm256_cvtps_epi32(_mm256_mul_ps(Clamp_AVX2(g, 0.0f, 1.0f), scale));
+    __m256i const ib = _mm256_cvtps_epi32(_mm256_mul_ps(Clamp_AVX2(b, 0.0f, 1.0f), scale));
+    __m256i const ia = _mm256_cvtps_epi32(_mm256_mul_ps(Clamp_AVX2(a, 0.0f, 1.0f), scale));
+    return _mm256_or_si256(_mm256_or_si256(ir, _mm256_slli_epi32(ig, 8)), _mm256_or_si256(_mm256_slli_epi32(ib, 16), _mm256_slli_epi32(ia, 24)));
+}
+
+// WritePackedFragments_SSE for a whole block row, halves are converted with F16C.
+SIMD_TARGET_AVX2
+static SIMD_FORCEINLINE void WritePackedFragments_AVX2(RasterTarget const & target, int32_t x, int32_t y, __m256 z, __m256 const * attributes, int mask) {
+    __m256i const normal = EncodeOctahedral_AVX2(attributes[AttributeNormal + 0], attributes[AttributeNormal + 1], attributes[AttributeNormal + 2]);
+    __m256i const color = PackRGBA8_AVX2(attributes[AttributeColor + 0], attributes[AttributeColor + 1], attributes[AttributeColor + 2], attributes[AttributeColor + 3]);
+    __m128i const u = _mm256_cvtps_ph(attributes[AttributeUV + 0], _MM_FROUND_TO_NEAREST_INT);
+    __m128i const v = _mm256_cvtps_ph(attributes[AttributeUV + 1], _MM_FROUND_TO_NEAREST_INT);
+
+    PackedFragment * dst = &GetTargetPackedFragment(target, x, y);
+    if(0 != (mask & 0x0F)) {
+        StorePackedFragments_SSE(dst, _mm256_castps256_ps128(z), _mm256_castsi256_si128(normal), _mm256_castsi256_si128(color), _mm_unpacklo_epi16(u, v), mask & 0x0F);
+    }
+    if(0 != (mask & 0xF0)) {
+        StorePackedFragments_SSE(dst + 4, _mm256_extractf128_ps(z, 1), _mm256_extracti128_si256(normal, 1), _mm256_extracti128_si256(color, 1), _mm_unpackhi_epi16(u, v), mask >> 4);
+    }
+}
+
+// WriteFragments_SSE for a whole block row, one half at a time.
+SIMD_TARGET_AVX2
+static SIMD_FORCEINLINE void WriteFragments_AVX2(RasterTarget const & target, int32_t x, int32_t y, __m256 z, __m256 const * attributes, int mask) {
+    __m128 half_attributes[RasterAttributeCount];
+    if(0 != (mask & 0x0F)) {
+        for(uint32_t a = 0; a < RasterAttributeCount; ++a) {
+            half_attributes[a] = _mm256_castps256_ps128(attributes[a]);
+        }
+        WriteFragments_SSE(target, x, y, _mm256_castps256_ps128(z), half_attributes, mask & 0x0F);
+    }
+    if(0 != (mask & 0xF0)) {
+        for(uint32_t a = 0; a < RasterAttributeCount; ++a) {
+            half_attributes[a] = _mm256_extractf128_ps(attributes[a], 1);
+        }
+        WriteFragments_SSE(target, x + 4, y, _mm256_extractf128_ps(z, 1), half_attributes, mask >> 4);
+    }
+}
+
+SIMD_TARGET_AVX2
+static SIMD_FORCEINLINE bool RasterizeBlock_AVX2(RasterTriangle const & tri, RasterTarget const & target, ScreenRect const & block, BlockCoverage const & coverage, bool test_depth) {
+    constexpr int32_t Lanes = 8;
+    __m256i const lane_index = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256 const lane_offsets = _mm256_cvtepi32_ps(lane_index);
+    int const valid_mask = (1 << (block.max_x - block.min_x)) - 1;
+    // Lanes past the block may belong to a tile of another thread, depth loads leave them out.
+    __m256i const valid_lanes = _mm256_cmpgt_epi32(_mm256_set1_epi32(block.max_x - block.min_x), lane_index);
+    bool written = false;
+
+    // Edges that don't cross the block are left out of the coverage test by keeping them at 0.
+    __m256i test_lanes[3];
+    int64_t row[3];
+    for(uint32_t i = 0; i < 3; ++i) {
+        int32_t const a = 0 != (coverage.test_mask & (1u << i)) ? tri.edge_a[i] : 0;
+        test_lanes[i] = _mm256_mullo_epi32(_mm256_set1_epi32(a), lane_index);
+        row[i] = coverage.corner[i];
+    }
+
+    // Planes over the block row, stepped down by ddy.
+    __m256 values[RasterInterpolantCount];
+    for(uint32_t i = 0; i < RasterInterpolantCount; ++i) {
+        values[i] = _mm256_add_ps(_mm256_set1_ps(EvalPlane(tri, i, block.min_x, block.min_y)), _mm256_mul_ps(_mm256_set1_ps(tri.plane_ddx[i]), lane_offsets));
+    }
+
+    for(int32_t y = block.min_y; y < block.max_y; ++y) {
+        // depth_row[0] is the depth of (block.min_x, y)
+        float * depth_row = nullptr != target.depth ? &target.depth[GetTargetPixelIndex(target, block.min_x, y)] : nullptr;
+        __m256i e[3];
+        for(uint32_t i = 0; i < 3; ++i) {
+            int32_t const test_row = 0 != (coverage.test_mask & (1u << i)) ? static_cast<int32_t>(row[i]) : 0;
+            e[i] = _mm256_add_epi32(_mm256_set1_epi32(test_row), test_lanes[i]);
+            row[i] += tri.edge_b[i];
+        }
+
+        // A lane is covered when no edge value has its sign bit set.
+        __m256i const any_negative = _mm256_or_si256(_mm256_or_si256(e[0], e[1]), e[2]);
+        int mask = (_mm256_movemask_ps(_mm256_castsi256_ps(any_negative)) ^ 0xFF) & valid_mask;
+
+        __m256 const vz = values[RasterInterpolantZ];
+        if(0 != mask && test_depth && nullptr == target.visibility) {
+            __m256 const depth = _mm256_maskload_ps(depth_row, valid_lanes);
+            mask &= _mm256_movemask_ps(_mm256_cmp_ps(vz, depth, _CMP_LT_OQ));
+        }
+
+        if(0 != mask) {
+            alignas(32) float z[Lanes];
+            _mm256_store_ps(z, vz);
+            if(nullptr != target.visibility) {
+                for(int32_t l = 0; l < Lanes; ++l) {
+                    if(0 != (mask & (1 << l))) {
+                        written |= WriteVisibility(target, block.min_x + l, y, z[l], tri.id);
+                    }
+                }
+            } else {
+                if(nullptr != depth_row) {
+                    for(int32_t l = 0; l < Lanes; ++l) {
+                        if(0 != (mask & (1 << l))) {
+                            depth_row[l] = z[l];
+                        }
+                    }
+                }
+                __m256 const w = _mm256_div_ps(_mm256_set1_ps(1.0f), values[RasterInterpolantInvW]);
+                __m256 attributes[RasterAttributeCount];
+                for(uint32_t a = 0; a < RasterAttributeCount; ++a) {
+                    attributes[a] = _mm256_mul_ps(values[RasterInterpolantAttributes + a], w);
+                }
+                if(nullptr != target.packed_fragments) {
+                    WritePackedFragments_AVX2(target, block.min_x, y, vz, attributes, mask);
+                } else {
+                    WriteFragments_AVX2(target, block.min_x, y, vz, attributes, mask);
+                }
+                written = true;
+            }
+        }
+
+        for(uint32_t i = 0; i < RasterInterpolantCount; ++i) {
+            values[i] = _mm256_add_ps(values[i], _mm256_set1_ps(tri.plane_ddy[i]));
+        }
+    }
+    return written;
+}
+
+SIMD_TARGET_AVX2
+bool RasterizeTriangle_AVX2(RasterTriangle const & tri, ScreenRect const & rect, RasterTarget const & target) {
+    bool written = false;
+    for(int32_t block_y = AlignDownToBlock(rect.min_y); block_y < rect.max_y; block_y += RasterBlockSize) {
+        for(int32_t block_x = AlignDownToBlock(rect.min_x); block_x < rect.max_x; block_x += RasterBlockSize) {
+            ScreenRect const block = GetClippedBlock(rect, block_x, block_y);
+            BlockCoverage const coverage = ClassifyBlock(tri, block);
+            if(coverage.outside) {
+                continue;
+            }
+            BlockDepth const depth = TestBlockDepth(tri, target, block);
+            if(depth.reject) {
+                continue;
+            }
+            if(RasterizeBlock_AVX2(tri, target, block, coverage, depth.test_pixels)) {
+                if(target.depth_test) {
+                    UpdateBlockDepth(target, block, depth.z_min);
+                }
+                written = true;
+            }
+        }
+    }
+    return written;
+}
+
+#endif // SIMD_X86
@@ -0,0 +1,247 @@
+#pragma once
+
+#include "raster_kernels.hpp"
+#include "fragment_packing.hpp"
+
+#include <cstddef>
+#include <cstring>
+
+// Helpers shared by the raster kernels of every SIMD level, see simd.hpp on why they are force inlined.
+
+struct BlockCoverage {
+    bool        outside;
+    uint32_t    test_mask;      // bit i set: edge i crosses the block and has to be tested per pixel
+    int64_t     corner[3];      // e_i at (block.min_x, block.min_y)
+};
+
+// Edge functions are linear, so their min/max over the samples of `block` are at its corners.
+static SIMD_FORCEINLINE BlockCoverage ClassifyBlock(RasterTriangle const & tri, ScreenRect const & block) {
+    BlockCoverage ret = {};
+    int64_t const extent_x = block.max_x - 1 - block.min_x;
+    int64_t const extent_y = block.max_y - 1 - block.min_y;
+    for(uint32_t i = 0; i < 3; ++i) {
+        ret.corner[i] = tri.edge_a[i] * static_cast<int64_t>(block.min_x) + tri.edge_b[i] * static_cast<int64_t>(block.min_y) + tri.edge_c[i];
+        int64_t const dx = tri.edge_a[i] * extent_x;
+        int64_t const dy = tri.edge_b[i] * extent_y;
+        int64_t const max_value = ret.corner[i] + (dx > 0 ? dx : 0) + (dy > 0 ? dy : 0);
+        int64_t const min_value = ret.corner[i] + (dx < 0 ? dx : 0) + (dy < 0 ? dy : 0);
+        if(max_value < 0) {
+            ret.outside = true;
+            return ret;
+        }
+        if(min_value < 0) {
+            ret.test_mask |= 1u << i;
+        }
+    }
+    return ret;
+}
+
+static SIMD_FORCEINLINE float EvalPlane(RasterTriangle const & tri, uint32_t plane, int32_t x, int32_t y) {
+    return tri.plane_origin[plane] + tri.plane_ddx[plane] * static_cast<float>(x - tri.bounds.min_x) + tri.plane_ddy[plane] * static_cast<float>(y - tri.bounds.min_y);
+}
+
+struct BlockDepth {
+    bool        reject;         // triangle is behind everything drawn in the block so far
+    bool        test_pixels;    // per-pixel depth tests are needed
+    float       z_min;          // of the triangle over the block
+};
+
+// Hierarchical Z test of `block` against the min/max of the RasterBlockSize block containing it.
+// The triangle's depth range over the block comes from its depth plane at the block corners.
+static SIMD_FORCEINLINE BlockDepth TestBlockDepth(RasterTriangle const & tri, RasterTarget const & target, ScreenRect const & block) {
+    BlockDepth ret = {};
+    if(!target.depth_test) {
+        return ret;
+    }
+
+    float const z_corner = EvalPlane(tri, RasterInterpolantZ, block.min_x, block.min_y);
+    float z_dx = tri.plane_ddx[RasterInterpolantZ];
+    float z_dy = tri.plane_ddy[RasterInterpolantZ];
+    z_dx *= static_cast<float>(block.max_x - 1 - block.min_x);
+    z_dy *= static_cast<float>(block.max_y - 1 - block.min_y);
+    float z_min = z_corner + (z_dx < 0.0f ? z_dx : 0.0f) + (z_dy < 0.0f ? z_dy : 0.0f);
+    float z_max = z_corner + (z_dx > 0.0f ? z_dx : 0.0f) + (z_dy > 0.0f ? z_dy : 0.0f);
+    z_min = (z_min < tri.z_min ? tri.z_min : z_min) - HiZEpsilon;
+    z_max = (z_max > tri.z_max ? tri.z_max : z_max) + HiZEpsilon;
+
+    uint32_t const index = static_cast<uint32_t>(block.min_y / RasterBlockSize) * target.blocks_x + static_cast<uint32_t>(block.min_x / RasterBlockSize);
+    ret.reject = z_min >= target.block_z_max[index];
+    ret.test_pixels = !(z_max < target.block_z_min[index]);
+    ret.z_min = z_min;
+    return ret;
+}
+
+// After pixels of `block` were written: depth can only go down, so the block min takes the triangle's and
+// the max is rescanned from the depth buffer.
+static SIMD_FORCEINLINE void UpdateBlockDepth(RasterTarget const & target, ScreenRect const & block, float z_min) {
+    uint32_t const index = static_cast<uint32_t>(block.min_y / RasterBlockSize) * target.blocks_x + static_cast<uint32_t>(block.min_x / RasterBlockSize);
+    if(z_min < target.block_z_min[index]) {
+        target.block_z_min[index] = z_min;
+    }
+
+    int32_t const min_x = block.min_x & ~(RasterBlockSize - 1);
+    int32_t const min_y = block.min_y & ~(RasterBlockSize - 1);
+    int32_t const max_x = min_x + RasterBlockSize < static_cast<int32_t>(target.width) ? min_x + RasterBlockSize : static_cast<int32_t>(target.width);
+    int32_t const max_y = min_y + RasterBlockSize < static_cast<int32_t>(target.height) ? min_y + RasterBlockSize : static_cast<int32_t>(target.height);
+    float z_max = 0.0f;
+    if(nullptr != target.visibility) {
+        // Depth bits are on top and depth is never negative, so the max value has the max depth.
+        uint64_t value_max = 0;
+        for(int32_t y = min_y; y < max_y; ++y) {
+            uint64_t const * row = &target.visibility[GetTargetPixelIndex(target, min_x, y)];
+            for(int32_t x = 0; x < max_x - min_x; ++x) {
+                value_max = row[x] > value_max ? row[x] : value_max;
+            }
+        }
+        uint32_t const z_bits = static_cast<uint32_t>(value_max >> 32);
+        memcpy(&z_max, &z_bits, sizeof(z_max));
+    } else {
+        for(int32_t y = min_y; y < max_y; ++y) {
+            float const * row = &target.depth[GetTargetPixelIndex(target, min_x, y)];
+            for(int32_t x = 0; x < max_x - min_x; ++x) {
+                z_max = row[x] > z_max ? row[x] : z_max;
+            }
+        }
+    }
+    target.block_z_max[index] = z_max;
+}
+
+// 64-bit min of (depth, triangle ID): depth test and write in one, returns true when the pixel changed.
+// Tiles belong to one thread while they are rasterized, so it doesn't have to be an atomic min.
+static SIMD_FORCEINLINE bool WriteVisibility(RasterTarget const & target, int32_t x, int32_t y, float z, uint32_t id) {
+    uint32_t z_bits = 0;
+    if(z > 0.0f) {
+        memcpy(&z_bits, &z, sizeof(z_bits));
+    }
+    uint64_t const value = (static_cast<uint64_t>(z_bits) << 32) | id;
+    uint64_t & dst = target.visibility[GetTargetPixelIndex(target, x, y)];
+    if(value < dst) {
+        dst = value;
+        return true;
+    }
+    return false;
+}
+
+// Block of the RasterBlockSize grid starting at (block_x, block_y), clipped to `rect`.
+static SIMD_FORCEINLINE ScreenRect GetClippedBlock(ScreenRect const & rect, int32_t block_x, int32_t block_y) {
+    ScreenRect block = {};
+    block.min_x = block_x < rect.min_x ? rect.min_x : block_x;
+    block.min_y = block_y < rect.min_y ? rect.min_y : block_y;
+    block.max_x = block_x + RasterBlockSize > rect.max_x ? rect.max_x : block_x + RasterBlockSize;
+    block.max_y = block_y + RasterBlockSize > rect.max_y ? rect.max_y : block_y + RasterBlockSize;
+    return block;
+}
+
+static SIMD_FORCEINLINE int32_t AlignDownToBlock(int32_t v) {
+    return v & ~(RasterBlockSize - 1);
+}
+
+// Pixels of a block row follow (x, y) in memory in both layouts
+static SIMD_FORCEINLINE Fragment & GetTargetFragment(RasterTarget const & target, int32_t x, int32_t y) {
+    return target.fragments[GetTargetFragmentIndex(target, x, y)];
+}
+
+static SIMD_FORCEINLINE PackedFragment & GetTargetPackedFragment(RasterTarget const & target, int32_t x, int32_t y) {
+    return target.packed_fragments[GetTargetFragmentIndex(target, x, y)];
+}
+
+// NDC of the pixel center
+static SIMD_FORCEINLINE float GetPixelNDC(int32_t x, uint32_t size) {
+    return static_cast<float>(x * 2 + 1 - static_cast<int32_t>(size)) / static_cast<float>(size);
+}
+
+// Plane values of one pixel, stepped along a row with StepInterpolantsX.
+struct PixelInterpolants {
+    float       values[RasterInterpolantCount];
+};
+
+static SIMD_FORCEINLINE void EvalInterpolants(RasterTriangle const & tri, int32_t x, int32_t y, PixelInterpolants & out) {
+    for(uint32_t i = 0; i < RasterInterpolantCount; ++i) {
+        out.values[i] = EvalPlane(tri, i, x, y);
+    }
+}
+
+static SIMD_FORCEINLINE void StepInterpolantsX(RasterTriangle const & tri, PixelInterpolants & p) {
+    for(uint32_t i = 0; i < RasterInterpolantCount; ++i) {
+        p.values[i] += tri.plane_ddx[i];
+    }
+}
+
+static SIMD_FORCEINLINE void WriteFragment(RasterTarget const & target, int32_t x, int32_t y, PixelInterpolants const & p) {
+    static_assert(offsetof(Fragment, pos_world) + RasterAttributeCount * sizeof(float) == sizeof(Fragment));
+    Fragment frag;
+    frag.pos_ndc[0] = GetPixelNDC(x, target.width);
+    frag.pos_ndc[1] = GetPixelNDC(y, target.height);
+    frag.pos_ndc[2] = p.values[RasterInterpolantZ];
+    frag.pos_ndc[3] = 0.0f;
+    float const w = 1.0f / p.values[RasterInterpolantInvW];
+    float attributes[RasterAttributeCount];
+    for(uint32_t a = 0; a < RasterAttributeCount; ++a) {
+        attributes[a] = p.values[RasterInterpolantAttributes + a] * w;
+    }
+    memcpy(reinterpret_cast<uint8_t *>(&frag) + offsetof(Fragment, pos_world), attributes, sizeof(attributes));
+
+    if(nullptr != target.packed_fragments) {
+        GetTargetPackedFragment(target, x, y) = PackFragment(frag);
+    } else {
+        GetTargetFragment(target, x, y) = frag;
+    }
+}
+
+#if SIMD_X86
+
+// Attributes in the order of RasterAttributeCount
+static constexpr uint32_t AttributePosWorld = 0;
+static constexpr uint32_t AttributeNormal = 4;
+static constexpr uint32_t AttributeColor = 8;
+static constexpr uint32_t AttributeUV = 12;
+
+// 4 horizontally adjacent pixels starting at (x, y), only lanes in `mask` are written.
+// `attributes` are already multiplied by w.
+static SIMD_FORCEINLINE void WriteFragments_SSE(RasterTarget const & target, int32_t x, int32_t y, __m128 z, __m128 const * attributes, int mask) {
+    int32_t const ndc_x = x * 2 + 1 - static_cast<int32_t>(target.width);
+    __m128 pos_ndc[4] = {
+        _mm_div_ps(_mm_cvtepi32_ps(_mm_setr_epi32(ndc_x, ndc_x + 2, ndc_x + 4, ndc_x + 6)), _mm_set1_ps(static_cast<float>(target.width))),
+        _mm_set1_ps(GetPixelNDC(y, target.height)),
+        z,
+        _mm_setzero_ps(),
+    };
+    __m128 pos_world[4] = { attributes[AttributePosWorld + 0], attributes[AttributePosWorld + 1], attributes[AttributePosWorld + 2], attributes[AttributePosWorld + 3] };
+    __m128 normal[4] = { attributes[AttributeNormal + 0], attributes[AttributeNormal + 1], attributes[AttributeNormal + 2], attributes[AttributeNormal + 3] };
+    __m128 color[4] = { attributes[AttributeColor + 0], attributes[AttributeColor + 1], attributes[AttributeColor + 2], attributes[AttributeColor + 3] };
+    _MM_TRANSPOSE4_PS(pos_ndc[0], pos_ndc[1], pos_ndc[2], pos_ndc[3]);
+    _MM_TRANSPOSE4_PS(pos_world[0], pos_world[1], pos_world[2], pos_world[3]);
+    _MM_TRANSPOSE4_PS(normal[0], normal[1], normal[2], normal[3]);
+    _MM_TRANSPOSE4_PS(color[0], color[1], color[2], color[3]);
+    // (u0 v0 u1 v1), (u2 v2 u3 v3)
+    __m128 const uv[2] = {
+        _mm_unpacklo_ps(attributes[AttributeUV + 0], attributes[AttributeUV + 1]),
+        _mm_unpackhi_ps(attributes[AttributeUV + 0], attributes[AttributeUV + 1]),
+    };
+
+    Fragment * dst = &GetTargetFragment(target, x, y);
+    for(int32_t l = 0; l < 4; ++l) {
+        if(0 != (mask & (1 << l))) {
+            _mm_storeu_ps(dst[l].pos_ndc, pos_ndc[l]);
+            _mm_storeu_ps(dst[l].pos_world, pos_world[l]);
+            _mm_storeu_ps(dst[l].normal_world, normal[l]);
+            _mm_storeu_ps(dst[l].col, color[l]);
+            if(0 == (l & 1)) {
+                _mm_storel_pi(reinterpret_cast<__m64 *>(dst[l].uv), uv[l / 2]);
+            } else {
+                _mm_storeh_pi(reinterpret_cast<__m64 *>(dst[l].uv), uv[l / 2]);
+            }
+        }
+    }
+}
+
+// Same as WriteFragments_SSE with PackedFragment output.
+static SIMD_FORCEINLINE void WritePackedFragments_SSE(RasterTarget const & target, int32_t x, int32_t y, __m128 z, __m128 const * attributes, int mask) {
+    __m128i const normal = EncodeOctahedral_SSE(attributes[AttributeNormal + 0], attributes[AttributeNormal + 1], attributes[AttributeNormal + 2]);
+    __m128i const color = PackRGBA8_SSE(attributes[AttributeColor + 0], attributes[AttributeColor + 1], attributes[AttributeColor + 2], attributes[AttributeColor + 3]);
+    __m128i const u = FloatToHalf_SSE(attributes[AttributeUV + 0]);
+    __m128i const v = FloatToHalf_SSE(attributes[AttributeUV + 1]);
+    StorePackedFragments_SSE(&GetTargetPackedFragment(target, x, y), z, normal, color, _mm_or_si128(u, _mm_slli_epi32(v, 16)), mask);
+}
+
+#endif // SIMD_X86
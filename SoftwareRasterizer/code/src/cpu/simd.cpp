@@ -0,0 +1,71 @@
+#include "simd.hpp"
+
+#if SIMD_X86 && defined(_MSC_VER)
+    #include <intrin.h>
+#endif
+
+static SimdLevel DetectSimdLevel() {
+#if SIMD_X86 && defined(_MSC_VER)
+    int info[4] = {};
+    __cpuid(info, 0);
+    int const max_leaf = info[0];
+
+    __cpuid(info, 1);
+    bool const has_sse2 = 0 != (info[3] & (1 << 26));
+    bool const has_fma = 0 != (info[2] & (1 << 12));
+    bool const has_f16c = 0 != (info[2] & (1 << 29));
+    bool const has_osxsave = 0 != (info[2] & (1 << 27));
+    bool const has_avx = 0 != (info[2] & (1 << 28));
+
+    bool has_avx2 = false;
+    bool has_avx512f = false;
+    if(max_leaf >= 7) {
+        __cpuidex(info, 7, 0);
+        has_avx2 = 0 != (info[1] & (1 << 5));
+        has_avx512f = 0 != (info[1] & (1 << 16));
+    }
+
+    // OS has to save the YMM registers on context switch, and the opmask and ZMM registers for AVX-512.
+    uint64_t const xcr0 = has_osxsave ? _xgetbv(0) : 0;
+    bool const os_saves_ymm = 0x6 == (xcr0 & 0x6);
+    bool const os_saves_zmm = 0xE6 == (xcr0 & 0xE6);
+
+    bool const has_avx2_level = has_avx && has_avx2 && has_fma && has_f16c && os_saves_ymm;
+    if(has_avx2_level && has_avx512f && os_saves_zmm) {
+        return SimdLevel::AVX512;
+    }
+    if(has_avx2_level) {
+        return SimdLevel::AVX2;
+    }
+    if(has_sse2) {
+        return SimdLevel::SSE;
+    }
+    return SimdLevel::Scalar;
+#elif SIMD_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") && __builtin_cpu_supports("f16c")) {
+        return __builtin_cpu_supports("avx512f") ? SimdLevel::AVX512 : SimdLevel::AVX2;
+    }
+    if(__builtin_cpu_supports("sse2")) {
+        return SimdLevel::SSE;
+    }
+    return SimdLevel::Scalar;
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+SimdLevel GetSimdLevel() {
+    static SimdLevel const level = DetectSimdLevel();
+    return level;
+}
+
+char const * GetSimdLevelName(SimdLevel level) {
+    switch(level) {
+        case SimdLevel::Scalar: return "Scalar";
+        case SimdLevel::SSE:    return "SSE";
+        case SimdLevel::AVX2:   return "AVX2";
+        case SimdLevel::AVX512: return "AVX-512";
+    }
+    return "Unknown";
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "../base.h"
+
+// x86 SIMD support for the cpu/ pipeline.
+// Kernels are built for every level and picked at runtime with GetSimdLevel().
+// AVX2 and AVX-512 kernels live in their own *_avx2.cpp / *_avx512.cpp translation units:
+//  - MSVC builds those files with /arch:AVX2 or /arch:AVX512 (set per file in the vcxproj) so the scalar code
+//    around the intrinsics is VEX/EVEX encoded too and there are no SSE/AVX transition stalls.
+//  - GCC/Clang get the same through SIMD_TARGET_AVX2 / SIMD_TARGET_AVX512 on every function in them.
+// Helpers shared with those files must be `static SIMD_FORCEINLINE` so no AVX2 copy of them leaks to other TUs.
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386__)
+    #define SIMD_X86 1
+    #include <immintrin.h>
+#else
+    #define SIMD_X86 0
+#endif
+
+#if SIMD_X86 && (defined(__GNUC__) || defined(__clang__))
+    #define SIMD_TARGET_AVX2 __attribute__((target("avx2,fma,f16c")))
+    #define SIMD_TARGET_AVX512 __attribute__((target("avx512f,avx2,fma,f16c")))
+#else
+    #define SIMD_TARGET_AVX2
+    #define SIMD_TARGET_AVX512
+#endif
+
+#if defined(_MSC_VER)
+    #define SIMD_FORCEINLINE __forceinline
+#else
+    #define SIMD_FORCEINLINE inline __attribute__((always_inline))
+#endif
+
+enum class SimdLevel {
+    Scalar,
+    SSE,    // SSE2, 4 lanes
+    AVX2,   // AVX2 + FMA + F16C, 8 lanes
+    AVX512, // AVX-512F on top of AVX2, 16 lanes. Stages without an AVX-512 kernel run their AVX2 one.
+};
+
+// Best level supported by both CPU and OS. Queried once and cached.
+SimdLevel GetSimdLevel();
+
+char const * GetSimdLevelName(SimdLevel level);
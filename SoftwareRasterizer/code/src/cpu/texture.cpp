@@ -0,0 +1,406 @@
+#include "texture.hpp"
+#include "texture_compression.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+#define STBI_WINDOWS_UTF8
+// The failure reason is a process wide global (and a static buffer for unknown PNG chunks) in this stb_image
+// version, while AssetLoader workers load textures concurrently
+#define STBI_NO_FAILURE_STRINGS
+#define STB_IMAGE_IMPLEMENTATION
+#include "../dep/include/stb/stb_image.h"
+
+#define STB_IMAGE_RESIZE_IMPLEMENTATION
+#include "../dep/include/stb/stb_image_resize.h"
+
+static std::atomic<uint32_t> texture_serial_counter = 0;
+
+uint32_t NewTextureSerial() {
+    return texture_serial_counter.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+uint32_t GetTextureMipCount(uint32_t width, uint32_t height) {
+    uint32_t count = 1;
+    for(uint32_t size = std::max(width, height); size > 1; size >>= 1) {
+        ++count;
+    }
+    return count;
+}
+
+// Resizes rows [row_begin, row_end) of `dst` from the whole of `src`: same scale as a resize of the full level,
+// shifted by the first row, so the filter taps land exactly where they would and the blocks join without seams.
+static bool ResizeMipRows(Texture & texture, uint32_t src_mip, uint32_t row_begin, uint32_t row_end, stbir_edge edge, stbir_colorspace space) {
+    TextureMip const & src = texture.mips[src_mip];
+    TextureMip const & dst = texture.mips[src_mip + 1];
+    float const x_scale = static_cast<float>(dst.width) / static_cast<float>(src.width);
+    float const y_scale = static_cast<float>(dst.height) / static_cast<float>(src.height);
+    int const res = stbir_resize_subpixel(
+        texture.texels.data() + src.offset, static_cast<int>(src.width), static_cast<int>(src.height), static_cast<int>(src.width * 4),
+        texture.texels.data() + dst.offset + row_begin * dst.width, static_cast<int>(dst.width), static_cast<int>(row_end - row_begin), static_cast<int>(dst.width * 4),
+        STBIR_TYPE_UINT8, 4, 3, 0,
+        edge, edge,
+        STBIR_FILTER_BOX, STBIR_FILTER_BOX,
+        space, nullptr,
+        x_scale, y_scale, 0.0f, static_cast<float>(row_begin));
+    return 0 != res;
+}
+
+bool BuildTexture(uint8_t const * rgba8, uint32_t width, uint32_t height, TextureBuildOptions const & options, Texture & out, ThreadPool * pool) {
+    out = {};
+    if(nullptr == rgba8 || 0 == width || 0 == height || width > TextureMaxSize || height > TextureMaxSize) {
+        ::printf("BuildTexture: invalid image (%u x %u)\n", width, height);
+        return false;
+    }
+
+    uint32_t const mip_count = options.mips ? GetTextureMipCount(width, height) : 1;
+    ASSERT(mip_count <= TextureMaxMips);
+
+    out.width = width;
+    out.height = height;
+    out.color_space = options.color_space;
+    out.serial = NewTextureSerial();
+    out.mips.resize(mip_count);
+    uint32_t texel_count = 0;
+    for(uint32_t m = 0; m < mip_count; ++m) {
+        TextureMip & mip = out.mips[m];
+        mip.width = std::max(width >> m, 1u);
+        mip.height = std::max(height >> m, 1u);
+        mip.offset = texel_count;
+        mip.tiles_x = 0;
+        texel_count += mip.width * mip.height;
+    }
+    out.texels.resize(texel_count);
+    ::memcpy(out.texels.data(), rgba8, size_t(width) * height * 4);
+
+    stbir_edge const edge = (TextureAddressMode::Wrap == options.edge) ? STBIR_EDGE_WRAP : STBIR_EDGE_CLAMP;
+    stbir_colorspace const space = (TextureColorSpace::sRGB == options.color_space) ? STBIR_COLORSPACE_SRGB : STBIR_COLORSPACE_LINEAR;
+
+    for(uint32_t m = 1; m < mip_count; ++m) {
+        uint32_t const rows = out.mips[m].height;
+        uint32_t const job_count = (rows + TextureMipRowsPerJob - 1) / TextureMipRowsPerJob;
+        std::atomic<bool> failed = false;
+        auto resize_block = [&](uint32_t job, uint32_t) {
+            uint32_t const row_begin = job * TextureMipRowsPerJob;
+            uint32_t const row_end = std::min(row_begin + TextureMipRowsPerJob, rows);
+            if(false == ResizeMipRows(out, m - 1, row_begin, row_end, edge, space)) {
+                failed.store(true, std::memory_order_relaxed);
+            }
+        };
+        if(nullptr != pool && job_count > 1) {
+            pool->ParallelFor(job_count, resize_block);
+        } else {
+            for(uint32_t job = 0; job < job_count; ++job) {
+                resize_block(job, 0);
+            }
+        }
+        if(failed.load(std::memory_order_relaxed)) {
+            ::printf("BuildTexture: resizing mip %u failed\n", m);
+            out = {};
+            return false;
+        }
+    }
+
+    if(TextureFormat::RGBA8 != options.format) {
+        Texture const uncompressed = std::move(out);
+        CompressTexture(uncompressed, options.format, out, pool);
+    } else if(TextureLayout::Linear != options.layout) {
+        Texture const linear = std::move(out);
+        ConvertTextureLayout(linear, options.layout, out, pool);
+    }
+    return true;
+}
+
+void ConvertTextureLayout(Texture const & src, TextureLayout layout, Texture & out, ThreadPool * pool) {
+    ASSERT(TextureFormat::RGBA8 == src.format);
+    ASSERT(&src != &out);
+    out.width = src.width;
+    out.height = src.height;
+    out.color_space = src.color_space;
+    out.layout = layout;
+    out.format = TextureFormat::RGBA8;
+    out.serial = NewTextureSerial();
+    out.mips.resize(src.mips.size());
+    uint32_t texel_count = 0;
+    for(size_t m = 0; m < src.mips.size(); ++m) {
+        TextureMip & mip = out.mips[m];
+        mip.width = src.mips[m].width;
+        mip.height = src.mips[m].height;
+        mip.offset = texel_count;
+        if(TextureLayout::Tiled == layout) {
+            mip.tiles_x = (mip.width + TextureTileSize - 1) >> TextureTileShift;
+            uint32_t const tiles_y = (mip.height + TextureTileSize - 1) >> TextureTileShift;
+            texel_count += (mip.tiles_x * tiles_y) << (2 * TextureTileShift);
+        } else {
+            mip.tiles_x = 0;
+            texel_count += mip.width * mip.height;
+        }
+    }
+    // Padding texels of partial tiles stay 0, the sampler never addresses them
+    out.texels.assign(texel_count, 0);
+
+    for(size_t m = 0; m < src.mips.size(); ++m) {
+        TextureMip const & src_mip = src.mips[m];
+        TextureMip const & dst_mip = out.mips[m];
+        uint32_t const job_count = (src_mip.height + TextureTileSize - 1) >> TextureTileShift;
+        auto convert_rows = [&](uint32_t job, uint32_t) {
+            uint32_t const row_begin = job << TextureTileShift;
+            uint32_t const row_end = std::min(row_begin + TextureTileSize, src_mip.height);
+            for(uint32_t y = row_begin; y < row_end; ++y) {
+                for(uint32_t x = 0; x < src_mip.width; ++x) {
+                    out.texels[GetTexelIndex(layout, dst_mip, x, y)] = src.texels[GetTexelIndex(src.layout, src_mip, x, y)];
+                }
+            }
+        };
+        if(nullptr != pool && job_count > 1) {
+            pool->ParallelFor(job_count, convert_rows);
+        } else {
+            for(uint32_t job = 0; job < job_count; ++job) {
+                convert_rows(job, 0);
+            }
+        }
+    }
+}
+
+bool LoadTexture(char const * path, TextureBuildOptions const & options, Texture & out, ThreadPool * pool) {
+    int w = 0, h = 0, channels = 0;
+    stbi_uc * image = stbi_load(path, &w, &h, &channels, STBI_rgb_alpha);
+    if(nullptr == image) {
+        ::printf("LoadTexture: can't load %s\n", path);
+        out = {};
+        return false;
+    }
+    bool const ok = BuildTexture(image, static_cast<uint32_t>(w), static_cast<uint32_t>(h), options, out, pool);
+    stbi_image_free(image);
+    return ok;
+}
+
+float GetTextureLod(Texture const & texture, float du_dx, float dv_dx, float du_dy, float dv_dy) {
+    float const w = static_cast<float>(texture.width);
+    float const h = static_cast<float>(texture.height);
+    float const x_u = du_dx * w, x_v = dv_dx * h;
+    float const y_u = du_dy * w, y_v = dv_dy * h;
+    float const len_sq = std::max(x_u * x_u + x_v * x_v, y_u * y_u + y_v * y_v);
+    // log2(sqrt(x)) without the sqrt; -inf for a zero footprint, which clamps to the top level
+    return 0.5f * std::log2(len_sq);
+}
+
+// Byte to float in [0, 1], sRGB bytes decoded to linear. Exact per byte.
+static float const * GetDecodeTable(TextureColorSpace color_space) {
+    struct Tables {
+        float linear[256];
+        float srgb[256];
+    };
+    static Tables const tables = []() {
+        Tables t = {};
+        for(uint32_t i = 0; i < 256; ++i) {
+            float const c = static_cast<float>(i) / 255.0f;
+            t.linear[i] = c;
+            t.srgb[i] = (c <= 0.04045f) ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+        return t;
+    }();
+    return (TextureColorSpace::sRGB == color_space) ? tables.srgb : tables.linear;
+}
+
+// Keeps texel coordinates far from the int32 range: wrapping repeats every 1 anyway, clamping only needs one
+// texel of overshoot for the bilinear footprint
+static float ReduceCoord(float coord, TextureAddressMode mode) {
+    if(TextureAddressMode::Wrap == mode) {
+        return coord - std::floor(coord);
+    }
+    return std::clamp(coord, -1.0f, 2.0f);
+}
+
+// After ReduceCoord a wrapped coordinate is at most one texel outside [0, size), which saves the integer divide
+static int32_t AddressTexel(int32_t coord, int32_t size, TextureAddressMode mode) {
+    if(TextureAddressMode::Wrap == mode) {
+        if(coord < 0) {
+            return coord + size;
+        }
+        return (coord >= size) ? coord - size : coord;
+    }
+    return std::clamp(coord, 0, size - 1);
+}
+
+static void DecodeTexel(uint32_t texel, float const * decode, float out[4]) {
+    out[0] = decode[texel & 0xFF];
+    out[1] = decode[(texel >> 8) & 0xFF];
+    out[2] = decode[(texel >> 16) & 0xFF];
+    out[3] = static_cast<float>(texel >> 24) * (1.0f / 255.0f);
+}
+
+// Texel access of one level: a texel is Fetch(Row(y), Column(x)), the taps of a footprint share rows and columns
+template<TextureLayout Layout>
+struct UncompressedTexels {
+    uint32_t const *    texels;
+    TextureMip const &  mip;
+
+    static UncompressedTexels Get(Texture const & texture, uint32_t level) {
+        return { texture.texels.data() + texture.mips[level].offset, texture.mips[level] };
+    }
+
+    uint32_t Column(uint32_t x) const { return GetTexelColumnOffset(Layout, x); }
+    uint32_t Row(uint32_t y) const { return GetTexelRowOffset(Layout, mip, y); }
+    uint32_t Fetch(uint32_t row, uint32_t column) const { return texels[row + column]; }
+};
+
+struct DecodedTextureBlock {
+    uint32_t const *    block;          // nullptr: empty
+    uint32_t            serial;
+    uint32_t            texels[16];
+};
+
+struct TextureBlockCache {
+    DecodedTextureBlock     entries[TextureBlockCacheSize];
+    TextureBlockCacheStats  stats;
+};
+
+static thread_local TextureBlockCache texture_block_cache = {};
+
+TextureBlockCacheStats GetTextureBlockCacheStats() {
+    return texture_block_cache.stats;
+}
+
+void ResetTextureBlockCacheStats() {
+    texture_block_cache.stats = {};
+}
+
+template<TextureFormat Format>
+struct CompressedTexels {
+    static constexpr uint32_t BlockWords = (TextureFormat::BC1 == Format) ? 2 : 4;
+
+    uint32_t const *    blocks;
+    TextureMip const &  mip;
+    uint32_t            serial;
+    uint32_t            level;
+
+    static CompressedTexels Get(Texture const & texture, uint32_t level) {
+        return { texture.texels.data() + texture.mips[level].offset, texture.mips[level], texture.serial, level };
+    }
+
+    uint32_t Column(uint32_t x) const { return x; }
+    uint32_t Row(uint32_t y) const { return y; }
+    uint32_t Fetch(uint32_t y, uint32_t x) const {
+        uint32_t const bx = x / TextureBlockSize;
+        uint32_t const by = y / TextureBlockSize;
+        uint32_t const * block = blocks + (by * mip.tiles_x + bx) * BlockWords;
+        // Direct mapped on the position in the window and the level's parity
+        constexpr uint32_t mask = TextureBlockCacheWindow - 1;
+        uint32_t const slot = ((((level & 1) * TextureBlockCacheWindow) + (by & mask)) * TextureBlockCacheWindow) + (bx & mask);
+        DecodedTextureBlock & entry = texture_block_cache.entries[slot];
+        if(entry.block != block || entry.serial != serial) {
+            if constexpr(TextureFormat::BC1 == Format) {
+                DecodeBC1Block(block, entry.texels);
+            } else if constexpr(TextureFormat::BC3 == Format) {
+                DecodeBC3Block(block, entry.texels);
+            } else {
+                DecodeBC7Block(block, entry.texels);
+            }
+            entry.block = block;
+            entry.serial = serial;
+            ++texture_block_cache.stats.misses;
+        } else {
+            ++texture_block_cache.stats.hits;
+        }
+        return entry.texels[(y % TextureBlockSize) * TextureBlockSize + (x % TextureBlockSize)];
+    }
+};
+static_assert(0 == (TextureBlockCacheWindow & (TextureBlockCacheWindow - 1)), "CompressedTexels::Fetch masks the window");
+
+// Texel centers are at half integers, as on the GPU. Instantiated per layout / format so the texel addressing
+// inlines without a branch per tap.
+template<typename Texels>
+static void SampleMip(Texture const & texture, TextureSampler const & sampler, uint32_t level, bool bilinear, float u, float v, float const * decode, float out[4]) {
+    Texels const texels = Texels::Get(texture, level);
+    TextureMip const & mip = texture.mips[level];
+    int32_t const w = static_cast<int32_t>(mip.width);
+    int32_t const h = static_cast<int32_t>(mip.height);
+    float const x = u * static_cast<float>(w);
+    float const y = v * static_cast<float>(h);
+
+    if(false == bilinear) {
+        uint32_t const tx = static_cast<uint32_t>(AddressTexel(static_cast<int32_t>(std::floor(x)), w, sampler.address_u));
+        uint32_t const ty = static_cast<uint32_t>(AddressTexel(static_cast<int32_t>(std::floor(y)), h, sampler.address_v));
+        DecodeTexel(texels.Fetch(texels.Row(ty), texels.Column(tx)), decode, out);
+        return;
+    }
+
+    float const fx = x - 0.5f;
+    float const fy = y - 0.5f;
+    float const x0f = std::floor(fx);
+    float const y0f = std::floor(fy);
+    float const ax = fx - x0f;
+    float const ay = fy - y0f;
+    uint32_t const col0 = texels.Column(static_cast<uint32_t>(AddressTexel(static_cast<int32_t>(x0f), w, sampler.address_u)));
+    uint32_t const col1 = texels.Column(static_cast<uint32_t>(AddressTexel(static_cast<int32_t>(x0f) + 1, w, sampler.address_u)));
+    uint32_t const row0 = texels.Row(static_cast<uint32_t>(AddressTexel(static_cast<int32_t>(y0f), h, sampler.address_v)));
+    uint32_t const row1 = texels.Row(static_cast<uint32_t>(AddressTexel(static_cast<int32_t>(y0f) + 1, h, sampler.address_v)));
+
+    float t00[4], t10[4], t01[4], t11[4];
+    DecodeTexel(texels.Fetch(row0, col0), decode, t00);
+    DecodeTexel(texels.Fetch(row0, col1), decode, t10);
+    DecodeTexel(texels.Fetch(row1, col0), decode, t01);
+    DecodeTexel(texels.Fetch(row1, col1), decode, t11);
+    for(uint32_t c = 0; c < 4; ++c) {
+        float const top = t00[c] + (t10[c] - t00[c]) * ax;
+        float const bottom = t01[c] + (t11[c] - t01[c]) * ax;
+        out[c] = top + (bottom - top) * ay;
+    }
+}
+
+template<typename Texels>
+static void SampleTextureTexels(Texture const & texture, TextureSampler const & sampler, float u, float v, float lod, float out[4]) {
+    float const * decode = GetDecodeTable(texture.color_space);
+    u = ReduceCoord(u, sampler.address_u);
+    v = ReduceCoord(v, sampler.address_v);
+
+    float const max_lod = static_cast<float>(texture.mips.size() - 1);
+    float const level = std::clamp(lod + sampler.lod_bias, 0.0f, max_lod);
+
+    if(TextureFilter::Trilinear != sampler.filter) {
+        uint32_t const nearest = static_cast<uint32_t>(level + 0.5f);
+        SampleMip<Texels>(texture, sampler, nearest, TextureFilter::Bilinear == sampler.filter, u, v, decode, out);
+        return;
+    }
+
+    uint32_t const fine = static_cast<uint32_t>(level);
+    float const blend = level - static_cast<float>(fine);
+    SampleMip<Texels>(texture, sampler, fine, true, u, v, decode, out);
+    if(blend > 0.0f) {
+        float coarse[4];
+        SampleMip<Texels>(texture, sampler, fine + 1, true, u, v, decode, coarse);
+        for(uint32_t c = 0; c < 4; ++c) {
+            out[c] += (coarse[c] - out[c]) * blend;
+        }
+    }
+}
+
+void SampleTexture(Texture const & texture, TextureSampler const & sampler, float u, float v, float lod, float out[4]) {
+    ASSERT(false == texture.mips.empty());
+    switch(texture.format) {
+        case TextureFormat::BC1:
+            SampleTextureTexels<CompressedTexels<TextureFormat::BC1>>(texture, sampler, u, v, lod, out);
+            break;
+        case TextureFormat::BC3:
+            SampleTextureTexels<CompressedTexels<TextureFormat::BC3>>(texture, sampler, u, v, lod, out);
+            break;
+        case TextureFormat::BC7:
+            SampleTextureTexels<CompressedTexels<TextureFormat::BC7>>(texture, sampler, u, v, lod, out);
+            break;
+        default:
+            if(TextureLayout::Tiled == texture.layout) {
+                SampleTextureTexels<UncompressedTexels<TextureLayout::Tiled>>(texture, sampler, u, v, lod, out);
+            } else {
+                SampleTextureTexels<UncompressedTexels<TextureLayout::Linear>>(texture, sampler, u, v, lod, out);
+            }
+            break;
+    }
+}
+
+void SampleTextureGrad(Texture const & texture, TextureSampler const & sampler, float u, float v, float du_dx, float dv_dx, float du_dy, float dv_dy, float out[4]) {
+    SampleTexture(texture, sampler, u, v, GetTextureLod(texture, du_dx, dv_dx, du_dy, dv_dy), out);
+}
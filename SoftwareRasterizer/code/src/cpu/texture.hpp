@@ -0,0 +1,167 @@
+#pragma once
+
+#include "../base.h"
+
+class ThreadPool;
+
+// RGBA8 textures with full mip chains built on the CPU at load time, and a CPU sampler for them.
+//
+// Every mip level is resized from the previous one with stb_image_resize (a box filter, widened to a trapezoid
+// when a dimension is odd), in linear light when the texture is sRGB so minifying doesn't darken bright detail
+// on dark backgrounds. Alpha is filtered linearly and colors are weighted by it. A level depends on the one
+// above it, so levels run in order and every level is split into blocks of rows resized in parallel.
+//
+// Texels are stored row-major (Linear, what the GPU upload wants) or swizzled (Tiled): every level is cut into
+// 8x8 tiles of 256 bytes stored one after the other in row-major tile order, with the texels of a tile in Morton
+// (Z) order. Each 4x4 quarter of a tile is then one 64 byte cache line, so the 2x2 footprint of a bilinear tap
+// and the neighborhood of the next pixels stay within one or two lines whatever direction the surface is walked
+// in, where a linear image touches a new line per row. Levels are padded to whole tiles.
+//
+// Textures can also stay block compressed (BC1 / BC3 / BC7, see texture_compression.hpp), 4-8x smaller than RGBA8.
+// Blocks are then stored row-major per level and the sampler decodes them on demand into a small per-thread cache
+// of decoded blocks, indexed by the block's position so neighboring blocks and the two levels of a trilinear
+// sample don't evict each other.
+//
+// The sampler works on the same texels: point / bilinear / trilinear filtering, wrap or clamp addressing, and an
+// LOD picked from the UV derivatives the way the GPU does (log2 of the longer footprint axis in texels).
+enum class TextureColorSpace : uint8_t {
+    Linear,
+    sRGB,
+};
+
+enum class TextureAddressMode : uint8_t {
+    Wrap,
+    Clamp,
+};
+
+enum class TextureLayout : uint8_t {
+    Linear,
+    Tiled,
+};
+
+enum class TextureFormat : uint8_t {
+    RGBA8,
+    BC1,
+    BC3,
+    BC7,
+};
+
+enum class TextureFilter : uint8_t {
+    Point,
+    Bilinear,
+    Trilinear,
+};
+
+// Largest texture the D3D12 samplers take, keeps every texel offset in 32 bits
+constexpr uint32_t TextureMaxSize = 16384;
+constexpr uint32_t TextureMaxMips = 15;
+// Rows of a mip level resized by one job
+constexpr uint32_t TextureMipRowsPerJob = 32;
+// Tiled layout: TextureTileSize x TextureTileSize texels per tile
+constexpr uint32_t TextureTileShift = 3;
+constexpr uint32_t TextureTileSize = 1 << TextureTileShift;
+// Compressed formats: texels per block side
+constexpr uint32_t TextureBlockSize = 4;
+// Decoded blocks per thread: a 16x16 window of blocks (64x64 texels, a TileRasterizer tile at 1 texel per pixel)
+// for each of two levels
+constexpr uint32_t TextureBlockCacheWindow = 16;
+constexpr uint32_t TextureBlockCacheSize = 2 * TextureBlockCacheWindow * TextureBlockCacheWindow;
+
+struct TextureMip {
+    uint32_t    width;
+    uint32_t    height;
+    uint32_t    offset;             // in Texture::texels
+    uint32_t    tiles_x;            // Tiled: tiles per row of tiles, the level takes tiles_x * tiles_y whole tiles
+                                    // Compressed: blocks per row of blocks
+};
+
+struct Texture {
+    uint32_t                width       = 0;
+    uint32_t                height      = 0;
+    TextureColorSpace       color_space = TextureColorSpace::sRGB;
+    TextureLayout           layout      = TextureLayout::Linear;
+    TextureFormat           format      = TextureFormat::RGBA8;
+    uint32_t                serial      = 0;    // new on every build, tells decoded blocks of old texels apart
+    std::vector<TextureMip> mips;       // largest first
+    std::vector<uint32_t>   texels;     // RGBA8, R in the low byte, every mip concatenated. Compressed: the blocks
+};
+
+struct TextureBuildOptions {
+    TextureColorSpace   color_space = TextureColorSpace::sRGB;
+    TextureAddressMode  edge        = TextureAddressMode::Wrap;     // how the resize filter reads past the edges
+    TextureLayout       layout      = TextureLayout::Linear;     // RGBA8 only
+    TextureFormat       format      = TextureFormat::RGBA8;         // compressed after the mips are built
+    bool                mips        = true;                         // false: level 0 only
+};
+
+struct TextureSampler {
+    TextureFilter       filter      = TextureFilter::Trilinear;
+    TextureAddressMode  address_u   = TextureAddressMode::Wrap;
+    TextureAddressMode  address_v   = TextureAddressMode::Wrap;
+    float               lod_bias    = 0.0f;
+};
+
+struct TextureBlockCacheStats {
+    uint64_t    hits;
+    uint64_t    misses;             // blocks decoded
+};
+
+// Levels of a full chain down to 1 x 1
+uint32_t GetTextureMipCount(uint32_t width, uint32_t height);
+
+// Spreads the low 8 bits of `v` to the even bits
+inline uint32_t SpreadTextureBits(uint32_t v) {
+    v = (v | (v << 4)) & 0x0F0F;
+    v = (v | (v << 2)) & 0x3333;
+    v = (v | (v << 1)) & 0x5555;
+    return v;
+}
+
+// The index of a texel splits into a part from its column and one from its row, so the taps of a filter
+// footprint share them: texel (x, y) of `mip` is texels[mip.offset + GetTexelRowOffset(y) + GetTexelColumnOffset(x)]
+inline uint32_t GetTexelColumnOffset(TextureLayout layout, uint32_t x) {
+    if(TextureLayout::Tiled == layout) {
+        return ((x >> TextureTileShift) << (2 * TextureTileShift)) | SpreadTextureBits(x & (TextureTileSize - 1));
+    }
+    return x;
+}
+
+inline uint32_t GetTexelRowOffset(TextureLayout layout, TextureMip const & mip, uint32_t y) {
+    if(TextureLayout::Tiled == layout) {
+        return (((y >> TextureTileShift) * mip.tiles_x) << (2 * TextureTileShift)) | (SpreadTextureBits(y & (TextureTileSize - 1)) << 1);
+    }
+    return y * mip.width;
+}
+
+// Index in Texture::texels of texel (x, y) of `mip`, x and y inside the level
+inline uint32_t GetTexelIndex(TextureLayout layout, TextureMip const & mip, uint32_t x, uint32_t y) {
+    return mip.offset + GetTexelRowOffset(layout, mip, y) + GetTexelColumnOffset(layout, x);
+}
+
+// Builds `out` (replaced) from `rgba8` (width * height texels, rows tightly packed). `pool` can be nullptr to run
+// on the calling thread. Returns false when the size is 0 or above TextureMaxSize.
+bool BuildTexture(uint8_t const * rgba8, uint32_t width, uint32_t height, TextureBuildOptions const & options, Texture & out, ThreadPool * pool);
+
+// Copy of `src` (RGBA8) with its texels in `layout`. `pool` can be nullptr.
+void ConvertTextureLayout(Texture const & src, TextureLayout layout, Texture & out, ThreadPool * pool);
+
+// Loads an image file with stb_image (converted to RGBA8) and builds `out` from it.
+bool LoadTexture(char const * path, TextureBuildOptions const & options, Texture & out, ThreadPool * pool);
+
+// LOD of a pixel footprint given by the derivatives of its UVs (in [0, 1] texture space) along screen x and y.
+// Not clamped to the mip range and without bias.
+float GetTextureLod(Texture const & texture, float du_dx, float dv_dx, float du_dy, float dv_dy);
+
+// Filtered texel at (u, v) with the given LOD (bias added, clamped to the mip range; Bilinear and Point use the
+// nearest level). Returns linear RGBA in [0, 1]: sRGB textures are decoded before filtering.
+void SampleTexture(Texture const & texture, TextureSampler const & sampler, float u, float v, float lod, float out[4]);
+
+// SampleTexture with the LOD taken from the UV derivatives
+void SampleTextureGrad(Texture const & texture, TextureSampler const & sampler, float u, float v, float du_dx, float dv_dx, float du_dy, float dv_dy, float out[4]);
+
+// Decoded block cache counters of the calling thread since the last reset
+TextureBlockCacheStats GetTextureBlockCacheStats();
+void ResetTextureBlockCacheStats();
+
+// Serial for a Texture whose texels were (re)built
+uint32_t NewTextureSerial();
@@ -0,0 +1,147 @@
+#include "texture_benchmark.hpp"
+#include "texture_compression.hpp"
+#include "tile_rasterizer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+TextureBenchmarkResult BenchmarkTextureSampling(
+    Texture const & texture,
+    TextureSampler const & sampler,
+    float angle_degrees,
+    float texels_per_pixel,
+    uint32_t size,
+    uint32_t repeats)
+{
+    ASSERT(false == texture.mips.empty());
+    float const angle = angle_degrees * (3.14159265f / 180.0f);
+    float const cos_a = std::cos(angle);
+    float const sin_a = std::sin(angle);
+    // UV step per pixel along screen x and y
+    float const du_dx = cos_a * texels_per_pixel / static_cast<float>(texture.width);
+    float const dv_dx = sin_a * texels_per_pixel / static_cast<float>(texture.height);
+    float const du_dy = -sin_a * texels_per_pixel / static_cast<float>(texture.width);
+    float const dv_dy = cos_a * texels_per_pixel / static_cast<float>(texture.height);
+    float const half = 0.5f * static_cast<float>(size);
+
+    TextureBenchmarkResult result = {};
+    result.angle_degrees = angle_degrees;
+    result.ms = INFINITY;
+    for(uint32_t r = 0; r < std::max(repeats, 1u); ++r) {
+        ResetTextureBlockCacheStats();
+        float checksum = 0.0f;
+        auto const start = std::chrono::high_resolution_clock::now();
+        for(uint32_t tile_y = 0; tile_y < size; tile_y += TileRasterizer::TileSize) {
+            for(uint32_t tile_x = 0; tile_x < size; tile_x += TileRasterizer::TileSize) {
+                uint32_t const end_y = std::min(tile_y + TileRasterizer::TileSize, size);
+                uint32_t const end_x = std::min(tile_x + TileRasterizer::TileSize, size);
+                for(uint32_t y = tile_y; y < end_y; ++y) {
+                    float const py = static_cast<float>(y) + 0.5f - half;
+                    for(uint32_t x = tile_x; x < end_x; ++x) {
+                        float const px = static_cast<float>(x) + 0.5f - half;
+                        float const u = 0.5f + px * du_dx + py * du_dy;
+                        float const v = 0.5f + px * dv_dx + py * dv_dy;
+                        float sample[4];
+                        SampleTextureGrad(texture, sampler, u, v, du_dx, dv_dx, du_dy, dv_dy, sample);
+                        checksum += sample[0] + sample[1] + sample[2] + sample[3];
+                    }
+                }
+            }
+        }
+        auto const end = std::chrono::high_resolution_clock::now();
+        float const ms = std::chrono::duration<float, std::milli>(end - start).count();
+        if(ms < result.ms) {
+            result.ms = ms;
+        }
+        result.checksum = checksum;
+    }
+    result.samples_per_us = static_cast<float>(size) * static_cast<float>(size) / (result.ms * 1000.0f);
+    TextureBlockCacheStats const stats = GetTextureBlockCacheStats();
+    uint64_t const lookups = stats.hits + stats.misses;
+    result.block_hit_rate = (lookups > 0) ? static_cast<float>(stats.hits) / static_cast<float>(lookups) : 0.0f;
+    return result;
+}
+
+void BenchmarkTextureLayouts(
+    Texture const & texture,
+    TextureSampler const & sampler,
+    float texels_per_pixel,
+    uint32_t size,
+    uint32_t repeats,
+    ThreadPool * pool,
+    TextureLayoutBenchmark out[TextureBenchmarkAngleCount])
+{
+    Texture linear = {};
+    Texture tiled = {};
+    ConvertTextureLayout(texture, TextureLayout::Linear, linear, pool);
+    ConvertTextureLayout(texture, TextureLayout::Tiled, tiled, pool);
+
+    for(uint32_t i = 0; i < TextureBenchmarkAngleCount; ++i) {
+        float const angle = 90.0f * static_cast<float>(i) / static_cast<float>(TextureBenchmarkAngleCount - 1);
+        out[i].linear = BenchmarkTextureSampling(linear, sampler, angle, texels_per_pixel, size, repeats);
+        out[i].tiled = BenchmarkTextureSampling(tiled, sampler, angle, texels_per_pixel, size, repeats);
+    }
+}
+
+// Level 0 of `compressed` decoded and compared with level 0 of `reference`
+static float GetCompressionRmsError(Texture const & reference, Texture const & compressed) {
+    TextureMip const & ref_mip = reference.mips[0];
+    TextureMip const & mip = compressed.mips[0];
+    uint32_t const block_words = GetTextureFormatBlockBytes(compressed.format) / 4;
+    uint32_t const blocks_y = (mip.height + TextureBlockSize - 1) / TextureBlockSize;
+    double error = 0.0;
+    for(uint32_t by = 0; by < blocks_y; ++by) {
+        for(uint32_t bx = 0; bx < mip.tiles_x; ++bx) {
+            uint32_t decoded[16];
+            DecodeTextureBlock(compressed.format, compressed.texels.data() + mip.offset + (by * mip.tiles_x + bx) * block_words, decoded);
+            for(uint32_t i = 0; i < 16; ++i) {
+                uint32_t const x = bx * TextureBlockSize + (i % TextureBlockSize);
+                uint32_t const y = by * TextureBlockSize + (i / TextureBlockSize);
+                if(x >= mip.width || y >= mip.height) {
+                    continue;
+                }
+                uint32_t const ref = reference.texels[GetTexelIndex(reference.layout, ref_mip, x, y)];
+                for(uint32_t c = 0; c < 4; ++c) {
+                    double const d = static_cast<double>((decoded[i] >> (8 * c)) & 0xFF) - static_cast<double>((ref >> (8 * c)) & 0xFF);
+                    error += d * d;
+                }
+            }
+        }
+    }
+    return static_cast<float>(std::sqrt(error / (4.0 * mip.width * mip.height)));
+}
+
+void BenchmarkTextureFormats(
+    Texture const & texture,
+    TextureSampler const & sampler,
+    float angle_degrees,
+    float texels_per_pixel,
+    uint32_t size,
+    uint32_t repeats,
+    ThreadPool * pool,
+    TextureFormatBenchmark out[TextureBenchmarkFormatCount])
+{
+    ASSERT(TextureFormat::RGBA8 == texture.format);
+    static constexpr TextureFormat Formats[TextureBenchmarkFormatCount] = {
+        TextureFormat::RGBA8, TextureFormat::BC1, TextureFormat::BC3, TextureFormat::BC7,
+    };
+    for(uint32_t i = 0; i < TextureBenchmarkFormatCount; ++i) {
+        TextureFormatBenchmark & bench = out[i];
+        bench = {};
+        bench.format = Formats[i];
+        if(TextureFormat::RGBA8 == Formats[i]) {
+            bench.bytes = texture.texels.size() * sizeof(uint32_t);
+            bench.result = BenchmarkTextureSampling(texture, sampler, angle_degrees, texels_per_pixel, size, repeats);
+            continue;
+        }
+        Texture compressed = {};
+        auto const start = std::chrono::high_resolution_clock::now();
+        CompressTexture(texture, Formats[i], compressed, pool);
+        auto const end = std::chrono::high_resolution_clock::now();
+        bench.compress_ms = std::chrono::duration<float, std::milli>(end - start).count();
+        bench.bytes = compressed.texels.size() * sizeof(uint32_t);
+        bench.rms_error = GetCompressionRmsError(texture, compressed);
+        bench.result = BenchmarkTextureSampling(compressed, sampler, angle_degrees, texels_per_pixel, size, repeats);
+    }
+}
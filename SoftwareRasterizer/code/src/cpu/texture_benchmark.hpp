@@ -0,0 +1,72 @@
+#pragma once
+
+#include "texture.hpp"
+
+// Micro benchmarks of the CPU texture sampler.
+//
+// A pass samples a `size` x `size` pixel quad with SampleTextureGrad in TileRasterizer::TileSize tiles, pixel by
+// pixel in scanline order within a tile like the fragment stage walks them. The quad is mapped onto the texture
+// rotated by an angle around its center and scaled to `texels_per_pixel`, so the derivatives are constant and every
+// pass hits a fixed mip level pair. At 0 degrees consecutive pixels walk along texel rows, at 90 degrees down texel
+// columns. Passes run on the calling thread: the point is how well one core's caches are used, not throughput.
+//
+// The format benchmark puts the same texture in RGBA8 and every block compressed format: compressed texels are a
+// fraction of the memory traffic but every block touched first has to be decoded into the sampler's cache.
+
+// Angles of BenchmarkTextureLayouts, 0 to 90 degrees
+constexpr uint32_t TextureBenchmarkAngleCount = 7;
+// Formats of BenchmarkTextureFormats: RGBA8, BC1, BC3, BC7
+constexpr uint32_t TextureBenchmarkFormatCount = 4;
+
+struct TextureBenchmarkResult {
+    float   angle_degrees;
+    float   ms;                 // best of the repeats
+    float   samples_per_us;
+    float   checksum;           // sum of the samples, keeps the work observable and compares layouts
+    float   block_hit_rate;     // decoded block cache of compressed formats, 0 otherwise
+};
+
+struct TextureLayoutBenchmark {
+    TextureBenchmarkResult  linear;
+    TextureBenchmarkResult  tiled;
+};
+
+struct TextureFormatBenchmark {
+    TextureFormat           format;
+    uint64_t                bytes;          // texels of every level
+    float                   compress_ms;    // 0 for RGBA8
+    float                   rms_error;      // of level 0 against the RGBA8 texels, in 8 bit steps
+    TextureBenchmarkResult  result;
+};
+
+// One timed configuration, best of `repeats` passes
+TextureBenchmarkResult BenchmarkTextureSampling(
+    Texture const & texture,
+    TextureSampler const & sampler,
+    float angle_degrees,
+    float texels_per_pixel,
+    uint32_t size,
+    uint32_t repeats);
+
+// `texture` converted to both layouts and sampled at every angle of TextureBenchmarkAngleCount. `pool` (can be
+// nullptr) is only used for the conversion.
+void BenchmarkTextureLayouts(
+    Texture const & texture,
+    TextureSampler const & sampler,
+    float texels_per_pixel,
+    uint32_t size,
+    uint32_t repeats,
+    ThreadPool * pool,
+    TextureLayoutBenchmark out[TextureBenchmarkAngleCount]);
+
+// `texture` (RGBA8) compressed to every format and sampled at `angle_degrees`. `pool` (can be nullptr) is only
+// used for the compression.
+void BenchmarkTextureFormats(
+    Texture const & texture,
+    TextureSampler const & sampler,
+    float angle_degrees,
+    float texels_per_pixel,
+    uint32_t size,
+    uint32_t repeats,
+    ThreadPool * pool,
+    TextureFormatBenchmark out[TextureBenchmarkFormatCount]);
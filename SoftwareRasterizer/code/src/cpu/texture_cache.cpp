@@ -0,0 +1,332 @@
+#include "texture_cache.hpp"
+#include "texture_compression.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <thread>
+
+using CacheClock = std::chrono::steady_clock;
+
+// Texels copied (and hashed) per step when reading an entry, small enough to stay in L2 between the two
+static constexpr size_t TextureCacheCopyBytes = 64 * 1024;
+
+static uint64_t HashFnv(void const * data, size_t size, uint64_t hash) {
+    uint8_t const * bytes = static_cast<uint8_t const *>(data);
+    for(size_t i = 0; i < size; ++i) {
+        hash = (hash ^ bytes[i]) * 0x100000001B3ull;
+    }
+    return hash;
+}
+
+static constexpr uint64_t HashFnvSeed = 0xCBF29CE484222325ull;
+
+// Hash of the texels, 4 independent lanes of 8 bytes so it keeps up with the copy. Update takes multiples of
+// 32 bytes except for the last call.
+struct ContentHasher {
+    uint64_t lanes[4];
+
+    explicit ContentHasher(uint64_t seed) {
+        for(uint32_t i = 0; i < 4; ++i) {
+            lanes[i] = seed + i;
+        }
+    }
+
+    void Update(uint8_t const * data, size_t size) {
+        size_t i = 0;
+        for(; i + 32 <= size; i += 32) {
+            for(uint32_t l = 0; l < 4; ++l) {
+                uint64_t word;
+                memcpy(&word, data + i + l * 8, 8);
+                uint64_t h = (lanes[l] ^ word) * 0x9E3779B97F4A7C15ull;
+                lanes[l] = h ^ (h >> 29);
+            }
+        }
+        lanes[0] = HashFnv(data + i, size - i, lanes[0]);
+    }
+
+    uint64_t Finish() const {
+        return HashFnv(lanes, sizeof(lanes), HashFnvSeed);
+    }
+};
+
+static uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// Key of `path` built with `options`: the source's absolute path, mtime and size. Returns false when the source
+// doesn't exist.
+static bool MakeKey(char const * path, TextureBuildOptions const & options, TextureCacheHeader & key, std::string & source_path) {
+    std::error_code error;
+    std::filesystem::path const absolute_path = std::filesystem::absolute(path, error).lexically_normal();
+    if(error) {
+        return false;
+    }
+    auto const mtime = std::filesystem::last_write_time(absolute_path, error);
+    if(error) {
+        return false;
+    }
+    uintmax_t const size = std::filesystem::file_size(absolute_path, error);
+    if(error) {
+        return false;
+    }
+    source_path = absolute_path.generic_string();
+
+    key = {};
+    key.source_mtime = static_cast<int64_t>(mtime.time_since_epoch().count());
+    key.source_size = static_cast<uint64_t>(size);
+    key.color_space = static_cast<uint8_t>(options.color_space);
+    key.edge = static_cast<uint8_t>(options.edge);
+    key.layout = static_cast<uint8_t>(options.layout);
+    key.format = static_cast<uint8_t>(options.format);
+    key.mips = (options.mips) ? 1 : 0;
+
+    uint64_t hash = HashFnv(&TextureCacheVersion, sizeof(TextureCacheVersion), HashFnvSeed);
+    hash = HashFnv(&key.source_mtime, sizeof(key.source_mtime), hash);
+    hash = HashFnv(&key.source_size, sizeof(key.source_size), hash);
+    uint8_t const option_bytes[5] = { key.color_space, key.edge, key.layout, key.format, key.mips };
+    hash = HashFnv(option_bytes, sizeof(option_bytes), hash);
+    hash = HashFnv(source_path.data(), source_path.size(), hash);
+    key.key = hash;
+    return true;
+}
+
+// Texels (32 bit words, blocks for the compressed formats) `mip` takes in `layout` / `format`, 0 when its tiles_x
+// isn't the one the layout / format gives it.
+static uint64_t GetMipTexelCount(TextureLayout layout, TextureFormat format, TextureMip const & mip) {
+    if(TextureFormat::RGBA8 != format) {
+        uint32_t const blocks_x = (mip.width + TextureBlockSize - 1) / TextureBlockSize;
+        uint32_t const blocks_y = (mip.height + TextureBlockSize - 1) / TextureBlockSize;
+        return (blocks_x == mip.tiles_x) ? uint64_t(blocks_x) * blocks_y * (GetTextureFormatBlockBytes(format) / 4) : 0;
+    }
+    if(TextureLayout::Tiled == layout) {
+        uint32_t const tiles_x = (mip.width + TextureTileSize - 1) >> TextureTileShift;
+        uint32_t const tiles_y = (mip.height + TextureTileSize - 1) >> TextureTileShift;
+        return (tiles_x == mip.tiles_x) ? (uint64_t(tiles_x) * tiles_y) << (2 * TextureTileShift) : 0;
+    }
+    return (0 == mip.tiles_x) ? uint64_t(mip.width) * mip.height : 0;
+}
+
+static bool IsSameKey(TextureCacheHeader const & a, TextureCacheHeader const & b) {
+    return a.key == b.key && a.source_mtime == b.source_mtime && a.source_size == b.source_size &&
+        a.color_space == b.color_space && a.edge == b.edge && a.layout == b.layout && a.format == b.format && a.mips == b.mips;
+}
+
+bool TextureCache::Init(char const * cache_directory) {
+    std::error_code error;
+    std::filesystem::create_directories(cache_directory, error);
+    if(error) {
+        ::printf("TextureCache::Init: can't create %s\n", cache_directory);
+        return false;
+    }
+    directory = cache_directory;
+    ResetStats();
+    return true;
+}
+
+void TextureCache::Exit() {
+    directory.clear();
+}
+
+std::string TextureCache::GetEntryPath(char const * path, TextureBuildOptions const & options) const {
+    TextureCacheHeader key = {};
+    std::string source_path;
+    if(false == MakeKey(path, options, key, source_path)) {
+        return std::string();
+    }
+    return GetEntryPath(key);
+}
+
+std::string TextureCache::GetEntryPath(TextureCacheHeader const & key) const {
+    char name[32] = {};
+    ::snprintf(name, sizeof(name), "%016llx.rtex", static_cast<unsigned long long>(key.key));
+    return (std::filesystem::path(directory) / name).string();
+}
+
+bool TextureCache::Load(char const * path, TextureBuildOptions const & options, Texture & out, ThreadPool * pool) {
+    ASSERT(false == directory.empty());
+    auto const start = CacheClock::now();
+
+    // The key is taken before the source is read: a source changing during the load leaves an entry that
+    // doesn't match it anymore rather than a stale one that does
+    TextureCacheHeader key = {};
+    std::string source_path;
+    bool const has_key = MakeKey(path, options, key, source_path);
+    std::string entry_path;
+    if(has_key) {
+        entry_path = GetEntryPath(key);
+        std::error_code error;
+        if(std::filesystem::exists(entry_path, error)) {
+            if(Read(entry_path.c_str(), key, source_path, out)) {
+                hits.fetch_add(1, std::memory_order_relaxed);
+                auto const us = std::chrono::duration_cast<std::chrono::microseconds>(CacheClock::now() - start).count();
+                hit_us.fetch_add(static_cast<uint64_t>(us), std::memory_order_relaxed);
+                return true;
+            }
+            invalid.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    misses.fetch_add(1, std::memory_order_relaxed);
+    bool const loaded = LoadTexture(path, options, out, pool);
+    if(loaded && has_key && Write(entry_path.c_str(), key, source_path, out)) {
+        writes.fetch_add(1, std::memory_order_relaxed);
+    }
+    auto const us = std::chrono::duration_cast<std::chrono::microseconds>(CacheClock::now() - start).count();
+    miss_us.fetch_add(static_cast<uint64_t>(us), std::memory_order_relaxed);
+    return loaded;
+}
+
+bool TextureCache::Read(char const * entry_path, TextureCacheHeader const & key, std::string const & source_path, Texture & out) {
+    MappedFile file;
+    if(false == file.Open(entry_path)) {
+        return false;
+    }
+    uint8_t const * const data = file.GetData();
+    uint64_t const size = file.GetSize();
+    if(size < sizeof(TextureCacheHeader)) {
+        ::printf("TextureCache::Read: %s is too small for a cache entry\n", entry_path);
+        return false;
+    }
+    TextureCacheHeader const & header = *reinterpret_cast<TextureCacheHeader const *>(data);
+    if(TextureCacheMagic != header.magic || TextureCacheVersion != header.version || header.file_size != size) {
+        ::printf("TextureCache::Read: %s is not a cache entry of this version\n", entry_path);
+        return false;
+    }
+    if(false == IsSameKey(header, key) || header.path_length != source_path.size() ||
+        sizeof(TextureCacheHeader) + header.path_length > size ||
+        0 != memcmp(data + sizeof(TextureCacheHeader), source_path.data(), source_path.size())) {
+        // Another source (or version of it) hashed to the same entry, it gets replaced
+        return false;
+    }
+
+    uint64_t const mips_bytes = uint64_t(header.mip_count) * sizeof(TextureMip);
+    bool const valid_size = header.width > 0 && header.height > 0 && header.width <= TextureMaxSize && header.height <= TextureMaxSize &&
+        header.mip_count > 0 && header.mip_count <= GetTextureMipCount(header.width, header.height) &&
+        header.texture_layout <= static_cast<uint8_t>(TextureLayout::Tiled) && header.texture_format <= static_cast<uint8_t>(TextureFormat::BC7);
+    bool const in_file = header.mips_offset <= size && mips_bytes <= size - header.mips_offset &&
+        // Compared in texels, a corrupted texel_count would wrap around as a byte count
+        header.texels_offset <= size && header.texel_count <= (size - header.texels_offset) / sizeof(uint32_t) &&
+        0 == header.mips_offset % alignof(TextureMip) && 0 == header.texels_offset % TextureCacheAlignment;
+    if(!valid_size || !in_file) {
+        ::printf("TextureCache::Read: %s is corrupted\n", entry_path);
+        return false;
+    }
+    uint64_t const texels_bytes = header.texel_count * sizeof(uint32_t);
+    TextureMip const * const mips = reinterpret_cast<TextureMip const *>(data + header.mips_offset);
+    for(uint32_t m = 0; m < header.mip_count; ++m) {
+        // The whole level within the texels, the sampler reads it without bounds checks
+        uint64_t const mip_texel_count = GetMipTexelCount(static_cast<TextureLayout>(header.texture_layout), static_cast<TextureFormat>(header.texture_format), mips[m]);
+        if(mips[m].width != std::max(1u, header.width >> m) || mips[m].height != std::max(1u, header.height >> m) ||
+            0 == mip_texel_count || mips[m].offset > header.texel_count || mip_texel_count > header.texel_count - mips[m].offset) {
+            ::printf("TextureCache::Read: %s is corrupted\n", entry_path);
+            return false;
+        }
+    }
+
+    // Copied out in steps and hashed while the step is still in cache
+    out = Texture();
+    out.texels.resize(static_cast<size_t>(header.texel_count));
+    ContentHasher hasher(HashFnv(mips, static_cast<size_t>(mips_bytes), HashFnvSeed));
+    uint8_t const * const src = data + header.texels_offset;
+    uint8_t * const dst = reinterpret_cast<uint8_t *>(out.texels.data());
+    for(uint64_t offset = 0; offset < texels_bytes; offset += TextureCacheCopyBytes) {
+        size_t const bytes = static_cast<size_t>(std::min<uint64_t>(TextureCacheCopyBytes, texels_bytes - offset));
+        memcpy(dst + offset, src + offset, bytes);
+        hasher.Update(dst + offset, bytes);
+    }
+    if(hasher.Finish() != header.content_hash) {
+        ::printf("TextureCache::Read: %s is corrupted (content hash)\n", entry_path);
+        out = Texture();
+        return false;
+    }
+
+    out.width = header.width;
+    out.height = header.height;
+    out.color_space = static_cast<TextureColorSpace>(header.color_space);
+    out.layout = static_cast<TextureLayout>(header.texture_layout);
+    out.format = static_cast<TextureFormat>(header.texture_format);
+    out.serial = NewTextureSerial();
+    out.mips.assign(mips, mips + header.mip_count);
+    bytes_read.fetch_add(size, std::memory_order_relaxed);
+    return true;
+}
+
+bool TextureCache::Write(char const * entry_path, TextureCacheHeader const & key, std::string const & source_path, Texture const & texture) {
+    TextureCacheHeader header = key;
+    header.magic = TextureCacheMagic;
+    header.version = TextureCacheVersion;
+    header.texture_layout = static_cast<uint8_t>(texture.layout);
+    header.texture_format = static_cast<uint8_t>(texture.format);
+    header.width = texture.width;
+    header.height = texture.height;
+    header.mip_count = static_cast<uint32_t>(texture.mips.size());
+    header.path_length = static_cast<uint32_t>(source_path.size());
+    header.mips_offset = AlignUp(sizeof(TextureCacheHeader) + header.path_length, alignof(TextureMip));
+    header.texels_offset = AlignUp(header.mips_offset + sizeof(TextureMip) * texture.mips.size(), TextureCacheAlignment);
+    header.texel_count = texture.texels.size();
+    header.file_size = header.texels_offset + header.texel_count * sizeof(uint32_t);
+
+    size_t const mips_bytes = sizeof(TextureMip) * texture.mips.size();
+    size_t const texels_bytes = sizeof(uint32_t) * texture.texels.size();
+    ContentHasher hasher(HashFnv(texture.mips.data(), mips_bytes, HashFnvSeed));
+    for(size_t offset = 0; offset < texels_bytes; offset += TextureCacheCopyBytes) {
+        hasher.Update(reinterpret_cast<uint8_t const *>(texture.texels.data()) + offset, std::min(TextureCacheCopyBytes, texels_bytes - offset));
+    }
+    header.content_hash = hasher.Finish();
+
+    // Written next to the entry and renamed over it, readers see the old entry or the whole new one
+    char suffix[48] = {};
+    ::snprintf(suffix, sizeof(suffix), ".%016llx.tmp", static_cast<unsigned long long>(std::hash<std::thread::id>()(std::this_thread::get_id())));
+    std::string const temp_path = std::string(entry_path) + suffix;
+    FILE * file = ::fopen(temp_path.c_str(), "wb");
+    if(nullptr == file) {
+        ::printf("TextureCache::Write: can't open %s for writing\n", temp_path.c_str());
+        return false;
+    }
+    static constexpr uint8_t padding[TextureCacheAlignment] = {};
+    bool ok = 1 == ::fwrite(&header, sizeof(header), 1, file);
+    ok = ok && (0 == source_path.size() || 1 == ::fwrite(source_path.data(), source_path.size(), 1, file));
+    size_t pad = static_cast<size_t>(header.mips_offset - sizeof(TextureCacheHeader) - header.path_length);
+    ok = ok && (0 == pad || 1 == ::fwrite(padding, pad, 1, file));
+    ok = ok && (0 == mips_bytes || 1 == ::fwrite(texture.mips.data(), mips_bytes, 1, file));
+    pad = static_cast<size_t>(header.texels_offset - header.mips_offset - mips_bytes);
+    ok = ok && (0 == pad || 1 == ::fwrite(padding, pad, 1, file));
+    ok = ok && (0 == texels_bytes || 1 == ::fwrite(texture.texels.data(), texels_bytes, 1, file));
+    ok = (0 == ::fclose(file)) && ok;
+
+    std::error_code error;
+    if(ok) {
+        std::filesystem::rename(temp_path, entry_path, error);
+        ok = !error;
+    }
+    if(!ok) {
+        ::printf("TextureCache::Write: writing %s failed\n", entry_path);
+        std::filesystem::remove(temp_path, error);
+    }
+    return ok;
+}
+
+TextureCacheStats TextureCache::GetStats() const {
+    TextureCacheStats stats = {};
+    stats.hits = hits.load(std::memory_order_relaxed);
+    stats.misses = misses.load(std::memory_order_relaxed);
+    stats.invalid = invalid.load(std::memory_order_relaxed);
+    stats.writes = writes.load(std::memory_order_relaxed);
+    stats.bytes_read = bytes_read.load(std::memory_order_relaxed);
+    stats.hit_ms = static_cast<float>(hit_us.load(std::memory_order_relaxed)) / 1000.0f;
+    stats.miss_ms = static_cast<float>(miss_us.load(std::memory_order_relaxed)) / 1000.0f;
+    return stats;
+}
+
+void TextureCache::ResetStats() {
+    hits = 0;
+    misses = 0;
+    invalid = 0;
+    writes = 0;
+    bytes_read = 0;
+    hit_us = 0;
+    miss_us = 0;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "mapped_file.hpp"
+#include "texture.hpp"
+
+#include <atomic>
+#include <string>
+
+// On disk cache of built Textures, so a warm start maps a file instead of decoding (inflate + unfilter) the image,
+// building its mip chain and swizzling / compressing it again.
+//
+// An entry is keyed by the source path, its modification time and size, and the TextureBuildOptions: the 64 bit
+// hash of those names the entry file in the cache directory, and the key itself is stored in the entry and
+// compared on load, so a changed source or different options never read a stale entry. The payload (mip table +
+// texels) carries a hash of its content that is checked while it's copied out of the mapping, which catches
+// truncated or corrupted entries; those are counted as misses and rebuilt.
+//
+// Layout (little endian, in the style of the mesh files):
+//   TextureCacheHeader
+//   source path (path_length bytes, no terminator)
+//   TextureMip[mip_count]
+//   texels (texel_count uint32_t), starting at a multiple of TextureCacheAlignment
+// Entries are written to a temporary file and renamed into place, so concurrent loads of the same texture (e.g. by
+// the AssetLoader workers) never see a partial entry.
+constexpr uint32_t TextureCacheMagic = 0x58455452; // "RTEX"
+constexpr uint32_t TextureCacheVersion = 1;
+constexpr uint32_t TextureCacheAlignment = 64;
+
+struct TextureCacheHeader {
+    uint32_t    magic;
+    uint32_t    version;
+    uint64_t    file_size;
+    uint64_t    key;                // hash of the fields below up to mip_count and of the source path
+    int64_t     source_mtime;       // std::filesystem::file_time_type ticks
+    uint64_t    source_size;
+    uint8_t     color_space;        // TextureBuildOptions
+    uint8_t     edge;
+    uint8_t     layout;
+    uint8_t     format;
+    uint8_t     mips;
+    uint8_t     texture_layout;     // Texture, what the options built
+    uint8_t     texture_format;
+    uint8_t     reserved;
+    uint32_t    width;
+    uint32_t    height;
+    uint32_t    mip_count;
+    uint32_t    path_length;
+    uint64_t    mips_offset;
+    uint64_t    texels_offset;
+    uint64_t    texel_count;
+    uint64_t    content_hash;       // of the mip table and the texels
+};
+
+struct TextureCacheStats {
+    uint64_t    hits;
+    uint64_t    misses;             // built from the source, invalid included
+    uint64_t    invalid;            // entries found but stale or corrupted
+    uint64_t    writes;             // entries written
+    uint64_t    bytes_read;         // from hits
+    float       hit_ms;             // total time spent in hits
+    float       miss_ms;            // total time spent in misses, decode and write included
+};
+
+class TextureCache {
+public:
+    // Entries are read from and written to `directory`, created when missing. Returns false when it can't be.
+    bool Init(char const * directory);
+    void Exit();
+
+    // LoadTexture through the cache: a valid entry is copied out of its mapping, otherwise the texture is loaded
+    // from `path`, built with `options` and written as a new entry. Thread safe. `pool` is used for misses and can
+    // be nullptr.
+    bool Load(char const * path, TextureBuildOptions const & options, Texture & out, ThreadPool * pool);
+
+    // Entry file of (path, options) for the source as it is now, empty when the source doesn't exist
+    std::string GetEntryPath(char const * path, TextureBuildOptions const & options) const;
+
+    TextureCacheStats GetStats() const;
+    void ResetStats();
+
+private:
+    std::string GetEntryPath(TextureCacheHeader const & key) const;
+    bool Read(char const * entry_path, TextureCacheHeader const & key, std::string const & source_path, Texture & out);
+    bool Write(char const * entry_path, TextureCacheHeader const & key, std::string const & source_path, Texture const & texture);
+
+    std::string             directory;
+
+    std::atomic<uint64_t>   hits = 0;
+    std::atomic<uint64_t>   misses = 0;
+    std::atomic<uint64_t>   invalid = 0;
+    std::atomic<uint64_t>   writes = 0;
+    std::atomic<uint64_t>   bytes_read = 0;
+    std::atomic<uint64_t>   hit_us = 0;
+    std::atomic<uint64_t>   miss_us = 0;
+};
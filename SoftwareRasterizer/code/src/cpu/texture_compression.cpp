@@ -0,0 +1,782 @@
+#include "texture_compression.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Blocks per job while compressing
+static constexpr uint32_t CompressBlocksPerJob = 256;
+
+uint32_t GetTextureFormatBlockBytes(TextureFormat format) {
+    switch(format) {
+        case TextureFormat::BC1: return 8;
+        case TextureFormat::BC3: return 16;
+        case TextureFormat::BC7: return 16;
+        default: return 0;
+    }
+}
+
+static uint32_t PackTexel(uint32_t r, uint32_t g, uint32_t b, uint32_t a) {
+    return r | (g << 8) | (b << 16) | (a << 24);
+}
+
+static uint32_t GetChannel(uint32_t texel, uint32_t c) {
+    return (texel >> (8 * c)) & 0xFF;
+}
+
+static uint16_t LoadU16(uint8_t const * p) {
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+static uint32_t LoadU32(uint8_t const * p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) | (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+static uint64_t LoadU64(uint8_t const * p) {
+    return static_cast<uint64_t>(LoadU32(p)) | (static_cast<uint64_t>(LoadU32(p + 4)) << 32);
+}
+
+static void StoreU16(uint8_t * p, uint32_t v) {
+    p[0] = static_cast<uint8_t>(v);
+    p[1] = static_cast<uint8_t>(v >> 8);
+}
+
+static void StoreU64(uint8_t * p, uint64_t v) {
+    for(uint32_t i = 0; i < 8; ++i) {
+        p[i] = static_cast<uint8_t>(v >> (8 * i));
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// BC1 / BC3
+
+static void Expand565(uint32_t c, uint32_t rgb[3]) {
+    uint32_t const r = (c >> 11) & 31;
+    uint32_t const g = (c >> 5) & 63;
+    uint32_t const b = c & 31;
+    rgb[0] = (r << 3) | (r >> 2);
+    rgb[1] = (g << 2) | (g >> 4);
+    rgb[2] = (b << 3) | (b >> 2);
+}
+
+// Palette of a BC1 color block. `four_colors` forces the 4 color mode, as BC2/BC3 do.
+static void GetColorPalette(uint32_t c0, uint32_t c1, bool four_colors, uint32_t palette[4]) {
+    uint32_t e0[3], e1[3];
+    Expand565(c0, e0);
+    Expand565(c1, e1);
+    palette[0] = PackTexel(e0[0], e0[1], e0[2], 255);
+    palette[1] = PackTexel(e1[0], e1[1], e1[2], 255);
+    if(four_colors || c0 > c1) {
+        palette[2] = PackTexel((2 * e0[0] + e1[0] + 1) / 3, (2 * e0[1] + e1[1] + 1) / 3, (2 * e0[2] + e1[2] + 1) / 3, 255);
+        palette[3] = PackTexel((e0[0] + 2 * e1[0] + 1) / 3, (e0[1] + 2 * e1[1] + 1) / 3, (e0[2] + 2 * e1[2] + 1) / 3, 255);
+    } else {
+        palette[2] = PackTexel((e0[0] + e1[0] + 1) / 2, (e0[1] + e1[1] + 1) / 2, (e0[2] + e1[2] + 1) / 2, 255);
+        palette[3] = 0;
+    }
+}
+
+static void DecodeColorBlock(uint8_t const * block, bool four_colors, uint32_t out[16]) {
+    uint32_t palette[4];
+    GetColorPalette(LoadU16(block), LoadU16(block + 2), four_colors, palette);
+    uint32_t const indices = LoadU32(block + 4);
+    for(uint32_t i = 0; i < 16; ++i) {
+        out[i] = palette[(indices >> (2 * i)) & 3];
+    }
+}
+
+static void GetAlphaPalette(uint32_t a0, uint32_t a1, uint32_t palette[8]) {
+    palette[0] = a0;
+    palette[1] = a1;
+    if(a0 > a1) {
+        for(uint32_t i = 1; i < 7; ++i) {
+            palette[i + 1] = ((7 - i) * a0 + i * a1 + 3) / 7;
+        }
+    } else {
+        for(uint32_t i = 1; i < 5; ++i) {
+            palette[i + 1] = ((5 - i) * a0 + i * a1 + 2) / 5;
+        }
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+}
+
+void DecodeBC1Block(void const * block, uint32_t out[16]) {
+    DecodeColorBlock(static_cast<uint8_t const *>(block), false, out);
+}
+
+void DecodeBC3Block(void const * block, uint32_t out[16]) {
+    uint8_t const * bytes = static_cast<uint8_t const *>(block);
+    DecodeColorBlock(bytes + 8, true, out);
+    uint32_t palette[8];
+    GetAlphaPalette(bytes[0], bytes[1], palette);
+    uint64_t const indices = LoadU64(bytes) >> 16;
+    for(uint32_t i = 0; i < 16; ++i) {
+        out[i] = (out[i] & 0x00FFFFFF) | (palette[(indices >> (3 * i)) & 7] << 24);
+    }
+}
+
+static uint32_t To565(float const rgb[3]) {
+    uint32_t const r = static_cast<uint32_t>(std::clamp(rgb[0], 0.0f, 255.0f) * (31.0f / 255.0f) + 0.5f);
+    uint32_t const g = static_cast<uint32_t>(std::clamp(rgb[1], 0.0f, 255.0f) * (63.0f / 255.0f) + 0.5f);
+    uint32_t const b = static_cast<uint32_t>(std::clamp(rgb[2], 0.0f, 255.0f) * (31.0f / 255.0f) + 0.5f);
+    return (r << 11) | (g << 5) | b;
+}
+
+static uint32_t GetColorDistance(uint32_t a, uint32_t b, uint32_t channels) {
+    uint32_t d = 0;
+    for(uint32_t c = 0; c < channels; ++c) {
+        int32_t const delta = static_cast<int32_t>(GetChannel(a, c)) - static_cast<int32_t>(GetChannel(b, c));
+        d += static_cast<uint32_t>(delta * delta);
+    }
+    return d;
+}
+
+// Endpoints along the principal axis of the texels flagged in `used`: the extremes of their projections.
+// `channels` is 3 (RGB) or 4 (RGBA).
+static void FindPrincipalEndpoints(uint32_t const texels[16], bool const used[16], uint32_t channels, float e0[4], float e1[4]) {
+    float mean[4] = {};
+    uint32_t count = 0;
+    for(uint32_t i = 0; i < 16; ++i) {
+        if(used[i]) {
+            for(uint32_t c = 0; c < channels; ++c) {
+                mean[c] += static_cast<float>(GetChannel(texels[i], c));
+            }
+            ++count;
+        }
+    }
+    for(uint32_t c = 0; c < channels; ++c) {
+        mean[c] /= static_cast<float>(std::max(count, 1u));
+    }
+
+    float cov[4][4] = {};
+    for(uint32_t i = 0; i < 16; ++i) {
+        if(used[i]) {
+            float d[4] = {};
+            for(uint32_t c = 0; c < channels; ++c) {
+                d[c] = static_cast<float>(GetChannel(texels[i], c)) - mean[c];
+            }
+            for(uint32_t a = 0; a < channels; ++a) {
+                for(uint32_t b = 0; b < channels; ++b) {
+                    cov[a][b] += d[a] * d[b];
+                }
+            }
+        }
+    }
+
+    // Power iteration
+    float axis[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    for(uint32_t iteration = 0; iteration < 8; ++iteration) {
+        float next[4] = {};
+        float length = 0.0f;
+        for(uint32_t a = 0; a < channels; ++a) {
+            for(uint32_t b = 0; b < channels; ++b) {
+                next[a] += cov[a][b] * axis[b];
+            }
+            length = std::max(length, std::abs(next[a]));
+        }
+        if(length < 1e-6f) {
+            break;
+        }
+        for(uint32_t a = 0; a < channels; ++a) {
+            axis[a] = next[a] / length;
+        }
+    }
+
+    float min_t = INFINITY, max_t = -INFINITY;
+    for(uint32_t i = 0; i < 16; ++i) {
+        if(used[i]) {
+            float t = 0.0f;
+            for(uint32_t c = 0; c < channels; ++c) {
+                t += (static_cast<float>(GetChannel(texels[i], c)) - mean[c]) * axis[c];
+            }
+            min_t = std::min(min_t, t);
+            max_t = std::max(max_t, t);
+        }
+    }
+    float axis_length_sq = 0.0f;
+    for(uint32_t c = 0; c < channels; ++c) {
+        axis_length_sq += axis[c] * axis[c];
+    }
+    float const scale = (axis_length_sq > 0.0f && count > 0) ? 1.0f / axis_length_sq : 0.0f;
+    for(uint32_t c = 0; c < channels; ++c) {
+        e0[c] = mean[c] + axis[c] * max_t * scale;
+        e1[c] = mean[c] + axis[c] * min_t * scale;
+    }
+}
+
+// Least squares endpoints for texels at the given interpolation weights (0 at e0, 1 at e1). Keeps the endpoints
+// when the system is singular (every texel at the same weight).
+static void RefitEndpoints(uint32_t const texels[16], bool const used[16], float const weights[16], uint32_t channels, float e0[4], float e1[4]) {
+    float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+    float ax[4] = {}, bx[4] = {};
+    for(uint32_t i = 0; i < 16; ++i) {
+        if(used[i]) {
+            float const b = weights[i];
+            float const a = 1.0f - b;
+            aa += a * a;
+            ab += a * b;
+            bb += b * b;
+            for(uint32_t c = 0; c < channels; ++c) {
+                float const x = static_cast<float>(GetChannel(texels[i], c));
+                ax[c] += a * x;
+                bx[c] += b * x;
+            }
+        }
+    }
+    float const det = aa * bb - ab * ab;
+    if(std::abs(det) < 1e-3f) {
+        return;
+    }
+    for(uint32_t c = 0; c < channels; ++c) {
+        e0[c] = (ax[c] * bb - bx[c] * ab) / det;
+        e1[c] = (bx[c] * aa - ax[c] * ab) / det;
+    }
+}
+
+// Picks the indices of a color block for the given endpoints, returns the error. Texels not in `opaque` take the
+// transparent index (3 color mode only).
+static uint32_t FitColorIndices(uint32_t const texels[16], bool const opaque[16], uint32_t c0, uint32_t c1, bool four_colors, uint32_t & out_indices) {
+    uint32_t palette[4];
+    GetColorPalette(c0, c1, four_colors, palette);
+    uint32_t const palette_size = (four_colors || c0 > c1) ? 4 : 3;
+    uint32_t error = 0;
+    out_indices = 0;
+    for(uint32_t i = 0; i < 16; ++i) {
+        uint32_t best = 3;
+        if(opaque[i]) {
+            uint32_t best_d = ~0u;
+            for(uint32_t p = 0; p < palette_size; ++p) {
+                uint32_t const d = GetColorDistance(texels[i], palette[p], 3);
+                if(d < best_d) {
+                    best_d = d;
+                    best = p;
+                }
+            }
+            error += best_d;
+        }
+        out_indices |= best << (2 * i);
+    }
+    return error;
+}
+
+// `allow_transparent`: BC1, texels with alpha below 128 become transparent black through the 3 color mode
+static void EncodeColorBlock(uint32_t const texels[16], bool allow_transparent, uint8_t * block) {
+    bool opaque[16];
+    bool any_transparent = false;
+    bool any_opaque = false;
+    for(uint32_t i = 0; i < 16; ++i) {
+        opaque[i] = (false == allow_transparent) || GetChannel(texels[i], 3) >= 128;
+        any_transparent |= !opaque[i];
+        any_opaque |= opaque[i];
+    }
+    if(false == any_opaque) {
+        StoreU16(block, 0);
+        StoreU16(block + 2, 0);
+        std::memset(block + 4, 0xFF, 4);
+        return;
+    }
+
+    float e0[4], e1[4];
+    FindPrincipalEndpoints(texels, opaque, 3, e0, e1);
+
+    // 4 color mode wants c0 > c1, the 3 color one c0 <= c1. Endpoints follow the swap so a refit stays matched.
+    auto order = [&](uint32_t & c0, uint32_t & c1, float a[4], float b[4]) {
+        if(any_transparent ? (c0 > c1) : (c0 < c1)) {
+            std::swap(c0, c1);
+            for(uint32_t c = 0; c < 3; ++c) {
+                std::swap(a[c], b[c]);
+            }
+        }
+    };
+    uint32_t c0 = To565(e0), c1 = To565(e1);
+    order(c0, c1, e0, e1);
+    uint32_t indices = 0;
+    uint32_t error = FitColorIndices(texels, opaque, c0, c1, false == allow_transparent, indices);
+
+    // One least squares refit on the chosen indices
+    if(error > 0) {
+        static constexpr float Weights4[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+        static constexpr float Weights3[4] = { 0.0f, 1.0f, 0.5f, 0.0f };
+        bool const four_colors = (false == allow_transparent) || c0 > c1;
+        float weights[16];
+        for(uint32_t i = 0; i < 16; ++i) {
+            uint32_t const index = (indices >> (2 * i)) & 3;
+            weights[i] = four_colors ? Weights4[index] : Weights3[index];
+        }
+        RefitEndpoints(texels, opaque, weights, 3, e0, e1);
+        uint32_t n0 = To565(e0), n1 = To565(e1);
+        order(n0, n1, e0, e1);
+        uint32_t n_indices = 0;
+        uint32_t const n_error = FitColorIndices(texels, opaque, n0, n1, false == allow_transparent, n_indices);
+        if(n_error < error) {
+            c0 = n0;
+            c1 = n1;
+            indices = n_indices;
+        }
+    }
+
+    StoreU16(block, c0);
+    StoreU16(block + 2, c1);
+    block[4] = static_cast<uint8_t>(indices);
+    block[5] = static_cast<uint8_t>(indices >> 8);
+    block[6] = static_cast<uint8_t>(indices >> 16);
+    block[7] = static_cast<uint8_t>(indices >> 24);
+}
+
+void EncodeBC1Block(uint32_t const texels[16], void * block) {
+    EncodeColorBlock(texels, true, static_cast<uint8_t *>(block));
+}
+
+void EncodeBC3Block(uint32_t const texels[16], void * block) {
+    uint8_t * bytes = static_cast<uint8_t *>(block);
+    uint32_t a0 = 0, a1 = 255;
+    for(uint32_t i = 0; i < 16; ++i) {
+        a0 = std::max(a0, GetChannel(texels[i], 3));
+        a1 = std::min(a1, GetChannel(texels[i], 3));
+    }
+    uint64_t indices = 0;
+    if(a0 > a1) {
+        uint32_t palette[8];
+        GetAlphaPalette(a0, a1, palette);
+        for(uint32_t i = 0; i < 16; ++i) {
+            uint32_t const a = GetChannel(texels[i], 3);
+            uint32_t best = 0, best_d = ~0u;
+            for(uint32_t p = 0; p < 8; ++p) {
+                uint32_t const d = static_cast<uint32_t>(std::abs(static_cast<int32_t>(a) - static_cast<int32_t>(palette[p])));
+                if(d < best_d) {
+                    best_d = d;
+                    best = p;
+                }
+            }
+            indices |= static_cast<uint64_t>(best) << (3 * i);
+        }
+    }
+    StoreU64(bytes, (indices << 16) | (a1 << 8) | a0);
+    EncodeColorBlock(texels, false, bytes + 8);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// BC7
+
+struct BC7ModeInfo {
+    uint8_t     subsets;
+    uint8_t     partition_bits;
+    uint8_t     rotation_bits;
+    uint8_t     index_selection_bits;
+    uint8_t     color_bits;
+    uint8_t     alpha_bits;
+    uint8_t     endpoint_pbits;         // one p-bit per endpoint
+    uint8_t     shared_pbits;           // one p-bit per subset
+    uint8_t     index_bits;
+    uint8_t     index_bits_2;           // second index set (alpha or color, see index selection)
+};
+
+static constexpr BC7ModeInfo BC7Modes[8] = {
+    { 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+    { 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+    { 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+    { 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+    { 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+    { 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+    { 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+    { 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 },
+};
+
+// Subset of every texel for the 2 subset partitions, bit i set: texel i is in subset 1
+static constexpr uint16_t BC7Partitions2[64] = {
+    0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80, 0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+    0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE, 0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+    0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A, 0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+    0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C, 0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22,
+};
+
+// Subset of every texel for the 3 subset partitions, 2 bits per texel, texel 0 in the low bits
+static constexpr uint32_t BC7Partitions3[64] = {
+    0xAA685050, 0x6A5A5040, 0x5A5A4200, 0x5450A0A8, 0xA5A50000, 0xA0A05050, 0x5555A0A0, 0x5A5A5050,
+    0xAA550000, 0xAA555500, 0xAAAA5500, 0x90909090, 0x94949494, 0xA4A4A4A4, 0xA9A59450, 0x2A0A4250,
+    0xA5945040, 0x0A425054, 0xA5A5A500, 0x55A0A0A0, 0xA8A85454, 0x6A6A4040, 0xA4A45000, 0x1A1A0500,
+    0x0050A4A4, 0xAAA59090, 0x14696914, 0x69691400, 0xA08585A0, 0xAA821414, 0x50A4A450, 0x6A5A0200,
+    0xA9A58000, 0x5090A0A8, 0xA8A09050, 0x24242424, 0x00AA5500, 0x24924924, 0x24499224, 0x50A50A50,
+    0x500AA550, 0xAAAA4444, 0x66660000, 0xA5A0A5A0, 0x50A050A0, 0x69286928, 0x44AAAA44, 0x66666600,
+    0xAA444444, 0x54A854A8, 0x95809580, 0x96969600, 0xA85454A8, 0x80959580, 0xAA141414, 0x96960000,
+    0xAAAA1414, 0xA05050A0, 0xA0A5A5A0, 0x96000000, 0x40804080, 0xA9A8A9A8, 0xAAAAAA44, 0x2A4A5254,
+};
+
+// Texel holding the anchor index of subset 1 (2 subsets), subsets 1 and 2 (3 subsets). Subset 0's is texel 0.
+static constexpr uint8_t BC7Anchors2[64] = {
+    15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+    15,  2,  8,  2,  2,  8,  8, 15,  2,  8,  2,  2,  8,  8,  2,  2,
+    15, 15,  6,  8,  2,  8, 15, 15,  2,  8,  2,  2,  2, 15, 15,  6,
+     6,  2,  6,  8, 15, 15,  2,  2, 15, 15, 15, 15, 15,  2,  2, 15,
+};
+static constexpr uint8_t BC7Anchors3a[64] = {
+     3,  3, 15, 15,  8,  3, 15, 15,  8,  8,  6,  6,  6,  5,  3,  3,
+     3,  3,  8, 15,  3,  3,  6, 10,  5,  8,  8,  6,  8,  5, 15, 15,
+     8, 15,  3,  5,  6, 10,  8, 15, 15,  3, 15,  5, 15, 15, 15, 15,
+     3, 15,  5,  5,  5,  8,  5, 10,  5, 10,  8, 13, 15, 12,  3,  3,
+};
+static constexpr uint8_t BC7Anchors3b[64] = {
+    15,  8,  8,  3, 15, 15,  3,  8, 15, 15, 15, 15, 15, 15, 15,  8,
+    15,  8, 15,  3, 15,  8, 15,  8,  3, 15,  6, 10, 15, 15, 10,  8,
+    15,  3, 15, 10, 10,  8,  9, 10,  6, 15,  8, 15,  3,  6,  6,  8,
+    15,  3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,  3, 15, 15,  8,
+};
+
+static constexpr uint8_t BC7Weights2[4] = { 0, 21, 43, 64 };
+static constexpr uint8_t BC7Weights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+static constexpr uint8_t BC7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+static uint8_t const * GetBC7Weights(uint32_t index_bits) {
+    return (2 == index_bits) ? BC7Weights2 : (3 == index_bits) ? BC7Weights3 : BC7Weights4;
+}
+
+static uint32_t InterpolateBC7(uint32_t e0, uint32_t e1, uint32_t weight) {
+    return ((64 - weight) * e0 + weight * e1 + 32) >> 6;
+}
+
+// Reads the 128 bits of a block from the least significant bit up
+struct BC7BitReader {
+    uint64_t    low;
+    uint64_t    high;
+    uint32_t    position = 0;
+
+    uint32_t Read(uint32_t count) {
+        if(0 == count) {
+            return 0;
+        }
+        uint64_t bits;
+        if(position >= 64) {
+            bits = high >> (position - 64);
+        } else if(position + count <= 64) {
+            bits = low >> position;
+        } else {
+            bits = (low >> position) | (high << (64 - position));
+        }
+        position += count;
+        return static_cast<uint32_t>(bits & ((1ull << count) - 1));
+    }
+};
+
+static uint32_t GetBC7Subset(BC7ModeInfo const & info, uint32_t partition, uint32_t texel) {
+    if(2 == info.subsets) {
+        return (BC7Partitions2[partition] >> texel) & 1;
+    }
+    if(3 == info.subsets) {
+        return (BC7Partitions3[partition] >> (2 * texel)) & 3;
+    }
+    return 0;
+}
+
+static bool IsBC7Anchor(BC7ModeInfo const & info, uint32_t partition, uint32_t texel) {
+    if(0 == texel) {
+        return true;
+    }
+    if(2 == info.subsets) {
+        return BC7Anchors2[partition] == texel;
+    }
+    if(3 == info.subsets) {
+        return BC7Anchors3a[partition] == texel || BC7Anchors3b[partition] == texel;
+    }
+    return false;
+}
+
+void DecodeBC7Block(void const * block, uint32_t out[16]) {
+    uint8_t const * bytes = static_cast<uint8_t const *>(block);
+    BC7BitReader reader = { LoadU64(bytes), LoadU64(bytes + 8) };
+
+    uint32_t mode = 0;
+    while(mode < 8 && 0 == reader.Read(1)) {
+        ++mode;
+    }
+    if(mode >= 8) {
+        // Reserved
+        for(uint32_t i = 0; i < 16; ++i) {
+            out[i] = 0;
+        }
+        return;
+    }
+    BC7ModeInfo const & info = BC7Modes[mode];
+    uint32_t const partition = reader.Read(info.partition_bits);
+    uint32_t const rotation = reader.Read(info.rotation_bits);
+    uint32_t const index_selection = reader.Read(info.index_selection_bits);
+
+    // endpoints[subset * 2 + endpoint][channel]
+    uint32_t endpoints[6][4] = {};
+    uint32_t const endpoint_count = 2u * info.subsets;
+    for(uint32_t c = 0; c < 3; ++c) {
+        for(uint32_t e = 0; e < endpoint_count; ++e) {
+            endpoints[e][c] = reader.Read(info.color_bits);
+        }
+    }
+    for(uint32_t e = 0; e < endpoint_count; ++e) {
+        endpoints[e][3] = reader.Read(info.alpha_bits);
+    }
+
+    uint32_t pbits[6] = {};
+    if(0 != info.endpoint_pbits) {
+        for(uint32_t e = 0; e < endpoint_count; ++e) {
+            pbits[e] = reader.Read(1);
+        }
+    } else if(0 != info.shared_pbits) {
+        for(uint32_t s = 0; s < info.subsets; ++s) {
+            pbits[2 * s] = pbits[2 * s + 1] = reader.Read(1);
+        }
+    }
+    bool const has_pbits = 0 != (info.endpoint_pbits | info.shared_pbits);
+
+    // Unquantize to 8 bits: append the p-bit, then repeat the high bits in the low ones
+    for(uint32_t e = 0; e < endpoint_count; ++e) {
+        for(uint32_t c = 0; c < 4; ++c) {
+            uint32_t bits = (c < 3) ? info.color_bits : info.alpha_bits;
+            if(0 == bits) {
+                endpoints[e][c] = 255;
+                continue;
+            }
+            uint32_t value = endpoints[e][c];
+            if(has_pbits) {
+                value = (value << 1) | pbits[e];
+                ++bits;
+            }
+            value <<= (8 - bits);
+            endpoints[e][c] = value | (value >> bits);
+        }
+    }
+
+    uint32_t indices[16] = {};
+    for(uint32_t i = 0; i < 16; ++i) {
+        uint32_t const bits = info.index_bits - (IsBC7Anchor(info, partition, i) ? 1u : 0u);
+        indices[i] = reader.Read(bits);
+    }
+    uint32_t indices_2[16] = {};
+    if(0 != info.index_bits_2) {
+        for(uint32_t i = 0; i < 16; ++i) {
+            indices_2[i] = reader.Read(info.index_bits_2 - ((0 == i) ? 1u : 0u));
+        }
+    }
+
+    uint8_t const * weights = GetBC7Weights(info.index_bits);
+    uint8_t const * weights_2 = GetBC7Weights(info.index_bits_2);
+    for(uint32_t i = 0; i < 16; ++i) {
+        uint32_t const subset = GetBC7Subset(info, partition, i);
+        uint32_t const * e0 = endpoints[2 * subset];
+        uint32_t const * e1 = endpoints[2 * subset + 1];
+        uint32_t color_weight = weights[indices[i]];
+        uint32_t alpha_weight = color_weight;
+        if(0 != info.index_bits_2) {
+            // Index selection 0: the 2 bit indices go to color, the second set to alpha. 1: swapped.
+            color_weight = (0 == index_selection) ? weights[indices[i]] : weights_2[indices_2[i]];
+            alpha_weight = (0 == index_selection) ? weights_2[indices_2[i]] : weights[indices[i]];
+        }
+        uint32_t rgba[4] = {
+            InterpolateBC7(e0[0], e1[0], color_weight),
+            InterpolateBC7(e0[1], e1[1], color_weight),
+            InterpolateBC7(e0[2], e1[2], color_weight),
+            InterpolateBC7(e0[3], e1[3], alpha_weight),
+        };
+        if(0 != rotation) {
+            std::swap(rgba[3], rgba[rotation - 1]);
+        }
+        out[i] = PackTexel(rgba[0], rgba[1], rgba[2], rgba[3]);
+    }
+}
+
+// Writes the bits of a block from the least significant bit up
+struct BC7BitWriter {
+    uint64_t    low = 0;
+    uint64_t    high = 0;
+    uint32_t    position = 0;
+
+    void Write(uint32_t value, uint32_t count) {
+        for(uint32_t i = 0; i < count; ++i, ++position) {
+            uint64_t const bit = (value >> i) & 1;
+            if(position < 64) {
+                low |= bit << position;
+            } else {
+                high |= bit << (position - 64);
+            }
+        }
+    }
+};
+
+// Best 7 bit value + p-bit per endpoint of mode 6, both endpoint channels share the endpoint's p-bit
+static void QuantizeBC7Mode6Endpoint(float const endpoint[4], uint32_t out[4], uint32_t & out_pbit) {
+    float best_error = INFINITY;
+    for(uint32_t p = 0; p < 2; ++p) {
+        uint32_t q[4];
+        float error = 0.0f;
+        for(uint32_t c = 0; c < 4; ++c) {
+            float const target = std::clamp(endpoint[c], 0.0f, 255.0f);
+            q[c] = static_cast<uint32_t>(std::clamp((target - static_cast<float>(p)) * 0.5f + 0.5f, 0.0f, 127.0f));
+            float const d = static_cast<float>((q[c] << 1) | p) - target;
+            error += d * d;
+        }
+        if(error < best_error) {
+            best_error = error;
+            out_pbit = p;
+            for(uint32_t c = 0; c < 4; ++c) {
+                out[c] = q[c];
+            }
+        }
+    }
+}
+
+static uint32_t FitBC7Mode6Indices(uint32_t const texels[16], uint32_t const q0[4], uint32_t p0, uint32_t const q1[4], uint32_t p1, uint32_t indices[16]) {
+    uint32_t palette[16];
+    for(uint32_t w = 0; w < 16; ++w) {
+        uint32_t rgba[4];
+        for(uint32_t c = 0; c < 4; ++c) {
+            rgba[c] = InterpolateBC7((q0[c] << 1) | p0, (q1[c] << 1) | p1, BC7Weights4[w]);
+        }
+        palette[w] = PackTexel(rgba[0], rgba[1], rgba[2], rgba[3]);
+    }
+    uint32_t error = 0;
+    for(uint32_t i = 0; i < 16; ++i) {
+        uint32_t best = 0, best_d = ~0u;
+        for(uint32_t w = 0; w < 16; ++w) {
+            uint32_t const d = GetColorDistance(texels[i], palette[w], 4);
+            if(d < best_d) {
+                best_d = d;
+                best = w;
+            }
+        }
+        indices[i] = best;
+        error += best_d;
+    }
+    return error;
+}
+
+void EncodeBC7Block(uint32_t const texels[16], void * block) {
+    bool used[16];
+    std::fill(used, used + 16, true);
+    float e0[4], e1[4];
+    FindPrincipalEndpoints(texels, used, 4, e0, e1);
+
+    uint32_t q0[4], q1[4], p0 = 0, p1 = 0;
+    QuantizeBC7Mode6Endpoint(e0, q0, p0);
+    QuantizeBC7Mode6Endpoint(e1, q1, p1);
+    uint32_t indices[16];
+    uint32_t error = FitBC7Mode6Indices(texels, q0, p0, q1, p1, indices);
+
+    // One least squares refit on the chosen indices
+    if(error > 0) {
+        float weights[16];
+        for(uint32_t i = 0; i < 16; ++i) {
+            weights[i] = static_cast<float>(BC7Weights4[indices[i]]) / 64.0f;
+        }
+        RefitEndpoints(texels, used, weights, 4, e0, e1);
+        uint32_t n0[4], n1[4], np0 = 0, np1 = 0;
+        QuantizeBC7Mode6Endpoint(e0, n0, np0);
+        QuantizeBC7Mode6Endpoint(e1, n1, np1);
+        uint32_t n_indices[16];
+        uint32_t const n_error = FitBC7Mode6Indices(texels, n0, np0, n1, np1, n_indices);
+        if(n_error < error) {
+            std::copy(n0, n0 + 4, q0);
+            std::copy(n1, n1 + 4, q1);
+            std::copy(n_indices, n_indices + 16, indices);
+            p0 = np0;
+            p1 = np1;
+        }
+    }
+
+    // The anchor (texel 0) index is stored without its high bit, which must be 0
+    if(indices[0] & 8) {
+        std::swap(q0, q1);
+        std::swap(p0, p1);
+        for(uint32_t i = 0; i < 16; ++i) {
+            indices[i] = 15 - indices[i];
+        }
+    }
+
+    BC7BitWriter writer;
+    writer.Write(1 << 6, 7);
+    for(uint32_t c = 0; c < 4; ++c) {
+        writer.Write(q0[c], 7);
+        writer.Write(q1[c], 7);
+    }
+    writer.Write(p0, 1);
+    writer.Write(p1, 1);
+    writer.Write(indices[0], 3);
+    for(uint32_t i = 1; i < 16; ++i) {
+        writer.Write(indices[i], 4);
+    }
+    uint8_t * bytes = static_cast<uint8_t *>(block);
+    StoreU64(bytes, writer.low);
+    StoreU64(bytes + 8, writer.high);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void DecodeTextureBlock(TextureFormat format, void const * block, uint32_t out[16]) {
+    switch(format) {
+        case TextureFormat::BC1: DecodeBC1Block(block, out); break;
+        case TextureFormat::BC3: DecodeBC3Block(block, out); break;
+        case TextureFormat::BC7: DecodeBC7Block(block, out); break;
+        default: ASSERT(false); break;
+    }
+}
+
+static void EncodeTextureBlock(TextureFormat format, uint32_t const texels[16], void * block) {
+    switch(format) {
+        case TextureFormat::BC1: EncodeBC1Block(texels, block); break;
+        case TextureFormat::BC3: EncodeBC3Block(texels, block); break;
+        case TextureFormat::BC7: EncodeBC7Block(texels, block); break;
+        default: ASSERT(false); break;
+    }
+}
+
+void CompressTexture(Texture const & src, TextureFormat format, Texture & out, ThreadPool * pool) {
+    ASSERT(TextureFormat::RGBA8 == src.format);
+    ASSERT(TextureFormat::RGBA8 != format);
+    ASSERT(&src != &out);
+    uint32_t const block_words = GetTextureFormatBlockBytes(format) / 4;
+
+    out.width = src.width;
+    out.height = src.height;
+    out.color_space = src.color_space;
+    out.layout = TextureLayout::Linear;
+    out.format = format;
+    out.serial = NewTextureSerial();
+    out.mips.resize(src.mips.size());
+    uint32_t word_count = 0;
+    for(size_t m = 0; m < src.mips.size(); ++m) {
+        TextureMip & mip = out.mips[m];
+        mip.width = src.mips[m].width;
+        mip.height = src.mips[m].height;
+        mip.offset = word_count;
+        mip.tiles_x = (mip.width + TextureBlockSize - 1) / TextureBlockSize;
+        uint32_t const blocks_y = (mip.height + TextureBlockSize - 1) / TextureBlockSize;
+        word_count += mip.tiles_x * blocks_y * block_words;
+    }
+    out.texels.assign(word_count, 0);
+
+    for(size_t m = 0; m < src.mips.size(); ++m) {
+        TextureMip const & src_mip = src.mips[m];
+        TextureMip const & dst_mip = out.mips[m];
+        uint32_t const blocks_y = (dst_mip.height + TextureBlockSize - 1) / TextureBlockSize;
+        uint32_t const block_count = dst_mip.tiles_x * blocks_y;
+        uint32_t const job_count = (block_count + CompressBlocksPerJob - 1) / CompressBlocksPerJob;
+        auto compress_blocks = [&](uint32_t job, uint32_t) {
+            uint32_t const begin = job * CompressBlocksPerJob;
+            uint32_t const end = std::min(begin + CompressBlocksPerJob, block_count);
+            for(uint32_t b = begin; b < end; ++b) {
+                uint32_t const bx = b % dst_mip.tiles_x;
+                uint32_t const by = b / dst_mip.tiles_x;
+                uint32_t texels[16];
+                for(uint32_t i = 0; i < 16; ++i) {
+                    uint32_t const x = std::min(bx * TextureBlockSize + (i & 3), src_mip.width - 1);
+                    uint32_t const y = std::min(by * TextureBlockSize + (i >> 2), src_mip.height - 1);
+                    texels[i] = src.texels[GetTexelIndex(src.layout, src_mip, x, y)];
+                }
+                EncodeTextureBlock(format, texels, out.texels.data() + dst_mip.offset + b * block_words);
+            }
+        };
+        if(nullptr != pool && job_count > 1) {
+            pool->ParallelFor(job_count, compress_blocks);
+        } else {
+            for(uint32_t job = 0; job < job_count; ++job) {
+                compress_blocks(job, 0);
+            }
+        }
+    }
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "texture.hpp"
+
+// BC1 / BC3 / BC7 block compression of Textures, and the block decoders the sampler runs on demand.
+//
+// A block covers 4x4 texels: 8 bytes for BC1 (RGB, 1 bit alpha), 16 bytes for BC3 (BC1 color + interpolated
+// alpha) and BC7 (RGBA, 8 modes). The decoders take any valid block. The encoders are fast load time ones rather
+// than the best quality:
+//   - BC1 / BC3 color: endpoints on the principal axis of the block's colors, refit once by least squares
+//     (BC1 switches to its 3 color + transparent mode when a texel has alpha below 128)
+//   - BC3 alpha: the block's alpha range with 8 interpolated values
+//   - BC7: mode 6 only (one subset, RGBA endpoints of 7 bits + a p-bit, 4 bit indices), principal axis in RGBA
+// Decoded texels are RGBA8 with R in the low byte, as in Texture::texels.
+
+// Bytes of one block
+uint32_t GetTextureFormatBlockBytes(TextureFormat format);
+
+void DecodeBC1Block(void const * block, uint32_t out[16]);
+void DecodeBC3Block(void const * block, uint32_t out[16]);
+void DecodeBC7Block(void const * block, uint32_t out[16]);
+
+// Decodes a block of `format` (not RGBA8)
+void DecodeTextureBlock(TextureFormat format, void const * block, uint32_t out[16]);
+
+void EncodeBC1Block(uint32_t const texels[16], void * block);
+void EncodeBC3Block(uint32_t const texels[16], void * block);
+void EncodeBC7Block(uint32_t const texels[16], void * block);
+
+// Compressed copy of `src` (RGBA8, any layout) in `format`, every mip level compressed on its own with the
+// texels of partial edge blocks repeated from the level's edge. `pool` can be nullptr.
+void CompressTexture(Texture const & src, TextureFormat format, Texture & out, ThreadPool * pool);
@@ -0,0 +1,89 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(uint32_t thread_count) {
+    if(0 == thread_count) {
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+    workers.reserve(thread_count - 1);
+    for(uint32_t i = 1; i < thread_count; ++i) {
+        workers.emplace_back(&ThreadPool::WorkerMain, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    wake_cv.notify_all();
+    for(std::thread & worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::ParallelFor(uint32_t count, Job const & job) {
+    if(0 == count) {
+        return;
+    }
+
+    if(workers.empty() || 1 == count) {
+        for(uint32_t i = 0; i < count; ++i) {
+            job(i, 0);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        current_job = &job;
+        current_count = count;
+        next_index = 0;
+        finished_count = 0;
+        busy_workers = static_cast<uint32_t>(workers.size());
+        ++generation;
+    }
+    wake_cv.notify_all();
+
+    RunJobs(0);
+
+    // Wait for the other workers to leave the job, `job` is only borrowed for this call.
+    std::unique_lock<std::mutex> lock(mutex);
+    done_cv.wait(lock, [this] { return 0 == busy_workers; });
+    current_job = nullptr;
+    ASSERT(finished_count == count);
+}
+
+void ThreadPool::WorkerMain(uint32_t worker_index) {
+    uint64_t seen_generation = 0;
+    while(true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake_cv.wait(lock, [&] { return quit || generation != seen_generation; });
+            if(quit) {
+                return;
+            }
+            seen_generation = generation;
+        }
+
+        RunJobs(worker_index);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            --busy_workers;
+        }
+        done_cv.notify_one();
+    }
+}
+
+void ThreadPool::RunJobs(uint32_t worker_index) {
+    while(true) {
+        uint32_t index = next_index.fetch_add(1, std::memory_order_relaxed);
+        if(index >= current_count) {
+            break;
+        }
+        (*current_job)(index, worker_index);
+        finished_count.fetch_add(1, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "../base.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// Fixed size pool of worker threads used by the cpu/ pipeline stages.
+// ParallelFor is a blocking fork/join: the calling thread takes part as worker 0,
+// so a pool created with 1 thread runs everything inline on the caller.
+class ThreadPool {
+public:
+    using Job = std::function<void(uint32_t index, uint32_t worker_index)>;
+
+    // thread_count == 0 -> std::thread::hardware_concurrency()
+    explicit ThreadPool(uint32_t thread_count = 0);
+    ~ThreadPool();
+
+    ThreadPool(ThreadPool const &) = delete;
+    ThreadPool & operator=(ThreadPool const &) = delete;
+
+    // Number of threads that may execute a job concurrently (including the caller).
+    uint32_t GetWorkerCount() const { return static_cast<uint32_t>(workers.size()) + 1; }
+
+    // Runs job(index, worker_index) for every index in [0, count) and returns when all of them finished.
+    // Not re-entrant: don't call ParallelFor from inside a job.
+    void ParallelFor(uint32_t count, Job const & job);
+
+private:
+    void WorkerMain(uint32_t worker_index);
+    void RunJobs(uint32_t worker_index);
+
+    std::vector<std::thread>    workers;
+
+    std::mutex                  mutex;
+    std::condition_variable     wake_cv;
+    std::condition_variable     done_cv;
+    uint64_t                    generation = 0;
+    bool                        quit = false;
+
+    // Current ParallelFor
+    Job const *                 current_job = nullptr;
+    uint32_t                    current_count = 0;
+    std::atomic<uint32_t>       next_index = 0;
+    std::atomic<uint32_t>       finished_count = 0;
+    uint32_t                    busy_workers = 0;
+};
@@ -0,0 +1,349 @@
+#include "tile_rasterizer.hpp"
+#include "fragment_packing.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+// Triangles per bin set, small enough that all workers get a share on light meshes.
+static constexpr uint32_t MinTrianglesPerBinSet = 256;
+
+static_assert(TileRasterizer::TileSize % RasterBlockSize == 0, "Tiles have to be made of whole blocks");
+
+// Calls run(first, count) for the runs of `tile` that are contiguous in the buffers of `target`: the whole
+// RasterBlockSize tiles (padding included) when Tiled, rows when Linear. `fragment_order` runs over the fragment
+// buffer, bottom row first when Linear.
+template<typename RunFn>
+static void ForEachTargetRun(RasterTarget const & target, ScreenRect const & tile, bool fragment_order, RunFn const & run) {
+    if(RasterTargetLayout::Tiled == target.layout) {
+        for(int32_t y = tile.min_y; y < tile.max_y; y += RasterBlockSize) {
+            for(int32_t x = tile.min_x; x < tile.max_x; x += RasterBlockSize) {
+                run(GetTiledPixelIndex(target.blocks_x, x, y), static_cast<size_t>(RasterBlockSize * RasterBlockSize));
+            }
+        }
+        return;
+    }
+    size_t const count = static_cast<size_t>(tile.max_x - tile.min_x);
+    for(int32_t y = tile.min_y; y < tile.max_y; ++y) {
+        run(fragment_order ? GetTargetFragmentIndex(target, tile.min_x, y) : GetTargetPixelIndex(target, tile.min_x, y), count);
+    }
+}
+
+void TileRasterizer::Init(uint32_t in_width, uint32_t in_height, ThreadPool * in_pool) {
+    ASSERT(nullptr != in_pool);
+    pool = in_pool;
+    width = in_width;
+    height = in_height;
+    tiles_x = (width + TileSize - 1) / TileSize;
+    tiles_y = (height + TileSize - 1) / TileSize;
+    bin_set_count = pool->GetWorkerCount();
+    SetSimdLevel(GetSimdLevel());
+    bins.clear();
+    bins.resize(bin_set_count * tiles_x * tiles_y);
+
+    blocks_x = (width + RasterBlockSize - 1) / RasterBlockSize;
+    blocks_y = (height + RasterBlockSize - 1) / RasterBlockSize;
+    // Sized for the tiled layout (the larger one) so the layout can change between draws
+    size_t const pixel_count = GetRasterTargetPixelCount(RasterTargetLayout::Tiled, width, height);
+    depth.assign(pixel_count, 1.0f);
+    block_z_min.assign(blocks_x * blocks_y, 1.0f);
+    block_z_max.assign(blocks_x * blocks_y, 1.0f);
+    visibility.assign(pixel_count, GetVisibilityClearValue(clear_values.depth));
+    tile_cleared.assign(tiles_x * tiles_y, 1);
+}
+
+void TileRasterizer::SetSimdLevel(SimdLevel level) {
+    simd_level = std::min(level, GetSimdLevel());
+    rasterize_triangle = GetRasterizeTriangleFn(simd_level);
+}
+
+void TileRasterizer::SetSubpixelBits(uint32_t bits) {
+    subpixel_bits = std::max(1u, std::min(bits, MaxSubpixelBits));
+}
+
+void TileRasterizer::SetClearValues(RasterClearValues const & values) {
+    clear_values = values;
+}
+
+uint32_t TileRasterizer::GetClearedTileCount() const {
+    return static_cast<uint32_t>(std::count(tile_cleared.begin(), tile_cleared.end(), 1));
+}
+
+void TileRasterizer::Exit() {
+    bins.clear();
+    bins.shrink_to_fit();
+    depth.clear();
+    depth.shrink_to_fit();
+    block_z_min.clear();
+    block_z_min.shrink_to_fit();
+    block_z_max.clear();
+    block_z_max.shrink_to_fit();
+    visibility.clear();
+    visibility.shrink_to_fit();
+    tile_cleared.clear();
+    tile_cleared.shrink_to_fit();
+    setups.clear();
+    setups.shrink_to_fit();
+    pool = nullptr;
+}
+
+void TileRasterizer::Draw(
+    OutputVertexAttributes const * vertices,
+    IndexType const * indices,
+    uint32_t index_count,
+    Fragment * fragments)
+{
+    DrawState state = {};
+    state.vertices = vertices;
+    state.indices = indices;
+    state.triangle_count = index_count / 3;
+    state.fragments = fragments;
+    Draw(state);
+}
+
+void TileRasterizer::Draw(
+    OutputVertexAttributes const * vertices,
+    IndexType const * indices,
+    uint32_t index_count,
+    PackedFragment * fragments)
+{
+    DrawState state = {};
+    state.vertices = vertices;
+    state.indices = indices;
+    state.triangle_count = index_count / 3;
+    state.packed_fragments = fragments;
+    Draw(state);
+}
+
+size_t TileRasterizer::GetFragmentCount() const {
+    return GetRasterTargetPixelCount(target_layout, width, height);
+}
+
+void TileRasterizer::ResolveFragments(Fragment const * src, Fragment * dst) const {
+    ResolveFragments(src, dst, sizeof(Fragment));
+}
+
+void TileRasterizer::ResolveFragments(PackedFragment const * src, PackedFragment * dst) const {
+    ResolveFragments(src, dst, sizeof(PackedFragment));
+}
+
+void TileRasterizer::ResolveFragments(void const * src, void * dst, size_t fragment_size) const {
+    ASSERT(nullptr != pool);
+    // One row of tiles per job
+    pool->ParallelFor(tiles_y, [&](uint32_t tile_y, uint32_t) {
+        if(sizeof(Fragment) == fragment_size) {
+            ResolveTileRow(static_cast<Fragment const *>(src), static_cast<Fragment *>(dst), clear_fragment, tile_y);
+        } else {
+            ResolveTileRow(static_cast<PackedFragment const *>(src), static_cast<PackedFragment *>(dst), clear_packed_fragment, tile_y);
+        }
+    });
+}
+
+template<typename FragmentType>
+void TileRasterizer::ResolveTileRow(FragmentType const * src, FragmentType * dst, FragmentType const & clear_value, uint32_t tile_y) const {
+    int32_t const min_y = static_cast<int32_t>(tile_y * TileSize);
+    int32_t const max_y = std::min(min_y + static_cast<int32_t>(TileSize), static_cast<int32_t>(height));
+    for(int32_t y = min_y; y < max_y; ++y) {
+        size_t const row = static_cast<size_t>(height - y - 1) * width;
+        FragmentType * dst_row = &dst[row];
+        for(uint32_t tile_x = 0; tile_x < tiles_x; ++tile_x) {
+            int32_t const min_x = static_cast<int32_t>(tile_x * TileSize);
+            int32_t const max_x = std::min(min_x + static_cast<int32_t>(TileSize), static_cast<int32_t>(width));
+            // Untouched tiles never had their clear written, they resolve straight to the clear value
+            if(0 != tile_cleared[tile_y * tiles_x + tile_x]) {
+                std::fill(&dst_row[min_x], &dst_row[max_x], clear_value);
+                continue;
+            }
+            if(RasterTargetLayout::Linear == target_layout) {
+                memcpy(&dst_row[min_x], &src[row + static_cast<size_t>(min_x)], sizeof(FragmentType) * static_cast<size_t>(max_x - min_x));
+                continue;
+            }
+            for(int32_t x = min_x; x < max_x; x += RasterBlockSize) {
+                size_t const count = static_cast<size_t>(std::min(RasterBlockSize, max_x - x));
+                memcpy(&dst_row[x], &src[GetTiledPixelIndex(blocks_x, x, y)], sizeof(FragmentType) * count);
+            }
+        }
+    }
+}
+
+void TileRasterizer::Draw(DrawState & state) {
+    ASSERT(nullptr != pool);
+    if(setups.size() < state.triangle_count) {
+        setups.resize(state.triangle_count);
+    }
+
+    // Clear values of this Draw, ResolveFragments of its output uses the same ones
+    clear_fragment = {};
+    memcpy(clear_fragment.col, clear_values.color, sizeof(clear_fragment.col));
+    clear_packed_fragment = PackFragment(clear_fragment);
+    visibility_clear_value = GetVisibilityClearValue(clear_values.depth);
+
+    // 1. Setup + Binning, one contiguous range of triangles per bin set.
+    state.used_bin_sets = std::max(1u, std::min(bin_set_count, state.triangle_count / MinTrianglesPerBinSet));
+    pool->ParallelFor(bin_set_count, [&](uint32_t bin_set, uint32_t) {
+        BinTriangles(state, bin_set);
+    });
+
+    // 2. Rasterization, one tile per job.
+    pool->ParallelFor(tiles_x * tiles_y, [&](uint32_t tile_index, uint32_t) {
+        RasterizeTile(state, tile_index);
+    });
+}
+
+void TileRasterizer::BinTriangles(DrawState const & state, uint32_t bin_set) {
+    uint32_t const tile_count = tiles_x * tiles_y;
+    std::vector<uint32_t> * set_bins = &bins[bin_set * tile_count];
+    for(uint32_t t = 0; t < tile_count; ++t) {
+        set_bins[t].clear();
+    }
+
+    if(bin_set >= state.used_bin_sets) {
+        return;
+    }
+
+    uint32_t const per_set = (state.triangle_count + state.used_bin_sets - 1) / state.used_bin_sets;
+    uint32_t const begin = bin_set * per_set;
+    uint32_t const end = std::min(state.triangle_count, begin + per_set);
+
+    for(uint32_t tri = begin; tri < end; ++tri) {
+        OutputVertexAttributes const & v0 = state.vertices[state.indices[3 * tri + 0]];
+        OutputVertexAttributes const & v1 = state.vertices[state.indices[3 * tri + 1]];
+        OutputVertexAttributes const & v2 = state.vertices[state.indices[3 * tri + 2]];
+
+        RasterTriangle & raster_tri = setups[tri];
+        if(SetupRasterTriangle(v0, v1, v2, GetViewport(), raster_tri)) {
+            raster_tri.id = tri;
+            ScreenRect const & rect = raster_tri.bounds;
+            uint32_t const tile_min_x = static_cast<uint32_t>(rect.min_x) / TileSize;
+            uint32_t const tile_min_y = static_cast<uint32_t>(rect.min_y) / TileSize;
+            uint32_t const tile_max_x = static_cast<uint32_t>(rect.max_x - 1) / TileSize;
+            uint32_t const tile_max_y = static_cast<uint32_t>(rect.max_y - 1) / TileSize;
+            for(uint32_t ty = tile_min_y; ty <= tile_max_y; ++ty) {
+                for(uint32_t tx = tile_min_x; tx <= tile_max_x; ++tx) {
+                    set_bins[ty * tiles_x + tx].push_back(tri);
+                }
+            }
+        }
+    }
+}
+
+void TileRasterizer::RasterizeTile(DrawState const & state, uint32_t tile_index) {
+    ScreenRect tile = {};
+    tile.min_x = static_cast<int32_t>((tile_index % tiles_x) * TileSize);
+    tile.min_y = static_cast<int32_t>((tile_index / tiles_x) * TileSize);
+    tile.max_x = std::min(tile.min_x + static_cast<int32_t>(TileSize), static_cast<int32_t>(width));
+    tile.max_y = std::min(tile.min_y + static_cast<int32_t>(TileSize), static_cast<int32_t>(height));
+
+    bool const use_visibility = RasterOutputMode::VisibilityBuffer == output_mode;
+    bool const use_depth = depth_test || use_visibility;
+
+    RasterTarget target = {};
+    target.fragments = state.fragments;
+    target.packed_fragments = state.packed_fragments;
+    target.width = width;
+    target.height = height;
+    target.layout = target_layout;
+    target.depth_test = use_depth;
+    target.depth = use_visibility ? nullptr : depth.data();
+    target.block_z_min = block_z_min.data();
+    target.block_z_max = block_z_max.data();
+    target.blocks_x = blocks_x;
+    target.visibility = use_visibility ? visibility.data() : nullptr;
+
+    uint32_t const tile_blocks_min_x = static_cast<uint32_t>(tile.min_x) / RasterBlockSize;
+    uint32_t const tile_blocks_min_y = static_cast<uint32_t>(tile.min_y) / RasterBlockSize;
+    uint32_t const tile_blocks_max_x = (static_cast<uint32_t>(tile.max_x) + RasterBlockSize - 1) / RasterBlockSize;
+    uint32_t const tile_blocks_max_y = (static_cast<uint32_t>(tile.max_y) + RasterBlockSize - 1) / RasterBlockSize;
+
+    // The buffers of the tile hold whatever an earlier Draw left there until the first triangle reaches the
+    // kernels: only then is the clear written (to memory that is about to be touched anyway). Depth still
+    // starts at the clear depth, so the tile level hierarchical Z works on cleared tiles.
+    bool cleared = true;
+    float tile_z_max = clear_values.depth;
+    uint32_t const tile_count = tiles_x * tiles_y;
+
+    for(uint32_t bin_set = 0; bin_set < bin_set_count; ++bin_set) {
+        for(uint32_t tri : bins[bin_set * tile_count + tile_index]) {
+            RasterTriangle const & raster_tri = setups[tri];
+
+            // Tile level hierarchical Z, the triangle can't get closer than its closest vertex.
+            if(use_depth && raster_tri.z_min - HiZEpsilon >= tile_z_max) {
+                continue;
+            }
+
+            ScreenRect rect = raster_tri.bounds;
+            rect.min_x = std::max(rect.min_x, tile.min_x);
+            rect.min_y = std::max(rect.min_y, tile.min_y);
+            rect.max_x = std::min(rect.max_x, tile.max_x);
+            rect.max_y = std::min(rect.max_y, tile.max_y);
+
+            if(cleared) {
+                ClearTile(state, tile, target);
+                cleared = false;
+            }
+            if(rasterize_triangle(raster_tri, rect, target) && use_depth) {
+                tile_z_max = 0.0f;
+                for(uint32_t by = tile_blocks_min_y; by < tile_blocks_max_y; ++by) {
+                    for(uint32_t bx = tile_blocks_min_x; bx < tile_blocks_max_x; ++bx) {
+                        tile_z_max = std::max(tile_z_max, block_z_max[by * blocks_x + bx]);
+                    }
+                }
+            }
+        }
+    }
+    tile_cleared[tile_index] = cleared ? 1 : 0;
+    if(use_visibility && false == cleared) {
+        ResolveTile(state, tile, target);
+    }
+}
+
+void TileRasterizer::ClearTile(DrawState const & state, ScreenRect const & tile, RasterTarget const & target) {
+    // The resolve writes every Fragment of the tile in visibility buffer mode
+    if(nullptr != target.visibility) {
+        ForEachTargetRun(target, tile, false, [&](size_t first, size_t count) {
+            std::fill_n(&visibility[first], count, visibility_clear_value);
+        });
+    } else {
+        ForEachTargetRun(target, tile, true, [&](size_t first, size_t count) {
+            ClearFragments(state, first, count);
+        });
+    }
+    if(false == target.depth_test) {
+        return;
+    }
+
+    if(nullptr != target.depth) {
+        ForEachTargetRun(target, tile, false, [&](size_t first, size_t count) {
+            std::fill_n(&depth[first], count, clear_values.depth);
+        });
+    }
+    uint32_t const tile_blocks_min_x = static_cast<uint32_t>(tile.min_x) / RasterBlockSize;
+    uint32_t const tile_blocks_min_y = static_cast<uint32_t>(tile.min_y) / RasterBlockSize;
+    uint32_t const tile_blocks_max_x = (static_cast<uint32_t>(tile.max_x) + RasterBlockSize - 1) / RasterBlockSize;
+    uint32_t const tile_blocks_max_y = (static_cast<uint32_t>(tile.max_y) + RasterBlockSize - 1) / RasterBlockSize;
+    for(uint32_t by = tile_blocks_min_y; by < tile_blocks_max_y; ++by) {
+        std::fill_n(&block_z_min[by * blocks_x + tile_blocks_min_x], tile_blocks_max_x - tile_blocks_min_x, clear_values.depth);
+        std::fill_n(&block_z_max[by * blocks_x + tile_blocks_min_x], tile_blocks_max_x - tile_blocks_min_x, clear_values.depth);
+    }
+}
+
+void TileRasterizer::ResolveTile(DrawState const & state, ScreenRect const & tile, RasterTarget const & target) {
+    for(int32_t y = tile.min_y; y < tile.max_y; ++y) {
+        for(int32_t x = tile.min_x; x < tile.max_x; ++x) {
+            uint64_t const value = visibility[GetTargetPixelIndex(target, x, y)];
+            if(visibility_clear_value == value) {
+                ClearFragments(state, GetTargetFragmentIndex(target, x, y), 1);
+                continue;
+            }
+            ResolveFragment(setups[GetVisibilityTriangleID(value)], target, x, y);
+        }
+    }
+}
+
+void TileRasterizer::ClearFragments(DrawState const & state, size_t first, size_t count) {
+    if(nullptr != state.packed_fragments) {
+        std::fill_n(&state.packed_fragments[first], count, clear_packed_fragment);
+    } else {
+        std::fill_n(&state.fragments[first], count, clear_fragment);
+    }
+}
@@ -0,0 +1,174 @@
+#pragma once
+
+#include "pipeline_types.hpp"
+#include "raster_kernels.hpp"
+
+class ThreadPool;
+
+// What Draw clears to. Pixels no triangle covers end up as a Fragment of zeros with col = color.
+struct RasterClearValues {
+    float       color[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    float       depth = 1.0f;
+};
+
+enum class RasterOutputMode {
+    Fragments,          // kernels write interpolated Fragments on every depth test pass
+    VisibilityBuffer,   // kernels write depth + triangle ID, Fragments are resolved once per pixel at the end
+};
+
+// Multithreaded CPU version of shaders/demo003/rasterization/rasterizer.comp.hlsl
+//
+// The shader gives each triangle a thread that walks the triangle's whole bounding box, so one big triangle
+// stalls the dispatch. Here triangles are first set up and binned into TileSize x TileSize screen tiles, then
+// every tile is rasterized by one worker. Inside a tile triangles are drawn in submission order, so the result
+// doesn't depend on the number of threads. Setup runs once per triangle while binning and every tile the
+// triangle overlaps reads the same setup record (edge equations and attribute planes, see raster_kernels.hpp).
+//
+// Per-pixel coverage runs in the raster_kernels.hpp kernel matching the best SIMD level of the CPU. Coverage is
+// fixed point with the top-left fill rule, so pixels on edges shared by two triangles are written exactly once.
+//
+// With the depth test on, every tile keeps the max depth of its blocks (the top of the hierarchical Z, blocks
+// are in raster_kernels.hpp): triangles entirely behind it skip the tile before any block is touched.
+//
+// In RasterOutputMode::VisibilityBuffer the Fragment buffer is only written by the resolve pass that runs on
+// each tile after its triangles: 8 bytes per pixel are touched per overdraw instead of a 72 byte Fragment.
+//
+// Output is the same Fragment buffer the compute path writes: width * height Fragments, bottom row first.
+// Drawing into a PackedFragment buffer instead writes the fragment_packing.hpp encoding with the same layout,
+// which cuts the bytes written per pixel (and uploaded to the fragment shading pass) from 72 to 16.
+//
+// With RasterTargetLayout::Tiled the fragment, depth and visibility buffers are stored as 8x8 pixel tiles (see
+// raster_kernels.hpp), so every block a kernel touches is one contiguous piece of memory. ResolveFragments turns
+// tiled fragments into the linear, bottom row first layout (the Y flip) once, where they're read back.
+//
+// Clears are lazy: every tile has a cleared bit, set when a Draw starts, and its fragment, depth and visibility
+// buffers are only cleared right before the first triangle is drawn into the tile (RasterClearValues). Tiles no
+// triangle reaches keep whatever an earlier Draw left in the buffers and ResolveFragments writes the clear value
+// for them, so sparse scenes never pay for a full screen clear: only the tiles that get drawn are written twice.
+// The clear value itself is one per Draw, not per tile: every Draw clears the whole target, so all the tiles it
+// leaves untouched share its RasterClearValues (taken when it starts, SetClearValues after it doesn't change how
+// its output resolves).
+class TileRasterizer {
+public:
+    static constexpr uint32_t TileSize = 64;
+
+    void Init(uint32_t width, uint32_t height, ThreadPool * pool);
+    void Exit();
+
+    // Rasterizes index_count / 3 triangles into `fragments` (GetFragmentCount). Only the tiles triangles reach
+    // are cleared, read the result through ResolveFragments.
+    void Draw(
+        OutputVertexAttributes const * vertices,
+        IndexType const * indices,
+        uint32_t index_count,
+        Fragment * fragments);
+
+    // Same as above with compact output, see fragment_packing.hpp.
+    void Draw(
+        OutputVertexAttributes const * vertices,
+        IndexType const * indices,
+        uint32_t index_count,
+        PackedFragment * fragments);
+
+    // Clamped to what the CPU supports, mostly for comparing kernels.
+    void SetSimdLevel(SimdLevel level);
+    SimdLevel GetActiveSimdLevel() const { return simd_level; }
+
+    // Fractional bits vertices are snapped to, clamped to [1, MaxSubpixelBits].
+    void SetSubpixelBits(uint32_t bits);
+    uint32_t GetSubpixelBits() const { return subpixel_bits; }
+
+    RasterViewport GetViewport() const { return { width, height, subpixel_bits }; }
+
+    // LESS depth test on NDC z, on by default. Off draws in submission order like rasterizer.comp.hlsl.
+    // Always on in visibility buffer mode.
+    void SetDepthTest(bool enable) { depth_test = enable; }
+    bool GetDepthTest() const { return depth_test; }
+
+    void SetOutputMode(RasterOutputMode mode) { output_mode = mode; }
+    RasterOutputMode GetOutputMode() const { return output_mode; }
+
+    // Layout of the buffers Draw writes, Linear by default
+    void SetTargetLayout(RasterTargetLayout layout) { target_layout = layout; }
+    RasterTargetLayout GetTargetLayout() const { return target_layout; }
+
+    // Fragments Draw writes in the current layout (tiled buffers are padded to whole tiles)
+    size_t GetFragmentCount() const;
+
+    // Copies the output of the last Draw to width * height linear Fragments, bottom row first, with the clear
+    // value in the tiles it didn't touch. `dst` can be e.g. a mapped upload buffer.
+    void ResolveFragments(Fragment const * src, Fragment * dst) const;
+    void ResolveFragments(PackedFragment const * src, PackedFragment * dst) const;
+
+    // Used by the next Draw, and by ResolveFragments of its output
+    void SetClearValues(RasterClearValues const & values);
+    RasterClearValues const & GetClearValues() const { return clear_values; }
+
+    // Of the last Draw in visibility buffer mode, in the target layout (Linear: row y at y * width, y up).
+    // Triangle IDs are triangle indices in the index buffer passed to Draw. Stale in cleared tiles.
+    uint64_t const * GetVisibilityBuffer() const { return visibility.data(); }
+
+    uint32_t GetTileCountX() const { return tiles_x; }
+    uint32_t GetTileCountY() const { return tiles_y; }
+
+    // Tiles the last Draw left untouched (never cleared nor drawn into)
+    bool IsTileCleared(uint32_t tile_x, uint32_t tile_y) const { return 0 != tile_cleared[tile_y * tiles_x + tile_x]; }
+    uint32_t GetClearedTileCount() const;
+
+private:
+    struct DrawState {
+        OutputVertexAttributes const *  vertices;
+        IndexType const *               indices;
+        uint32_t                        triangle_count;
+        Fragment *                      fragments;
+        PackedFragment *                packed_fragments;   // only one of fragments and packed_fragments is set
+        uint32_t                        used_bin_sets;
+    };
+
+    void Draw(DrawState & state);
+    void ClearFragments(DrawState const & state, size_t first, size_t count);
+    void ResolveFragments(void const * src, void * dst, size_t fragment_size) const;
+    template<typename FragmentType>
+    void ResolveTileRow(FragmentType const * src, FragmentType * dst, FragmentType const & clear_value, uint32_t tile_y) const;
+
+    void BinTriangles(DrawState const & state, uint32_t bin_set);
+    void RasterizeTile(DrawState const & state, uint32_t tile_index);
+    void ClearTile(DrawState const & state, ScreenRect const & tile, RasterTarget const & target);
+    void ResolveTile(DrawState const & state, ScreenRect const & tile, RasterTarget const & target);
+
+    ThreadPool *    pool = nullptr;
+    uint32_t        width = 0;
+    uint32_t        height = 0;
+    uint32_t        tiles_x = 0;
+    uint32_t        tiles_y = 0;
+
+    SimdLevel           simd_level = SimdLevel::Scalar;
+    RasterizeTriangleFn rasterize_triangle = nullptr;
+    uint32_t            subpixel_bits = DefaultSubpixelBits;
+    bool                depth_test = true;
+    RasterOutputMode    output_mode = RasterOutputMode::Fragments;
+    RasterTargetLayout  target_layout = RasterTargetLayout::Linear;
+    RasterClearValues   clear_values;
+
+    // Clear values of the last Draw, and its tiles that were never cleared (1) or drawn into (0)
+    Fragment                clear_fragment = {};
+    PackedFragment          clear_packed_fragment = {};
+    uint64_t                visibility_clear_value = 0;
+    std::vector<uint8_t>    tile_cleared;
+
+    // Depth buffer and block level of the hierarchical Z, see RasterTarget
+    uint32_t            blocks_x = 0;
+    uint32_t            blocks_y = 0;
+    std::vector<float>  depth;
+    std::vector<float>  block_z_min;
+    std::vector<float>  block_z_max;
+    std::vector<uint64_t> visibility;
+
+    // setups[triangle] of the current Draw, only valid for binned triangles
+    std::vector<RasterTriangle> setups;
+
+    // bins[bin_set * tile_count + tile] holds the triangles of one contiguous range of the index buffer
+    // that overlap `tile`. Bin sets are filled in parallel and walked in order while rasterizing.
+    uint32_t                            bin_set_count = 0;
+    std::vector<std::vector<uint32_t>>  bins;
+};
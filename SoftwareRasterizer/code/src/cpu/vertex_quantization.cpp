@@ -0,0 +1,228 @@
+#include "vertex_quantization.hpp"
+#include "vertex_shading_common.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+static constexpr float PosQuantizationSteps = 65535.0f;
+
+void QuantizeVertices(Vertex const * vertices, uint32_t vertex_count, QuantizedVertexStreams & out) {
+    out.vertex_count = vertex_count;
+    for(uint32_t c = 0; c < 3; ++c) {
+        out.pos[c].resize(vertex_count);
+    }
+    out.normal[0].resize(vertex_count);
+    out.normal[1].resize(vertex_count);
+    out.color.resize(vertex_count);
+    out.uv[0].resize(vertex_count);
+    out.uv[1].resize(vertex_count);
+
+    float pos_min[3] = { 0.0f, 0.0f, 0.0f };
+    float pos_max[3] = { 0.0f, 0.0f, 0.0f };
+    if(vertex_count > 0) {
+        for(uint32_t c = 0; c < 3; ++c) {
+            pos_min[c] = pos_max[c] = vertices[0].pos[c];
+        }
+    }
+    for(uint32_t i = 0; i < vertex_count; ++i) {
+        for(uint32_t c = 0; c < 3; ++c) {
+            pos_min[c] = std::min(pos_min[c], vertices[i].pos[c]);
+            pos_max[c] = std::max(pos_max[c], vertices[i].pos[c]);
+        }
+    }
+    float inv_scale[3] = {};
+    for(uint32_t c = 0; c < 3; ++c) {
+        float const extent = pos_max[c] - pos_min[c];
+        out.pos_offset[c] = pos_min[c];
+        out.pos_scale[c] = extent / PosQuantizationSteps;
+        // Flat along this axis: every vertex gets 0 and decodes to the offset.
+        inv_scale[c] = extent > 0.0f ? PosQuantizationSteps / extent : 0.0f;
+    }
+
+    for(uint32_t i = 0; i < vertex_count; ++i) {
+        Vertex const & v = vertices[i];
+        for(uint32_t c = 0; c < 3; ++c) {
+            float const q = std::clamp((v.pos[c] - pos_min[c]) * inv_scale[c], 0.0f, PosQuantizationSteps);
+            out.pos[c][i] = static_cast<uint16_t>(std::lround(q));
+        }
+
+        uint32_t const normal = EncodeOctahedral(v.normal[0], v.normal[1], v.normal[2]);
+        out.normal[0][i] = static_cast<int16_t>(static_cast<uint16_t>(normal));
+        out.normal[1][i] = static_cast<int16_t>(static_cast<uint16_t>(normal >> 16));
+        out.color[i] = PackRGBA8(v.col);
+
+        out.uv[0][i] = FloatToHalf(v.uv[0]);
+        out.uv[1][i] = FloatToHalf(v.uv[1]);
+    }
+}
+
+QuantizedVertexStreamsView GetQuantizedVertexStreamsView(QuantizedVertexStreams const & vertices) {
+    QuantizedVertexStreamsView view = {};
+    for(uint32_t c = 0; c < 3; ++c) {
+        view.pos[c] = vertices.pos[c].data();
+    }
+    view.normal[0] = vertices.normal[0].data();
+    view.normal[1] = vertices.normal[1].data();
+    view.color = vertices.color.data();
+    view.uv[0] = vertices.uv[0].data();
+    view.uv[1] = vertices.uv[1].data();
+    view.vertex_count = vertices.vertex_count;
+    return view;
+}
+
+void ShadeQuantizedVertices_Scalar(QuantizedVertexStreamsView const & vertices, uint32_t begin, uint32_t end, VertexShadingMatrices const & matrices, OutputVertexAttributes * out, ClipPosition * out_clip) {
+    for(uint32_t i = begin; i < end; ++i) {
+        OutputVertexAttributes & o = out[i];
+        float const pos[4] = { static_cast<float>(vertices.pos[0][i]), static_cast<float>(vertices.pos[1][i]), static_cast<float>(vertices.pos[2][i]), 1.0f };
+        float pos_clip[4] = {};
+        TransformPoint(matrices.model, pos, o.pos_world);
+        TransformPoint(matrices.model_view_proj, pos, pos_clip);
+
+        float const inv_w = 1.0f / pos_clip[3];
+        o.pos_ndc[0] = pos_clip[0] * inv_w;
+        o.pos_ndc[1] = pos_clip[1] * inv_w;
+        o.pos_ndc[2] = pos_clip[2] * inv_w;
+        o.pos_ndc[3] = inv_w;
+
+        uint32_t const normal = static_cast<uint16_t>(vertices.normal[0][i]) | (static_cast<uint32_t>(static_cast<uint16_t>(vertices.normal[1][i])) << 16);
+        DecodeOctahedral(normal, o.normal_world);
+        o.normal_world[3] = 0.0f;
+        UnpackRGBA8(vertices.color[i], o.col);
+        o.uv[0] = HalfToFloat(vertices.uv[0][i]);
+        o.uv[1] = HalfToFloat(vertices.uv[1][i]);
+        if(nullptr != out_clip) {
+            memcpy(out_clip[i].pos_clip, pos_clip, sizeof(pos_clip));
+        }
+    }
+}
+
+#if SIMD_X86
+
+// 4 uint16 / int16 at `src` to floats, SSE2 has no 16 to 32 bit extension so it's an unpack (and a shift back
+// down for the sign).
+static SIMD_FORCEINLINE __m128 LoadUInt16_SSE(uint16_t const * src) {
+    __m128i const value = _mm_loadl_epi64(reinterpret_cast<__m128i const *>(src));
+    return _mm_cvtepi32_ps(_mm_unpacklo_epi16(value, _mm_setzero_si128()));
+}
+
+static SIMD_FORCEINLINE __m128 LoadInt16_SSE(int16_t const * src) {
+    __m128i const value = _mm_loadl_epi64(reinterpret_cast<__m128i const *>(src));
+    return _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(value, value), 16));
+}
+
+// HalfToFloat for 4 halves, without F16C.
+static SIMD_FORCEINLINE __m128 LoadHalf_SSE(uint16_t const * src) {
+    __m128i const half = _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<__m128i const *>(src)), _mm_setzero_si128());
+    __m128i const exponent_mantissa = _mm_slli_epi32(_mm_and_si128(half, _mm_set1_epi32(0x7FFF)), 13);
+    __m128 const value = _mm_mul_ps(_mm_castsi128_ps(exponent_mantissa), _mm_castsi128_ps(_mm_set1_epi32(0x77800000)));
+    __m128i const inf_nan = _mm_and_si128(_mm_cmpgt_epi32(exponent_mantissa, _mm_set1_epi32((0x7C00 << 13) - 1)), _mm_set1_epi32(0x7F800000));
+    __m128i const sign = _mm_slli_epi32(_mm_and_si128(half, _mm_set1_epi32(0x8000)), 16);
+    return _mm_castsi128_ps(_mm_or_si128(_mm_or_si128(_mm_castps_si128(value), inf_nan), sign));
+}
+
+// DecodeOctahedral for 4 normals, x and y as decoded snorm16.
+static SIMD_FORCEINLINE void DecodeOctahedral_SSE(__m128 x, __m128 y, __m128 & out_x, __m128 & out_y, __m128 & out_z) {
+    __m128 const sign_mask = _mm_set1_ps(-0.0f);
+    x = _mm_max_ps(_mm_mul_ps(x, _mm_set1_ps(1.0f / Snorm16Steps)), _mm_set1_ps(-1.0f));
+    y = _mm_max_ps(_mm_mul_ps(y, _mm_set1_ps(1.0f / Snorm16Steps)), _mm_set1_ps(-1.0f));
+    __m128 const z = _mm_sub_ps(_mm_sub_ps(_mm_set1_ps(1.0f), _mm_andnot_ps(sign_mask, x)), _mm_andnot_ps(sign_mask, y));
+    __m128 const t = _mm_max_ps(_mm_sub_ps(_mm_setzero_ps(), z), _mm_setzero_ps());
+    // x -= copysign(t, x), same for y
+    x = _mm_sub_ps(x, _mm_or_ps(t, _mm_and_ps(x, sign_mask)));
+    y = _mm_sub_ps(y, _mm_or_ps(t, _mm_and_ps(y, sign_mask)));
+    __m128 const inv_length = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z))));
+    out_x = _mm_mul_ps(x, inv_length);
+    out_y = _mm_mul_ps(y, inv_length);
+    out_z = _mm_mul_ps(z, inv_length);
+}
+
+void ShadeQuantizedVertices_SSE(QuantizedVertexStreamsView const & vertices, uint32_t begin, uint32_t end, VertexShadingMatrices const & matrices, OutputVertexAttributes * out, ClipPosition * out_clip) {
+    constexpr uint32_t Lanes = 4;
+    uint32_t i = begin;
+    for(; i + Lanes <= end; i += Lanes) {
+        __m128 const x = LoadUInt16_SSE(&vertices.pos[0][i]);
+        __m128 const y = LoadUInt16_SSE(&vertices.pos[1][i]);
+        __m128 const z = LoadUInt16_SSE(&vertices.pos[2][i]);
+
+        Matrix4x4 const & mvp = matrices.model_view_proj;
+        Matrix4x4 const & model = matrices.model;
+        StoreShadedPositions_SSE(i,
+            TransformColumn_SSE(mvp, 0, x, y, z), TransformColumn_SSE(mvp, 1, x, y, z), TransformColumn_SSE(mvp, 2, x, y, z), TransformColumn_SSE(mvp, 3, x, y, z),
+            TransformColumn_SSE(model, 0, x, y, z), TransformColumn_SSE(model, 1, x, y, z), TransformColumn_SSE(model, 2, x, y, z), TransformColumn_SSE(model, 3, x, y, z),
+            out, out_clip);
+
+        __m128 normal_x, normal_y, normal_z;
+        DecodeOctahedral_SSE(LoadInt16_SSE(&vertices.normal[0][i]), LoadInt16_SSE(&vertices.normal[1][i]), normal_x, normal_y, normal_z);
+
+        __m128i const color = _mm_loadu_si128(reinterpret_cast<__m128i const *>(&vertices.color[i]));
+        __m128i const byte_mask = _mm_set1_epi32(0xFF);
+        __m128 const to_unorm = _mm_set1_ps(1.0f / 255.0f);
+        __m128 const r = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(color, byte_mask)), to_unorm);
+        __m128 const g = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(color, 8), byte_mask)), to_unorm);
+        __m128 const b = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(color, 16), byte_mask)), to_unorm);
+        __m128 const a = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(color, 24)), to_unorm);
+
+        StorePassedAttributes_SSE(i, normal_x, normal_y, normal_z, _mm_setzero_ps(), r, g, b, a,
+            LoadHalf_SSE(&vertices.uv[0][i]), LoadHalf_SSE(&vertices.uv[1][i]), out);
+    }
+    ShadeQuantizedVertices_Scalar(vertices, i, end, matrices, out, out_clip);
+}
+
+#endif // SIMD_X86
+
+ShadeQuantizedVerticesFn GetShadeQuantizedVerticesFn(SimdLevel level) {
+#if SIMD_X86
+    switch(level) {
+        case SimdLevel::AVX512:
+        case SimdLevel::AVX2:   return &ShadeQuantizedVertices_AVX2;
+        case SimdLevel::SSE:    return &ShadeQuantizedVertices_SSE;
+        case SimdLevel::Scalar: break;
+    }
+#else
+    CONSUME_VAR(level);
+#endif
+    return &ShadeQuantizedVertices_Scalar;
+}
+
+void ShadeQuantizedVertices(
+    QuantizedVertexStreams const & vertices,
+    VertexTransforms const & transforms,
+    OutputVertexAttributes * out,
+    ClipPosition * out_clip,
+    ThreadPool * pool,
+    SimdLevel simd_level)
+{
+    // Dequantization as a matrix in front of the transforms: scale on the diagonal, offset in the last row.
+    Matrix4x4 dequantize = {};
+    for(uint32_t c = 0; c < 3; ++c) {
+        dequantize.m[c][c] = vertices.pos_scale[c];
+        dequantize.m[3][c] = vertices.pos_offset[c];
+    }
+    dequantize.m[3][3] = 1.0f;
+    VertexShadingMatrices matrices = {};
+    matrices.model = MultiplyMatrix(dequantize, transforms.model);
+    matrices.model_view_proj = MultiplyMatrix(MultiplyMatrix(matrices.model, transforms.view), transforms.proj);
+    ShadeQuantizedVerticesFn const shade = GetShadeQuantizedVerticesFn(std::min(simd_level, GetSimdLevel()));
+    QuantizedVertexStreamsView const view = GetQuantizedVertexStreamsView(vertices);
+
+    // Multiple of every kernel's lane count, so only the last batch has a scalar remainder.
+    constexpr uint32_t BatchSize = 4096;
+    uint32_t const vertex_count = vertices.vertex_count;
+    uint32_t const batch_count = (vertex_count + BatchSize - 1) / BatchSize;
+
+    auto shade_batch = [&](uint32_t batch, uint32_t) {
+        uint32_t const begin = batch * BatchSize;
+        uint32_t const end = std::min(vertex_count, begin + BatchSize);
+        shade(view, begin, end, matrices, out, out_clip);
+    };
+
+    if(nullptr != pool && batch_count > 1) {
+        pool->ParallelFor(batch_count, shade_batch);
+    } else {
+        for(uint32_t b = 0; b < batch_count; ++b) {
+            shade_batch(b, 0);
+        }
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "attribute_encoding.hpp"
+#include "vertex_shading.hpp"
+
+class ThreadPool;
+
+// Compact alternative to VertexStreams: 18 bytes per vertex instead of 52 (and Vertex's 56).
+//   - position: 3 x uint16, mapped to the mesh bounding box by a per mesh scale and offset
+//   - normal:   2 x snorm16, octahedral encoding of the unit normal (w is always 0)
+//   - color:    RGBA8 unorm, one uint32 with r in the low byte
+//   - uv:       2 x half float
+// Normals, colors and uvs use the attribute_encoding.hpp encodings, like PackedFragment.
+// Still one stream per component so the SIMD kernels load 4/8 consecutive values at once. Positions are
+// never decoded on their own: the scale and offset are folded into the transforms, so the kernels transform
+// the integer coordinates directly.
+struct QuantizedVertexStreams {
+    uint32_t                vertex_count = 0;
+    float                   pos_scale[3] = {};      // object space position = pos * pos_scale + pos_offset
+    float                   pos_offset[3] = {};
+    std::vector<uint16_t>   pos[3];
+    std::vector<int16_t>    normal[2];
+    std::vector<uint32_t>   color;
+    std::vector<uint16_t>   uv[2];
+};
+
+// Raw stream pointers of a QuantizedVertexStreams for the kernels, see VertexStreamsView.
+struct QuantizedVertexStreamsView {
+    uint16_t const *    pos[3] = {};
+    int16_t const *     normal[2] = {};
+    uint32_t const *    color = nullptr;
+    uint16_t const *    uv[2] = {};
+    uint32_t            vertex_count = 0;
+};
+
+QuantizedVertexStreamsView GetQuantizedVertexStreamsView(QuantizedVertexStreams const & vertices);
+
+// Converts once per mesh, not per draw. Positions are rounded to the nearest of 65536 steps across the
+// bounding box, normals are normalized before encoding, colors clamped to [0, 1].
+void QuantizeVertices(Vertex const * vertices, uint32_t vertex_count, QuantizedVertexStreams & out);
+
+// ShadeVertices for quantized vertices: same output, decoded on the fly.
+void ShadeQuantizedVertices(
+    QuantizedVertexStreams const & vertices,
+    VertexTransforms const & transforms,
+    OutputVertexAttributes * out,
+    ClipPosition * out_clip,
+    ThreadPool * pool,
+    SimdLevel simd_level);
+
+// Kernels: shade vertices [begin, end). `matrices` already include the position scale and offset.
+// The SIMD ones do 4 (SSE) or 8 (AVX2, also used for AVX-512) vertices per iteration and leave the remainder
+// to the scalar kernel.
+using ShadeQuantizedVerticesFn = void (*)(QuantizedVertexStreamsView const & vertices, uint32_t begin, uint32_t end, VertexShadingMatrices const & matrices, OutputVertexAttributes * out, ClipPosition * out_clip);
+
+void ShadeQuantizedVertices_Scalar(QuantizedVertexStreamsView const & vertices, uint32_t begin, uint32_t end, VertexShadingMatrices const & matrices, OutputVertexAttributes * out, ClipPosition * out_clip);
+#if SIMD_X86
+void ShadeQuantizedVertices_SSE(QuantizedVertexStreamsView const & vertices, uint32_t begin, uint32_t end, VertexShadingMatrices const & matrices, OutputVertexAttributes * out, ClipPosition * out_clip);
+void ShadeQuantizedVertices_AVX2(QuantizedVertexStreamsView const & vertices, uint32_t begin, uint32_t end, VertexShadingMatrices const & matrices, OutputVertexAttributes * out, ClipPosition * out_clip);
+#endif
+
+ShadeQuantizedVerticesFn GetShadeQuantizedVerticesFn(SimdLevel level);
@@ -0,0 +1,102 @@
+#include "vertex_quantization.hpp"
+#include "vertex_shading_common.hpp"
+
+#if SIMD_X86
+
+// Column `c` of pos * mat for 8 positions with w = 1.
+SIMD_TARGET_AVX2
+static SIMD_FORCEINLINE __m256 TransformColumn_AVX2(Matrix4x4 const & mat, uint32_t c, __m256 x, __m256 y, __m256 z) {
+    __m256 ret = _mm256_fmadd_ps(x, _mm256_set1_ps(mat.m[0][c]), _mm256_set1_ps(mat.m[3][c]));
+    ret = _mm256_fmadd_ps(y, _mm256_set1_ps(mat.m[1][c]), ret);
+    return _mm256_fmadd_ps(z, _mm256_set1_ps(mat.m[2][c]), ret);
+}
+
+SIMD_TARGET_AVX2
+static SIMD_FORCEINLINE __m256 LoadUInt16_AVX2(uint16_t const * src) {
+    return _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<__m128i const *>(src))));
+}
+
+SIMD_TARGET_AVX2
+static SIMD_FORCEINLINE __m256 LoadInt16_AVX2(int16_t const * src) {
+    return _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<__m128i const *>(src))));
+}
+
+// DecodeOctahedral for 8 normals, x and y as decoded snorm16.
+SIMD_TARGET_AVX2
+static SIMD_FORCEINLINE void DecodeOctahedral_AVX2(__m256 x, __m256 y, __m256 & out_x, __m256 & out_y, __m256 & out_z) {
+    __m256 const sign_mask = _mm256_set1_ps(-0.0f);
+    x = _mm256_max_ps(_mm256_mul_ps(x, _mm256_set1_ps(1.0f / Snorm16Steps)), _mm256_set1_ps(-1.0f));
+    y = _mm256_max_ps(_mm256_mul_ps(y, _mm256_set1_ps(1.0f / Snorm16Steps)), _mm256_set1_ps(-1.0f));
+    __m256 const z = _mm256_sub_ps(_mm256_sub_ps(_mm256_set1_ps(1.0f), _mm256_andnot_ps(sign_mask, x)), _mm256_andnot_ps(sign_mask, y));
+    __m256 const t = _mm256_max_ps(_mm256_sub_ps(_mm256_setzero_ps(), z), _mm256_setzero_ps());
+    // x -= copysign(t, x), same for y
+    x = _mm256_sub_ps(x, _mm256_or_ps(t, _mm256_and_ps(x, sign_mask)));
+    y = _mm256_sub_ps(y, _mm256_or_ps(t, _mm256_and_ps(y, sign_mask)));
+    __m256 const length2 = _mm256_fmadd_ps(z, z, _mm256_fmadd_ps(y, y, _mm256_mul_ps(x, x)));
+    __m256 const inv_length = _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_sqrt_ps(length2));
+    out_x = _mm256_mul_ps(x, inv_length);
+    out_y = _mm256_mul_ps(y, inv_length);
+    out_z = _mm256_mul_ps(z, inv_length);
+}
+
+SIMD_TARGET_AVX2
+void ShadeQuantizedVertices_AVX2(QuantizedVertexStreamsView const & vertices, uint32_t begin, uint32_t end, VertexShadingMatrices const & matrices, OutputVertexAttributes * out, ClipPosition * out_clip) {
+    constexpr uint32_t Lanes = 8;
+    uint32_t i = begin;
+    for(; i + Lanes <= end; i += Lanes) {
+        __m256 const x = LoadUInt16_AVX2(&vertices.pos[0][i]);
+        __m256 const y = LoadUInt16_AVX2(&vertices.pos[1][i]);
+        __m256 const z = LoadUInt16_AVX2(&vertices.pos[2][i]);
+
+        Matrix4x4 const & mvp = matrices.model_view_proj;
+        Matrix4x4 const & model = matrices.model;
+        __m256 const clip_x = TransformColumn_AVX2(mvp, 0, x, y, z);
+        __m256 const clip_y = TransformColumn_AVX2(mvp, 1, x, y, z);
+        __m256 const clip_z = TransformColumn_AVX2(mvp, 2, x, y, z);
+        __m256 const clip_w = TransformColumn_AVX2(mvp, 3, x, y, z);
+        __m256 const world_x = TransformColumn_AVX2(model, 0, x, y, z);
+        __m256 const world_y = TransformColumn_AVX2(model, 1, x, y, z);
+        __m256 const world_z = TransformColumn_AVX2(model, 2, x, y, z);
+        __m256 const world_w = TransformColumn_AVX2(model, 3, x, y, z);
+
+        // Stores go through the SSE transposes a half at a time.
+        StoreShadedPositions_SSE(i,
+            _mm256_castps256_ps128(clip_x), _mm256_castps256_ps128(clip_y), _mm256_castps256_ps128(clip_z), _mm256_castps256_ps128(clip_w),
+            _mm256_castps256_ps128(world_x), _mm256_castps256_ps128(world_y), _mm256_castps256_ps128(world_z), _mm256_castps256_ps128(world_w),
+            out, out_clip);
+        StoreShadedPositions_SSE(i + 4,
+            _mm256_extractf128_ps(clip_x, 1), _mm256_extractf128_ps(clip_y, 1), _mm256_extractf128_ps(clip_z, 1), _mm256_extractf128_ps(clip_w, 1),
+            _mm256_extractf128_ps(world_x, 1), _mm256_extractf128_ps(world_y, 1), _mm256_extractf128_ps(world_z, 1), _mm256_extractf128_ps(world_w, 1),
+            out, out_clip);
+
+        __m256 normal_x, normal_y, normal_z;
+        DecodeOctahedral_AVX2(LoadInt16_AVX2(&vertices.normal[0][i]), LoadInt16_AVX2(&vertices.normal[1][i]), normal_x, normal_y, normal_z);
+
+        __m256i const color = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(&vertices.color[i]));
+        __m256i const byte_mask = _mm256_set1_epi32(0xFF);
+        __m256 const to_unorm = _mm256_set1_ps(1.0f / 255.0f);
+        __m256 const r = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(color, byte_mask)), to_unorm);
+        __m256 const g = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(color, 8), byte_mask)), to_unorm);
+        __m256 const b = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(color, 16), byte_mask)), to_unorm);
+        __m256 const a = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(color, 24)), to_unorm);
+
+        // F16C
+        __m256 const u = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<__m128i const *>(&vertices.uv[0][i])));
+        __m256 const v = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<__m128i const *>(&vertices.uv[1][i])));
+
+        __m128 const zero = _mm_setzero_ps();
+        StorePassedAttributes_SSE(i,
+            _mm256_castps256_ps128(normal_x), _mm256_castps256_ps128(normal_y), _mm256_castps256_ps128(normal_z), zero,
+            _mm256_castps256_ps128(r), _mm256_castps256_ps128(g), _mm256_castps256_ps128(b), _mm256_castps256_ps128(a),
+            _mm256_castps256_ps128(u), _mm256_castps256_ps128(v),
+            out);
+        StorePassedAttributes_SSE(i + 4,
+            _mm256_extractf128_ps(normal_x, 1), _mm256_extractf128_ps(normal_y, 1), _mm256_extractf128_ps(normal_z, 1), zero,
+            _mm256_extractf128_ps(r, 1), _mm256_extractf128_ps(g, 1), _mm256_extractf128_ps(b, 1), _mm256_extractf128_ps(a, 1),
+            _mm256_extractf128_ps(u, 1), _mm256_extractf128_ps(v, 1),
+            out);
+    }
+    ShadeQuantizedVertices_Scalar(vertices, i, end, matrices, out, out_clip);
+}
+
+#endif // SIMD_X86
@@ -0,0 +1,185 @@
+#include "vertex_shading.hpp"
+#include "vertex_shading_common.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+void BuildVertexStreams(Vertex const * vertices, uint32_t vertex_count, VertexStreams & out) {
+    out.vertex_count = vertex_count;
+    float * streams[VertexStreamCount] = {};
+    for(uint32_t s = 0; s < VertexStreamCount; ++s) {
+        out.streams[s].resize(vertex_count);
+        streams[s] = out.streams[s].data();
+    }
+    // A block of Vertices stays in L1 while it's read once per stream, every stream is written contiguously.
+    constexpr uint32_t BlockSize = 256;
+    for(uint32_t begin = 0; begin < vertex_count; begin += BlockSize) {
+        uint32_t const end = std::min(vertex_count, begin + BlockSize);
+        for(uint32_t c = 0; c < 3; ++c) {
+            for(uint32_t i = begin; i < end; ++i) {
+                streams[VertexStreamPos + c][i] = vertices[i].pos[c];
+            }
+        }
+        for(uint32_t c = 0; c < 4; ++c) {
+            for(uint32_t i = begin; i < end; ++i) {
+                streams[VertexStreamNormal + c][i] = vertices[i].normal[c];
+            }
+            for(uint32_t i = begin; i < end; ++i) {
+                streams[VertexStreamColor + c][i] = vertices[i].col[c];
+            }
+        }
+        for(uint32_t c = 0; c < 2; ++c) {
+            for(uint32_t i = begin; i < end; ++i) {
+                streams[VertexStreamUV + c][i] = vertices[i].uv[c];
+            }
+        }
+    }
+}
+
+VertexStreamsView GetVertexStreamsView(VertexStreams const & vertices) {
+    VertexStreamsView view = {};
+    for(uint32_t s = 0; s < VertexStreamCount; ++s) {
+        view.streams[s] = vertices.streams[s].data();
+    }
+    view.vertex_count = vertices.vertex_count;
+    return view;
+}
+
+void ShadeVertices_Scalar(VertexStreamsView const & vertices, uint32_t begin, uint32_t end, VertexShadingMatrices const & matrices, OutputVertexAttributes * out, ClipPosition * out_clip) {
+    float const * const * const streams = vertices.streams;
+    for(uint32_t i = begin; i < end; ++i) {
+        OutputVertexAttributes & o = out[i];
+        float const pos[4] = { streams[VertexStreamPos + 0][i], streams[VertexStreamPos + 1][i], streams[VertexStreamPos + 2][i], 1.0f };
+        float pos_clip[4] = {};
+        TransformPoint(matrices.model, pos, o.pos_world);
+        TransformPoint(matrices.model_view_proj, pos, pos_clip);
+
+        float const inv_w = 1.0f / pos_clip[3];
+        o.pos_ndc[0] = pos_clip[0] * inv_w;
+        o.pos_ndc[1] = pos_clip[1] * inv_w;
+        o.pos_ndc[2] = pos_clip[2] * inv_w;
+        o.pos_ndc[3] = inv_w;
+        for(uint32_t c = 0; c < 4; ++c) {
+            o.normal_world[c] = streams[VertexStreamNormal + c][i];
+            o.col[c] = streams[VertexStreamColor + c][i];
+        }
+        o.uv[0] = streams[VertexStreamUV + 0][i];
+        o.uv[1] = streams[VertexStreamUV + 1][i];
+        if(nullptr != out_clip) {
+            memcpy(out_clip[i].pos_clip, pos_clip, sizeof(pos_clip));
+        }
+    }
+}
+
+#if SIMD_X86
+
+void ShadeVertices_SSE(VertexStreamsView const & vertices, uint32_t begin, uint32_t end, VertexShadingMatrices const & matrices, OutputVertexAttributes * out, ClipPosition * out_clip) {
+    constexpr uint32_t Lanes = 4;
+    float const * const * const streams = vertices.streams;
+    uint32_t i = begin;
+    for(; i + Lanes <= end; i += Lanes) {
+        __m128 const x = _mm_loadu_ps(&streams[VertexStreamPos + 0][i]);
+        __m128 const y = _mm_loadu_ps(&streams[VertexStreamPos + 1][i]);
+        __m128 const z = _mm_loadu_ps(&streams[VertexStreamPos + 2][i]);
+
+        Matrix4x4 const & mvp = matrices.model_view_proj;
+        Matrix4x4 const & model = matrices.model;
+        StoreShadedVertices_SSE(vertices, i,
+            TransformColumn_SSE(mvp, 0, x, y, z), TransformColumn_SSE(mvp, 1, x, y, z), TransformColumn_SSE(mvp, 2, x, y, z), TransformColumn_SSE(mvp, 3, x, y, z),
+            TransformColumn_SSE(model, 0, x, y, z), TransformColumn_SSE(model, 1, x, y, z), TransformColumn_SSE(model, 2, x, y, z), TransformColumn_SSE(model, 3, x, y, z),
+            out, out_clip);
+    }
+    ShadeVertices_Scalar(vertices, i, end, matrices, out, out_clip);
+}
+
+#endif // SIMD_X86
+
+ShadeVerticesFn GetShadeVerticesFn(SimdLevel level) {
+#if SIMD_X86
+    switch(level) {
+        case SimdLevel::AVX512: return &ShadeVertices_AVX512;
+        case SimdLevel::AVX2:   return &ShadeVertices_AVX2;
+        case SimdLevel::SSE:    return &ShadeVertices_SSE;
+        case SimdLevel::Scalar: break;
+    }
+#else
+    CONSUME_VAR(level);
+#endif
+    return &ShadeVertices_Scalar;
+}
+
+static VertexShadingMatrices GetVertexShadingMatrices(VertexTransforms const & transforms) {
+    VertexShadingMatrices matrices = {};
+    matrices.model = transforms.model;
+    matrices.model_view_proj = MultiplyMatrix(MultiplyMatrix(transforms.model, transforms.view), transforms.proj);
+    return matrices;
+}
+
+void ShadeVertices(
+    VertexStreams const & vertices,
+    VertexTransforms const & transforms,
+    OutputVertexAttributes * out,
+    ClipPosition * out_clip,
+    ThreadPool * pool,
+    SimdLevel simd_level)
+{
+    VertexShadingMatrices const matrices = GetVertexShadingMatrices(transforms);
+    ShadeVerticesFn const shade = GetShadeVerticesFn(std::min(simd_level, GetSimdLevel()));
+    VertexStreamsView const view = GetVertexStreamsView(vertices);
+
+    // Multiple of every kernel's lane count, so only the last batch has a scalar remainder.
+    constexpr uint32_t BatchSize = 4096;
+    uint32_t const vertex_count = vertices.vertex_count;
+    uint32_t const batch_count = (vertex_count + BatchSize - 1) / BatchSize;
+
+    auto shade_batch = [&](uint32_t batch, uint32_t) {
+        uint32_t const begin = batch * BatchSize;
+        uint32_t const end = std::min(vertex_count, begin + BatchSize);
+        shade(view, begin, end, matrices, out, out_clip);
+    };
+
+    if(nullptr != pool && batch_count > 1) {
+        pool->ParallelFor(batch_count, shade_batch);
+    } else {
+        for(uint32_t b = 0; b < batch_count; ++b) {
+            shade_batch(b, 0);
+        }
+    }
+}
+
+void ShadeVertexRanges(
+    VertexStreams const & vertices,
+    VertexRange const * ranges,
+    uint32_t range_count,
+    VertexTransforms const & transforms,
+    OutputVertexAttributes * out,
+    ClipPosition * out_clip,
+    ThreadPool * pool,
+    SimdLevel simd_level)
+{
+    VertexShadingMatrices const matrices = GetVertexShadingMatrices(transforms);
+    ShadeVerticesFn const shade = GetShadeVerticesFn(std::min(simd_level, GetSimdLevel()));
+    VertexStreamsView const view = GetVertexStreamsView(vertices);
+
+    // Ranges are meshlet sized, a batch takes enough of them to be worth a job.
+    constexpr uint32_t RangesPerBatch = 64;
+    uint32_t const batch_count = (range_count + RangesPerBatch - 1) / RangesPerBatch;
+
+    auto shade_batch = [&](uint32_t batch, uint32_t) {
+        uint32_t const begin = batch * RangesPerBatch;
+        uint32_t const end = std::min(range_count, begin + RangesPerBatch);
+        for(uint32_t r = begin; r < end; ++r) {
+            ASSERT(ranges[r].begin + ranges[r].count <= vertices.vertex_count);
+            shade(view, ranges[r].begin, ranges[r].begin + ranges[r].count, matrices, out, out_clip);
+        }
+    };
+
+    if(nullptr != pool && batch_count > 1) {
+        pool->ParallelFor(batch_count, shade_batch);
+    } else {
+        for(uint32_t b = 0; b < batch_count; ++b) {
+            shade_batch(b, 0);
+        }
+    }
+}
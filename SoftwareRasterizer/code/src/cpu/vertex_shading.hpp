@@ -0,0 +1,81 @@
+#pragma once
+
+#include "pipeline_types.hpp"
+#include "simd.hpp"
+
+class ThreadPool;
+
+// Structure of arrays copy of Mesh::vertices: one stream per float the vertex shader reads, so SIMD kernels
+// load 4/8/16 consecutive values of a component with one load instead of gathering them out of 56 byte Vertices.
+// pos.w is not stored, positions are always transformed with w = 1.
+constexpr uint32_t VertexStreamPos = 0;         // x, y, z
+constexpr uint32_t VertexStreamNormal = 3;      // x, y, z, w
+constexpr uint32_t VertexStreamColor = 7;       // r, g, b, a
+constexpr uint32_t VertexStreamUV = 11;         // u, v
+constexpr uint32_t VertexStreamCount = 13;
+
+struct VertexStreams {
+    uint32_t            vertex_count = 0;
+    std::vector<float>  streams[VertexStreamCount];
+};
+
+// Converts once per mesh, not per draw.
+void BuildVertexStreams(Vertex const * vertices, uint32_t vertex_count, VertexStreams & out);
+
+// Raw stream pointers of a VertexStreams, taken once per call by the dispatchers so the kernels (some built with
+// /arch, see simd.hpp) never index a std::vector.
+struct VertexStreamsView {
+    float const *   streams[VertexStreamCount] = {};
+    uint32_t        vertex_count = 0;
+};
+
+VertexStreamsView GetVertexStreamsView(VertexStreams const & vertices);
+
+// CPU port of shaders/demo003/rasterization/vertex_shading.comp.hlsl
+// Transforms all vertices of `vertices` into `out` (which must hold as many elements).
+// `out_clip` receives the clip space positions for primitive assembly, can be nullptr.
+// model * view * proj is concatenated once per call, so each vertex takes two matrix transforms (world and clip)
+// instead of three chained ones.
+void ShadeVertices(
+    VertexStreams const & vertices,
+    VertexTransforms const & transforms,
+    OutputVertexAttributes * out,
+    ClipPosition * out_clip,
+    ThreadPool * pool,
+    SimdLevel simd_level);
+
+// Vertices [begin, begin + count) of a VertexStreams.
+struct VertexRange {
+    uint32_t    begin;
+    uint32_t    count;
+};
+
+// Same as ShadeVertices for the vertices in `ranges` only, the rest of `out` / `out_clip` is left untouched.
+// Used with meshlets (see meshlets.hpp): only the vertices of the meshlets that survived culling are shaded.
+void ShadeVertexRanges(
+    VertexStreams const & vertices,
+    VertexRange const * ranges,
+    uint32_t range_count,
+    VertexTransforms const & transforms,
+    OutputVertexAttributes * out,
+    ClipPosition * out_clip,
+    ThreadPool * pool,
+    SimdLevel simd_level);
+
+struct VertexShadingMatrices {
+    Matrix4x4   model;
+    Matrix4x4   model_view_proj;
+};
+
+// Kernels: shade vertices [begin, end). The SIMD ones do 4 (SSE), 8 (AVX2) or 16 (AVX-512) vertices per
+// iteration and leave the remainder to the scalar kernel.
+using ShadeVerticesFn = void (*)(VertexStreamsView const & vertices, uint32_t begin, uint32_t end, VertexShadingMatrices const & matrices, OutputVertexAttributes * out, ClipPosition * out_clip);
+
+void ShadeVertices_Scalar(VertexStreamsView const & vertices, uint32_t begin, uint32_t end, VertexShadingMatrices const & matrices, OutputVertexAttributes * out, ClipPosition * out_clip);
+#if SIMD_X86
+void ShadeVertices_SSE(VertexStreamsView const & vertices, uint32_t begin, uint32_t end, VertexShadingMatrices const & matrices, OutputVertexAttributes * out, ClipPosition * out_clip);
+void ShadeVertices_AVX2(VertexStreamsView const & vertices, uint32_t begin, uint32_t end, VertexShadingMatrices const & matrices, OutputVertexAttributes * out, ClipPosition * out_clip);
+void ShadeVertices_AVX512(VertexStreamsView const & vertices, uint32_t begin, uint32_t end, VertexShadingMatrices const & matrices, OutputVertexAttributes * out, ClipPosition * out_clip);
+#endif
+
+ShadeVerticesFn GetShadeVerticesFn(SimdLevel level);
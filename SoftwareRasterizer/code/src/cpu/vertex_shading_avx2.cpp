@@ -0,0 +1,48 @@
+#include "vertex_shading.hpp"
+#include "vertex_shading_common.hpp"
+
+#if SIMD_X86
+
+// Column `c` of pos * mat for 8 positions with w = 1.
+SIMD_TARGET_AVX2
+static SIMD_FORCEINLINE __m256 TransformColumn_AVX2(Matrix4x4 const & mat, uint32_t c, __m256 x, __m256 y, __m256 z) {
+    __m256 ret = _mm256_fmadd_ps(x, _mm256_set1_ps(mat.m[0][c]), _mm256_set1_ps(mat.m[3][c]));
+    ret = _mm256_fmadd_ps(y, _mm256_set1_ps(mat.m[1][c]), ret);
+    return _mm256_fmadd_ps(z, _mm256_set1_ps(mat.m[2][c]), ret);
+}
+
+SIMD_TARGET_AVX2
+void ShadeVertices_AVX2(VertexStreamsView const & vertices, uint32_t begin, uint32_t end, VertexShadingMatrices const & matrices, OutputVertexAttributes * out, ClipPosition * out_clip) {
+    constexpr uint32_t Lanes = 8;
+    float const * const * const streams = vertices.streams;
+    uint32_t i = begin;
+    for(; i + Lanes <= end; i += Lanes) {
+        __m256 const x = _mm256_loadu_ps(&streams[VertexStreamPos + 0][i]);
+        __m256 const y = _mm256_loadu_ps(&streams[VertexStreamPos + 1][i]);
+        __m256 const z = _mm256_loadu_ps(&streams[VertexStreamPos + 2][i]);
+
+        Matrix4x4 const & mvp = matrices.model_view_proj;
+        Matrix4x4 const & model = matrices.model;
+        __m256 const clip_x = TransformColumn_AVX2(mvp, 0, x, y, z);
+        __m256 const clip_y = TransformColumn_AVX2(mvp, 1, x, y, z);
+        __m256 const clip_z = TransformColumn_AVX2(mvp, 2, x, y, z);
+        __m256 const clip_w = TransformColumn_AVX2(mvp, 3, x, y, z);
+        __m256 const world_x = TransformColumn_AVX2(model, 0, x, y, z);
+        __m256 const world_y = TransformColumn_AVX2(model, 1, x, y, z);
+        __m256 const world_z = TransformColumn_AVX2(model, 2, x, y, z);
+        __m256 const world_w = TransformColumn_AVX2(model, 3, x, y, z);
+
+        // Stores go through the SSE transposes a half at a time.
+        StoreShadedVertices_SSE(vertices, i,
+            _mm256_castps256_ps128(clip_x), _mm256_castps256_ps128(clip_y), _mm256_castps256_ps128(clip_z), _mm256_castps256_ps128(clip_w),
+            _mm256_castps256_ps128(world_x), _mm256_castps256_ps128(world_y), _mm256_castps256_ps128(world_z), _mm256_castps256_ps128(world_w),
+            out, out_clip);
+        StoreShadedVertices_SSE(vertices, i + 4,
+            _mm256_extractf128_ps(clip_x, 1), _mm256_extractf128_ps(clip_y, 1), _mm256_extractf128_ps(clip_z, 1), _mm256_extractf128_ps(clip_w, 1),
+            _mm256_extractf128_ps(world_x, 1), _mm256_extractf128_ps(world_y, 1), _mm256_extractf128_ps(world_z, 1), _mm256_extractf128_ps(world_w, 1),
+            out, out_clip);
+    }
+    ShadeVertices_Scalar(vertices, i, end, matrices, out, out_clip);
+}
+
+#endif // SIMD_X86
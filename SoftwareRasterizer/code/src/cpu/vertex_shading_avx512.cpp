@@ -0,0 +1,48 @@
+#include "vertex_shading.hpp"
+#include "vertex_shading_common.hpp"
+
+#if SIMD_X86
+
+// Column `c` of pos * mat for 16 positions with w = 1.
+SIMD_TARGET_AVX512
+static SIMD_FORCEINLINE __m512 TransformColumn_AVX512(Matrix4x4 const & mat, uint32_t c, __m512 x, __m512 y, __m512 z) {
+    __m512 ret = _mm512_fmadd_ps(x, _mm512_set1_ps(mat.m[0][c]), _mm512_set1_ps(mat.m[3][c]));
+    ret = _mm512_fmadd_ps(y, _mm512_set1_ps(mat.m[1][c]), ret);
+    return _mm512_fmadd_ps(z, _mm512_set1_ps(mat.m[2][c]), ret);
+}
+
+SIMD_TARGET_AVX512
+void ShadeVertices_AVX512(VertexStreamsView const & vertices, uint32_t begin, uint32_t end, VertexShadingMatrices const & matrices, OutputVertexAttributes * out, ClipPosition * out_clip) {
+    constexpr uint32_t Lanes = 16;
+    float const * const * const streams = vertices.streams;
+    uint32_t i = begin;
+    for(; i + Lanes <= end; i += Lanes) {
+        __m512 const x = _mm512_loadu_ps(&streams[VertexStreamPos + 0][i]);
+        __m512 const y = _mm512_loadu_ps(&streams[VertexStreamPos + 1][i]);
+        __m512 const z = _mm512_loadu_ps(&streams[VertexStreamPos + 2][i]);
+
+        Matrix4x4 const & mvp = matrices.model_view_proj;
+        Matrix4x4 const & model = matrices.model;
+        // Spilled so the quarters can be loaded with a runtime index, _mm512_extractf32x4_ps wants an immediate.
+        alignas(64) float pos[8][Lanes];
+        _mm512_store_ps(pos[0], TransformColumn_AVX512(mvp, 0, x, y, z));
+        _mm512_store_ps(pos[1], TransformColumn_AVX512(mvp, 1, x, y, z));
+        _mm512_store_ps(pos[2], TransformColumn_AVX512(mvp, 2, x, y, z));
+        _mm512_store_ps(pos[3], TransformColumn_AVX512(mvp, 3, x, y, z));
+        _mm512_store_ps(pos[4], TransformColumn_AVX512(model, 0, x, y, z));
+        _mm512_store_ps(pos[5], TransformColumn_AVX512(model, 1, x, y, z));
+        _mm512_store_ps(pos[6], TransformColumn_AVX512(model, 2, x, y, z));
+        _mm512_store_ps(pos[7], TransformColumn_AVX512(model, 3, x, y, z));
+
+        // Stores go through the SSE transposes a quarter at a time.
+        for(uint32_t q = 0; q < Lanes; q += 4) {
+            StoreShadedVertices_SSE(vertices, i + q,
+                _mm_load_ps(&pos[0][q]), _mm_load_ps(&pos[1][q]), _mm_load_ps(&pos[2][q]), _mm_load_ps(&pos[3][q]),
+                _mm_load_ps(&pos[4][q]), _mm_load_ps(&pos[5][q]), _mm_load_ps(&pos[6][q]), _mm_load_ps(&pos[7][q]),
+                out, out_clip);
+        }
+    }
+    ShadeVertices_Scalar(vertices, i, end, matrices, out, out_clip);
+}
+
+#endif // SIMD_X86
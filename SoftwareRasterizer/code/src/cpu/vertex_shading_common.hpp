@@ -0,0 +1,104 @@
+#pragma once
+
+#include "vertex_shading.hpp"
+
+// Helpers shared by the vertex shading kernels of every SIMD level, see simd.hpp on why they are force inlined.
+
+#if SIMD_X86
+
+// Column `c` of pos * mat for 4 positions with w = 1.
+static SIMD_FORCEINLINE __m128 TransformColumn_SSE(Matrix4x4 const & mat, uint32_t c, __m128 x, __m128 y, __m128 z) {
+    return _mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(mat.m[0][c])), _mm_mul_ps(y, _mm_set1_ps(mat.m[1][c]))),
+        _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(mat.m[2][c])), _mm_set1_ps(mat.m[3][c])));
+}
+
+// Transposes 4 shaded positions back to AoS and stores them as vertices [first, first + 4) of `out` / `out_clip`.
+// clip_* / world_* hold one component per register.
+static SIMD_FORCEINLINE void StoreShadedPositions_SSE(
+    uint32_t first,
+    __m128 clip_x, __m128 clip_y, __m128 clip_z, __m128 clip_w,
+    __m128 world_x, __m128 world_y, __m128 world_z, __m128 world_w,
+    OutputVertexAttributes * out,
+    ClipPosition * out_clip)
+{
+    OutputVertexAttributes * const o = &out[first];
+
+    __m128 const inv_w = _mm_div_ps(_mm_set1_ps(1.0f), clip_w);
+    __m128 ndc_x = _mm_mul_ps(clip_x, inv_w);
+    __m128 ndc_y = _mm_mul_ps(clip_y, inv_w);
+    __m128 ndc_z = _mm_mul_ps(clip_z, inv_w);
+    __m128 ndc_w = inv_w;
+    _MM_TRANSPOSE4_PS(ndc_x, ndc_y, ndc_z, ndc_w);
+    _mm_storeu_ps(o[0].pos_ndc, ndc_x);
+    _mm_storeu_ps(o[1].pos_ndc, ndc_y);
+    _mm_storeu_ps(o[2].pos_ndc, ndc_z);
+    _mm_storeu_ps(o[3].pos_ndc, ndc_w);
+
+    _MM_TRANSPOSE4_PS(world_x, world_y, world_z, world_w);
+    _mm_storeu_ps(o[0].pos_world, world_x);
+    _mm_storeu_ps(o[1].pos_world, world_y);
+    _mm_storeu_ps(o[2].pos_world, world_z);
+    _mm_storeu_ps(o[3].pos_world, world_w);
+
+    if(nullptr != out_clip) {
+        _MM_TRANSPOSE4_PS(clip_x, clip_y, clip_z, clip_w);
+        _mm_storeu_ps(out_clip[first + 0].pos_clip, clip_x);
+        _mm_storeu_ps(out_clip[first + 1].pos_clip, clip_y);
+        _mm_storeu_ps(out_clip[first + 2].pos_clip, clip_z);
+        _mm_storeu_ps(out_clip[first + 3].pos_clip, clip_w);
+    }
+}
+
+// Same for the attributes passed through to the fragments, one component per register.
+static SIMD_FORCEINLINE void StorePassedAttributes_SSE(
+    uint32_t first,
+    __m128 normal_x, __m128 normal_y, __m128 normal_z, __m128 normal_w,
+    __m128 r, __m128 g, __m128 b, __m128 a,
+    __m128 u, __m128 v,
+    OutputVertexAttributes * out)
+{
+    OutputVertexAttributes * const o = &out[first];
+
+    _MM_TRANSPOSE4_PS(normal_x, normal_y, normal_z, normal_w);
+    _mm_storeu_ps(o[0].normal_world, normal_x);
+    _mm_storeu_ps(o[1].normal_world, normal_y);
+    _mm_storeu_ps(o[2].normal_world, normal_z);
+    _mm_storeu_ps(o[3].normal_world, normal_w);
+
+    _MM_TRANSPOSE4_PS(r, g, b, a);
+    _mm_storeu_ps(o[0].col, r);
+    _mm_storeu_ps(o[1].col, g);
+    _mm_storeu_ps(o[2].col, b);
+    _mm_storeu_ps(o[3].col, a);
+
+    __m128 const uv_01 = _mm_unpacklo_ps(u, v);
+    __m128 const uv_23 = _mm_unpackhi_ps(u, v);
+    _mm_storel_pi(reinterpret_cast<__m64 *>(o[0].uv), uv_01);
+    _mm_storeh_pi(reinterpret_cast<__m64 *>(o[1].uv), uv_01);
+    _mm_storel_pi(reinterpret_cast<__m64 *>(o[2].uv), uv_23);
+    _mm_storeh_pi(reinterpret_cast<__m64 *>(o[3].uv), uv_23);
+}
+
+// Both of the above for VertexStreams. The passed through streams (normal, color, uv) are loaded here, they
+// never need to be in registers at the same time as the positions.
+static SIMD_FORCEINLINE void StoreShadedVertices_SSE(
+    VertexStreamsView const & vertices,
+    uint32_t first,
+    __m128 clip_x, __m128 clip_y, __m128 clip_z, __m128 clip_w,
+    __m128 world_x, __m128 world_y, __m128 world_z, __m128 world_w,
+    OutputVertexAttributes * out,
+    ClipPosition * out_clip)
+{
+    float const * const * const streams = vertices.streams;
+    StoreShadedPositions_SSE(first, clip_x, clip_y, clip_z, clip_w, world_x, world_y, world_z, world_w, out, out_clip);
+    StorePassedAttributes_SSE(first,
+        _mm_loadu_ps(&streams[VertexStreamNormal + 0][first]), _mm_loadu_ps(&streams[VertexStreamNormal + 1][first]),
+        _mm_loadu_ps(&streams[VertexStreamNormal + 2][first]), _mm_loadu_ps(&streams[VertexStreamNormal + 3][first]),
+        _mm_loadu_ps(&streams[VertexStreamColor + 0][first]), _mm_loadu_ps(&streams[VertexStreamColor + 1][first]),
+        _mm_loadu_ps(&streams[VertexStreamColor + 2][first]), _mm_loadu_ps(&streams[VertexStreamColor + 3][first]),
+        _mm_loadu_ps(&streams[VertexStreamUV + 0][first]), _mm_loadu_ps(&streams[VertexStreamUV + 1][first]),
+        out);
+}
+
+#endif // SIMD_X86
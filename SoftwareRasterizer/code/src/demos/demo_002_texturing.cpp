@@ -5,9 +5,10 @@
 
 #include "../demo_framework.hpp"
 
-#define STBI_WINDOWS_UTF8
-#define STB_IMAGE_IMPLEMENTATION
-#include "../dep/include/stb/stb_image.h"
+#include "../cpu/asset_loader.hpp"
+#include "../cpu/texture.hpp"
+#include "../cpu/texture_benchmark.hpp"
+#include "../cpu/thread_pool.hpp"
 
 class Demo_002_Texturing : public Demo {
 protected:
@@ -32,17 +33,33 @@ private:
     ID3D12GraphicsCommandList * direct_cmd_list [FrameQueueLength] = {};
     ID3D12GraphicsCommandList * copy_cmd_list = nullptr;
 
-    // Used for Texture
+    // Used for Texture: a placeholder checkerboard until the asset loader finishes the real one
     ID3D12Resource * my_texture_resource = nullptr;
     ID3D12DescriptorHeap * cbv_srv_uav_heap = nullptr;
     uint32_t cbv_srv_uav_handle_increment_size = 0;
 
+    AssetLoader asset_loader;
+    TextureCache texture_cache;
+    AssetHandle texture_asset = InvalidAssetHandle;
+    bool texture_loaded = false;
+    std::vector<AssetCompletion> asset_completions;
+
     ID3D12DescriptorHeap * rtv_heap = nullptr;
     uint32_t rtv_handle_increment_size = 0;
 
     ID3D12RootSignature * root_signature = nullptr;
     ID3D12PipelineState * graphics_pso = nullptr;
 
+    // CPU copy of the texture (Linear layout, as uploaded) for the sampler benchmark, empty until loaded
+    Texture cpu_texture = {};
+    TextureSampler cpu_sampler = {};
+    float benchmark_texels_per_pixel = 1.0f;
+    bool benchmark_done = false;
+    TextureLayoutBenchmark layout_benchmark[TextureBenchmarkAngleCount] = {};
+    float format_benchmark_angle = 0.0f;
+    bool format_benchmark_done = false;
+    TextureFormatBenchmark format_benchmark[TextureBenchmarkFormatCount] = {};
+
     Mesh mesh = {};
     ID3D12Resource * vertex_buffer  = nullptr;
     ID3D12Resource * index_buffer   = nullptr;
@@ -114,6 +131,9 @@ private:
         fence->Release();
         CloseHandle(event);
     }
+
+    ID3D12Resource * UploadTexture(Texture const & texture);
+    void CreateTextureSRV(ID3D12Resource * texture_resource, uint32_t mip_count);
 };
 
 static auto _ = Demo_Register("Texturing", [] { return new Demo_002_Texturing(); });
@@ -121,6 +141,14 @@ static auto _ = Demo_Register("Texturing", [] { return new Demo_002_Texturing();
 bool Demo_002_Texturing::DoInitResources() {
     bool vsync_on = false;
 
+    // Decoded and mip mapped on the loader's threads while the device objects below are created, or mapped from
+    // the texture cache after the first run
+    asset_loader.Init(0);
+    if(texture_cache.Init("../cache/textures")) {
+        asset_loader.SetTextureCache(&texture_cache);
+    }
+    texture_asset = asset_loader.RequestTexture("../assets/directx.png", TextureBuildOptions());
+
     // Create Swapchain 
     IDXGISwapChain1 * swap_chain1 = nullptr;
     DXGI_SWAP_CHAIN_DESC1 swap_chain_desc = {};
@@ -191,123 +219,23 @@ bool Demo_002_Texturing::DoInitResources() {
         device->CreateDescriptorHeap(&heap_desc, IID_PPV_ARGS(&cbv_srv_uav_heap));
     }
 
-    // Load Image via STB into Memory and Then into a D3D12Resource
+    // Draw with a checkerboard until the loader has the real texture, see OnUpdate
     {
-        // Load PNG from File
-        int img_w, img_h, image_c;
-        stbi_uc* image_data = stbi_load("../assets/directx.png", &img_w, &img_h, &image_c, STBI_rgb_alpha);
-        size_t bytes_per_pixel = 4;
-        size_t bytes_per_row = img_w * bytes_per_pixel;
-        size_t image_bytes = bytes_per_row * img_h;
-        ASSERT(nullptr != image_data);
-        CONSUME_VAR(image_bytes);
-        
-        D3D12_HEAP_PROPERTIES   default_heap_props      = GetDefaultHeapProps(D3D12_HEAP_TYPE_DEFAULT);
-
-        D3D12_RESOURCE_DESC texture_resource_desc = {};
-        texture_resource_desc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
-        texture_resource_desc.Alignment = 0;
-        texture_resource_desc.Width = img_w;
-        texture_resource_desc.Height = img_h;
-        texture_resource_desc.DepthOrArraySize = 1;
-        texture_resource_desc.MipLevels = 1;
-        texture_resource_desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-        texture_resource_desc.SampleDesc.Count = 1;
-        texture_resource_desc.SampleDesc.Quality = 0;
-        texture_resource_desc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
-        texture_resource_desc.Flags = D3D12_RESOURCE_FLAG_NONE;
-
-        res = device->CreateCommittedResource(&default_heap_props,
-            D3D12_HEAP_FLAG_NONE,
-            &texture_resource_desc,
-            D3D12_RESOURCE_STATE_COPY_DEST,
-            nullptr,
-            IID_PPV_ARGS(&my_texture_resource));
-        CHECK_AND_FAIL(res);
-        
-        // Aligned
-        uint32_t alignment = D3D12_TEXTURE_DATA_PITCH_ALIGNMENT;
-        uint64_t dest_row_size_in_bytes = (((uint64_t)bytes_per_row  + alignment - 1) / alignment) * alignment; ;
-        
-        uint64_t texture_upload_buffer_size = 0;// = (uint64_t)image_bytes;
-        uint32_t num_rows = 0;// = img_h;
-        uint64_t row_size_in_bytes = 0; // 
-        D3D12_PLACED_SUBRESOURCE_FOOTPRINT placed_subresource_foot_print = {};
-        device->GetCopyableFootprints(&texture_resource_desc, 0, 1, 0, &placed_subresource_foot_print, &num_rows, &row_size_in_bytes, &texture_upload_buffer_size);
-        
-        CONSUME_VAR(row_size_in_bytes);
-
-        ID3D12Resource * staging_buffer = nullptr;
-
-        // Staging
-        D3D12_HEAP_PROPERTIES   staging_heap_props      = GetDefaultHeapProps(D3D12_HEAP_TYPE_UPLOAD);
-        D3D12_RESOURCE_DESC     staging_resource_desc   = GetBufferResourceDesc(texture_upload_buffer_size);
-        res = device->CreateCommittedResource(&staging_heap_props,
-            D3D12_HEAP_FLAG_NONE,
-            &staging_resource_desc,
-            D3D12_RESOURCE_STATE_GENERIC_READ | D3D12_RESOURCE_STATE_COPY_SOURCE,
-            nullptr,
-            IID_PPV_ARGS(&staging_buffer));
-        CHECK_AND_FAIL(res);
-
-        D3D12_RANGE read_range = {}; read_range.Begin = 0; read_range.End = 0;
-        using Byte = uint8_t;
-        Byte * data_dst = nullptr;
-        res = staging_buffer->Map(0, &read_range, reinterpret_cast<void**>(&data_dst)); CHECK_AND_FAIL(res);
-        
-        for(uint32_t y = 0; y < num_rows; ++y) {
-            memcpy (data_dst + y * dest_row_size_in_bytes,
-                    image_data + y * bytes_per_row,
-                    row_size_in_bytes);
-        }
-        
-        staging_buffer->Unmap(0, nullptr); 
-
-        {
-            direct_cmd_list[0]->Reset(direct_cmd_allocator, nullptr);
-
-            D3D12_RESOURCE_BARRIER barrier = {};
-            barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-            barrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
-
-            D3D12_TEXTURE_COPY_LOCATION dst = {};
-            dst.pResource = my_texture_resource;
-            dst.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
-            dst.SubresourceIndex = 0;
-
-            D3D12_TEXTURE_COPY_LOCATION src = {};
-            src.pResource = staging_buffer;
-            src.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
-            src.PlacedFootprint = placed_subresource_foot_print;
-
-            direct_cmd_list[0]->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
-
-            barrier.Transition.pResource = my_texture_resource;
-            barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_DEST;
-            barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
-            direct_cmd_list[0]->ResourceBarrier(1, &barrier);
-            direct_cmd_list[0]->Close();
-            
-            ID3D12CommandList * execute_cmds[1] = { direct_cmd_list[0] };
-            direct_queue->ExecuteCommandLists(1, execute_cmds);
-
-            WaitForQueue(direct_queue);
-        }
-
-        staging_buffer->Release();
-        stbi_image_free(image_data);
-        
-
-        D3D12_CPU_DESCRIPTOR_HANDLE current_srv_handle = cbv_srv_uav_heap->GetCPUDescriptorHandleForHeapStart();
-        // Create SRV Handle for our Sample Texture
-        {
-            D3D12_SHADER_RESOURCE_VIEW_DESC srv_desc = {};
-            srv_desc.Format = texture_resource_desc.Format;
-            srv_desc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-            srv_desc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-            srv_desc.Texture2D.MipLevels = 1;
-            device->CreateShaderResourceView(my_texture_resource, &srv_desc, current_srv_handle);
+        constexpr uint32_t PlaceholderSize = 64;
+        constexpr uint32_t PlaceholderCheckerSize = 8;
+        std::vector<uint32_t> checkerboard(PlaceholderSize * PlaceholderSize);
+        for(uint32_t y = 0; y < PlaceholderSize; ++y) {
+            for(uint32_t x = 0; x < PlaceholderSize; ++x) {
+                bool const odd = 0 != (((x / PlaceholderCheckerSize) ^ (y / PlaceholderCheckerSize)) & 1);
+                checkerboard[y * PlaceholderSize + x] = (odd) ? 0xFFFF00FF : 0xFF202020;
+            }
         }
+        Texture placeholder = {};
+        bool built = BuildTexture(reinterpret_cast<uint8_t const *>(checkerboard.data()), PlaceholderSize, PlaceholderSize, TextureBuildOptions(), placeholder, nullptr);
+        ASSERT(built);
+        CONSUME_VAR(built);
+        my_texture_resource = UploadTexture(placeholder);
+        CreateTextureSRV(my_texture_resource, static_cast<uint32_t>(placeholder.mips.size()));
     }
 
     IDxcBlob * vertex_shader = Demo::CompileShaderFromFile(L"../code/src/shaders/demo002/simple_mesh.vert.hlsl", L"VSMain", L"vs_6_0");
@@ -604,7 +532,126 @@ bool Demo_002_Texturing::DoInitResources() {
     return true;
 }
 
+// Uploads every mip level of `texture` (RGBA8, Linear layout) into a new resource ready to be sampled. Waits for
+// the copy on the direct queue.
+ID3D12Resource * Demo_002_Texturing::UploadTexture(Texture const & texture) {
+    ASSERT(TextureFormat::RGBA8 == texture.format && TextureLayout::Linear == texture.layout);
+    uint32_t const mip_count = static_cast<uint32_t>(texture.mips.size());
+    
+    ID3D12Resource * texture_resource = nullptr;
+    D3D12_HEAP_PROPERTIES   default_heap_props      = GetDefaultHeapProps(D3D12_HEAP_TYPE_DEFAULT);
+
+    D3D12_RESOURCE_DESC texture_resource_desc = {};
+    texture_resource_desc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+    texture_resource_desc.Alignment = 0;
+    texture_resource_desc.Width = texture.width;
+    texture_resource_desc.Height = texture.height;
+    texture_resource_desc.DepthOrArraySize = 1;
+    texture_resource_desc.MipLevels = static_cast<UINT16>(mip_count);
+    texture_resource_desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    texture_resource_desc.SampleDesc.Count = 1;
+    texture_resource_desc.SampleDesc.Quality = 0;
+    texture_resource_desc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
+    texture_resource_desc.Flags = D3D12_RESOURCE_FLAG_NONE;
+
+    HRESULT res = device->CreateCommittedResource(&default_heap_props,
+        D3D12_HEAP_FLAG_NONE,
+        &texture_resource_desc,
+        D3D12_RESOURCE_STATE_COPY_DEST,
+        nullptr,
+        IID_PPV_ARGS(&texture_resource));
+    CHECK_AND_FAIL(res);
+    
+    uint64_t texture_upload_buffer_size = 0;
+    D3D12_PLACED_SUBRESOURCE_FOOTPRINT placed_subresource_foot_prints[TextureMaxMips] = {};
+    uint32_t num_rows[TextureMaxMips] = {};
+    uint64_t row_size_in_bytes[TextureMaxMips] = {};
+    device->GetCopyableFootprints(&texture_resource_desc, 0, mip_count, 0, placed_subresource_foot_prints, num_rows, row_size_in_bytes, &texture_upload_buffer_size);
+
+    ID3D12Resource * staging_buffer = nullptr;
+
+    // Staging
+    D3D12_HEAP_PROPERTIES   staging_heap_props      = GetDefaultHeapProps(D3D12_HEAP_TYPE_UPLOAD);
+    D3D12_RESOURCE_DESC     staging_resource_desc   = GetBufferResourceDesc(texture_upload_buffer_size);
+    res = device->CreateCommittedResource(&staging_heap_props,
+        D3D12_HEAP_FLAG_NONE,
+        &staging_resource_desc,
+        D3D12_RESOURCE_STATE_GENERIC_READ | D3D12_RESOURCE_STATE_COPY_SOURCE,
+        nullptr,
+        IID_PPV_ARGS(&staging_buffer));
+    CHECK_AND_FAIL(res);
+
+    D3D12_RANGE read_range = {}; read_range.Begin = 0; read_range.End = 0;
+    using Byte = uint8_t;
+    Byte * data_dst = nullptr;
+    res = staging_buffer->Map(0, &read_range, reinterpret_cast<void**>(&data_dst)); CHECK_AND_FAIL(res);
+    
+    for(uint32_t m = 0; m < mip_count; ++m) {
+        D3D12_PLACED_SUBRESOURCE_FOOTPRINT const & foot_print = placed_subresource_foot_prints[m];
+        TextureMip const & mip = texture.mips[m];
+        for(uint32_t y = 0; y < num_rows[m]; ++y) {
+            memcpy (data_dst + foot_print.Offset + y * foot_print.Footprint.RowPitch,
+                    texture.texels.data() + mip.offset + y * mip.width,
+                    row_size_in_bytes[m]);
+        }
+    }
+    
+    staging_buffer->Unmap(0, nullptr); 
+
+    {
+        direct_cmd_list[0]->Reset(direct_cmd_allocator, nullptr);
+
+        D3D12_RESOURCE_BARRIER barrier = {};
+        barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+        barrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+
+        for(uint32_t m = 0; m < mip_count; ++m) {
+            D3D12_TEXTURE_COPY_LOCATION dst = {};
+            dst.pResource = texture_resource;
+            dst.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
+            dst.SubresourceIndex = m;
+
+            D3D12_TEXTURE_COPY_LOCATION src = {};
+            src.pResource = staging_buffer;
+            src.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
+            src.PlacedFootprint = placed_subresource_foot_prints[m];
+
+            direct_cmd_list[0]->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+        }
+
+        barrier.Transition.pResource = texture_resource;
+        barrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+        barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_DEST;
+        barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
+        direct_cmd_list[0]->ResourceBarrier(1, &barrier);
+        direct_cmd_list[0]->Close();
+        
+        ID3D12CommandList * execute_cmds[1] = { direct_cmd_list[0] };
+        direct_queue->ExecuteCommandLists(1, execute_cmds);
+
+        WaitForQueue(direct_queue);
+    }
+
+    staging_buffer->Release();
+
+    return texture_resource;
+}
+
+// (Re)writes the texture's SRV, the first descriptor of the heap
+void Demo_002_Texturing::CreateTextureSRV(ID3D12Resource * texture_resource, uint32_t mip_count) {
+    D3D12_CPU_DESCRIPTOR_HANDLE current_srv_handle = cbv_srv_uav_heap->GetCPUDescriptorHandleForHeapStart();
+    D3D12_SHADER_RESOURCE_VIEW_DESC srv_desc = {};
+    srv_desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    srv_desc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+    srv_desc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+    srv_desc.Texture2D.MipLevels = mip_count;
+    device->CreateShaderResourceView(texture_resource, &srv_desc, current_srv_handle);
+}
+
 bool Demo_002_Texturing::DoExitResources() { 
+    asset_loader.Exit();
+    texture_cache.Exit();
+
     WaitForQueue(direct_queue);
     
     Demo::ExitUI();
@@ -652,9 +699,76 @@ void Demo_002_Texturing::OnUI() {
 
     // 1. Show the big demo window (Most of the sample code is in ImGui::ShowDemoWindow()! You can browse its code to learn more about Dear ImGui!).
     // ImGui::ShowDemoWindow(&show_demo_window);
+    ImGui::Begin("Settings", &show_demo_window);
+
+    AssetLoaderStats const loader_stats = asset_loader.GetStats();
+    ImGui::Text("Assets: %u loaded, %u failed, %u pending, %.1f ms (%.1f ms one after the other, slowest %.1f ms)",
+        loader_stats.loaded, loader_stats.failed, loader_stats.pending, loader_stats.wall_ms, loader_stats.sum_load_ms, loader_stats.max_load_ms);
+    TextureCacheStats const cache_stats = texture_cache.GetStats();
+    ImGui::Text("Texture cache: %llu hits (%.1f ms), %llu misses (%.1f ms), %llu invalid", static_cast<unsigned long long>(cache_stats.hits),
+        cache_stats.hit_ms, static_cast<unsigned long long>(cache_stats.misses), cache_stats.miss_ms, static_cast<unsigned long long>(cache_stats.invalid));
+    if(false == texture_loaded) {
+        bool const failed = AssetState::Failed == asset_loader.GetState(texture_asset);
+        ImGui::Text("Texture: %s, drawing the placeholder", (failed) ? "failed to load" : "loading");
+        ImGui::End();
+        return;
+    }
+    ImGui::Text("Texture: %u x %u, %u mips", cpu_texture.width, cpu_texture.height, static_cast<uint32_t>(cpu_texture.mips.size()));
+    int filter = static_cast<int>(cpu_sampler.filter);
+    if(ImGui::Combo("CPU Sampler Filter", &filter, "Point\0Bilinear\0Trilinear\0")) {
+        cpu_sampler.filter = static_cast<TextureFilter>(filter);
+    }
+    ImGui::SliderFloat("Texels per Pixel", &benchmark_texels_per_pixel, 0.25f, 8.0f);
+    if(ImGui::Button("Benchmark Linear vs Tiled Layout")) {
+        BenchmarkTextureLayouts(cpu_texture, cpu_sampler, benchmark_texels_per_pixel, 1024, 4, nullptr, layout_benchmark);
+        benchmark_done = true;
+    }
+    if(benchmark_done) {
+        for(uint32_t i = 0; i < TextureBenchmarkAngleCount; ++i) {
+            TextureLayoutBenchmark const & result = layout_benchmark[i];
+            ImGui::Text("%4.0f deg: linear %6.2f ms, tiled %6.2f ms (%.2fx)", result.linear.angle_degrees,
+                result.linear.ms, result.tiled.ms, result.linear.ms / result.tiled.ms);
+        }
+    }
+
+    ImGui::SliderFloat("Rotation (degrees)", &format_benchmark_angle, 0.0f, 90.0f);
+    if(ImGui::Button("Benchmark RGBA8 vs BC1 / BC3 / BC7")) {
+        ThreadPool compress_thread_pool;
+        BenchmarkTextureFormats(cpu_texture, cpu_sampler, format_benchmark_angle, benchmark_texels_per_pixel, 1024, 4, &compress_thread_pool, format_benchmark);
+        format_benchmark_done = true;
+    }
+    if(format_benchmark_done) {
+        static char const * const format_names[] = { "RGBA8", "BC1", "BC3", "BC7" };
+        for(uint32_t i = 0; i < TextureBenchmarkFormatCount; ++i) {
+            TextureFormatBenchmark const & result = format_benchmark[i];
+            ImGui::Text("%-5s: %7.2f MB, %6.2f ms (%.2fx), block hits %5.1f%%, RMS error %.2f, compressed in %.0f ms",
+                format_names[static_cast<uint32_t>(result.format)], static_cast<double>(result.bytes) / (1024.0 * 1024.0),
+                result.result.ms, format_benchmark[0].result.ms / result.result.ms, result.result.block_hit_rate * 100.0f,
+                result.rms_error, result.compress_ms);
+        }
+    }
+
+    ImGui::End();
 }
 
 void Demo_002_Texturing::OnUpdate() {
+    asset_completions.clear();
+    asset_loader.PollCompletions(asset_completions);
+    for(AssetCompletion const & completion : asset_completions) {
+        if(texture_asset != completion.handle || false == completion.loaded) {
+            continue;
+        }
+        bool taken = asset_loader.TakeTexture(completion.handle, cpu_texture);
+        ASSERT(taken);
+        CONSUME_VAR(taken);
+
+        // The placeholder may still be read by frames in flight
+        WaitForQueue(direct_queue);
+        my_texture_resource->Release();
+        my_texture_resource = UploadTexture(cpu_texture);
+        CreateTextureSRV(my_texture_resource, static_cast<uint32_t>(cpu_texture.mips.size()));
+        texture_loaded = true;
+    }
 }
 
 void Demo_002_Texturing::OnRender() {
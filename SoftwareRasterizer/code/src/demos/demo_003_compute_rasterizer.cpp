@@ -5,6 +5,18 @@
 
 #include "../demo_framework.hpp"
 
+#include "../cpu/thread_pool.hpp"
+#include "../cpu/vertex_shading.hpp"
+#include "../cpu/vertex_quantization.hpp"
+#include "../cpu/primitive_assembly.hpp"
+#include "../cpu/meshlets.hpp"
+#include "../cpu/mesh_optimizer.hpp"
+#include "../cpu/mesh_lod.hpp"
+#include "../cpu/mesh_file.hpp"
+#include "../cpu/obj_importer.hpp"
+#include "../cpu/tile_rasterizer.hpp"
+#include "../cpu/color_output.hpp"
+
 class Demo_003_RasterizerCompute : public Demo {
 protected:
     virtual bool DoInitResources() override;
@@ -18,6 +30,21 @@ private:
     static constexpr uint32_t FrameQueueLength = 2;
 
     bool use_software_rasterizer = true;
+    // Runs vertex shading and rasterization on the CPU (cpu/) and uploads the fragments for fragment_shading.comp.hlsl
+    bool use_cpu_rasterizer = false;
+    // CPU rasterizer writes and uploads PackedFragments, shaded by fragment_shading_packed.comp.hlsl
+    bool use_packed_fragments = false;
+    // CPU path shades the fragments itself (color_output.hpp) and uploads the RGBA8 image into frame_buffer,
+    // instead of uploading the fragments for fragment_shading.comp.hlsl. Fragment buffers only, not packed.
+    bool use_cpu_fragment_shading = false;
+    bool use_srgb_output = false;
+    // CPU path culls meshlets before vertex shading and only shades the vertices of the visible ones
+    bool use_meshlet_culling = false;
+    // CPU path shades from QuantizedVertexStreams (18 bytes per vertex) instead of float VertexStreams
+    bool use_quantized_vertices = false;
+    // Draws the coarsest LOD of mesh_lods within lod_max_pixel_error, LOD 0 otherwise (all paths but meshlet culling)
+    bool use_mesh_lods = false;
+    float lod_max_pixel_error = 1.0f;
  
     // SwapChain and It's RenderTarget Resources
     IDXGISwapChain4 * swap_chain = nullptr;
@@ -36,7 +63,17 @@ private:
     ID3D12RootSignature * root_signature = nullptr;
     ID3D12PipelineState * graphics_pso = nullptr;
 
+    // Imported or generated mesh, only used when there's no mesh file
     Mesh mesh = {};
+    bool mesh_imported = false;
+    ObjImportStats mesh_import_stats = {};
+    MappedMeshFile mesh_file = {};
+    // What everything draws: points into mesh_file when it's open, into mesh otherwise
+    MeshView mesh_view = {};
+    MeshOptimizationStats mesh_optimization_stats = {};
+    // Index buffer holds every LOD, current_lod is the one drawn this frame
+    MeshLodChain mesh_lods = {};
+    uint32_t current_lod = 0;
     ID3D12Resource * vertex_buffer  = nullptr;
     ID3D12Resource * index_buffer   = nullptr;
     size_t vertex_buffer_bytes  = 0;
@@ -85,6 +122,8 @@ private:
         float       col[4];
         float       uv[2];
     };
+    static_assert(sizeof(OutputVertexAttributes) == sizeof(::OutputVertexAttributes));
+    static_assert(sizeof(Fragment) == sizeof(::Fragment));
 
     // Resources 
 
@@ -94,6 +133,26 @@ private:
     ID3D12Resource * transformed_vertices_buffer[FrameQueueLength] = {}; 
     ID3D12Resource * mvp_buffer[FrameQueueLength] = {}; 
 
+    // CPU Rasterization
+    ThreadPool * cpu_thread_pool = nullptr;
+    PrimitiveAssembler cpu_primitive_assembler = {};
+    TileRasterizer cpu_rasterizer = {};
+    VertexTransforms cpu_transforms = {};
+    VertexStreams cpu_vertex_streams = {};
+    QuantizedVertexStreams cpu_quantized_vertex_streams = {};
+    MeshletMesh cpu_meshlet_mesh = {};
+    VertexStreams cpu_meshlet_vertex_streams = {};
+    MeshletCuller cpu_meshlet_culler = {};
+    std::vector<VertexRange> cpu_meshlet_vertex_ranges;
+    std::vector<IndexType> cpu_meshlet_indices;
+    std::vector<::OutputVertexAttributes> cpu_transformed_vertices;
+    std::vector<ClipPosition> cpu_clip_positions;
+    std::vector<IndexType> cpu_assembled_indices;
+    std::vector<::Fragment> cpu_fragments;
+    std::vector<PackedFragment> cpu_packed_fragments;
+    std::vector<::Fragment> cpu_resolved_fragments;
+    ID3D12Resource * fragment_upload_buffer[FrameQueueLength] = {};
+
     ID3D12DescriptorHeap * cbv_srv_uav_heap = nullptr;
     
     struct
@@ -115,6 +174,9 @@ private:
         ID3D12PipelineState * compute_pso = nullptr;
         ID3D12RootSignature * root_signature = nullptr;
         D3D12_GPU_DESCRIPTOR_HANDLE descriptor_table_start[FrameQueueLength];
+        // Same root signature, PackedFragment view of fragment_buffer
+        ID3D12PipelineState * packed_compute_pso = nullptr;
+        D3D12_GPU_DESCRIPTOR_HANDLE packed_descriptor_table_start[FrameQueueLength];
     } fragment_shading_pass;
 
     // 1. Clear FrameBuffer with Color and Depth
@@ -163,7 +225,7 @@ private:
 
         // Transformed Vertices Buffer
         {
-            uint32_t transformed_vertices_buffer_bytes = static_cast<uint32_t>(mesh.vertices.size()) * sizeof(OutputVertexAttributes);
+            uint32_t transformed_vertices_buffer_bytes = mesh_view.vertex_count * sizeof(OutputVertexAttributes);
             D3D12_RESOURCE_DESC     resource_desc   = GetBufferResourceDesc(transformed_vertices_buffer_bytes);
             resource_desc.Flags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
 
@@ -194,6 +256,44 @@ private:
                 CHECK_AND_FAIL(res);
             }
         }
+
+        // CPU Rasterizer + Fragment Upload Buffer
+        {
+            cpu_primitive_assembler.Init(cpu_thread_pool);
+            cpu_rasterizer.Init(window_width, window_height, cpu_thread_pool);
+            BuildVertexStreams(mesh_view.vertices, mesh_view.vertex_count, cpu_vertex_streams);
+            QuantizeVertices(mesh_view.vertices, mesh_view.vertex_count, cpu_quantized_vertex_streams);
+            cpu_meshlet_culler.Init(cpu_thread_pool);
+            cpu_meshlet_culler.SetCullMode(cpu_primitive_assembler.GetCullMode());
+            MeshFileView const & file_view = mesh_file.GetView();
+            if(nullptr != file_view.meshlets) {
+                cpu_meshlet_mesh.meshlets.assign(file_view.meshlets, file_view.meshlets + file_view.meshlet_count);
+                cpu_meshlet_mesh.vertices.assign(file_view.meshlet_vertices, file_view.meshlet_vertices + file_view.meshlet_vertex_count);
+                cpu_meshlet_mesh.triangles.assign(file_view.meshlet_triangles, file_view.meshlet_triangles + file_view.meshlet_triangle_count * 3);
+            } else {
+                BuildMeshlets(mesh_view, cpu_meshlet_mesh);
+            }
+            BuildVertexStreams(cpu_meshlet_mesh.vertices.data(), static_cast<uint32_t>(cpu_meshlet_mesh.vertices.size()), cpu_meshlet_vertex_streams);
+            cpu_transformed_vertices.resize(mesh_view.vertex_count);
+            cpu_clip_positions.resize(mesh_view.vertex_count);
+            // Sized for the tiled layout (padded to whole tiles) so the layout can change in the UI
+            size_t const fragment_count = GetRasterTargetPixelCount(RasterTargetLayout::Tiled, window_width, window_height);
+            cpu_fragments.resize(fragment_count);
+            cpu_packed_fragments.resize(fragment_count);
+            cpu_resolved_fragments.resize(window_width * window_height);
+
+            D3D12_HEAP_PROPERTIES   upload_heap_props   = GetDefaultHeapProps(D3D12_HEAP_TYPE_UPLOAD);
+            D3D12_RESOURCE_DESC     resource_desc       = GetBufferResourceDesc(window_width * window_height * sizeof(Fragment));
+            for(uint32_t i = 0; i < FrameQueueLength; ++i) {
+                res = device->CreateCommittedResource(&upload_heap_props,
+                    D3D12_HEAP_FLAG_NONE,
+                    &resource_desc,
+                    D3D12_RESOURCE_STATE_GENERIC_READ,
+                    nullptr,
+                    IID_PPV_ARGS(&fragment_upload_buffer[i]));
+                CHECK_AND_FAIL(res);
+            }
+        }
         
         // DepthArray Allocation
         {
@@ -329,7 +429,7 @@ private:
                     uav_desc.Format = DXGI_FORMAT_UNKNOWN;
                     uav_desc.ViewDimension = D3D12_UAV_DIMENSION_BUFFER;
                     uav_desc.Buffer.FirstElement = 0;
-                    uav_desc.Buffer.NumElements = static_cast<uint32_t>(mesh.vertices.size());
+                    uav_desc.Buffer.NumElements = mesh_view.vertex_count;
                     uav_desc.Buffer.StructureByteStride = sizeof(OutputVertexAttributes);
                     uav_desc.Buffer.CounterOffsetInBytes = 0;
                     uav_desc.Buffer.Flags = D3D12_BUFFER_UAV_FLAG_NONE;
@@ -342,7 +442,7 @@ private:
                     srv_desc.ViewDimension = D3D12_SRV_DIMENSION_BUFFER;
                     srv_desc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
                     srv_desc.Buffer.FirstElement = 0;
-                    srv_desc.Buffer.NumElements = static_cast<uint32_t>(mesh.vertices.size());
+                    srv_desc.Buffer.NumElements = mesh_view.vertex_count;
                     srv_desc.Buffer.StructureByteStride = sizeof(InputVertexAttributes);
                     srv_desc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_NONE;
                     device->CreateShaderResourceView(vertex_buffer, &srv_desc, current_cpu_handle);
@@ -406,10 +506,10 @@ private:
                 parameters[0].DescriptorTable.pDescriptorRanges = descriptor_ranges;
                 
                 // : register(b0, space1)
-                parameters[1].ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS; // indices_count
+                parameters[1].ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS; // indices_count, width, height, first_index
                 parameters[1].Constants.ShaderRegister = 0;
                 parameters[1].Constants.RegisterSpace = 1;
-                parameters[1].Constants.Num32BitValues = 3;
+                parameters[1].Constants.Num32BitValues = 4;
 
                 ID3DBlob * rs_blob = nullptr;
                 ID3DBlob * rs_error_blob = nullptr;
@@ -480,7 +580,7 @@ private:
                     srv_desc.ViewDimension = D3D12_SRV_DIMENSION_BUFFER;
                     srv_desc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
                     srv_desc.Buffer.FirstElement = 0;
-                    srv_desc.Buffer.NumElements = static_cast<uint32_t>(mesh.vertices.size());
+                    srv_desc.Buffer.NumElements = mesh_view.vertex_count;
                     srv_desc.Buffer.StructureByteStride = sizeof(OutputVertexAttributes);
                     srv_desc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_NONE;
                     device->CreateShaderResourceView(transformed_vertices_buffer[i], &srv_desc, current_cpu_handle);
@@ -492,7 +592,7 @@ private:
                     srv_desc.ViewDimension = D3D12_SRV_DIMENSION_BUFFER;
                     srv_desc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
                     srv_desc.Buffer.FirstElement = 0;
-                    srv_desc.Buffer.NumElements = static_cast<uint32_t>(mesh.indices.size());
+                    srv_desc.Buffer.NumElements = static_cast<uint32_t>(mesh_lods.indices.size());
                     srv_desc.Buffer.StructureByteStride = sizeof(IndexType);
                     srv_desc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_NONE;
                     device->CreateShaderResourceView(index_buffer, &srv_desc, current_cpu_handle);
@@ -568,6 +668,20 @@ private:
                 device->CreateComputePipelineState(&pso_desc, IID_PPV_ARGS(&fragment_shading_pass.compute_pso));
             }
             compute_shader->Release();
+
+            IDxcBlob * packed_compute_shader = Demo::CompileShaderFromFile(L"../code/src/shaders/demo003/rasterization/fragment_shading_packed.comp.hlsl", L"main", L"cs_6_0");
+            ASSERT(nullptr != packed_compute_shader);
+            {
+                D3D12_COMPUTE_PIPELINE_STATE_DESC pso_desc = {};
+                pso_desc.pRootSignature = fragment_shading_pass.root_signature;
+                pso_desc.CS.pShaderBytecode = packed_compute_shader->GetBufferPointer();
+                pso_desc.CS.BytecodeLength = packed_compute_shader->GetBufferSize();
+                pso_desc.NodeMask = 0;
+                pso_desc.CachedPSO = {};
+                pso_desc.Flags = D3D12_PIPELINE_STATE_FLAG_NONE;
+                device->CreateComputePipelineState(&pso_desc, IID_PPV_ARGS(&fragment_shading_pass.packed_compute_pso));
+            }
+            packed_compute_shader->Release();
             
             // Create UAV+SRV(Framebuffer+Fragments)
             {
@@ -597,6 +711,35 @@ private:
                     current_gpu_handle.ptr += device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
                 }
             }
+
+            // Create UAV+SRV(Framebuffer+PackedFragments), the packed fragments fit in the front of fragment_buffer
+            {
+                for(uint32_t i = 0; i < FrameQueueLength; ++i) {
+
+                    fragment_shading_pass.packed_descriptor_table_start[i] = current_gpu_handle;
+
+                    D3D12_UNORDERED_ACCESS_VIEW_DESC uav_desc = {};
+                    uav_desc.Format = texture_resource_desc.Format;
+                    uav_desc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D;
+                    uav_desc.Texture2D.MipSlice = 0;
+                    uav_desc.Texture2D.PlaneSlice = 0;
+                    device->CreateUnorderedAccessView(frame_buffer[i], nullptr, &uav_desc, current_cpu_handle);
+                    current_cpu_handle.ptr += device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+                    current_gpu_handle.ptr += device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+
+                    D3D12_SHADER_RESOURCE_VIEW_DESC srv_desc = {};
+                    srv_desc.Format = DXGI_FORMAT_UNKNOWN;
+                    srv_desc.ViewDimension = D3D12_SRV_DIMENSION_BUFFER;
+                    srv_desc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+                    srv_desc.Buffer.FirstElement = 0;
+                    srv_desc.Buffer.NumElements = window_width * window_height;
+                    srv_desc.Buffer.StructureByteStride = sizeof(PackedFragment);
+                    srv_desc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_NONE;
+                    device->CreateShaderResourceView(fragment_buffer[i], &srv_desc, current_cpu_handle);
+                    current_cpu_handle.ptr += device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+                    current_gpu_handle.ptr += device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+                }
+            }
         }
     }
     void Exit_Rasterization () {
@@ -604,12 +747,22 @@ private:
         for(uint32_t i = 0; i < FrameQueueLength; ++i) {
             frame_buffer[i]->Release();
             fragment_buffer[i]->Release();
+            fragment_upload_buffer[i]->Release();
             transformed_vertices_buffer[i]->Release();
             mvp_buffer[i]->Release();
         }
 
         cbv_srv_uav_heap->Release();
 
+        // CPU Rasterizer
+        {
+            cpu_rasterizer.Exit();
+            cpu_meshlet_culler.Exit();
+            cpu_primitive_assembler.Exit();
+            delete cpu_thread_pool;
+            cpu_thread_pool = nullptr;
+        }
+
         // Rasterizer Pass
         {
             rasterizer_pass.compute_pso->Release();
@@ -619,6 +772,7 @@ private:
         // Fragment Shading Pass
         {
             fragment_shading_pass.compute_pso->Release();
+            fragment_shading_pass.packed_compute_pso->Release();
             fragment_shading_pass.root_signature->Release();
         }
 
@@ -866,10 +1020,28 @@ bool Demo_003_RasterizerCompute::DoInitResources() {
     vertex_shader->Release();
     pixel_shader->Release();
 
-    GetTriangleMesh(&mesh);
+    // Created here rather than in Init_Rasterization so the mesh import runs on it too
+    cpu_thread_pool = new ThreadPool();
+
+    // Mesh files are written already optimized (see WriteMeshFile), so there's only the analysis left.
+    // Otherwise an OBJ next to the other assets, or the built-in triangle.
+    if(mesh_file.Open("../assets/mesh.rmsh")) {
+        mesh_view = mesh_file.GetView().mesh;
+        mesh_optimization_stats.before = AnalyzeVertexCache(mesh_view.indices, mesh_view.index_count, mesh_view.vertex_count, sizeof(OutputVertexAttributes));
+        mesh_optimization_stats.after = mesh_optimization_stats.before;
+    } else {
+        mesh_imported = ImportObj("../assets/mesh.obj", mesh, cpu_thread_pool, &mesh_import_stats);
+        if(!mesh_imported) {
+            GetTriangleMesh(&mesh);
+        }
+        OptimizeMesh(mesh, &mesh_optimization_stats);
+        mesh_view = GetMeshView(mesh);
+    }
     
-    vertex_buffer_bytes = sizeof(Vertex) * mesh.vertices.size();
-    index_buffer_bytes = sizeof(IndexType) * mesh.indices.size();
+    BuildMeshLods(mesh_view, mesh_lods);
+
+    vertex_buffer_bytes = sizeof(Vertex) * mesh_view.vertex_count;
+    index_buffer_bytes = sizeof(IndexType) * mesh_lods.indices.size();
 
     // Vertex Buffer
     {
@@ -901,7 +1073,7 @@ bool Demo_003_RasterizerCompute::DoInitResources() {
         using Byte = uint8_t;
         Byte * vertex_data_begin = nullptr;
         res = staging_vertex_buffer->Map(0, &read_range, reinterpret_cast<void**>(&vertex_data_begin)); CHECK_AND_FAIL(res);
-        memcpy(vertex_data_begin, mesh.vertices.data(), vertex_buffer_bytes);
+        memcpy(vertex_data_begin, mesh_view.vertices, vertex_buffer_bytes);
         staging_vertex_buffer->Unmap(0, nullptr); 
 
         // Copy to Buffer
@@ -965,7 +1137,7 @@ bool Demo_003_RasterizerCompute::DoInitResources() {
         using Byte = uint8_t;
         Byte * index_data_begin = nullptr;
         staging_index_buffer->Map(0, &read_range, reinterpret_cast<void**>(&index_data_begin));
-        memcpy(index_data_begin, mesh.indices.data(), index_buffer_bytes);
+        memcpy(index_data_begin, mesh_lods.indices.data(), index_buffer_bytes);
         staging_index_buffer->Unmap(0, nullptr);
 
         // Copy to Buffer
@@ -1020,6 +1192,8 @@ bool Demo_003_RasterizerCompute::DoExitResources() {
 
     vertex_buffer->Release();
     index_buffer->Release();
+    mesh_file.Close();
+    mesh_view = {};
 
     for(uint32_t n = 0; n < FrameQueueLength; ++n) {
         swap_chain_render_targets[n]->Release();
@@ -1057,7 +1231,77 @@ void Demo_003_RasterizerCompute::OnUI() {
     // ImGui::ShowDemoWindow(&show_window);
     ImGui::Begin("Settings", &show_window);
 
+    if(mesh_imported) {
+        ImGui::Text("OBJ Import: %.1f MB in %.1f ms (%.0f MB/s), parse %.1f ms (%.0f MB/s)",
+            static_cast<double>(mesh_import_stats.file_bytes) / (1024.0 * 1024.0), mesh_import_stats.total_ms, mesh_import_stats.total_mb_per_s,
+            mesh_import_stats.parse_ms, mesh_import_stats.parse_mb_per_s);
+        ImGui::Text("OBJ Weld: %u triangles, %u vertices in %.1f ms, normals %s",
+            mesh_import_stats.triangles, mesh_import_stats.vertices, mesh_import_stats.weld_ms, mesh_import_stats.generated_normals ? "generated" : "from file");
+    }
+    ImGui::Text("Vertex Cache ACMR: %.3f -> %.3f, ATVR: %.3f -> %.3f",
+        mesh_optimization_stats.before.acmr, mesh_optimization_stats.after.acmr, mesh_optimization_stats.before.atvr, mesh_optimization_stats.after.atvr);
+    ImGui::Text("Vertex Fetch Overfetch: %.2f -> %.2f", mesh_optimization_stats.before.overfetch, mesh_optimization_stats.after.overfetch);
+    ImGui::Checkbox("Screen Space Error LOD", &use_mesh_lods);
+    if(use_mesh_lods) {
+        ImGui::SliderFloat("Max LOD Error (pixels)", &lod_max_pixel_error, 0.1f, 16.0f);
+    }
+    ImGui::Text("LOD %u of %u: %u triangles, %.2f px error", current_lod, static_cast<uint32_t>(mesh_lods.lods.size()),
+        mesh_lods.lods[current_lod].index_count / 3, GetMeshLodPixelError(mesh_lods, current_lod, cpu_transforms, static_cast<float>(window_height)));
     ImGui::Checkbox("Software Rasterization", &use_software_rasterizer);
+    if(use_software_rasterizer) {
+        ImGui::Checkbox("CPU Vertex Shading + Rasterization", &use_cpu_rasterizer);
+        if(use_cpu_rasterizer) {
+            int simd_level = static_cast<int>(cpu_rasterizer.GetActiveSimdLevel());
+            if(ImGui::Combo("CPU SIMD Kernels", &simd_level, "Scalar\0SSE\0AVX2\0AVX-512\0")) {
+                cpu_rasterizer.SetSimdLevel(static_cast<SimdLevel>(simd_level));
+            }
+            int subpixel_bits = static_cast<int>(cpu_rasterizer.GetSubpixelBits());
+            if(ImGui::SliderInt("Subpixel Bits", &subpixel_bits, 1, static_cast<int>(MaxSubpixelBits))) {
+                cpu_rasterizer.SetSubpixelBits(static_cast<uint32_t>(subpixel_bits));
+            }
+            int output_mode = static_cast<int>(cpu_rasterizer.GetOutputMode());
+            if(ImGui::Combo("CPU Raster Output", &output_mode, "Fragments\0Visibility Buffer\0")) {
+                cpu_rasterizer.SetOutputMode(static_cast<RasterOutputMode>(output_mode));
+            }
+            ImGui::Checkbox("Packed Fragments (16 bytes)", &use_packed_fragments);
+            if(!use_packed_fragments) {
+                ImGui::Checkbox("CPU Fragment Shading", &use_cpu_fragment_shading);
+                if(use_cpu_fragment_shading) {
+                    ImGui::Checkbox("sRGB Output", &use_srgb_output);
+                }
+            }
+            int target_layout = static_cast<int>(cpu_rasterizer.GetTargetLayout());
+            if(ImGui::Combo("CPU Target Layout", &target_layout, "Linear\0Tiled 8x8\0")) {
+                cpu_rasterizer.SetTargetLayout(static_cast<RasterTargetLayout>(target_layout));
+            }
+            bool depth_test = cpu_rasterizer.GetDepthTest();
+            if(ImGui::Checkbox("Depth Test (Hierarchical Z)", &depth_test)) {
+                cpu_rasterizer.SetDepthTest(depth_test);
+            }
+            int cull_mode = static_cast<int>(cpu_primitive_assembler.GetCullMode());
+            if(ImGui::Combo("Cull Mode", &cull_mode, "None\0Back\0Front\0")) {
+                cpu_primitive_assembler.SetCullMode(static_cast<CullMode>(cull_mode));
+                cpu_meshlet_culler.SetCullMode(static_cast<CullMode>(cull_mode));
+            }
+            ImGui::Checkbox("Meshlet Culling", &use_meshlet_culling);
+            if(!use_meshlet_culling) {
+                ImGui::Checkbox("Quantized Vertices (18 bytes)", &use_quantized_vertices);
+            }
+            if(use_meshlet_culling) {
+                MeshletCullStats const & meshlet_stats = cpu_meshlet_culler.GetStats();
+                ImGui::Text("Meshlets: %u visible of %u, culled %u frustum, %u cone",
+                    meshlet_stats.visible, static_cast<uint32_t>(cpu_meshlet_mesh.meshlets.size()), meshlet_stats.culled_frustum, meshlet_stats.culled_cone);
+                ImGui::Text("Shaded: %u vertices, %u triangles", meshlet_stats.visible_vertices, meshlet_stats.visible_triangles);
+            }
+            PrimitiveAssemblyStats const & assembly_stats = cpu_primitive_assembler.GetStats();
+            ImGui::Text("Triangles: %u accepted, %u rejected, %u clipped into %u",
+                assembly_stats.accepted, assembly_stats.rejected, assembly_stats.clipped, assembly_stats.clipped_output);
+            ImGui::Text("Culled: %u back-face, %u zero area, %u small",
+                assembly_stats.culled_backface, assembly_stats.culled_zero_area, assembly_stats.culled_small);
+            ImGui::Text("Rasterized: %u", assembly_stats.output);
+            ImGui::Text("Tiles left cleared: %u of %u", cpu_rasterizer.GetClearedTileCount(), cpu_rasterizer.GetTileCountX() * cpu_rasterizer.GetTileCountY());
+        }
+    }
 
     ImGui::End();
 }
@@ -1069,6 +1313,9 @@ void Demo_003_RasterizerCompute::OnUpdate() {
     mvp_uniform.view_mat = DirectX::XMMatrixIdentity();
     mvp_uniform.proj_mat = DirectX::XMMatrixIdentity();
     static_assert(sizeof(DirectX::XMMATRIX) == sizeof(DirectX::XMFLOAT4X4));
+    static_assert(sizeof(VertexShadingUniform) == sizeof(VertexTransforms));
+    memcpy(&cpu_transforms, &mvp_uniform, sizeof(VertexTransforms));
+    current_lod = use_mesh_lods ? SelectMeshLod(mesh_lods, cpu_transforms, static_cast<float>(window_height), lod_max_pixel_error) : 0;
 
     D3D12_RANGE read_range = {}; read_range.Begin = 0; read_range.End = 0;
     using Byte = uint8_t;
@@ -1087,53 +1334,175 @@ void Demo_003_RasterizerCompute::OnRender() {
         rtv_handle.ptr = rtv_handle.ptr + SIZE_T(frame_index * rtv_handle_increment_size);
 
         if(true == use_software_rasterizer) {
-            
+            bool const cpu_fragment_shading = use_cpu_rasterizer && use_cpu_fragment_shading && !use_packed_fragments;
+
             current_cmd_list->SetDescriptorHeaps(1, &cbv_srv_uav_heap);
             
-            // Vertex Shading Pass
-            {
-                current_cmd_list->SetComputeRootSignature(vertex_shading_pass.root_signature);
-                current_cmd_list->SetPipelineState(vertex_shading_pass.compute_pso);
-                current_cmd_list->SetComputeRootDescriptorTable(0, vertex_shading_pass.descriptor_table_start[frame_index]);
-
-                uint32_t vertices_count = static_cast<uint32_t>(mesh.vertices.size());
-                current_cmd_list->SetComputeRoot32BitConstants(1, 1, &vertices_count, 0);
+            if(true == use_cpu_rasterizer) {
+                // Vertex Shading + Rasterization on CPU
+                {
+                    uint32_t vertices_count = 0;
+                    uint32_t indices_count = 0;
+                    IndexType const * indices = nullptr;
+                    // Assemble leaves the clipped vertices at the end, so both paths size the arrays to their own vertices first.
+                    if(use_meshlet_culling) {
+                        cpu_meshlet_culler.Cull(cpu_meshlet_mesh, cpu_transforms, cpu_meshlet_vertex_ranges, cpu_meshlet_indices);
+                        vertices_count = static_cast<uint32_t>(cpu_meshlet_mesh.vertices.size());
+                        indices_count = static_cast<uint32_t>(cpu_meshlet_indices.size());
+                        indices = cpu_meshlet_indices.data();
+                        cpu_transformed_vertices.resize(vertices_count);
+                        cpu_clip_positions.resize(vertices_count);
+                        ShadeVertexRanges(cpu_meshlet_vertex_streams, cpu_meshlet_vertex_ranges.data(), static_cast<uint32_t>(cpu_meshlet_vertex_ranges.size()), cpu_transforms,
+                            cpu_transformed_vertices.data(), cpu_clip_positions.data(), cpu_thread_pool, cpu_rasterizer.GetActiveSimdLevel());
+                    } else {
+                        MeshLod const & lod = mesh_lods.lods[current_lod];
+                        vertices_count = mesh_view.vertex_count;
+                        indices_count = lod.index_count;
+                        indices = mesh_lods.indices.data() + lod.index_offset;
+                        cpu_transformed_vertices.resize(vertices_count);
+                        cpu_clip_positions.resize(vertices_count);
+                        if(use_quantized_vertices) {
+                            ShadeQuantizedVertices(cpu_quantized_vertex_streams, cpu_transforms, cpu_transformed_vertices.data(), cpu_clip_positions.data(), cpu_thread_pool, cpu_rasterizer.GetActiveSimdLevel());
+                        } else {
+                            ShadeVertices(cpu_vertex_streams, cpu_transforms, cpu_transformed_vertices.data(), cpu_clip_positions.data(), cpu_thread_pool, cpu_rasterizer.GetActiveSimdLevel());
+                        }
+                    }
+                    cpu_primitive_assembler.Assemble(cpu_transformed_vertices, cpu_clip_positions.data(), vertices_count,
+                        indices, indices_count,
+                        cpu_rasterizer.GetViewport(), cpu_assembled_indices);
+                    uint32_t assembled_indices_count = static_cast<uint32_t>(cpu_assembled_indices.size());
+                    if(use_packed_fragments) {
+                        cpu_rasterizer.Draw(cpu_transformed_vertices.data(), cpu_assembled_indices.data(), assembled_indices_count, cpu_packed_fragments.data());
+                    } else {
+                        cpu_rasterizer.Draw(cpu_transformed_vertices.data(), cpu_assembled_indices.data(), assembled_indices_count, cpu_fragments.data());
+                    }
+                }
 
-                constexpr uint32_t thread_group_size_x = 16;
-                constexpr uint32_t thread_group_size_y = 1;
-                constexpr uint32_t thread_group_size_z = 1;
-                uint32_t thread_group_count_x = (static_cast<uint32_t>(mesh.vertices.size()) / thread_group_size_x) + 1;
-                uint32_t thread_group_count_y = 1;
-                uint32_t thread_group_count_z = 1;
-                current_cmd_list->Dispatch(thread_group_count_x, thread_group_count_y, thread_group_count_z);
-            }
+                if(cpu_fragment_shading) {
+                    // Fragment Shading on the CPU, written into the upload buffer in the footprint of frame_buffer
+                    // upload buffer of this frame is free: MoveToNextFrame waited for its fence.
+                    cpu_rasterizer.ResolveFragments(cpu_fragments.data(), cpu_resolved_fragments.data());
+
+                    D3D12_RESOURCE_DESC const frame_buffer_desc = frame_buffer[frame_index]->GetDesc();
+                    D3D12_PLACED_SUBRESOURCE_FOOTPRINT foot_print = {};
+                    device->GetCopyableFootprints(&frame_buffer_desc, 0, 1, 0, &foot_print, nullptr, nullptr, nullptr);
+
+                    D3D12_RANGE read_range = {}; read_range.Begin = 0; read_range.End = 0;
+                    using Byte = uint8_t;
+                    Byte * data_begin = nullptr;
+                    HRESULT res = fragment_upload_buffer[frame_index]->Map(0, &read_range, reinterpret_cast<void**>(&data_begin)); CHECK_AND_FAIL(res);
+                    ShadeFragments(cpu_resolved_fragments.data(), window_width, window_height,
+                        use_srgb_output ? ColorEncoding::sRGB : ColorEncoding::Linear,
+                        data_begin + foot_print.Offset, foot_print.Footprint.RowPitch, cpu_thread_pool, cpu_rasterizer.GetActiveSimdLevel());
+                    fragment_upload_buffer[frame_index]->Unmap(0, nullptr);
+
+                    D3D12_RESOURCE_BARRIER barrier = {};
+                    barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+                    barrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+                    barrier.Transition.pResource = frame_buffer[frame_index];
+                    barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+                    barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_COPY_DEST;
+                    current_cmd_list->ResourceBarrier(1, &barrier);
+
+                    D3D12_TEXTURE_COPY_LOCATION dst = {};
+                    dst.pResource = frame_buffer[frame_index];
+                    dst.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
+                    dst.SubresourceIndex = 0;
+
+                    D3D12_TEXTURE_COPY_LOCATION src = {};
+                    src.pResource = fragment_upload_buffer[frame_index];
+                    src.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
+                    src.PlacedFootprint = foot_print;
+
+                    current_cmd_list->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+
+                    barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_DEST;
+                    barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+                    current_cmd_list->ResourceBarrier(1, &barrier);
+                } else {
+                    // Upload Fragments
+                    // upload buffer of this frame is free: MoveToNextFrame waited for its fence.
+                    size_t const pixel_count = static_cast<size_t>(window_width) * window_height;
+                    size_t fragment_buffer_bytes = pixel_count * (use_packed_fragments ? sizeof(PackedFragment) : sizeof(Fragment));
+                    D3D12_RANGE read_range = {}; read_range.Begin = 0; read_range.End = 0;
+                    using Byte = uint8_t;
+                    Byte * data_begin = nullptr;
+                    HRESULT res = fragment_upload_buffer[frame_index]->Map(0, &read_range, reinterpret_cast<void**>(&data_begin)); CHECK_AND_FAIL(res);
+                    // Linear: a copy, Tiled: resolved to the linear, bottom row first layout straight into the upload buffer
+                    if(use_packed_fragments) {
+                        cpu_rasterizer.ResolveFragments(cpu_packed_fragments.data(), reinterpret_cast<PackedFragment *>(data_begin));
+                    } else {
+                        cpu_rasterizer.ResolveFragments(cpu_fragments.data(), reinterpret_cast<Fragment *>(data_begin));
+                    }
+                    fragment_upload_buffer[frame_index]->Unmap(0, nullptr);
+
+                    D3D12_RESOURCE_BARRIER barrier = {};
+                    barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+                    barrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+                    barrier.Transition.pResource = fragment_buffer[frame_index];
+                    barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
+                    barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_COPY_DEST;
+                    current_cmd_list->ResourceBarrier(1, &barrier);
+
+                    current_cmd_list->CopyBufferRegion(fragment_buffer[frame_index], 0, fragment_upload_buffer[frame_index], 0, fragment_buffer_bytes);
+
+                    barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_DEST;
+                    barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
+                    current_cmd_list->ResourceBarrier(1, &barrier);
+                }
+            } else {
+                // Vertex Shading Pass
+                {
+                    current_cmd_list->SetComputeRootSignature(vertex_shading_pass.root_signature);
+                    current_cmd_list->SetPipelineState(vertex_shading_pass.compute_pso);
+                    current_cmd_list->SetComputeRootDescriptorTable(0, vertex_shading_pass.descriptor_table_start[frame_index]);
+
+                    uint32_t vertices_count = mesh_view.vertex_count;
+                    current_cmd_list->SetComputeRoot32BitConstants(1, 1, &vertices_count, 0);
+
+                    constexpr uint32_t thread_group_size_x = 16;
+                    constexpr uint32_t thread_group_size_y = 1;
+                    constexpr uint32_t thread_group_size_z = 1;
+                    uint32_t thread_group_count_x = (mesh_view.vertex_count / thread_group_size_x) + 1;
+                    uint32_t thread_group_count_y = 1;
+                    uint32_t thread_group_count_z = 1;
+                    current_cmd_list->Dispatch(thread_group_count_x, thread_group_count_y, thread_group_count_z);
+                }
             
-            // Rasterization
-            {
-                current_cmd_list->SetComputeRootSignature(rasterizer_pass.root_signature);
-                current_cmd_list->SetPipelineState(rasterizer_pass.compute_pso);
-                current_cmd_list->SetComputeRootDescriptorTable(0, rasterizer_pass.descriptor_table_start[frame_index]);
+                // Rasterization
+                {
+                    current_cmd_list->SetComputeRootSignature(rasterizer_pass.root_signature);
+                    current_cmd_list->SetPipelineState(rasterizer_pass.compute_pso);
+                    current_cmd_list->SetComputeRootDescriptorTable(0, rasterizer_pass.descriptor_table_start[frame_index]);
                 
-                uint32_t indices_count = static_cast<uint32_t>(mesh.indices.size());
-                current_cmd_list->SetComputeRoot32BitConstants(1, 1, &indices_count, 0);
-                current_cmd_list->SetComputeRoot32BitConstants(1, 1, &window_width, 1);
-                current_cmd_list->SetComputeRoot32BitConstants(1, 1, &window_height, 2);
-
-                constexpr uint32_t thread_group_size_x = 16;
-                constexpr uint32_t thread_group_size_y = 1;
-                constexpr uint32_t thread_group_size_z = 1;
-                uint32_t triangle_count = static_cast<uint32_t>(mesh.indices.size() / 3);
-                uint32_t thread_group_count_x = (triangle_count / thread_group_size_x) + 1;
-                uint32_t thread_group_count_y = 1;
-                uint32_t thread_group_count_z = 1;
-                current_cmd_list->Dispatch(thread_group_count_x, thread_group_count_y, thread_group_count_z);
+                    MeshLod const & lod = mesh_lods.lods[current_lod];
+                    current_cmd_list->SetComputeRoot32BitConstants(1, 1, &lod.index_count, 0);
+                    current_cmd_list->SetComputeRoot32BitConstants(1, 1, &window_width, 1);
+                    current_cmd_list->SetComputeRoot32BitConstants(1, 1, &window_height, 2);
+                    current_cmd_list->SetComputeRoot32BitConstants(1, 1, &lod.index_offset, 3);
+
+                    constexpr uint32_t thread_group_size_x = 16;
+                    constexpr uint32_t thread_group_size_y = 1;
+                    constexpr uint32_t thread_group_size_z = 1;
+                    uint32_t triangle_count = lod.index_count / 3;
+                    uint32_t thread_group_count_x = (triangle_count / thread_group_size_x) + 1;
+                    uint32_t thread_group_count_y = 1;
+                    uint32_t thread_group_count_z = 1;
+                    current_cmd_list->Dispatch(thread_group_count_x, thread_group_count_y, thread_group_count_z);
+                }
             }
 
             // Fragment Shading Pass
-            {
+            if(false == cpu_fragment_shading) {
+                bool const packed = use_cpu_rasterizer && use_packed_fragments;
                 current_cmd_list->SetComputeRootSignature(fragment_shading_pass.root_signature);
-                current_cmd_list->SetPipelineState(fragment_shading_pass.compute_pso);
-                current_cmd_list->SetComputeRootDescriptorTable(0, fragment_shading_pass.descriptor_table_start[frame_index]);
+                if(packed) {
+                    current_cmd_list->SetPipelineState(fragment_shading_pass.packed_compute_pso);
+                    current_cmd_list->SetComputeRootDescriptorTable(0, fragment_shading_pass.packed_descriptor_table_start[frame_index]);
+                } else {
+                    current_cmd_list->SetPipelineState(fragment_shading_pass.compute_pso);
+                    current_cmd_list->SetComputeRootDescriptorTable(0, fragment_shading_pass.descriptor_table_start[frame_index]);
+                }
                 constexpr uint32_t thread_group_size_x = 16;
                 constexpr uint32_t thread_group_size_y = 16;
                 constexpr uint32_t thread_group_size_z = 1;
@@ -1244,7 +1613,8 @@ void Demo_003_RasterizerCompute::OnRender() {
             current_cmd_list->SetPipelineState(graphics_pso);
 
             // Draw Indexed
-            current_cmd_list->DrawIndexedInstanced((uint32_t)mesh.indices.size(), 1, 0, 0, 0);
+            MeshLod const & lod = mesh_lods.lods[current_lod];
+            current_cmd_list->DrawIndexedInstanced(lod.index_count, 1, lod.index_offset, 0, 0);
 
             RenderUI(current_cmd_list);
             
@@ -0,0 +1,42 @@
+
+// Input
+struct PackedFragment { // cpu/fragment_packing.hpp
+    float depth;    // pos_ndc.z, pos_ndc.xy is the pixel center
+    uint normal;    // octahedral, 2 x snorm16
+    uint color;     // RGBA8
+    uint uv;        // 2 x half
+};
+StructuredBuffer<PackedFragment> fragments : register(t0, space1);
+
+struct CS_SystemValues {
+    uint GI : SV_GroupIndex;
+    uint3 GTid : SV_GroupThreadID;
+    uint3 DTid : SV_DispatchThreadID;
+};
+
+// Output
+RWTexture2D<float4> Framebuffer : register(u0, space1);
+
+float4 UnpackColor(uint bits) {
+    return float4(bits & 0xFF, (bits >> 8) & 0xFF, (bits >> 16) & 0xFF, bits >> 24) / 255.0f;
+}
+
+float4 PackColor(float4 linear_color) {
+    // no srgb support yet.
+    return linear_color;
+}
+
+// 1 thread per fragment
+[numthreads( 16, 16, 1 )]
+void main(CS_SystemValues cs) {
+    int width, height;
+    Framebuffer.GetDimensions(width, height);
+    int x = cs.DTid.x;
+    int y = cs.DTid.y;
+    int index = y * width + x;
+    PackedFragment frag = fragments[index];
+
+    if(x < width && y < height) {
+        Framebuffer[cs.DTid.xy] = PackColor(float4(UnpackColor(frag.color).xyz, 1.0f));
+    }
+}
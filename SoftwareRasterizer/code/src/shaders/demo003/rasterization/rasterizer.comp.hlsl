@@ -15,6 +15,7 @@ cbuffer info : register(b0, space1) {
     uint indices_count;
     uint width;
     uint height;
+    uint first_index; // of the LOD drawn, indices holds all of them
 };
 
 // Output
@@ -107,9 +108,9 @@ void main(CS_SystemValues cs) {
     int tid = cs.DTid.x;
     // fragments[tid].color = float3(1.0f, 0.0f, 0.0f);
     if(3 * tid + 2 < indices_count) {
-        OutputVertexAttribs v0 = vertices[indices[3 * tid + 0]];
-        OutputVertexAttribs v1 = vertices[indices[3 * tid + 1]];
-        OutputVertexAttribs v2 = vertices[indices[3 * tid + 2]];
+        OutputVertexAttribs v0 = vertices[indices[first_index + 3 * tid + 0]];
+        OutputVertexAttribs v1 = vertices[indices[first_index + 3 * tid + 1]];
+        OutputVertexAttribs v2 = vertices[indices[first_index + 3 * tid + 2]];
 
         float2 min_pointf = float2(0.0f, 0.0f);
         float2 max_pointf = float2(0.0f, 0.0f);